@@ -1211,14 +1211,9 @@ chat_text_view_insert_text_with_emoticons (EmpathyChatTextView *view,
 					   const gchar         *str)
 {
 	EmpathyChatTextViewPriv *priv = GET_PRIV (view);
-	gboolean                 use_smileys = FALSE;
 	GSList                  *smileys, *l;
 
-	empathy_conf_get_bool (empathy_conf_get (),
-			       EMPATHY_PREFS_CHAT_SHOW_SMILEYS,
-			       &use_smileys);
-
-	if (!use_smileys) {
+	if (!empathy_conf_get_cache (empathy_conf_get ())->chat_show_smileys) {
 		gtk_text_buffer_insert (priv->buffer, iter, str, -1);
 		return;
 	}
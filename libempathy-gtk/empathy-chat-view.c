@@ -25,6 +25,9 @@
 #include "empathy-chat-view.h"
 #include "empathy-smiley-manager.h"
 
+#define DEBUG_FLAG EMPATHY_DEBUG_CHAT
+#include <libempathy/empathy-debug.h>
+
 static void chat_view_base_init (gpointer klass);
 
 GType
@@ -66,8 +69,10 @@ empathy_chat_view_append_message (EmpathyChatView *view,
 	g_return_if_fail (EMPATHY_IS_CHAT_VIEW (view));
 	
 	if (EMPATHY_TYPE_CHAT_VIEW_GET_IFACE (view)->append_message) {
+		EMPATHY_TRACE_BEGIN (DEBUG_FLAG, "chat-view-append-message", 0);
 		EMPATHY_TYPE_CHAT_VIEW_GET_IFACE (view)->append_message (view,
 									 msg);
+		EMPATHY_TRACE_END (DEBUG_FLAG, "chat-view-append-message", 0);
 	}
 }
 
@@ -48,6 +48,7 @@
 #include "empathy-contact-list-store.h"
 #include "empathy-contact-list-view.h"
 #include "empathy-contact-menu.h"
+#include "empathy-nick-index.h"
 #include "empathy-theme-manager.h"
 #include "empathy-smiley-manager.h"
 #include "empathy-ui-utils.h"
@@ -75,7 +76,7 @@ typedef struct {
 	GSList            *sent_messages;
 	gint               sent_messages_index;
 	GList             *compositors;
-	GCompletion       *completion;
+	EmpathyNickIndex  *nick_index;
 	guint              composing_stop_timeout_id;
 	guint              block_events_timeout_id;
 	TpHandleType       handle_type;
@@ -508,13 +509,23 @@ chat_message_received (EmpathyChat *chat, EmpathyMessage *message)
 	g_signal_emit (chat, signals[NEW_MESSAGE], 0, message);
 }
 
+/* The pending backlog comes as one batch, acknowledged in one call */
 static void
-chat_message_received_cb (EmpathyTpChat  *tp_chat,
-			  EmpathyMessage *message,
-			  EmpathyChat    *chat)
+chat_messages_received_cb (EmpathyTpChat *tp_chat,
+			   GPtrArray     *messages,
+			   EmpathyChat   *chat)
 {
-	chat_message_received (chat, message);
-	empathy_tp_chat_acknowledge_message (tp_chat, message);
+	GList *list = NULL;
+	guint  i;
+
+	for (i = 0; i < messages->len; i++) {
+		chat_message_received (chat, g_ptr_array_index (messages, i));
+		list = g_list_prepend (list, g_ptr_array_index (messages, i));
+	}
+
+	list = g_list_reverse (list);
+	empathy_tp_chat_acknowledge_messages (tp_chat, list);
+	g_list_free (list);
 }
 
 static void
@@ -599,7 +610,10 @@ chat_input_text_buffer_changed_cb (GtkTextBuffer *buffer,
 	EmpathyChatPriv *priv;
 	GtkTextIter     start, end;
 	gchar          *str;
-	gboolean        spell_checker = FALSE;
+	GPtrArray      *words;
+	GArray         *offsets;
+	gboolean       *correct;
+	guint           i;
 
 	priv = GET_PRIV (chat);
 
@@ -609,13 +623,9 @@ chat_input_text_buffer_changed_cb (GtkTextBuffer *buffer,
 		chat_composing_start (chat);
 	}
 
-	empathy_conf_get_bool (empathy_conf_get (),
-                           EMPATHY_PREFS_CHAT_SPELL_CHECKER_ENABLED,
-                           &spell_checker);
-
 	gtk_text_buffer_get_start_iter (buffer, &start);
 
-	if (!spell_checker) {
+	if (!empathy_conf_get_cache (empathy_conf_get ())->chat_spell_checker_enabled) {
 		gtk_text_buffer_get_end_iter (buffer, &end);
 		gtk_text_buffer_remove_tag_by_name (buffer, "misspelled", &start, &end);
 		return;
@@ -627,10 +637,12 @@ chat_input_text_buffer_changed_cb (GtkTextBuffer *buffer,
 
 	/* NOTE: this is really inefficient, we shouldn't have to
 	   reiterate the whole buffer each time and check each work
-	   every time. */
-	while (TRUE) {
-		gboolean correct = FALSE;
+	   every time. Words are cached by the spell checker though, and
+	   we check them all in one go. */
+	words = g_ptr_array_new ();
+	offsets = g_array_new (FALSE, FALSE, sizeof (gint));
 
+	while (TRUE) {
 		/* if at start */
 		if (gtk_text_iter_is_start (&start)) {
 			end = start;
@@ -653,22 +665,44 @@ chat_input_text_buffer_changed_cb (GtkTextBuffer *buffer,
 
 		/* spell check string if not a command */
 		if (str[0] != '/') {
-			correct = empathy_spell_check (str);
+			gint offset;
+
+			g_ptr_array_add (words, str);
+			offset = gtk_text_iter_get_offset (&start);
+			g_array_append_val (offsets, offset);
+			offset = gtk_text_iter_get_offset (&end);
+			g_array_append_val (offsets, offset);
 		} else {
-			correct = TRUE;
+			gtk_text_buffer_remove_tag_by_name (buffer, "misspelled", &start, &end);
+			g_free (str);
 		}
 
-		if (!correct) {
+		/* set start iter to the end iters position */
+		start = end;
+	}
+
+	g_ptr_array_add (words, NULL);
+	correct = g_new (gboolean, words->len);
+	empathy_spell_check_words ((const gchar * const *) words->pdata, correct);
+
+	for (i = 0; i + 1 < words->len; i++) {
+		gtk_text_buffer_get_iter_at_offset (buffer, &start,
+			g_array_index (offsets, gint, 2 * i));
+		gtk_text_buffer_get_iter_at_offset (buffer, &end,
+			g_array_index (offsets, gint, 2 * i + 1));
+
+		if (!correct[i]) {
 			gtk_text_buffer_apply_tag_by_name (buffer, "misspelled", &start, &end);
 		} else {
 			gtk_text_buffer_remove_tag_by_name (buffer, "misspelled", &start, &end);
 		}
 
-		g_free (str);
-
-		/* set start iter to the end iters position */
-		start = end;
+		g_free (g_ptr_array_index (words, i));
 	}
+
+	g_free (correct);
+	g_array_free (offsets, TRUE);
+	g_ptr_array_free (words, TRUE);
 }
 
 static gboolean
@@ -755,7 +789,7 @@ chat_input_key_press_event_cb (GtkWidget   *widget,
 		GtkTextBuffer *buffer;
 		GtkTextIter    start, current;
 		gchar         *nick, *completed;
-		GList         *list, *completed_list;
+		GList         *completed_list;
 		gboolean       is_start_of_buffer;
 
 		buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (EMPATHY_CHAT (chat)->input_text_view));
@@ -766,13 +800,10 @@ chat_input_key_press_event_cb (GtkWidget   *widget,
 		gtk_text_iter_backward_word_start (&start);
 		is_start_of_buffer = gtk_text_iter_is_start (&start);
 
-		list = empathy_contact_list_get_members (EMPATHY_CONTACT_LIST (priv->tp_chat));
-		g_completion_add_items (priv->completion, list);
-
 		nick = gtk_text_buffer_get_text (buffer, &start, &current, FALSE);
-		completed_list = g_completion_complete (priv->completion,
-							nick,
-							&completed);
+		completed_list = empathy_nick_index_complete (priv->nick_index,
+							      nick,
+							      &completed);
 
 		g_free (nick);
 
@@ -814,10 +845,7 @@ chat_input_key_press_event_cb (GtkWidget   *widget,
 			g_free (completed);
 		}
 
-		g_completion_clear_items (priv->completion);
-
-		g_list_foreach (list, (GFunc) g_object_unref, NULL);
-		g_list_free (list);
+		g_list_free (completed_list);
 
 		return TRUE;
 	}
@@ -1122,60 +1150,41 @@ chat_add_logs (EmpathyChat *chat)
 	empathy_chat_view_scroll (chat->view, TRUE);
 }
 
-static gint
-chat_contacts_completion_func (const gchar *s1,
-			       const gchar *s2,
-			       gsize        n)
-{
-	gchar *tmp, *nick1, *nick2;
-	gint   ret;
-
-	if (s1 == s2) {
-		return 0;
-	}
-	if (!s1 || !s2) {
-		return s1 ? -1 : +1;
-	}
-
-	tmp = g_utf8_normalize (s1, -1, G_NORMALIZE_DEFAULT);
-	nick1 = g_utf8_casefold (tmp, -1);
-	g_free (tmp);
-
-	tmp = g_utf8_normalize (s2, -1, G_NORMALIZE_DEFAULT);
-	nick2 = g_utf8_casefold (tmp, -1);
-	g_free (tmp);
-
-	ret = strncmp (nick1, nick2, n);
-
-	g_free (nick1);
-	g_free (nick2);
-
-	return ret;
-}
-
 static void
 chat_members_changed_cb (EmpathyTpChat  *tp_chat,
-			 EmpathyContact *contact,
-			 EmpathyContact *actor,
+			 GPtrArray      *added,
+			 GPtrArray      *removed,
 			 guint           reason,
 			 gchar          *message,
-			 gboolean        is_member,
 			 EmpathyChat    *chat)
 {
 	EmpathyChatPriv *priv = GET_PRIV (chat);
+	EmpathyContact  *contact;
+	gchar           *str;
+	guint            i;
 
-	if (priv->block_events_timeout_id == 0) {
-		gchar *str;
+	for (i = 0; i < removed->len; i++) {
+		contact = g_ptr_array_index (removed, i);
+		empathy_nick_index_remove (priv->nick_index, contact);
 
-		if (is_member) {
-			str = g_strdup_printf (_("%s has joined the room"),
-					       empathy_contact_get_name (contact));
-		} else {
+		if (priv->block_events_timeout_id == 0) {
 			str = g_strdup_printf (_("%s has left the room"),
 					       empathy_contact_get_name (contact));
+			empathy_chat_view_append_event (chat->view, str);
+			g_free (str);
+		}
+	}
+
+	for (i = 0; i < added->len; i++) {
+		contact = g_ptr_array_index (added, i);
+		empathy_nick_index_add (priv->nick_index, contact);
+
+		if (priv->block_events_timeout_id == 0) {
+			str = g_strdup_printf (_("%s has joined the room"),
+					       empathy_contact_get_name (contact));
+			empathy_chat_view_append_event (chat->view, str);
+			g_free (str);
 		}
-		empathy_chat_view_append_event (chat->view, str);
-		g_free (str);
 	}
 }
 
@@ -1282,6 +1291,7 @@ chat_destroy_cb (EmpathyTpChat *tp_chat,
 	}
 
 	chat_composing_remove_timeout (chat);
+	empathy_nick_index_clear (priv->nick_index);
 	g_object_unref (priv->tp_chat);
 	priv->tp_chat = NULL;
 	g_object_notify (G_OBJECT (chat), "tp-chat");
@@ -1467,7 +1477,7 @@ chat_finalize (GObject *object)
 		g_signal_handlers_disconnect_by_func (priv->tp_chat,
 			chat_destroy_cb, chat);
 		g_signal_handlers_disconnect_by_func (priv->tp_chat,
-			chat_message_received_cb, chat);
+			chat_messages_received_cb, chat);
 		g_signal_handlers_disconnect_by_func (priv->tp_chat,
 			chat_send_error_cb, chat);
 		g_signal_handlers_disconnect_by_func (priv->tp_chat,
@@ -1495,7 +1505,7 @@ chat_finalize (GObject *object)
 	g_free (priv->id);
 	g_free (priv->name);
 	g_free (priv->subject);
-	g_completion_free (priv->completion);
+	empathy_nick_index_free (priv->nick_index);
 
 	G_OBJECT_CLASS (empathy_chat_parent_class)->finalize (object);
 }
@@ -1625,8 +1635,7 @@ empathy_chat_init (EmpathyChat *chat)
 		g_timeout_add_seconds (1, chat_block_events_timeout_cb, chat);
 
 	/* Add nick name completion */
-	priv->completion = g_completion_new ((GCompletionFunc) empathy_contact_get_name);
-	g_completion_set_compare (priv->completion, chat_contacts_completion_func);
+	priv->nick_index = empathy_nick_index_new ();
 }
 
 EmpathyChat *
@@ -1651,6 +1660,7 @@ empathy_chat_set_tp_chat (EmpathyChat   *chat,
 {
 	EmpathyChatPriv *priv = GET_PRIV (chat);
 	TpConnection    *connection;
+	GList           *members, *l;
 
 	g_return_if_fail (EMPATHY_IS_CHAT (chat));
 	g_return_if_fail (EMPATHY_IS_TP_CHAT (tp_chat));
@@ -1673,8 +1683,8 @@ empathy_chat_set_tp_chat (EmpathyChat   *chat,
 	g_signal_connect (tp_chat, "destroy",
 			  G_CALLBACK (chat_destroy_cb),
 			  chat);
-	g_signal_connect (tp_chat, "message-received",
-			  G_CALLBACK (chat_message_received_cb),
+	g_signal_connect (tp_chat, "messages-received-batch",
+			  G_CALLBACK (chat_messages_received_cb),
 			  chat);
 	g_signal_connect (tp_chat, "send-error",
 			  G_CALLBACK (chat_send_error_cb),
@@ -1685,13 +1695,22 @@ empathy_chat_set_tp_chat (EmpathyChat   *chat,
 	g_signal_connect (tp_chat, "property-changed",
 			  G_CALLBACK (chat_property_changed_cb),
 			  chat);
-	g_signal_connect (tp_chat, "members-changed",
+	g_signal_connect (tp_chat, "members-changed-batch",
 			  G_CALLBACK (chat_members_changed_cb),
 			  chat);
 	g_signal_connect_swapped (tp_chat, "notify::remote-contact",
 				  G_CALLBACK (chat_remote_contact_changed_cb),
 				  chat);
 
+	/* Index current members for nick completion, members-changed-batch
+	 * keeps it up to date from now on */
+	members = empathy_contact_list_get_members (EMPATHY_CONTACT_LIST (tp_chat));
+	for (l = members; l; l = l->next) {
+		empathy_nick_index_add (priv->nick_index, l->data);
+		g_object_unref (l->data);
+	}
+	g_list_free (members);
+
 	chat_remote_contact_changed_cb (chat);
 
 	if (chat->input_text_view) {
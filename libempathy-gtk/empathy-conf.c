@@ -37,9 +37,32 @@
 
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyConf)
 typedef struct {
-	GConfClient *gconf_client;
+	GConfClient      *gconf_client;
+	EmpathyConfCache  cache;
+	gboolean          cache_ready;
+	guint             cache_notify_id;
+	/* Number of GConf lookups answered from the cache */
+	guint             cache_hits;
 } EmpathyConfPriv;
 
+typedef struct {
+	const gchar *key;
+	glong        offset;
+} EmpathyConfCacheEntry;
+
+#define CACHE_ENTRY(key, field) \
+	{ key, G_STRUCT_OFFSET (EmpathyConfCache, field) }
+
+static const EmpathyConfCacheEntry cache_entries[] = {
+	CACHE_ENTRY (EMPATHY_PREFS_CHAT_SHOW_SMILEYS, chat_show_smileys),
+	CACHE_ENTRY (EMPATHY_PREFS_CHAT_SPELL_CHECKER_ENABLED, chat_spell_checker_enabled),
+	CACHE_ENTRY (EMPATHY_PREFS_NOTIFICATIONS_ENABLED, notifications_enabled),
+	CACHE_ENTRY (EMPATHY_PREFS_NOTIFICATIONS_DISABLED_AWAY, notifications_disabled_away),
+	CACHE_ENTRY (EMPATHY_PREFS_NOTIFICATIONS_FOCUS, notifications_focus),
+	CACHE_ENTRY (EMPATHY_PREFS_SOUNDS_ENABLED, sounds_enabled),
+	CACHE_ENTRY (EMPATHY_PREFS_SOUNDS_DISABLED_AWAY, sounds_disabled_away),
+};
+
 typedef struct {
 	EmpathyConf           *conf;
 	EmpathyConfNotifyFunc  func;
@@ -90,6 +113,8 @@ conf_finalize (GObject *object)
 
 	priv = GET_PRIV (object);
 
+	DEBUG ("%u GConf lookups answered from the cache", priv->cache_hits);
+
 	gconf_client_remove_dir (priv->gconf_client,
 				 EMPATHY_CONF_ROOT,
 				 NULL);
@@ -116,11 +141,103 @@ void
 empathy_conf_shutdown (void)
 {
 	if (global_conf) {
+		EmpathyConfPriv *priv = GET_PRIV (global_conf);
+
+		/* The cache notification holds a reference on the conf */
+		if (priv->cache_notify_id != 0) {
+			empathy_conf_notify_remove (global_conf,
+						    priv->cache_notify_id);
+			priv->cache_notify_id = 0;
+		}
+
 		g_object_unref (global_conf);
 		global_conf = NULL;
 	}
 }
 
+static gboolean *
+conf_cache_lookup (EmpathyConfPriv *priv,
+		   const gchar     *key)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (cache_entries); i++) {
+		if (!strcmp (cache_entries[i].key, key)) {
+			return &G_STRUCT_MEMBER (gboolean, &priv->cache,
+						 cache_entries[i].offset);
+		}
+	}
+
+	return NULL;
+}
+
+static void
+conf_cache_notify_cb (EmpathyConf *conf,
+		      const gchar *key,
+		      gpointer     user_data)
+{
+	EmpathyConfPriv *priv = GET_PRIV (conf);
+	gboolean        *field;
+
+	field = conf_cache_lookup (priv, key);
+	if (field == NULL) {
+		return;
+	}
+
+	/* Read it back so an unset key falls back to its schema default */
+	*field = gconf_client_get_bool (priv->gconf_client, key, NULL);
+	DEBUG ("Cached bool:'%s' is now %d", key, *field);
+}
+
+static void
+conf_cache_ensure (EmpathyConf *conf)
+{
+	EmpathyConfPriv *priv = GET_PRIV (conf);
+	guint            i;
+
+	if (priv->cache_ready) {
+		return;
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (cache_entries); i++) {
+		G_STRUCT_MEMBER (gboolean, &priv->cache,
+				 cache_entries[i].offset) =
+			gconf_client_get_bool (priv->gconf_client,
+					       cache_entries[i].key,
+					       NULL);
+	}
+
+	/* The root directory is preloaded, we get notified for all keys
+	 * below it. */
+	priv->cache_notify_id = empathy_conf_notify_add (conf,
+							 EMPATHY_CONF_ROOT,
+							 conf_cache_notify_cb,
+							 NULL);
+	priv->cache_ready = TRUE;
+}
+
+const EmpathyConfCache *
+empathy_conf_get_cache (EmpathyConf *conf)
+{
+	EmpathyConfPriv *priv;
+
+	g_return_val_if_fail (EMPATHY_IS_CONF (conf), NULL);
+
+	priv = GET_PRIV (conf);
+	conf_cache_ensure (conf);
+	priv->cache_hits++;
+
+	return &priv->cache;
+}
+
+guint
+empathy_conf_get_cache_hits (EmpathyConf *conf)
+{
+	g_return_val_if_fail (EMPATHY_IS_CONF (conf), 0);
+
+	return GET_PRIV (conf)->cache_hits;
+}
+
 gboolean
 empathy_conf_set_int (EmpathyConf  *conf,
 		     const gchar *key,
@@ -140,30 +257,43 @@ empathy_conf_set_int (EmpathyConf  *conf,
 				     NULL);
 }
 
+/* Leaves value untouched when the key has neither a value nor a schema
+ * default, so callers can initialise it to their own default. */
 gboolean
 empathy_conf_get_int (EmpathyConf  *conf,
 		     const gchar *key,
 		     gint        *value)
 {
 	EmpathyConfPriv *priv;
+	GConfValue      *gconf_value;
 	GError          *error = NULL;
 
-	*value = 0;
-
 	g_return_val_if_fail (EMPATHY_IS_CONF (conf), FALSE);
 	g_return_val_if_fail (value != NULL, FALSE);
 
 	priv = GET_PRIV (conf);
 
-	*value = gconf_client_get_int (priv->gconf_client,
-				       key,
-				       &error);
+	gconf_value = gconf_client_get (priv->gconf_client,
+					key,
+					&error);
 
 	if (error) {
 		g_error_free (error);
 		return FALSE;
 	}
 
+	if (gconf_value == NULL) {
+		return FALSE;
+	}
+
+	if (gconf_value->type != GCONF_VALUE_INT) {
+		gconf_value_free (gconf_value);
+		return FALSE;
+	}
+
+	*value = gconf_value_get_int (gconf_value);
+	gconf_value_free (gconf_value);
+
 	return TRUE;
 }
 
@@ -181,10 +311,25 @@ empathy_conf_set_bool (EmpathyConf  *conf,
 
 	priv = GET_PRIV (conf);
 
-	return gconf_client_set_bool (priv->gconf_client,
-				      key,
-				      value,
-				      NULL);
+	if (!gconf_client_set_bool (priv->gconf_client,
+				    key,
+				    value,
+				    NULL)) {
+		return FALSE;
+	}
+
+	/* Don't wait for the notification, readers of the cache should see
+	 * the new value right away. */
+	if (priv->cache_ready) {
+		gboolean *field;
+
+		field = conf_cache_lookup (priv, key);
+		if (field != NULL) {
+			*field = value;
+		}
+	}
+
+	return TRUE;
 }
 
 gboolean
@@ -194,6 +339,7 @@ empathy_conf_get_bool (EmpathyConf  *conf,
 {
 	EmpathyConfPriv *priv;
 	GError          *error = NULL;
+	gboolean        *field;
 
 	*value = FALSE;
 
@@ -202,6 +348,14 @@ empathy_conf_get_bool (EmpathyConf  *conf,
 
 	priv = GET_PRIV (conf);
 
+	conf_cache_ensure (conf);
+	field = conf_cache_lookup (priv, key);
+	if (field != NULL) {
+		priv->cache_hits++;
+		*value = *field;
+		return TRUE;
+	}
+
 	*value = gconf_client_get_bool (priv->gconf_client,
 					key,
 					&error);
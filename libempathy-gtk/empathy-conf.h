@@ -77,11 +77,27 @@ struct _EmpathyConfClass {
 #define EMPATHY_PREFS_AUTOCONNECT                  EMPATHY_PREFS_PATH "/autoconnect"
 #define EMPATHY_PREFS_IMPORT_ASKED                 EMPATHY_PREFS_PATH "/import_asked"
 #define EMPATHY_PREFS_FILE_TRANSFER_DEFAULT_FOLDER EMPATHY_PREFS_PATH "/file_transfer/default_folder"
+#define EMPATHY_PREFS_FILE_TRANSFER_MAX_CONCURRENT EMPATHY_PREFS_PATH "/file_transfer/max_concurrent"
+#define EMPATHY_PREFS_FILE_TRANSFER_RATE_LIMIT     EMPATHY_PREFS_PATH "/file_transfer/rate_limit"
+#define EMPATHY_PREFS_FILE_TRANSFER_TRANSFER_RATE_LIMIT EMPATHY_PREFS_PATH "/file_transfer/transfer_rate_limit"
 
 typedef void (*EmpathyConfNotifyFunc) (EmpathyConf  *conf,
 				      const gchar *key,
 				      gpointer     user_data);
 
+/* Settings read for every message or keystroke. They are read from GConf
+ * once and kept up to date with change notifications, so hot paths can
+ * use the fields directly. */
+typedef struct {
+	gboolean chat_show_smileys;
+	gboolean chat_spell_checker_enabled;
+	gboolean notifications_enabled;
+	gboolean notifications_disabled_away;
+	gboolean notifications_focus;
+	gboolean sounds_enabled;
+	gboolean sounds_disabled_away;
+} EmpathyConfCache;
+
 GType       empathy_conf_get_type        (void) G_GNUC_CONST;
 EmpathyConf *empathy_conf_get             (void);
 void        empathy_conf_shutdown        (void);
@@ -115,6 +131,9 @@ gboolean    empathy_conf_set_string_list (EmpathyConf            *conf,
 gboolean    empathy_conf_get_string_list (EmpathyConf            *conf,
 					 const gchar           *key,
 					 GSList              **value);
+const EmpathyConfCache *
+            empathy_conf_get_cache       (EmpathyConf            *conf);
+guint       empathy_conf_get_cache_hits  (EmpathyConf            *conf);
 
 G_END_DECLS
 
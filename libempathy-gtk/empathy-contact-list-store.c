@@ -32,6 +32,8 @@
 
 #include <telepathy-glib/util.h>
 
+#include <libempathy/empathy-stats.h>
+#include <libempathy/empathy-tp-chat.h>
 #include <libempathy/empathy-utils.h>
 #include "empathy-contact-list-store.h"
 #include "empathy-ui-utils.h"
@@ -60,6 +62,8 @@ typedef struct {
 	gboolean                    show_active;
 	EmpathyContactListStoreSort sort_criterium;
 	guint                       inhibit_active;
+	/* EmpathyContact -> GList of GtkTreeIter, its rows in the store */
+	GHashTable                 *contact_rows;
 } EmpathyContactListStorePriv;
 
 typedef struct {
@@ -68,12 +72,6 @@ typedef struct {
 	gboolean     found;
 } FindGroup;
 
-typedef struct {
-	EmpathyContact *contact;
-	gboolean       found;
-	GList         *iters;
-} FindContact;
-
 typedef struct {
 	EmpathyContactListStore *store;
 	EmpathyContact          *contact;
@@ -138,10 +136,10 @@ static gint             contact_list_store_name_sort_func            (GtkTreeMod
 								      GtkTreeIter                   *iter_a,
 								      GtkTreeIter                   *iter_b,
 								      gpointer                       user_data);
-static gboolean         contact_list_store_find_contact_foreach      (GtkTreeModel                  *model,
-								      GtkTreePath                   *path,
-								      GtkTreeIter                   *iter,
-								      FindContact                   *fc);
+static void             contact_list_store_free_rows                 (GList                         *rows);
+static void             contact_list_store_add_row                   (EmpathyContactListStore       *store,
+								      EmpathyContact                *contact,
+								      GtkTreeIter                   *iter);
 static GList *          contact_list_store_find_contact              (EmpathyContactListStore       *store,
 								      EmpathyContact                *contact);
 static gboolean         contact_list_store_update_list_mode_foreach  (GtkTreeModel                  *model,
@@ -161,6 +159,53 @@ enum {
 
 G_DEFINE_TYPE (EmpathyContactListStore, empathy_contact_list_store, GTK_TYPE_TREE_STORE);
 
+static void
+contact_list_store_members_changed_batch_cb (EmpathyTpChat           *tp_chat,
+					     GPtrArray               *added,
+					     GPtrArray               *removed,
+					     guint                    reason,
+					     gchar                   *message,
+					     EmpathyContactListStore *store)
+{
+	GtkTreeSortable *sortable = GTK_TREE_SORTABLE (store);
+	gint             sort_column_id;
+	GtkSortType      order;
+	gboolean         sorted;
+	guint            i;
+
+	/* Don't keep the store sorted while adding rows one by one, sort it
+	 * once when all changes are done. */
+	sorted = added->len > 1 &&
+		gtk_tree_sortable_get_sort_column_id (sortable,
+						      &sort_column_id,
+						      &order);
+	if (sorted) {
+		gtk_tree_sortable_set_sort_column_id (sortable,
+			GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID,
+			GTK_SORT_ASCENDING);
+	}
+
+	for (i = 0; i < removed->len; i++) {
+		contact_list_store_members_changed_cb (EMPATHY_CONTACT_LIST (tp_chat),
+						       g_ptr_array_index (removed, i),
+						       NULL, reason, message,
+						       FALSE, store);
+	}
+
+	for (i = 0; i < added->len; i++) {
+		contact_list_store_members_changed_cb (EMPATHY_CONTACT_LIST (tp_chat),
+						       g_ptr_array_index (added, i),
+						       NULL, reason, message,
+						       TRUE, store);
+	}
+
+	if (sorted) {
+		gtk_tree_sortable_set_sort_column_id (sortable,
+						      sort_column_id,
+						      order);
+	}
+}
+
 static gboolean
 contact_list_store_iface_setup (gpointer user_data)
 {
@@ -168,11 +213,19 @@ contact_list_store_iface_setup (gpointer user_data)
 	EmpathyContactListStorePriv *priv = GET_PRIV (store);
 	GList                       *contacts, *l;
 
-	/* Signal connection. */
-	g_signal_connect (priv->list,
-			  "members-changed",
-			  G_CALLBACK (contact_list_store_members_changed_cb),
-			  store);
+	/* Signal connection. Chat rooms tell us about all the members that
+	 * joined or left at once. */
+	if (EMPATHY_IS_TP_CHAT (priv->list)) {
+		g_signal_connect (priv->list,
+				  "members-changed-batch",
+				  G_CALLBACK (contact_list_store_members_changed_batch_cb),
+				  store);
+	} else {
+		g_signal_connect (priv->list,
+				  "members-changed",
+				  G_CALLBACK (contact_list_store_members_changed_cb),
+				  store);
+	}
 	g_signal_connect (priv->list,
 			  "groups-changed",
 			  G_CALLBACK (contact_list_store_groups_changed_cb),
@@ -276,6 +329,9 @@ empathy_contact_list_store_init (EmpathyContactListStore *store)
 	store->priv = priv;
 	priv->show_avatars = TRUE;
 	priv->show_groups = TRUE;
+	priv->contact_rows = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+						    NULL,
+						    (GDestroyNotify) contact_list_store_free_rows);
 	priv->inhibit_active = g_timeout_add_seconds (ACTIVE_USER_WAIT_TO_ENABLE_TIME,
 						      (GSourceFunc) contact_list_store_inibit_active_cb,
 						      store);
@@ -301,10 +357,14 @@ contact_list_store_finalize (GObject *object)
 	g_signal_handlers_disconnect_by_func (priv->list,
 					      G_CALLBACK (contact_list_store_members_changed_cb),
 					      object);
+	g_signal_handlers_disconnect_by_func (priv->list,
+					      G_CALLBACK (contact_list_store_members_changed_batch_cb),
+					      object);
 	g_signal_handlers_disconnect_by_func (priv->list,
 					      G_CALLBACK (contact_list_store_groups_changed_cb),
 					      object);
 	g_object_unref (priv->list);
+	g_hash_table_destroy (priv->contact_rows);
 
 	if (priv->inhibit_active) {
 		g_source_remove (priv->inhibit_active);
@@ -522,6 +582,7 @@ empathy_contact_list_store_set_show_groups (EmpathyContactListStore *store,
 	/* Remove all contacts and add them back, not optimized but that's the
 	 * easy way :) */
 	gtk_tree_store_clear (GTK_TREE_STORE (store));
+	g_hash_table_remove_all (priv->contact_rows);
 	contacts = empathy_contact_list_get_members (priv->list);
 	for (l = contacts; l; l = l->next) {
 		contact_list_store_members_changed_cb (priv->list, l->data,
@@ -878,6 +939,7 @@ contact_list_store_add_contact (EmpathyContactListStore *store,
 				      empathy_contact_get_capabilities (contact) &
 				        EMPATHY_CAPABILITIES_VIDEO,
 				    -1);
+		contact_list_store_add_row (store, contact, &iter);
 	}
 
 	/* Else add to each group. */
@@ -900,6 +962,7 @@ contact_list_store_add_contact (EmpathyContactListStore *store,
 				      empathy_contact_get_capabilities (contact) &
 				        EMPATHY_CAPABILITIES_VIDEO,
 				    -1);
+		contact_list_store_add_row (store, contact, &iter);
 		g_free (l->data);
 	}
 	g_list_free (groups);
@@ -943,6 +1006,7 @@ contact_list_store_remove_contact (EmpathyContactListStore *store,
 
 	g_list_foreach (iters, (GFunc) gtk_tree_iter_free, NULL);
 	g_list_free (iters);
+	g_hash_table_remove (priv->contact_rows, contact);
 }
 
 static void
@@ -1105,10 +1169,15 @@ contact_list_store_contact_updated_cb (EmpathyContact          *contact,
 				       GParamSpec              *param,
 				       EmpathyContactListStore *store)
 {
+	gint64 start;
+
 	DEBUG ("Contact:'%s' updated, checking roster is in sync...",
 		empathy_contact_get_name (contact));
 
+	start = empathy_stats_get_time ();
 	contact_list_store_contact_update (store, contact);
+	EMPATHY_STAT_RECORD ("contact-list-store.update-time",
+			     empathy_stats_get_time () - start);
 }
 
 static void
@@ -1458,28 +1527,29 @@ contact_list_store_name_sort_func (GtkTreeModel *model,
 	return ret_val;
 }
 
-static gboolean
-contact_list_store_find_contact_foreach (GtkTreeModel *model,
-					 GtkTreePath  *path,
-					 GtkTreeIter  *iter,
-					 FindContact  *fc)
+static void
+contact_list_store_free_rows (GList *rows)
 {
-	EmpathyContact *contact;
-
-	gtk_tree_model_get (model, iter,
-			    EMPATHY_CONTACT_LIST_STORE_COL_CONTACT, &contact,
-			    -1);
+	g_list_foreach (rows, (GFunc) gtk_tree_iter_free, NULL);
+	g_list_free (rows);
+}
 
-	if (contact == fc->contact) {
-		fc->found = TRUE;
-		fc->iters = g_list_append (fc->iters, gtk_tree_iter_copy (iter));
-	}
+static void
+contact_list_store_add_row (EmpathyContactListStore *store,
+			    EmpathyContact          *contact,
+			    GtkTreeIter             *iter)
+{
+	EmpathyContactListStorePriv *priv;
+	GList                       *rows;
 
-	if (contact) {
-		g_object_unref (contact);
-	}
+	priv = GET_PRIV (store);
 
-	return FALSE;
+	/* Tree store iters stay valid until their row is removed, so they
+	 * can be kept around to find the contact without walking the tree */
+	rows = g_hash_table_lookup (priv->contact_rows, contact);
+	g_hash_table_steal (priv->contact_rows, contact);
+	rows = g_list_prepend (rows, gtk_tree_iter_copy (iter));
+	g_hash_table_insert (priv->contact_rows, contact, rows);
 }
 
 static GList *
@@ -1487,26 +1557,30 @@ contact_list_store_find_contact (EmpathyContactListStore *store,
 				 EmpathyContact          *contact)
 {
 	EmpathyContactListStorePriv *priv;
-	GtkTreeModel              *model;
-	GList                     *l = NULL;
-	FindContact                fc;
+	GList                       *rows, *l;
+	GList                       *iters = NULL;
 
 	priv = GET_PRIV (store);
 
-	memset (&fc, 0, sizeof (fc));
-
-	fc.contact = contact;
+	rows = g_hash_table_lookup (priv->contact_rows, contact);
+	for (l = rows; l; l = l->next) {
+		iters = g_list_prepend (iters, gtk_tree_iter_copy (l->data));
+	}
 
-	model = GTK_TREE_MODEL (store);
-	gtk_tree_model_foreach (model,
-				(GtkTreeModelForeachFunc) contact_list_store_find_contact_foreach,
-				&fc);
+	return iters;
+}
 
-	if (fc.found) {
-		l = fc.iters;
-	}
+/* Returns the rows of @contact in @store, a list of #GtkTreeIter to be freed
+ * with gtk_tree_iter_free() and g_list_free(). This doesn't walk the tree so
+ * it is cheap enough to be called on every change of the contact. */
+GList *
+empathy_contact_list_store_find_contact (EmpathyContactListStore *store,
+					 EmpathyContact          *contact)
+{
+	g_return_val_if_fail (EMPATHY_IS_CONTACT_LIST_STORE (store), NULL);
+	g_return_val_if_fail (EMPATHY_IS_CONTACT (contact), NULL);
 
-	return l;
+	return contact_list_store_find_contact (store, contact);
 }
 
 static gboolean
@@ -103,6 +103,8 @@ gboolean                   empathy_contact_list_store_search_equal_func  (GtkTre
 									 const gchar                *key,
 									 GtkTreeIter                *iter,
 									 gpointer                    search_data);
+GList *                    empathy_contact_list_store_find_contact       (EmpathyContactListStore    *store,
+									 EmpathyContact             *contact);
 
 G_END_DECLS
 
@@ -1420,6 +1420,8 @@ contact_widget_location_update (EmpathyContactWidget *information)
       ClutterActor *marker;
       ChamplainLayer *layer;
 
+      empathy_gtk_clutter_init ();
+
       information->map_view = champlain_view_new ();
       information->map_view_embed = champlain_view_embed_new (
           CHAMPLAIN_VIEW (information->map_view));
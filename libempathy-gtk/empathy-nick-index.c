@@ -0,0 +1,342 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "empathy-nick-index.h"
+
+/* Index of the nicknames of a chat room, used for nick completion. Nicks
+ * are normalized and casefolded once, when a member joins or is renamed,
+ * and kept sorted so a completion is a binary search for the first match
+ * followed by a walk over the matching range. */
+
+typedef struct {
+	gchar          *key;
+	EmpathyContact *contact;
+	gulong          notify_id;
+} NickEntry;
+
+struct _EmpathyNickIndex {
+	/* NickEntry sorted by key */
+	GPtrArray  *entries;
+	/* EmpathyContact -> NickEntry */
+	GHashTable *contacts;
+};
+
+static gchar *
+nick_index_make_key (const gchar *nick)
+{
+	gchar *tmp, *key;
+
+	if (nick == NULL) {
+		return g_strdup ("");
+	}
+
+	tmp = g_utf8_normalize (nick, -1, G_NORMALIZE_DEFAULT);
+	if (tmp == NULL) {
+		/* Not valid UTF-8 */
+		return g_strdup ("");
+	}
+
+	key = g_utf8_casefold (tmp, -1);
+	g_free (tmp);
+
+	return key;
+}
+
+/* Returns the position of the first entry whose key is not lower than @key */
+static guint
+nick_index_lower_bound (EmpathyNickIndex *nick_index,
+			const gchar      *key)
+{
+	guint low = 0;
+	guint high = nick_index->entries->len;
+
+	while (low < high) {
+		guint      mid = low + (high - low) / 2;
+		NickEntry *entry = g_ptr_array_index (nick_index->entries, mid);
+
+		if (strcmp (entry->key, key) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+static void
+nick_index_insert (EmpathyNickIndex *nick_index,
+		   NickEntry        *entry)
+{
+	GPtrArray *entries = nick_index->entries;
+	guint      pos;
+
+	pos = nick_index_lower_bound (nick_index, entry->key);
+
+	g_ptr_array_add (entries, NULL);
+	memmove (entries->pdata + pos + 1, entries->pdata + pos,
+		 (entries->len - pos - 1) * sizeof (gpointer));
+	entries->pdata[pos] = entry;
+}
+
+static void
+nick_index_unlink (EmpathyNickIndex *nick_index,
+		   NickEntry        *entry)
+{
+	GPtrArray *entries = nick_index->entries;
+	guint      pos;
+
+	/* Several members can have the same key, find ours among them */
+	pos = nick_index_lower_bound (nick_index, entry->key);
+	while (pos < entries->len && g_ptr_array_index (entries, pos) != entry) {
+		pos++;
+	}
+
+	g_return_if_fail (pos < entries->len);
+	g_ptr_array_remove_index (entries, pos);
+}
+
+static void
+nick_index_entry_free (NickEntry *entry)
+{
+	g_signal_handler_disconnect (entry->contact, entry->notify_id);
+	g_object_unref (entry->contact);
+	g_free (entry->key);
+	g_slice_free (NickEntry, entry);
+}
+
+static void
+nick_index_name_notify_cb (EmpathyContact   *contact,
+			   GParamSpec       *pspec,
+			   EmpathyNickIndex *nick_index)
+{
+	NickEntry *entry;
+	gchar     *key;
+
+	entry = g_hash_table_lookup (nick_index->contacts, contact);
+	g_return_if_fail (entry != NULL);
+
+	key = nick_index_make_key (empathy_contact_get_name (contact));
+	if (!strcmp (key, entry->key)) {
+		g_free (key);
+		return;
+	}
+
+	nick_index_unlink (nick_index, entry);
+	g_free (entry->key);
+	entry->key = key;
+	nick_index_insert (nick_index, entry);
+}
+
+EmpathyNickIndex *
+empathy_nick_index_new (void)
+{
+	EmpathyNickIndex *nick_index;
+
+	nick_index = g_slice_new (EmpathyNickIndex);
+	nick_index->entries = g_ptr_array_new ();
+	nick_index->contacts = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	return nick_index;
+}
+
+void
+empathy_nick_index_free (EmpathyNickIndex *nick_index)
+{
+	g_return_if_fail (nick_index != NULL);
+
+	empathy_nick_index_clear (nick_index);
+	g_ptr_array_free (nick_index->entries, TRUE);
+	g_hash_table_destroy (nick_index->contacts);
+	g_slice_free (EmpathyNickIndex, nick_index);
+}
+
+void
+empathy_nick_index_add (EmpathyNickIndex *nick_index,
+			EmpathyContact   *contact)
+{
+	NickEntry *entry;
+
+	g_return_if_fail (nick_index != NULL);
+	g_return_if_fail (EMPATHY_IS_CONTACT (contact));
+
+	if (g_hash_table_lookup (nick_index->contacts, contact) != NULL) {
+		return;
+	}
+
+	entry = g_slice_new (NickEntry);
+	entry->key = nick_index_make_key (empathy_contact_get_name (contact));
+	entry->contact = g_object_ref (contact);
+	entry->notify_id = g_signal_connect (contact, "notify::name",
+		G_CALLBACK (nick_index_name_notify_cb), nick_index);
+
+	nick_index_insert (nick_index, entry);
+	g_hash_table_insert (nick_index->contacts, contact, entry);
+}
+
+void
+empathy_nick_index_remove (EmpathyNickIndex *nick_index,
+			   EmpathyContact   *contact)
+{
+	NickEntry *entry;
+
+	g_return_if_fail (nick_index != NULL);
+	g_return_if_fail (EMPATHY_IS_CONTACT (contact));
+
+	entry = g_hash_table_lookup (nick_index->contacts, contact);
+	if (entry == NULL) {
+		return;
+	}
+
+	nick_index_unlink (nick_index, entry);
+	g_hash_table_remove (nick_index->contacts, contact);
+	nick_index_entry_free (entry);
+}
+
+void
+empathy_nick_index_clear (EmpathyNickIndex *nick_index)
+{
+	g_return_if_fail (nick_index != NULL);
+
+	g_ptr_array_foreach (nick_index->entries,
+			     (GFunc) nick_index_entry_free, NULL);
+	g_ptr_array_set_size (nick_index->entries, 0);
+	g_hash_table_remove_all (nick_index->contacts);
+}
+
+guint
+empathy_nick_index_get_size (EmpathyNickIndex *nick_index)
+{
+	g_return_val_if_fail (nick_index != NULL, 0);
+
+	return nick_index->entries->len;
+}
+
+/* Returns the longest prefix of @entry's name matching the first @len bytes
+ * of its key, so the completed text keeps the case of the nick. */
+static gchar *
+nick_index_name_prefix (NickEntry *entry,
+			gsize      len)
+{
+	const gchar *name, *end, *best;
+
+	name = empathy_contact_get_name (entry->contact);
+	if (name == NULL) {
+		return g_strdup ("");
+	}
+
+	best = name;
+	for (end = name; *end != '\0'; ) {
+		gchar *prefix, *key;
+		gsize  key_len;
+
+		end = g_utf8_next_char (end);
+		prefix = g_strndup (name, end - name);
+		key = nick_index_make_key (prefix);
+		key_len = strlen (key);
+
+		if (key_len <= len && !strncmp (key, entry->key, key_len)) {
+			best = end;
+		}
+
+		g_free (prefix);
+		g_free (key);
+
+		if (key_len >= len) {
+			break;
+		}
+	}
+
+	return g_strndup (name, best - name);
+}
+
+/**
+ * empathy_nick_index_complete:
+ * @nick_index: an #EmpathyNickIndex
+ * @prefix: the beginning of a nick, as typed by the user
+ * @common_prefix: return location for the longest common prefix of the
+ * matching nicks, or %NULL
+ *
+ * Finds the members whose nick starts with @prefix, ignoring case. This
+ * replaces a #GCompletion over the members of the chat, @common_prefix
+ * has the same meaning as the new prefix returned by
+ * g_completion_complete() and has to be freed with g_free().
+ *
+ * Return value: a list of the matching #EmpathyContact, sorted by nick.
+ * Contacts are not referenced, free the list with g_list_free().
+ */
+GList *
+empathy_nick_index_complete (EmpathyNickIndex *nick_index,
+			     const gchar      *prefix,
+			     gchar           **common_prefix)
+{
+	GList     *matches = NULL;
+	NickEntry *first, *last;
+	gchar     *key;
+	gsize      key_len, common_len;
+	guint      start, i;
+
+	g_return_val_if_fail (nick_index != NULL, NULL);
+
+	if (common_prefix) {
+		*common_prefix = NULL;
+	}
+
+	key = nick_index_make_key (prefix);
+	key_len = strlen (key);
+
+	start = nick_index_lower_bound (nick_index, key);
+	for (i = start; i < nick_index->entries->len; i++) {
+		NickEntry *entry = g_ptr_array_index (nick_index->entries, i);
+
+		if (strncmp (entry->key, key, key_len)) {
+			break;
+		}
+
+		matches = g_list_prepend (matches, entry->contact);
+	}
+
+	g_free (key);
+
+	if (matches == NULL || common_prefix == NULL) {
+		return g_list_reverse (matches);
+	}
+
+	/* The range is sorted, so the prefix common to all its keys is the
+	 * one common to its first and last keys. */
+	first = g_ptr_array_index (nick_index->entries, start);
+	last = g_ptr_array_index (nick_index->entries, i - 1);
+	for (common_len = 0;
+	     first->key[common_len] != '\0' &&
+	     first->key[common_len] == last->key[common_len];
+	     common_len++);
+
+	/* Don't cut an UTF-8 character */
+	while (common_len > 0 && (first->key[common_len] & 0xc0) == 0x80) {
+		common_len--;
+	}
+
+	*common_prefix = nick_index_name_prefix (first, common_len);
+
+	return g_list_reverse (matches);
+}
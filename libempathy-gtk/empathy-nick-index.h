@@ -0,0 +1,45 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __EMPATHY_NICK_INDEX_H__
+#define __EMPATHY_NICK_INDEX_H__
+
+#include <glib.h>
+
+#include <libempathy/empathy-contact.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EmpathyNickIndex EmpathyNickIndex;
+
+EmpathyNickIndex *empathy_nick_index_new      (void);
+void              empathy_nick_index_free     (EmpathyNickIndex *nick_index);
+void              empathy_nick_index_add      (EmpathyNickIndex *nick_index,
+					       EmpathyContact   *contact);
+void              empathy_nick_index_remove   (EmpathyNickIndex *nick_index,
+					       EmpathyContact   *contact);
+void              empathy_nick_index_clear    (EmpathyNickIndex *nick_index);
+guint             empathy_nick_index_get_size (EmpathyNickIndex *nick_index);
+GList *           empathy_nick_index_complete (EmpathyNickIndex *nick_index,
+					       const gchar      *prefix,
+					       gchar           **common_prefix);
+
+G_END_DECLS
+
+#endif /* __EMPATHY_NICK_INDEX_H__ */
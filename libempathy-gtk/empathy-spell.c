@@ -48,10 +48,19 @@ typedef struct {
 #define ISO_CODES_DATADIR    ISO_CODES_PREFIX "/share/xml/iso-codes"
 #define ISO_CODES_LOCALESDIR ISO_CODES_PREFIX "/share/locale"
 
+/* Maximum number of words we remember the spelling of. Once it is reached,
+ * the oldest entries are dropped first. */
+#define SPELL_CACHE_SIZE 2048
+
 static GHashTable  *iso_code_names = NULL;
 static GList       *languages = NULL;
 static gboolean     empathy_conf_notify_inited = FALSE;
 
+/* word -> GINT_TO_POINTER (correct + 1), keys are owned by the table */
+static GHashTable  *checked_words = NULL;
+/* Insertion order of the keys of checked_words, for eviction */
+static GQueue      *checked_words_order = NULL;
+
 static void
 spell_iso_codes_parse_start_tag (GMarkupParseContext  *ctx,
 				 const gchar          *element_name,
@@ -158,6 +167,67 @@ spell_iso_code_names_init (void)
 	}
 }
 
+static void
+spell_cache_clear (void)
+{
+	if (checked_words == NULL) {
+		return;
+	}
+
+	g_queue_free (checked_words_order);
+	g_hash_table_destroy (checked_words);
+	checked_words_order = NULL;
+	checked_words = NULL;
+}
+
+static gboolean
+spell_cache_lookup (const gchar *word,
+		    gboolean    *correct)
+{
+	gpointer value;
+
+	if (checked_words == NULL) {
+		return FALSE;
+	}
+
+	value = g_hash_table_lookup (checked_words, word);
+	if (value == NULL) {
+		return FALSE;
+	}
+
+	*correct = GPOINTER_TO_INT (value) - 1;
+
+	return TRUE;
+}
+
+static void
+spell_cache_insert (const gchar *word,
+		    gboolean     correct)
+{
+	gchar *key;
+
+	if (checked_words == NULL) {
+		checked_words = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       g_free, NULL);
+		checked_words_order = g_queue_new ();
+	}
+
+	if (g_hash_table_lookup (checked_words, word) != NULL) {
+		return;
+	}
+
+	if (g_hash_table_size (checked_words) >= SPELL_CACHE_SIZE) {
+		/* Drop the oldest word, the table frees the key */
+		g_hash_table_remove (checked_words,
+				     g_queue_pop_head (checked_words_order));
+	}
+
+	key = g_strdup (word);
+	g_hash_table_insert (checked_words, key,
+			     GINT_TO_POINTER ((correct ? TRUE : FALSE) + 1));
+	g_queue_push_tail (checked_words_order, key);
+}
+
 static void
 spell_notify_languages_cb (EmpathyConf  *conf,
 			   const gchar *key,
@@ -181,6 +251,9 @@ spell_notify_languages_cb (EmpathyConf  *conf,
 
 	g_list_free (languages);
 	languages = NULL;
+
+	/* Results depend on the dictionaries, forget them all */
+	spell_cache_clear ();
 }
 
 static void
@@ -294,15 +367,28 @@ empathy_spell_free_language_codes (GList *codes)
 	g_list_free (codes);
 }
 
-gboolean
-empathy_spell_check (const gchar *word)
+static gboolean
+spell_word_is_digits (const gchar *word)
 {
-	gint         enchant_result = 1;
 	const gchar *p;
 	gboolean     digit;
 	gunichar     c;
+
+	for (p = word, digit = TRUE; *p && digit; p = g_utf8_next_char (p)) {
+		c = g_utf8_get_char (p);
+		digit = g_unichar_isdigit (c);
+	}
+
+	return digit;
+}
+
+gboolean
+empathy_spell_check (const gchar *word)
+{
+	gint         enchant_result = 1;
 	gint         len;
 	GList       *l;
+	gboolean     correct;
 
 	g_return_val_if_fail (word != NULL, FALSE);
 
@@ -313,13 +399,12 @@ empathy_spell_check (const gchar *word)
 		return TRUE;
 	}
 
-	/* Ignore certain cases like numbers, etc. */
-	for (p = word, digit = TRUE; *p && digit; p = g_utf8_next_char (p)) {
-		c = g_utf8_get_char (p);
-		digit = g_unichar_isdigit (c);
+	if (spell_cache_lookup (word, &correct)) {
+		return correct;
 	}
 
-	if (digit) {
+	/* Ignore certain cases like numbers, etc. */
+	if (spell_word_is_digits (word)) {
 		/* We don't spell check digits. */
 		DEBUG ("Not spell checking word:'%s', it is all digits", word);
 		return TRUE;
@@ -338,7 +423,79 @@ empathy_spell_check (const gchar *word)
 		}
 	}
 
-	return (enchant_result == 0);
+	correct = (enchant_result == 0);
+	spell_cache_insert (word, correct);
+
+	return correct;
+}
+
+gboolean
+empathy_spell_check_words (const gchar * const *words,
+			   gboolean            *correct)
+{
+	GList    *l;
+	guint     n_words, n_pending, i;
+	gboolean *pending;
+	gboolean  all_correct = TRUE;
+
+	g_return_val_if_fail (words != NULL, FALSE);
+	g_return_val_if_fail (correct != NULL, FALSE);
+
+	spell_setup_languages ();
+
+	n_words = g_strv_length ((gchar **) words);
+	pending = g_new0 (gboolean, n_words);
+	n_pending = 0;
+
+	/* Answer what we can from the cache and collect the rest */
+	for (i = 0; i < n_words; i++) {
+		correct[i] = TRUE;
+
+		/* Empty strings are no words, never pass them to enchant */
+		if (!languages || words[i][0] == '\0' ||
+		    spell_cache_lookup (words[i], &correct[i])) {
+			continue;
+		}
+
+		if (spell_word_is_digits (words[i])) {
+			continue;
+		}
+
+		correct[i] = FALSE;
+		pending[i] = TRUE;
+		n_pending++;
+	}
+
+	/* Check the remaining words one dictionary at a time, a word
+	 * accepted by a dictionary is not looked up in the next ones. */
+	for (l = languages; l && n_pending > 0; l = l->next) {
+		SpellLanguage *lang = l->data;
+
+		for (i = 0; i < n_words; i++) {
+			if (!pending[i]) {
+				continue;
+			}
+
+			if (enchant_dict_check (lang->speller, words[i],
+						strlen (words[i])) == 0) {
+				correct[i] = TRUE;
+				pending[i] = FALSE;
+				n_pending--;
+			}
+		}
+	}
+
+	for (i = 0; i < n_words; i++) {
+		if (languages && words[i][0] != '\0') {
+			spell_cache_insert (words[i], correct[i]);
+		}
+
+		all_correct = all_correct && correct[i];
+	}
+
+	g_free (pending);
+
+	return all_correct;
 }
 
 GList *
@@ -412,6 +569,21 @@ empathy_spell_check (const gchar *word)
 	return TRUE;
 }
 
+gboolean
+empathy_spell_check_words (const gchar * const *words,
+			   gboolean            *correct)
+{
+	guint i;
+
+	DEBUG ("Support disabled, could not check spelling");
+
+	for (i = 0; words[i] != NULL; i++) {
+		correct[i] = TRUE;
+	}
+
+	return TRUE;
+}
+
 const gchar *
 empathy_spell_get_language_name (const gchar *lang)
 {
@@ -33,6 +33,8 @@ const gchar *empathy_spell_get_language_name   (const gchar *code);
 GList       *empathy_spell_get_language_codes  (void);
 void         empathy_spell_free_language_codes (GList       *codes);
 gboolean     empathy_spell_check               (const gchar *word);
+gboolean     empathy_spell_check_words         (const gchar * const *words,
+						gboolean    *correct);
 GList *      empathy_spell_get_suggestions     (const gchar *word);
 void         empathy_spell_free_suggestions    (GList       *suggestions);
 
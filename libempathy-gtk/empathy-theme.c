@@ -225,14 +225,9 @@ theme_insert_text_with_emoticons (GtkTextBuffer *buf,
 				  const gchar   *str,
 				  EmpathySmileyManager *smiley_manager)
 {
-	gboolean             use_smileys = FALSE;
 	GSList              *smileys, *l;
 
-	empathy_conf_get_bool (empathy_conf_get (),
-			      EMPATHY_PREFS_CHAT_SHOW_SMILEYS,
-			      &use_smileys);
-
-	if (!use_smileys) {
+	if (!empathy_conf_get_cache (empathy_conf_get ())->chat_show_smileys) {
 		gtk_text_buffer_insert (buf, iter, str, -1);
 		return;
 	}
@@ -39,6 +39,10 @@
 #include <gio/gio.h>
 #include <canberra-gtk.h>
 
+#if HAVE_LIBCHAMPLAIN
+#include <clutter-gtk/gtk-clutter-embed.h>
+#endif
+
 #include <libmissioncontrol/mc-profile.h>
 
 #include "empathy-ui-utils.h"
@@ -75,6 +79,23 @@ empathy_gtk_init (void)
 	initialized = TRUE;
 }
 
+/* Clutter is only needed to show maps, it is initialised by the first
+ * one instead of at startup */
+void
+empathy_gtk_clutter_init (void)
+{
+#if HAVE_LIBCHAMPLAIN
+	static gboolean initialized = FALSE;
+
+	if (initialized)
+		return;
+
+	gtk_clutter_init (NULL, NULL);
+
+	initialized = TRUE;
+#endif
+}
+
 GRegex *
 empathy_uri_regex_dup_singleton (void)
 {
@@ -1558,23 +1579,20 @@ static gboolean
 empathy_sound_pref_is_enabled (const char *key)
 {
 	EmpathyConf *conf;
+	const EmpathyConfCache *cache;
 	gboolean res;
 
 	conf = empathy_conf_get ();
+	cache = empathy_conf_get_cache (conf);
 	res = FALSE;
 
-	empathy_conf_get_bool (conf, EMPATHY_PREFS_SOUNDS_ENABLED, &res);
-
-	if (!res) {
+	if (!cache->sounds_enabled) {
 		return FALSE;
 	}
 
-	if (!empathy_check_available_state ()) {
-		empathy_conf_get_bool (conf, EMPATHY_PREFS_SOUNDS_DISABLED_AWAY,
-				       &res);
-		if (res) {
-			return FALSE;
-		}
+	if (!empathy_check_available_state () &&
+	    cache->sounds_disabled_away) {
+		return FALSE;
 	}
 
 	empathy_conf_get_bool (conf, key, &res);
@@ -62,6 +62,7 @@ typedef enum {
 } EmpathySound;
 
 void            empathy_gtk_init                        (void);
+void            empathy_gtk_clutter_init                (void);
 GRegex *        empathy_uri_regex_dup_singleton         (void);
 
 /* Glade */
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <telepathy-glib/enums.h>
+#include <telepathy-glib/interfaces.h>
+#include <telepathy-glib/util.h>
+
+#include "empathy-channel-classes.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_DISPATCHER
+#include "empathy-debug.h"
+
+/**
+ * SECTION:empathy-channel-classes
+ * @short_description: Lookup table of requestable channel classes
+ * @include: libempathy/empathy-channel-classes.h
+ *
+ * The RequestableChannelClasses property of a connection lists the channels
+ * it can create, each class being a set of fixed properties and a list of
+ * allowed properties. #EmpathyChannelClasses indexes that list by channel
+ * type and target handle type, which is what capability checks ask for.
+ */
+
+struct _EmpathyChannelClasses {
+  /* channel type quark -> GStrv[NUM_TP_HANDLE_TYPES], allowed properties */
+  GHashTable *classes;
+};
+
+static void
+channel_classes_free_allowed (GStrv *allowed)
+{
+  guint i;
+
+  for (i = 0; i < NUM_TP_HANDLE_TYPES; i++)
+    g_strfreev (allowed[i]);
+
+  g_free (allowed);
+}
+
+/**
+ * empathy_channel_classes_new:
+ * @requestable_channels: the value of the RequestableChannelClasses property
+ * of a connection
+ *
+ * Builds the lookup table of @requestable_channels. Classes whose channel
+ * type or target handle type is not fixed can't be looked up and are
+ * ignored. When several classes have the same channel type and handle type,
+ * the first one wins.
+ *
+ * Return value: a new #EmpathyChannelClasses
+ */
+EmpathyChannelClasses *
+empathy_channel_classes_new (const GPtrArray *requestable_channels)
+{
+  EmpathyChannelClasses *classes;
+  guint i;
+
+  g_return_val_if_fail (requestable_channels != NULL, NULL);
+
+  classes = g_slice_new0 (EmpathyChannelClasses);
+  classes->classes = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) channel_classes_free_allowed);
+
+  for (i = 0; i < requestable_channels->len; i++)
+    {
+      GValueArray *class;
+      GHashTable *fixed;
+      const gchar *channel_type;
+      guint32 handle_type;
+      gboolean valid;
+      GQuark quark;
+      GStrv *allowed;
+
+      class = g_ptr_array_index (requestable_channels, i);
+      fixed = g_value_get_boxed (g_value_array_get_nth (class, 0));
+
+      channel_type = tp_asv_get_string (fixed,
+          TP_IFACE_CHANNEL ".ChannelType");
+      handle_type = tp_asv_get_uint32 (fixed,
+          TP_IFACE_CHANNEL ".TargetHandleType", &valid);
+
+      if (channel_type == NULL || !valid || handle_type == 0 ||
+          handle_type >= NUM_TP_HANDLE_TYPES)
+        continue;
+
+      quark = g_quark_from_string (channel_type);
+      allowed = g_hash_table_lookup (classes->classes,
+          GUINT_TO_POINTER (quark));
+      if (allowed == NULL)
+        {
+          allowed = g_new0 (GStrv, NUM_TP_HANDLE_TYPES);
+          g_hash_table_insert (classes->classes, GUINT_TO_POINTER (quark),
+              allowed);
+        }
+
+      if (allowed[handle_type] != NULL)
+        continue;
+
+      allowed[handle_type] = g_strdupv (
+          g_value_get_boxed (g_value_array_get_nth (class, 1)));
+
+      /* A class without allowed properties still needs an entry */
+      if (allowed[handle_type] == NULL)
+        allowed[handle_type] = g_new0 (gchar *, 1);
+    }
+
+  DEBUG ("Indexed %u requestable channel classes", requestable_channels->len);
+
+  return classes;
+}
+
+/**
+ * empathy_channel_classes_free:
+ * @classes: an #EmpathyChannelClasses
+ *
+ * Frees @classes.
+ */
+void
+empathy_channel_classes_free (EmpathyChannelClasses *classes)
+{
+  if (classes == NULL)
+    return;
+
+  g_hash_table_destroy (classes->classes);
+  g_slice_free (EmpathyChannelClasses, classes);
+}
+
+/**
+ * empathy_channel_classes_lookup:
+ * @classes: an #EmpathyChannelClasses
+ * @channel_type: a channel type
+ * @handle_type: a target handle type
+ *
+ * Looks up the class of channels of type @channel_type targeting handles of
+ * type @handle_type.
+ *
+ * Return value: the allowed properties of the class, owned by @classes, or
+ * %NULL if no such channel can be requested
+ */
+GStrv
+empathy_channel_classes_lookup (EmpathyChannelClasses *classes,
+                                const gchar *channel_type,
+                                guint handle_type)
+{
+  GQuark quark;
+  GStrv *allowed;
+
+  g_return_val_if_fail (classes != NULL, NULL);
+  g_return_val_if_fail (channel_type != NULL, NULL);
+
+  if (handle_type >= NUM_TP_HANDLE_TYPES)
+    return NULL;
+
+  /* An unknown quark means no class has that channel type */
+  quark = g_quark_try_string (channel_type);
+  if (quark == 0)
+    return NULL;
+
+  allowed = g_hash_table_lookup (classes->classes, GUINT_TO_POINTER (quark));
+  if (allowed == NULL)
+    return NULL;
+
+  return allowed[handle_type];
+}
@@ -30,6 +30,8 @@
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 
+#include <telepathy-glib/util.h>
+
 #include "empathy-tp-chat.h"
 #include "empathy-chatroom-manager.h"
 #include "empathy-account-manager.h"
@@ -47,13 +49,52 @@ static EmpathyChatroomManager *chatroom_manager_singleton = NULL;
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyChatroomManager)
 typedef struct
 {
-  GList *chatrooms;
+  /* EmpathyChatroom, newest first */
+  GQueue *chatrooms;
+  /* account unique name -> AccountChatrooms */
+  GHashTable *accounts;
+  /* EmpathyChatroom -> ChatroomEntry */
+  GHashTable *entries;
   gchar *file;
+  /* whether the file was parsed, it's only done when the chatrooms are
+   * first needed */
+  gboolean loaded;
   EmpathyAccountManager *account_manager;
   /* source id of the autosave timer */
   gint save_timer_id;
+  /* sequence number of the next chatroom added */
+  guint next_seq;
 } EmpathyChatroomManagerPriv;
 
+/* Chatrooms of an account */
+typedef struct
+{
+  /* EmpathyChatroom, newest first */
+  GQueue chatrooms;
+  /* room -> GQueue of the EmpathyChatroom of that room, newest first.
+   * Several chatrooms can have the same room when the file has duplicates
+   * or after a rename. */
+  GHashTable *by_room;
+} AccountChatrooms;
+
+/* What the manager keeps about each chatroom */
+typedef struct
+{
+  /* Where the chatroom is indexed, they can't be read from the chatroom
+   * when it notifies a change of account or room */
+  gchar *account_name;
+  gchar *room;
+  /* When it was added, the newest chatroom of a room is the one found */
+  guint seq;
+  /* Its links in the chatrooms queues, for quick removal */
+  GList *link;
+  GList *account_link;
+  GList *room_link;
+  /* The chatroom's element in the file, NULL until needed or after a
+   * change */
+  gchar *xml;
+} ChatroomEntry;
+
 enum {
   CHATROOM_ADDED,
   CHATROOM_REMOVED,
@@ -71,28 +112,194 @@ enum
 
 G_DEFINE_TYPE (EmpathyChatroomManager, empathy_chatroom_manager, G_TYPE_OBJECT);
 
+static void
+account_chatrooms_free (AccountChatrooms *account_chatrooms)
+{
+  g_queue_clear (&account_chatrooms->chatrooms);
+  g_hash_table_destroy (account_chatrooms->by_room);
+  g_slice_free (AccountChatrooms, account_chatrooms);
+}
+
+static void
+chatroom_entry_free (ChatroomEntry *entry)
+{
+  g_free (entry->account_name);
+  g_free (entry->room);
+  g_free (entry->xml);
+  g_slice_free (ChatroomEntry, entry);
+}
+
+static void
+chatroom_manager_index (EmpathyChatroomManager *self,
+                        EmpathyChatroom *chatroom)
+{
+  EmpathyChatroomManagerPriv *priv = GET_PRIV (self);
+  AccountChatrooms *account_chatrooms;
+  ChatroomEntry *entry;
+  McAccount *account;
+  const gchar *room;
+
+  entry = g_hash_table_lookup (priv->entries, chatroom);
+  account = empathy_chatroom_get_account (chatroom);
+  room = empathy_chatroom_get_room (chatroom);
+
+  if (account == NULL)
+    return;
+
+  entry->account_name = g_strdup (mc_account_get_unique_name (account));
+  account_chatrooms = g_hash_table_lookup (priv->accounts,
+      entry->account_name);
+  if (account_chatrooms == NULL)
+    {
+      account_chatrooms = g_slice_new0 (AccountChatrooms);
+      account_chatrooms->by_room = g_hash_table_new_full (g_str_hash,
+          g_str_equal, g_free, (GDestroyNotify) g_queue_free);
+      g_hash_table_insert (priv->accounts, g_strdup (entry->account_name),
+          account_chatrooms);
+    }
+
+  g_queue_push_head (&account_chatrooms->chatrooms, chatroom);
+  entry->account_link = account_chatrooms->chatrooms.head;
+
+  if (room != NULL)
+    {
+      GQueue *queue;
+      GList *l;
+
+      entry->room = g_strdup (room);
+
+      queue = g_hash_table_lookup (account_chatrooms->by_room, room);
+      if (queue == NULL)
+        {
+          queue = g_queue_new ();
+          g_hash_table_insert (account_chatrooms->by_room, g_strdup (room),
+              queue);
+        }
+
+      /* New chatrooms go first, only a renamed one can have newer
+       * duplicates */
+      for (l = queue->head; l != NULL; l = l->next)
+        {
+          ChatroomEntry *other = g_hash_table_lookup (priv->entries,
+              l->data);
+
+          if (other->seq < entry->seq)
+            break;
+        }
+
+      if (l == NULL)
+        {
+          g_queue_push_tail (queue, chatroom);
+          entry->room_link = queue->tail;
+        }
+      else
+        {
+          g_queue_insert_before (queue, l, chatroom);
+          entry->room_link = l->prev;
+        }
+    }
+}
+
+static void
+chatroom_manager_unindex (EmpathyChatroomManager *self,
+                          EmpathyChatroom *chatroom)
+{
+  EmpathyChatroomManagerPriv *priv = GET_PRIV (self);
+  AccountChatrooms *account_chatrooms;
+  ChatroomEntry *entry;
+
+  entry = g_hash_table_lookup (priv->entries, chatroom);
+  if (entry->account_name == NULL)
+    return;
+
+  account_chatrooms = g_hash_table_lookup (priv->accounts,
+      entry->account_name);
+  g_queue_delete_link (&account_chatrooms->chatrooms, entry->account_link);
+
+  /* The next duplicate of the room, if any, takes over */
+  if (entry->room != NULL)
+    {
+      GQueue *queue;
+
+      queue = g_hash_table_lookup (account_chatrooms->by_room, entry->room);
+      g_queue_delete_link (queue, entry->room_link);
+      if (g_queue_is_empty (queue))
+        g_hash_table_remove (account_chatrooms->by_room, entry->room);
+    }
+
+  if (g_queue_is_empty (&account_chatrooms->chatrooms))
+    g_hash_table_remove (priv->accounts, entry->account_name);
+
+  g_free (entry->account_name);
+  g_free (entry->room);
+  entry->account_name = NULL;
+  entry->room = NULL;
+  entry->account_link = NULL;
+  entry->room_link = NULL;
+}
+
 /*
  * API to save/load and parse the chatrooms file.
  */
 
+/* Returns the <chatroom> element of @chatroom, only building it again if
+ * the chatroom changed since the last save */
+static const gchar *
+chatroom_manager_get_xml (EmpathyChatroomManager *manager,
+			  EmpathyChatroom        *chatroom)
+{
+	EmpathyChatroomManagerPriv *priv;
+	ChatroomEntry              *entry;
+	McAccount                  *account;
+	const gchar                *account_id = NULL;
+
+	priv = GET_PRIV (manager);
+	entry = g_hash_table_lookup (priv->entries, chatroom);
+
+	if (entry->xml != NULL) {
+		return entry->xml;
+	}
+
+	account = empathy_chatroom_get_account (chatroom);
+	if (account != NULL) {
+		account_id = mc_account_get_unique_name (account);
+	}
+
+	entry->xml = g_markup_printf_escaped (
+		"  <chatroom>\n"
+		"    <name>%s</name>\n"
+		"    <room>%s</room>\n"
+		"    <account>%s</account>\n"
+		"    <auto_connect>%s</auto_connect>\n"
+		"  </chatroom>\n",
+		EMP_STR_EMPTY (empathy_chatroom_get_name (chatroom)) ? "" :
+			empathy_chatroom_get_name (chatroom),
+		EMP_STR_EMPTY (empathy_chatroom_get_room (chatroom)) ? "" :
+			empathy_chatroom_get_room (chatroom),
+		account_id ? account_id : "",
+		empathy_chatroom_get_auto_connect (chatroom) ? "yes" : "no");
+
+	return entry->xml;
+}
+
 static gboolean
 chatroom_manager_file_save (EmpathyChatroomManager *manager)
 {
 	EmpathyChatroomManagerPriv *priv;
-	xmlDocPtr                  doc;
-	xmlNodePtr                 root;
-	GList                     *l;
+	GString                    *str;
+	GList                      *l;
+	GError                     *error = NULL;
+	gboolean                    ret;
 
 	priv = GET_PRIV (manager);
 
-	doc = xmlNewDoc ("1.0");
-	root = xmlNewNode (NULL, "chatrooms");
-	xmlDocSetRootElement (doc, root);
+	/* The file is written as text from the cached elements of the
+	 * chatrooms, only those that changed are serialized again */
+	str = g_string_new ("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+			    "<chatrooms>\n");
 
-	for (l = priv->chatrooms; l; l = l->next) {
+	for (l = priv->chatrooms->head; l; l = l->next) {
 		EmpathyChatroom *chatroom;
-		xmlNodePtr       node;
-		const gchar     *account_id;
 
 		chatroom = l->data;
 
@@ -100,27 +307,21 @@ chatroom_manager_file_save (EmpathyChatroomManager *manager)
 			continue;
 		}
 
-		account_id = mc_account_get_unique_name (empathy_chatroom_get_account (chatroom));
-
-		node = xmlNewChild (root, NULL, "chatroom", NULL);
-		xmlNewTextChild (node, NULL, "name", empathy_chatroom_get_name (chatroom));
-		xmlNewTextChild (node, NULL, "room", empathy_chatroom_get_room (chatroom));
-		xmlNewTextChild (node, NULL, "account", account_id);
-		xmlNewTextChild (node, NULL, "auto_connect",
-			empathy_chatroom_get_auto_connect (chatroom) ? "yes" : "no");
+		g_string_append (str, chatroom_manager_get_xml (manager, chatroom));
 	}
 
-	/* Make sure the XML is indented properly */
-	xmlIndentTreeOutput = 1;
+	g_string_append (str, "</chatrooms>\n");
 
 	DEBUG ("Saving file:'%s'", priv->file);
-	xmlSaveFormatFileEnc (priv->file, doc, "utf-8", 1);
-	xmlFreeDoc (doc);
+	ret = g_file_set_contents (priv->file, str->str, str->len, &error);
+	if (!ret) {
+		DEBUG ("Failed to save file: %s", error->message);
+		g_error_free (error);
+	}
 
-	xmlCleanupParser ();
-	xmlMemoryDump ();
+	g_string_free (str, TRUE);
 
-	return TRUE;
+	return ret;
 }
 
 static gboolean
@@ -153,7 +354,31 @@ chatroom_changed_cb (EmpathyChatroom *chatroom,
                      GParamSpec *spec,
                      EmpathyChatroomManager *self)
 {
-  reset_save_timeout (self);
+  EmpathyChatroomManagerPriv *priv = GET_PRIV (self);
+  ChatroomEntry *entry;
+
+  if (!tp_strdiff (spec->name, "account") || !tp_strdiff (spec->name, "room"))
+    {
+      chatroom_manager_unindex (self, chatroom);
+      chatroom_manager_index (self, chatroom);
+    }
+
+  /* Only changes of what is in the file need a save */
+  if (tp_strdiff (spec->name, "favorite") &&
+      tp_strdiff (spec->name, "name") &&
+      tp_strdiff (spec->name, "room") &&
+      tp_strdiff (spec->name, "account") &&
+      tp_strdiff (spec->name, "auto-connect") &&
+      tp_strdiff (spec->name, "auto_connect"))
+    return;
+
+  entry = g_hash_table_lookup (priv->entries, chatroom);
+  g_free (entry->xml);
+  entry->xml = NULL;
+
+  if (empathy_chatroom_is_favorite (chatroom) ||
+      !tp_strdiff (spec->name, "favorite"))
+    reset_save_timeout (self);
 }
 
 static void
@@ -161,13 +386,36 @@ add_chatroom (EmpathyChatroomManager *self,
               EmpathyChatroom *chatroom)
 {
   EmpathyChatroomManagerPriv *priv = GET_PRIV (self);
+  ChatroomEntry *entry;
 
-  priv->chatrooms = g_list_prepend (priv->chatrooms, g_object_ref (chatroom));
+  g_queue_push_head (priv->chatrooms, g_object_ref (chatroom));
+  entry = g_slice_new0 (ChatroomEntry);
+  entry->seq = priv->next_seq++;
+  entry->link = priv->chatrooms->head;
+  g_hash_table_insert (priv->entries, chatroom, entry);
+  chatroom_manager_index (self, chatroom);
 
   g_signal_connect (chatroom, "notify",
       G_CALLBACK (chatroom_changed_cb), self);
 }
 
+static void
+remove_chatroom (EmpathyChatroomManager *self,
+                 EmpathyChatroom *chatroom)
+{
+  EmpathyChatroomManagerPriv *priv = GET_PRIV (self);
+  ChatroomEntry *entry;
+
+  g_signal_handlers_disconnect_by_func (chatroom, chatroom_changed_cb, self);
+
+  chatroom_manager_unindex (self, chatroom);
+  entry = g_hash_table_lookup (priv->entries, chatroom);
+  g_queue_delete_link (priv->chatrooms, entry->link);
+  g_hash_table_remove (priv->entries, chatroom);
+
+  g_object_unref (chatroom);
+}
+
 static void
 chatroom_manager_parse_chatroom (EmpathyChatroomManager *manager,
 				 xmlNodePtr             node)
@@ -279,7 +527,7 @@ chatroom_manager_file_parse (EmpathyChatroomManager *manager,
 		}
 	}
 
-	DEBUG ("Parsed %d chatrooms", g_list_length (priv->chatrooms));
+	DEBUG ("Parsed %d chatrooms", g_queue_get_length (priv->chatrooms));
 
 	xmlFreeDoc (doc);
 	xmlFreeParserCtxt (ctxt);
@@ -303,6 +551,18 @@ chatroom_manager_get_all (EmpathyChatroomManager *manager)
 	return TRUE;
 }
 
+static void
+chatroom_manager_ensure_loaded (EmpathyChatroomManager *manager)
+{
+  EmpathyChatroomManagerPriv *priv = GET_PRIV (manager);
+
+  if (priv->loaded)
+    return;
+
+  priv->loaded = TRUE;
+  chatroom_manager_get_all (manager);
+}
+
 static void
 empathy_chatroom_manager_get_property (GObject *object,
                                        guint property_id,
@@ -349,7 +609,6 @@ chatroom_manager_finalize (GObject *object)
 {
   EmpathyChatroomManager *self = EMPATHY_CHATROOM_MANAGER (object);
   EmpathyChatroomManagerPriv *priv;
-  GList *l;
 
   priv = GET_PRIV (object);
 
@@ -363,17 +622,12 @@ chatroom_manager_finalize (GObject *object)
       chatroom_manager_file_save (self);
     }
 
-  for (l = priv->chatrooms; l != NULL; l = g_list_next (l))
-    {
-      EmpathyChatroom *chatroom = l->data;
-
-      g_signal_handlers_disconnect_by_func (chatroom, chatroom_changed_cb,
-          self);
-
-      g_object_unref (chatroom);
-    }
+  while (!g_queue_is_empty (priv->chatrooms))
+    remove_chatroom (self, g_queue_peek_head (priv->chatrooms));
 
-  g_list_free (priv->chatrooms);
+  g_queue_free (priv->chatrooms);
+  g_hash_table_destroy (priv->accounts);
+  g_hash_table_destroy (priv->entries);
   g_free (priv->file);
 
   (G_OBJECT_CLASS (empathy_chatroom_manager_parent_class)->finalize) (object);
@@ -416,7 +670,7 @@ empathy_chatroom_manager_constructor (GType type,
       g_free (dir);
     }
 
-  chatroom_manager_get_all (self);
+  /* The file is parsed when the chatrooms are first needed */
   return obj;
 }
 
@@ -469,6 +723,12 @@ empathy_chatroom_manager_init (EmpathyChatroomManager *manager)
       EMPATHY_TYPE_CHATROOM_MANAGER, EmpathyChatroomManagerPriv);
 
   manager->priv = priv;
+
+  priv->chatrooms = g_queue_new ();
+  priv->accounts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) account_chatrooms_free);
+  priv->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+      (GDestroyNotify) chatroom_entry_free);
 }
 
 EmpathyChatroomManager *
@@ -488,6 +748,7 @@ empathy_chatroom_manager_add (EmpathyChatroomManager *manager,
   g_return_val_if_fail (EMPATHY_IS_CHATROOM (chatroom), FALSE);
 
   priv = GET_PRIV (manager);
+  chatroom_manager_ensure_loaded (manager);
 
   /* don't add more than once */
   if (!empathy_chatroom_manager_find (manager,
@@ -511,34 +772,30 @@ empathy_chatroom_manager_remove (EmpathyChatroomManager *manager,
                                  EmpathyChatroom        *chatroom)
 {
   EmpathyChatroomManagerPriv *priv;
-  GList *l;
+  EmpathyChatroom *this_chatroom = NULL;
 
   g_return_if_fail (EMPATHY_IS_CHATROOM_MANAGER (manager));
   g_return_if_fail (EMPATHY_IS_CHATROOM (chatroom));
 
   priv = GET_PRIV (manager);
+  chatroom_manager_ensure_loaded (manager);
 
-  for (l = priv->chatrooms; l; l = l->next)
-    {
-      EmpathyChatroom *this_chatroom;
+  if (g_hash_table_lookup (priv->entries, chatroom) != NULL)
+    this_chatroom = chatroom;
+  else if (empathy_chatroom_get_account (chatroom) != NULL &&
+           empathy_chatroom_get_room (chatroom) != NULL)
+    this_chatroom = empathy_chatroom_manager_find (manager,
+        empathy_chatroom_get_account (chatroom),
+        empathy_chatroom_get_room (chatroom));
 
-      this_chatroom = l->data;
-
-      if (this_chatroom == chatroom ||
-          empathy_chatroom_equal (chatroom, this_chatroom))
-        {
-          priv->chatrooms = g_list_delete_link (priv->chatrooms, l);
-          if (empathy_chatroom_is_favorite (chatroom))
-            reset_save_timeout (manager);
+  if (this_chatroom == NULL)
+    return;
 
-          g_signal_emit (manager, signals[CHATROOM_REMOVED], 0, this_chatroom);
-          g_signal_handlers_disconnect_by_func (chatroom, chatroom_changed_cb,
-              manager);
+  if (empathy_chatroom_is_favorite (chatroom))
+    reset_save_timeout (manager);
 
-          g_object_unref (this_chatroom);
-          break;
-        }
-    }
+  g_signal_emit (manager, signals[CHATROOM_REMOVED], 0, this_chatroom);
+  remove_chatroom (manager, this_chatroom);
 }
 
 EmpathyChatroom *
@@ -547,31 +804,28 @@ empathy_chatroom_manager_find (EmpathyChatroomManager *manager,
                                const gchar *room)
 {
 	EmpathyChatroomManagerPriv *priv;
-	GList                     *l;
+	AccountChatrooms           *account_chatrooms;
+	GQueue                     *queue;
 
 	g_return_val_if_fail (EMPATHY_IS_CHATROOM_MANAGER (manager), NULL);
 	g_return_val_if_fail (MC_IS_ACCOUNT (account), NULL);
 	g_return_val_if_fail (room != NULL, NULL);
 
 	priv = GET_PRIV (manager);
+	chatroom_manager_ensure_loaded (manager);
 
-	for (l = priv->chatrooms; l; l = l->next) {
-		EmpathyChatroom *chatroom;
-		McAccount      *this_account;
-		const gchar    *this_room;
-
-		chatroom = l->data;
-		this_account = empathy_chatroom_get_account (chatroom);
-		this_room = empathy_chatroom_get_room (chatroom);
+	account_chatrooms = g_hash_table_lookup (priv->accounts,
+		mc_account_get_unique_name (account));
+	if (account_chatrooms == NULL) {
+		return NULL;
+	}
 
-		if (this_account && this_room &&
-		    empathy_account_equal (account, this_account) &&
-		    strcmp (this_room, room) == 0) {
-			return chatroom;
-		}
+	queue = g_hash_table_lookup (account_chatrooms->by_room, room);
+	if (queue == NULL) {
+		return NULL;
 	}
 
-	return NULL;
+	return g_queue_peek_head (queue);
 }
 
 GList *
@@ -579,29 +833,24 @@ empathy_chatroom_manager_get_chatrooms (EmpathyChatroomManager *manager,
 				       McAccount             *account)
 {
 	EmpathyChatroomManagerPriv *priv;
-	GList                     *chatrooms, *l;
+	AccountChatrooms           *account_chatrooms;
 
 	g_return_val_if_fail (EMPATHY_IS_CHATROOM_MANAGER (manager), NULL);
 
 	priv = GET_PRIV (manager);
+	chatroom_manager_ensure_loaded (manager);
 
 	if (!account) {
-		return g_list_copy (priv->chatrooms);
+		return g_list_copy (priv->chatrooms->head);
 	}
 
-	chatrooms = NULL;
-	for (l = priv->chatrooms; l; l = l->next) {
-		EmpathyChatroom *chatroom;
-
-		chatroom = l->data;
-
-		if (empathy_account_equal (account,
-					  empathy_chatroom_get_account (chatroom))) {
-			chatrooms = g_list_append (chatrooms, chatroom);
-		}
+	account_chatrooms = g_hash_table_lookup (priv->accounts,
+		mc_account_get_unique_name (account));
+	if (account_chatrooms == NULL) {
+		return NULL;
 	}
 
-	return chatrooms;
+	return g_list_copy (account_chatrooms->chatrooms.head);
 }
 
 guint
@@ -609,29 +858,24 @@ empathy_chatroom_manager_get_count (EmpathyChatroomManager *manager,
 				   McAccount             *account)
 {
 	EmpathyChatroomManagerPriv *priv;
-	GList                     *l;
-	guint                      count = 0;
+	AccountChatrooms           *account_chatrooms;
 
 	g_return_val_if_fail (EMPATHY_IS_CHATROOM_MANAGER (manager), 0);
 
 	priv = GET_PRIV (manager);
+	chatroom_manager_ensure_loaded (manager);
 
 	if (!account) {
-		return g_list_length (priv->chatrooms);
+		return g_queue_get_length (priv->chatrooms);
 	}
 
-	for (l = priv->chatrooms; l; l = l->next) {
-		EmpathyChatroom *chatroom;
-
-		chatroom = l->data;
-
-		if (empathy_account_equal (account,
-					   empathy_chatroom_get_account (chatroom))) {
-			count++;
-		}
+	account_chatrooms = g_hash_table_lookup (priv->accounts,
+		mc_account_get_unique_name (account));
+	if (account_chatrooms == NULL) {
+		return 0;
 	}
 
-	return count;
+	return g_queue_get_length (&account_chatrooms->chatrooms);
 }
 
 static void
@@ -639,24 +883,41 @@ chatroom_manager_chat_destroyed_cb (EmpathyTpChat *chat,
   gpointer manager)
 {
   EmpathyChatroomManagerPriv *priv = GET_PRIV (manager);
+  EmpathyChatroom *chatroom = NULL;
+  McAccount *account;
   GList *l;
 
-  for (l = priv->chatrooms; l; l = l->next)
-    {
-      EmpathyChatroom *chatroom = l->data;
-
-      if (empathy_chatroom_get_tp_chat (chatroom) != chat)
-        continue;
+  /* The chatroom of the chat is indexed by its account and ID */
+  account = empathy_account_manager_get_account (priv->account_manager,
+      empathy_tp_chat_get_connection (chat));
+  if (account != NULL)
+    chatroom = empathy_chatroom_manager_find (manager, account,
+        empathy_tp_chat_get_id (chat));
 
-      empathy_chatroom_set_tp_chat (chatroom, NULL);
-      if (!empathy_chatroom_is_favorite (chatroom))
+  if (chatroom == NULL || empathy_chatroom_get_tp_chat (chatroom) != chat)
+    {
+      chatroom = NULL;
+      for (l = priv->chatrooms->head; l; l = l->next)
         {
-          /* Remove the chatroom from the list, unless it's in the list of
-           * favourites..
-           * FIXME this policy should probably not be in libempathy */
-          empathy_chatroom_manager_remove (manager, chatroom);
+          if (empathy_chatroom_get_tp_chat (l->data) == chat)
+            {
+              chatroom = l->data;
+              break;
+            }
         }
     }
+
+  if (chatroom == NULL)
+    return;
+
+  empathy_chatroom_set_tp_chat (chatroom, NULL);
+  if (!empathy_chatroom_is_favorite (chatroom))
+    {
+      /* Remove the chatroom from the list, unless it's in the list of
+       * favourites..
+       * FIXME this policy should probably not be in libempathy */
+      empathy_chatroom_manager_remove (manager, chatroom);
+    }
 }
 
 static void
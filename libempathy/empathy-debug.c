@@ -32,10 +32,27 @@
 #include <telepathy-glib/debug.h>
 
 #include "empathy-debug.h"
+#include "empathy-time.h"
 
-#ifdef ENABLE_DEBUG
+/* Must be a power of two */
+#define TRACE_RING_SIZE 8192
 
-static EmpathyDebugFlags flags = 0;
+typedef struct
+{
+  /* Index of the event + 1, 0 while it is being written */
+  volatile guint seq;
+  gint64 time;
+  gpointer thread;
+  EmpathyDebugFlags flag;
+  EmpathyTraceType type;
+  const gchar *name;
+  guint64 value;
+} TraceEvent;
+
+EmpathyDebugFlags empathy_trace_flags = 0;
+
+static TraceEvent trace_ring[TRACE_RING_SIZE];
+static volatile gint trace_next = 0;
 
 static GDebugKey keys[] = {
   { "Tp", EMPATHY_DEBUG_TP },
@@ -50,6 +67,108 @@ static GDebugKey keys[] = {
   { 0, }
 };
 
+static const gchar *
+debug_flag_get_name (EmpathyDebugFlags flag)
+{
+  guint i;
+
+  for (i = 0; keys[i].value; i++)
+    if (keys[i].value == flag)
+      return keys[i].key;
+
+  return "Unknown";
+}
+
+static EmpathyDebugFlags
+debug_parse_flags (const gchar *flags_string)
+{
+  guint nkeys;
+
+  if (flags_string == NULL)
+    return 0;
+
+  for (nkeys = 0; keys[nkeys].value; nkeys++);
+
+  return g_parse_debug_string (flags_string, keys, nkeys);
+}
+
+void
+empathy_trace_set_flags (const gchar *flags_string)
+{
+  empathy_trace_flags |= debug_parse_flags (flags_string);
+}
+
+void
+empathy_trace_record (EmpathyDebugFlags flag,
+                      EmpathyTraceType type,
+                      const gchar *name,
+                      guint64 value)
+{
+  TraceEvent *event;
+  guint index;
+
+  /* Each writer gets its own slot, no lock is taken */
+  index = (guint) g_atomic_int_exchange_and_add (&trace_next, 1);
+  event = &trace_ring[index & (TRACE_RING_SIZE - 1)];
+
+  g_atomic_int_set ((volatile gint *) &event->seq, 0);
+
+  /* Not the wall clock, which can step while tracing */
+  event->time = (gint64) (empathy_time_get_monotonic () * G_USEC_PER_SEC);
+  event->thread = g_thread_self ();
+  event->flag = flag;
+  event->type = type;
+  event->name = name;
+  event->value = value;
+
+  g_atomic_int_set ((volatile gint *) &event->seq, index + 1);
+}
+
+/* Writes the events still in the ring, oldest first. Events being written
+ * or overwritten while dumping are skipped. */
+gboolean
+empathy_trace_dump (const gchar *filename,
+                    GError **error)
+{
+  static const gchar *type_names[] = { "begin", "end", "mark" };
+  GString *str;
+  guint next, first, i;
+  gboolean ret;
+
+  str = g_string_new ("# time(us) thread category type name value\n");
+
+  next = (guint) g_atomic_int_get (&trace_next);
+  first = next > TRACE_RING_SIZE ? next - TRACE_RING_SIZE : 0;
+
+  for (i = first; i != next; i++)
+    {
+      TraceEvent *slot = &trace_ring[i & (TRACE_RING_SIZE - 1)];
+      TraceEvent event;
+
+      if ((guint) g_atomic_int_get ((volatile gint *) &slot->seq) != i + 1)
+        continue;
+
+      event = *slot;
+
+      if ((guint) g_atomic_int_get ((volatile gint *) &slot->seq) != i + 1)
+        continue;
+
+      g_string_append_printf (str,
+          "%" G_GINT64_FORMAT " %p %s %s %s %" G_GUINT64_FORMAT "\n",
+          event.time, event.thread, debug_flag_get_name (event.flag),
+          type_names[event.type], event.name, event.value);
+    }
+
+  ret = g_file_set_contents (filename, str->str, str->len, error);
+  g_string_free (str, TRUE);
+
+  return ret;
+}
+
+#ifdef ENABLE_DEBUG
+
+static EmpathyDebugFlags flags = 0;
+
 static void
 debug_set_flags (EmpathyDebugFlags new_flags)
 {
@@ -59,14 +178,10 @@ debug_set_flags (EmpathyDebugFlags new_flags)
 void
 empathy_debug_set_flags (const gchar *flags_string)
 {
-  guint nkeys;
-
-  for (nkeys = 0; keys[nkeys].value; nkeys++);
-
   tp_debug_set_flags (flags_string);
 
   if (flags_string)
-      debug_set_flags (g_parse_debug_string (flags_string, keys, nkeys));
+      debug_set_flags (debug_parse_flags (flags_string));
 }
 
 gboolean
@@ -47,6 +47,39 @@ gboolean empathy_debug_flag_is_set (EmpathyDebugFlags flag);
 void empathy_debug (EmpathyDebugFlags flag, const gchar *format, ...)
     G_GNUC_PRINTF (2, 3);
 void empathy_debug_set_flags (const gchar *flags_string);
+
+typedef enum
+{
+  EMPATHY_TRACE_BEGIN,
+  EMPATHY_TRACE_END,
+  EMPATHY_TRACE_MARK,
+} EmpathyTraceType;
+
+/* Categories being traced, tested by the EMPATHY_TRACE_* macros before
+ * their arguments are evaluated */
+extern EmpathyDebugFlags empathy_trace_flags;
+
+void empathy_trace_set_flags (const gchar *flags_string);
+void empathy_trace_record (EmpathyDebugFlags flag, EmpathyTraceType type,
+    const gchar *name, guint64 value);
+gboolean empathy_trace_dump (const gchar *filename, GError **error);
+
+/* Trace events are kept in a ring buffer and only written out by
+ * empathy_trace_dump(). @name must be a static string, @value is free for
+ * the caller, e.g. to pair the begin and end of concurrent spans. */
+#define EMPATHY_TRACE(flag, type, name, value) \
+  G_STMT_START { \
+    if (G_UNLIKELY (empathy_trace_flags & (flag))) \
+      empathy_trace_record ((flag), (type), (name), (value)); \
+  } G_STMT_END
+
+#define EMPATHY_TRACE_BEGIN(flag, name, value) \
+  EMPATHY_TRACE (flag, EMPATHY_TRACE_BEGIN, name, value)
+#define EMPATHY_TRACE_END(flag, name, value) \
+  EMPATHY_TRACE (flag, EMPATHY_TRACE_END, name, value)
+#define EMPATHY_TRACE_MARK(flag, name, value) \
+  EMPATHY_TRACE (flag, EMPATHY_TRACE_MARK, name, value)
+
 G_END_DECLS
 
 #endif /* __EMPATHY_DEBUG_H__ */
@@ -72,9 +105,14 @@ G_END_DECLS
 #ifdef DEBUG_FLAG
 #ifdef ENABLE_DEBUG
 
+/* The flag is checked first, so the arguments are not evaluated when
+ * debugging is off */
 #undef DEBUG
 #define DEBUG(format, ...) \
-  empathy_debug (DEBUG_FLAG, "%s: " format, G_STRFUNC, ##__VA_ARGS__)
+  G_STMT_START { \
+    if (empathy_debug_flag_is_set (DEBUG_FLAG)) \
+      empathy_debug (DEBUG_FLAG, "%s: " format, G_STRFUNC, ##__VA_ARGS__); \
+  } G_STMT_END
 
 #undef DEBUGGING
 #define DEBUGGING empathy_debug_flag_is_set (DEBUG_FLAG)
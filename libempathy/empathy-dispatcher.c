@@ -35,6 +35,7 @@
 #include <extensions/extensions.h>
 
 #include "empathy-dispatcher.h"
+#include "empathy-channel-classes.h"
 #include "empathy-utils.h"
 #include "empathy-tube-handler.h"
 #include "empathy-account-manager.h"
@@ -58,6 +59,11 @@ typedef struct
 
   /* channels which the dispatcher is listening "invalidated" */
   GList *channels;
+
+  /* Latency of our requests, from the request to the channel being ready */
+  guint n_requests;
+  gdouble requests_time;
+  gdouble requests_max_time;
 } EmpathyDispatcherPriv;
 
 G_DEFINE_TYPE (EmpathyDispatcher, empathy_dispatcher, G_TYPE_OBJECT);
@@ -88,8 +94,28 @@ typedef struct
   EmpathyDispatcherRequestCb *cb;
   gpointer user_data;
   gpointer *request_data;
+
+  /* Identical requests made while this one was in flight, they share its
+   * channel. List of DispatcherRequestWaiter */
+  GList *waiters;
+  GTimer *timer;
 } DispatcherRequestData;
 
+typedef struct
+{
+  EmpathyDispatcherRequestCb *cb;
+  gpointer user_data;
+} DispatcherRequestWaiter;
+
+typedef struct
+{
+  EmpathyDispatcherRequestCb *cb;
+  EmpathyDispatcherBatchCb *done_cb;
+  gpointer user_data;
+  guint pending;
+  guint failed;
+} DispatcherBatch;
+
 typedef struct
 {
   TpChannel *channel;
@@ -107,8 +133,8 @@ typedef struct
   GHashTable *outstanding_channels;
   /* List of DispatcherRequestData */
   GList *outstanding_requests;
-  /* List of requestable channel classes */
-  GPtrArray *requestable_channels;
+  /* Requestable channel classes, indexed by type and handle type */
+  EmpathyChannelClasses *channel_classes;
 } ConnectionData;
 
 static DispatchData *
@@ -159,6 +185,7 @@ new_dispatcher_request_data (EmpathyDispatcher *dispatcher,
 
   result->cb = cb;
   result->user_data = user_data;
+  result->timer = g_timer_new ();
 
   return result;
 }
@@ -166,8 +193,15 @@ new_dispatcher_request_data (EmpathyDispatcher *dispatcher,
 static void
 free_dispatcher_request_data (DispatcherRequestData *r)
 {
+  GList *l;
+
   g_free (r->channel_type);
 
+  for (l = r->waiters; l != NULL; l = g_list_next (l))
+    g_slice_free (DispatcherRequestWaiter, l->data);
+  g_list_free (r->waiters);
+  g_timer_destroy (r->timer);
+
   if (r->dispatcher != NULL)
     g_object_unref (r->dispatcher);
 
@@ -204,19 +238,49 @@ free_connection_data (ConnectionData *cd)
 
   g_hash_table_destroy (cd->dispatched_channels);
   g_hash_table_destroy (cd->dispatching_channels);
-  int i;
 
   for (l = cd->outstanding_requests ; l != NULL; l = g_list_delete_link (l,l))
     {
       free_dispatcher_request_data (l->data);
     }
 
-  if (cd->requestable_channels  != NULL)
+  empathy_channel_classes_free (cd->channel_classes);
+}
+
+/* Tells the requestor of @r, and of all the requests coalesced with it, that
+ * the channel is ready or that the request failed */
+static void
+dispatcher_request_data_complete (DispatcherRequestData *r,
+                                  EmpathyDispatchOperation *operation,
+                                  const GError *error)
+{
+  EmpathyDispatcherPriv *priv = GET_PRIV (r->dispatcher);
+  gdouble elapsed;
+  GList *l;
+
+  elapsed = g_timer_elapsed (r->timer, NULL) * 1000;
+  priv->n_requests++;
+  priv->requests_time += elapsed;
+  priv->requests_max_time = MAX (priv->requests_max_time, elapsed);
+
+  DEBUG ("Request of %s channel to handle %u %s after %.1f ms, "
+    "%u coalesced (%u requests, %.1f ms average, %.1f ms max)",
+    r->channel_type, r->handle, error != NULL ? "failed" : "ready", elapsed,
+    g_list_length (r->waiters), priv->n_requests,
+    priv->requests_time / priv->n_requests, priv->requests_max_time);
+
+  if (error != NULL)
+    operation = NULL;
+
+  if (r->cb != NULL)
+    r->cb (operation, error, r->user_data);
+
+  for (l = r->waiters; l != NULL; l = g_list_next (l))
     {
-      for (i = 0 ; i < cd->requestable_channels->len ; i++)
-          g_value_array_free (
-            g_ptr_array_index (cd->requestable_channels, i));
-      g_ptr_array_free (cd->requestable_channels, TRUE);
+      DispatcherRequestWaiter *waiter = l->data;
+
+      if (waiter->cb != NULL)
+        waiter->cb (operation, error, waiter->user_data);
     }
 }
 
@@ -241,15 +305,26 @@ dispatcher_operation_can_start (EmpathyDispatcher *self,
   GList *l;
   const gchar *channel_type =
     empathy_dispatch_operation_get_channel_type (operation);
+  TpHandle handle;
+  TpHandleType handle_type;
+
+  handle = tp_channel_get_handle (
+    empathy_dispatch_operation_get_channel (operation), &handle_type);
 
   for (l = cd->outstanding_requests; l != NULL; l = g_list_next (l))
     {
       DispatcherRequestData *d = (DispatcherRequestData *) l->data;
 
-      if (d->operation == NULL && !tp_strdiff (d->channel_type, channel_type))
-        {
-          return FALSE;
-        }
+      if (d->operation != NULL || tp_strdiff (d->channel_type, channel_type))
+        continue;
+
+      /* Requests for other targets won't get this channel, there is no
+       * need to wait for them */
+      if (d->handle != 0 && handle != 0 &&
+          (d->handle != handle || d->handle_type != handle_type))
+        continue;
+
+      return FALSE;
     }
 
   return TRUE;
@@ -273,13 +348,7 @@ dispatch_operation_flush_requests (EmpathyDispatcher *dispatcher,
 
       if (d->operation == operation)
         {
-          if (d->cb != NULL)
-            {
-              if (error != NULL)
-                d->cb (NULL, error, d->user_data);
-              else
-                d->cb (operation, NULL, d->user_data);
-            }
+          dispatcher_request_data_complete (d, operation, error);
 
           cd->outstanding_requests = g_list_delete_link
             (cd->outstanding_requests, lt);
@@ -717,8 +786,8 @@ dispatcher_connection_got_all (TpProxy *proxy,
       cd = g_hash_table_lookup (priv->connections, proxy);
       g_assert (cd != NULL);
 
-      cd->requestable_channels = g_boxed_copy (
-        TP_ARRAY_TYPE_REQUESTABLE_CHANNEL_CLASS_LIST, requestable_channels);
+      empathy_channel_classes_free (cd->channel_classes);
+      cd->channel_classes = empathy_channel_classes_new (requestable_channels);
     }
 }
 
@@ -973,8 +1042,7 @@ dispatcher_request_failed (EmpathyDispatcher *dispatcher,
   ConnectionData *conn_data;
 
   conn_data = g_hash_table_lookup (priv->connections, request_data->connection);
-  if (request_data->cb != NULL)
-    request_data->cb (NULL, error, request_data->user_data);
+  dispatcher_request_data_complete (request_data, NULL, error);
 
   conn_data->outstanding_requests =
       g_list_remove (conn_data->outstanding_requests, request_data);
@@ -1088,6 +1156,9 @@ dispatcher_request_channel_cb (TpConnection *connection,
   EmpathyDispatcher *dispatcher = EMPATHY_DISPATCHER (weak_object);
   DispatcherRequestData *request_data = (DispatcherRequestData *) user_data;
 
+  EMPATHY_TRACE_END (DEBUG_FLAG, "RequestChannel",
+    GPOINTER_TO_SIZE (request_data));
+
   dispatcher_connection_new_requested_channel (dispatcher,
     request_data, object_path, NULL, error);
 }
@@ -1095,6 +1166,9 @@ dispatcher_request_channel_cb (TpConnection *connection,
 static void
 dispatcher_request_channel (DispatcherRequestData *request_data)
 {
+  EMPATHY_TRACE_BEGIN (DEBUG_FLAG, "RequestChannel",
+    GPOINTER_TO_SIZE (request_data));
+
   tp_cli_connection_call_request_channel (request_data->connection, -1,
     request_data->channel_type,
     request_data->handle_type,
@@ -1103,25 +1177,66 @@ dispatcher_request_channel (DispatcherRequestData *request_data)
     request_data, NULL, G_OBJECT (request_data->dispatcher));
 }
 
-void
-empathy_dispatcher_chat_with_contact (EmpathyContact *contact,
-                                      EmpathyDispatcherRequestCb *callback,
-                                      gpointer user_data)
+/* Finds a request in flight which will get the channel of type
+ * @channel_type to @handle */
+static DispatcherRequestData *
+dispatcher_find_request (ConnectionData *cd,
+                         const gchar *channel_type,
+                         guint handle_type,
+                         guint handle)
 {
-  EmpathyDispatcher *dispatcher;
-  EmpathyDispatcherPriv *priv;
+  GList *l;
+
+  if (handle == 0)
+    return NULL;
+
+  for (l = cd->outstanding_requests; l != NULL; l = g_list_next (l))
+    {
+      DispatcherRequestData *d = l->data;
+
+      /* Requests with explicit properties always create a new channel */
+      if (d->request == NULL && d->handle == handle &&
+          d->handle_type == handle_type &&
+          !tp_strdiff (d->channel_type, channel_type))
+        return d;
+    }
+
+  return NULL;
+}
+
+static void
+dispatcher_chat_with_contact (EmpathyDispatcher *dispatcher,
+                              EmpathyContact *contact,
+                              EmpathyDispatcherRequestCb *callback,
+                              gpointer user_data)
+{
+  EmpathyDispatcherPriv *priv = GET_PRIV (dispatcher);
   TpConnection *connection;
   ConnectionData *connection_data;
   DispatcherRequestData *request_data;
 
-  g_return_if_fail (EMPATHY_IS_CONTACT (contact));
-
-  dispatcher = empathy_dispatcher_dup_singleton ();
-  priv = GET_PRIV (dispatcher);
-
   connection = empathy_contact_get_connection (contact);
   connection_data = g_hash_table_lookup (priv->connections, connection);
 
+  /* Don't ask the connection twice for the same channel */
+  request_data = dispatcher_find_request (connection_data,
+    TP_IFACE_CHANNEL_TYPE_TEXT, TP_HANDLE_TYPE_CONTACT,
+    empathy_contact_get_handle (contact));
+
+  if (request_data != NULL)
+    {
+      DispatcherRequestWaiter *waiter;
+
+      DEBUG ("Chat with %s already requested",
+        empathy_contact_get_id (contact));
+
+      waiter = g_slice_new0 (DispatcherRequestWaiter);
+      waiter->cb = callback;
+      waiter->user_data = user_data;
+      request_data->waiters = g_list_append (request_data->waiters, waiter);
+      return;
+    }
+
   /* The contact handle might not be known yet */
   request_data  = new_dispatcher_request_data (dispatcher, connection,
     TP_IFACE_CHANNEL_TYPE_TEXT, TP_HANDLE_TYPE_CONTACT,
@@ -1131,6 +1246,78 @@ empathy_dispatcher_chat_with_contact (EmpathyContact *contact,
     (connection_data->outstanding_requests, request_data);
 
   dispatcher_request_channel (request_data);
+}
+
+void
+empathy_dispatcher_chat_with_contact (EmpathyContact *contact,
+                                      EmpathyDispatcherRequestCb *callback,
+                                      gpointer user_data)
+{
+  EmpathyDispatcher *dispatcher;
+
+  g_return_if_fail (EMPATHY_IS_CONTACT (contact));
+
+  dispatcher = empathy_dispatcher_dup_singleton ();
+  dispatcher_chat_with_contact (dispatcher, contact, callback, user_data);
+  g_object_unref (dispatcher);
+}
+
+static void
+dispatcher_batch_request_cb (EmpathyDispatchOperation *operation,
+                             const GError *error,
+                             gpointer user_data)
+{
+  DispatcherBatch *batch = user_data;
+
+  if (error != NULL)
+    batch->failed++;
+
+  if (batch->cb != NULL)
+    batch->cb (operation, error, batch->user_data);
+
+  if (--batch->pending > 0)
+    return;
+
+  if (batch->done_cb != NULL)
+    batch->done_cb (batch->failed, batch->user_data);
+
+  g_slice_free (DispatcherBatch, batch);
+}
+
+/* Requests text channels to all @contacts at once. @callback is called for
+ * each of them, and @done_callback once they are all done. The requests are
+ * sent without waiting for each other, and a request of a channel which is
+ * already being requested shares that request. */
+void
+empathy_dispatcher_chat_with_contacts (GList *contacts,
+                                       EmpathyDispatcherRequestCb *callback,
+                                       EmpathyDispatcherBatchCb *done_callback,
+                                       gpointer user_data)
+{
+  EmpathyDispatcher *dispatcher;
+  DispatcherBatch *batch;
+  GList *l;
+
+  if (contacts == NULL)
+    {
+      if (done_callback != NULL)
+        done_callback (0, user_data);
+      return;
+    }
+
+  dispatcher = empathy_dispatcher_dup_singleton ();
+
+  batch = g_slice_new0 (DispatcherBatch);
+  batch->cb = callback;
+  batch->done_cb = done_callback;
+  batch->user_data = user_data;
+  batch->pending = g_list_length (contacts);
+
+  DEBUG ("Requesting %u chats", batch->pending);
+
+  for (l = contacts; l != NULL; l = g_list_next (l))
+    dispatcher_chat_with_contact (dispatcher, EMPATHY_CONTACT (l->data),
+      dispatcher_batch_request_cb, batch);
 
   g_object_unref (dispatcher);
 }
@@ -1207,8 +1394,7 @@ dispatcher_request_handles_cb (TpConnection *connection,
 
       cd = g_hash_table_lookup (priv->connections, request_data->connection);
 
-      if (request_data->cb)
-        request_data->cb (NULL, error, request_data->user_data);
+      dispatcher_request_data_complete (request_data, NULL, error);
 
       cd->outstanding_requests = g_list_remove (cd->outstanding_requests,
         request_data);
@@ -1270,6 +1456,9 @@ dispatcher_create_channel_cb (TpConnection *connect,
   EmpathyDispatcher *dispatcher = EMPATHY_DISPATCHER (weak_object);
   DispatcherRequestData *request_data = (DispatcherRequestData *) user_data;
 
+  EMPATHY_TRACE_END (DEBUG_FLAG, "CreateChannel",
+    GPOINTER_TO_SIZE (request_data));
+
   dispatcher_connection_new_requested_channel (dispatcher,
     request_data, object_path, properties, error);
 }
@@ -1312,6 +1501,9 @@ empathy_dispatcher_create_channel (EmpathyDispatcher *dispatcher,
   connection_data->outstanding_requests = g_list_prepend
     (connection_data->outstanding_requests, request_data);
 
+  EMPATHY_TRACE_BEGIN (DEBUG_FLAG, "CreateChannel",
+    GPOINTER_TO_SIZE (request_data));
+
   tp_cli_connection_interface_requests_call_create_channel (
     request_data->connection, -1,
     request_data->request, dispatcher_create_channel_cb, request_data, NULL,
@@ -1387,6 +1579,9 @@ empathy_dispatcher_send_file_to_contact (EmpathyContact *contact,
   connection_data->outstanding_requests = g_list_prepend
     (connection_data->outstanding_requests, request_data);
 
+  EMPATHY_TRACE_BEGIN (DEBUG_FLAG, "CreateChannel",
+    GPOINTER_TO_SIZE (request_data));
+
   tp_cli_connection_interface_requests_call_create_channel (
     request_data->connection, -1,
     request_data->request, dispatcher_create_channel_cb, request_data, NULL,
@@ -1403,51 +1598,16 @@ empathy_dispatcher_find_channel_class (EmpathyDispatcher *dispatcher,
 {
   EmpathyDispatcherPriv *priv = GET_PRIV (dispatcher);
   ConnectionData *cd;
-  int i;
-  GPtrArray *classes;
 
   g_return_val_if_fail (channel_type != NULL, NULL);
   g_return_val_if_fail (handle_type != 0, NULL);
 
   cd = g_hash_table_lookup (priv->connections, connection);
 
-  if (cd == NULL)
-    return NULL;
-
-  classes = cd->requestable_channels;
-  if (classes == NULL)
+  if (cd == NULL || cd->channel_classes == NULL)
     return NULL;
 
-  for (i = 0; i < classes->len; i++)
-    {
-      GValueArray *class;
-      GValue *fixed;
-      GValue *allowed;
-      GHashTable *fprops;
-      const gchar *c_type;
-      guint32 h_type;
-      gboolean valid;
-
-      class = g_ptr_array_index (classes, i);
-      fixed = g_value_array_get_nth (class, 0);
-
-      fprops = g_value_get_boxed (fixed);
-      c_type = tp_asv_get_string (fprops, TP_IFACE_CHANNEL ".ChannelType");
-
-      if (tp_strdiff (channel_type, c_type))
-        continue;
-
-      h_type = tp_asv_get_uint32 (fprops,
-        TP_IFACE_CHANNEL ".TargetHandleType", &valid);
-
-      if (!valid || handle_type != h_type)
-        continue;
-
-      allowed = g_value_array_get_nth (class, 1);
-
-      return g_value_get_boxed (allowed);
-    }
-
-  return NULL;
+  return empathy_channel_classes_lookup (cd->channel_classes, channel_type,
+    handle_type);
 }
 
@@ -59,6 +59,9 @@ typedef void (EmpathyDispatcherRequestCb) (
   EmpathyDispatchOperation *dispatch,  const GError *error,
   gpointer user_data);
 
+/* Will be called when all the requests of a batch are done */
+typedef void (EmpathyDispatcherBatchCb) (guint n_failed, gpointer user_data);
+
 GType empathy_dispatcher_get_type (void) G_GNUC_CONST;
 
 void empathy_dispatcher_create_channel (EmpathyDispatcher *dispatcher,
@@ -71,6 +74,9 @@ void empathy_dispatcher_chat_with_contact_id (TpConnection *connection,
   gpointer user_data);
 void  empathy_dispatcher_chat_with_contact (EmpathyContact *contact,
   EmpathyDispatcherRequestCb *callback, gpointer user_data);
+void empathy_dispatcher_chat_with_contacts (GList *contacts,
+  EmpathyDispatcherRequestCb *callback, EmpathyDispatcherBatchCb *done_callback,
+  gpointer user_data);
 
 /* Request a file channel to a specific contact */
 void empathy_dispatcher_send_file_to_contact (EmpathyContact *contact,
@@ -0,0 +1,1249 @@
+/*
+ * Copyright (C) 2007-2009 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Marco Barisione <marco@barisione.org>
+ *          Jonny Lamb <jonny.lamb@collabora.co.uk>
+ */
+
+#include <config.h>
+
+#if defined (HAVE_SPLICE) && defined (HAVE_SENDFILE) && \
+    defined (HAVE_SYS_SENDFILE_H)
+#define _GNU_SOURCE
+#define HAVE_ZERO_COPY 1
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZERO_COPY
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#endif
+
+#include "empathy-file-copy.h"
+#include "empathy-time.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_FT
+#include "empathy-debug.h"
+
+/* Copies the content of a GInputStream to a GOutputStream.
+ *
+ * When both ends are backed by file descriptors, the data is moved by the
+ * kernel with splice() or sendfile() in a thread, and never goes through
+ * userspace. Otherwise, or if the kernel refuses to splice these fds, it
+ * goes through a ring of buffers with async GIO calls on the main loop:
+ * reads go ahead of writes as long as there are free buffers, and buffers
+ * grow or shrink with the observed throughput.
+ *
+ * A checksum of the data can be computed as it is copied. Since the data
+ * then has to go through userspace anyway, that disables zero-copy.
+ *
+ * Copies can be rate limited individually and all together, with token
+ * buckets: data is only read when the buckets hold enough tokens, which
+ * come in at the limited rate. */
+
+#define DEFAULT_RING_DEPTH 8
+#define DEFAULT_MAX_BUFFER_SIZE (256 * 1024)
+#define MIN_BUFFER_SIZE 4096
+/* Buffers are sized to hold about that much data at the observed rate, in
+ * ms */
+#define BUFFER_TARGET_TIME 50
+#define ZERO_COPY_CHUNK_SIZE (256 * 1024)
+/* How often the zero-copy thread checks for cancellation if the
+ * cancellable can't wake it up, in ms */
+#define CANCEL_POLL_INTERVAL 100
+/* Minimum delay between two progress notifications, in ms */
+#define PROGRESS_INTERVAL 250
+/* Rate limited copies can send that many seconds worth of data at once */
+#define RATE_BURST 0.25
+/* Smallest read worth waking up for when rate limited, in bytes */
+#define RATE_MIN_CHUNK 4096
+
+typedef struct {
+  guint64 rate; /* bytes per second, 0 if not limited */
+  gdouble tokens; /* bytes that can be copied now */
+  gdouble last_refill;
+} RateBucket;
+
+/* Protects all the buckets, which are used by the zero-copy threads */
+G_LOCK_DEFINE_STATIC (rate_limit);
+static RateBucket global_bucket;
+
+typedef struct {
+  gchar *data;
+  gsize size; /* allocated size */
+  gsize count; /* how many bytes are used */
+  gboolean is_full; /* whether the buffer contains data */
+} CopyBuffer;
+
+struct _EmpathyFileCopy {
+  volatile gint ref_count;
+  GInputStream *in;
+  GOutputStream *out;
+  gint in_fd;
+  gint out_fd;
+  GCancellable *cancellable;
+
+  EmpathyFileCopyProgressFunc progress_func;
+  EmpathyFileCopyDoneFunc done_func;
+  gpointer user_data;
+
+  gboolean started;
+  gboolean finished;
+  gboolean zero_copy;
+  GTimer *timer;
+  GChecksum *checksum;
+  RateBucket bucket;
+
+  /* Protects the fields below, updated by the zero-copy thread */
+  GMutex *lock;
+  guint64 copied;
+  guint64 last_copied;
+  gdouble last_progress;
+  gboolean progress_pending;
+  GError *error;
+  EmpathyFileCopyStats stats;
+
+  /* GIO engine */
+  guint ring_depth;
+  gsize max_buffer_size;
+  CopyBuffer *ring;
+  guint n_full; /* number of buffers containing data */
+  guint occupancy_sum; /* n_full summed over each I/O completion */
+  guint occupancy_samples;
+  gboolean read_stalled; /* the ring is full, reads wait for writes */
+  gsize written; /* bytes of the current write buffer already written */
+  guint curr_read; /* index of the buffer used for reading */
+  guint curr_write; /* index of the buffer used for writing */
+  gsize requested; /* bytes asked to the current read */
+  guint throttle_id; /* waiting for the rate limit to allow a read */
+  gboolean is_reading; /* we are reading */
+  gboolean is_writing; /* we are writing */
+  guint n_closed; /* number of streams that have been closed */
+};
+
+static void
+copy_notify_progress (EmpathyFileCopy *copy)
+{
+  if (copy->progress_func != NULL)
+    copy->progress_func (copy, empathy_file_copy_get_copied (copy),
+        copy->user_data);
+}
+
+/* Updates the statistics if a progress notification is due. Must be
+ * called with the lock held, if any. */
+static gboolean
+copy_update_progress (EmpathyFileCopy *copy)
+{
+  gdouble now, elapsed;
+  gsize buffer_size;
+
+  now = g_timer_elapsed (copy->timer, NULL);
+  elapsed = now - copy->last_progress;
+  if (elapsed * 1000 < PROGRESS_INTERVAL)
+    return FALSE;
+
+  copy->stats.rate = (copy->copied - copy->last_copied) / elapsed;
+  copy->last_copied = copy->copied;
+  copy->last_progress = now;
+
+  if (copy->occupancy_samples > 0)
+    copy->stats.occupancy = copy->occupancy_sum * 100 /
+        (copy->occupancy_samples * copy->ring_depth);
+  copy->occupancy_sum = 0;
+  copy->occupancy_samples = 0;
+
+  if (copy->zero_copy)
+    return TRUE;
+
+  /* Scale the buffers to the throughput, the next reads use that size */
+  buffer_size = copy->stats.rate * BUFFER_TARGET_TIME / 1000;
+  if (buffer_size > MIN_BUFFER_SIZE)
+    buffer_size = (gsize) 1 << g_bit_storage (buffer_size - 1);
+  copy->stats.buffer_size = CLAMP (buffer_size, MIN_BUFFER_SIZE,
+      copy->max_buffer_size);
+
+  return TRUE;
+}
+
+/* Must be called with the rate_limit lock held */
+static gboolean
+rate_bucket_refill (RateBucket *bucket,
+                    gdouble now)
+{
+  if (bucket->rate == 0)
+    return FALSE;
+
+  if (bucket->last_refill > 0)
+    bucket->tokens = MIN (bucket->rate * RATE_BURST,
+        bucket->tokens + (now - bucket->last_refill) * bucket->rate);
+  bucket->last_refill = now;
+
+  return TRUE;
+}
+
+/* Takes up to @wanted bytes worth of tokens from the buckets of @copy.
+ * If there aren't enough for a read, returns 0 and sets @wait_ms to when
+ * there will be. */
+static gsize
+copy_take_tokens (EmpathyFileCopy *copy,
+                  gsize wanted,
+                  guint *wait_ms)
+{
+  RateBucket *buckets[] = { &copy->bucket, &global_bucket };
+  gdouble now, allowed = wanted, wait = 0;
+  guint i;
+
+  now = empathy_time_get_monotonic ();
+
+  G_LOCK (rate_limit);
+
+  for (i = 0; i < G_N_ELEMENTS (buckets); i++)
+    {
+      RateBucket *bucket = buckets[i];
+      gdouble min_chunk;
+
+      if (!rate_bucket_refill (bucket, now))
+        continue;
+
+      /* Very low limits can't even hold a minimum chunk */
+      min_chunk = MIN (MIN (RATE_MIN_CHUNK, wanted),
+          bucket->rate * RATE_BURST);
+      if (bucket->tokens < min_chunk)
+        wait = MAX (wait, (min_chunk - bucket->tokens) / bucket->rate);
+
+      allowed = MIN (allowed, bucket->tokens);
+    }
+
+  if (wait > 0)
+    {
+      allowed = 0;
+    }
+  else
+    {
+      for (i = 0; i < G_N_ELEMENTS (buckets); i++)
+        if (buckets[i]->rate > 0)
+          buckets[i]->tokens -= allowed;
+    }
+
+  G_UNLOCK (rate_limit);
+
+  if (wait_ms != NULL)
+    *wait_ms = MAX (1, wait * 1000);
+
+  return allowed;
+}
+
+/* Gives back the tokens of bytes that were asked for but not copied */
+static void
+copy_return_tokens (EmpathyFileCopy *copy,
+                    gsize unused)
+{
+  if (unused == 0)
+    return;
+
+  G_LOCK (rate_limit);
+  if (copy->bucket.rate > 0)
+    copy->bucket.tokens += unused;
+  if (global_bucket.rate > 0)
+    global_bucket.tokens += unused;
+  G_UNLOCK (rate_limit);
+}
+
+static void
+copy_finish (EmpathyFileCopy *copy,
+             const GError *error)
+{
+  if (copy->finished)
+    return;
+
+  copy->finished = TRUE;
+
+  if (error == NULL)
+    {
+      gdouble elapsed;
+
+      elapsed = g_timer_elapsed (copy->timer, NULL);
+      DEBUG ("Copied %" G_GUINT64_FORMAT " bytes in %.2f s (%.1f kB/s, "
+          "%u stalls)%s", copy->copied, elapsed,
+          elapsed > 0 ? copy->copied / elapsed / 1024 : 0,
+          copy->stats.stalls, copy->zero_copy ? ", zero-copy" : "");
+
+      copy_notify_progress (copy);
+    }
+
+  if (copy->done_func != NULL)
+    copy->done_func (copy, error, copy->user_data);
+}
+
+static void
+copy_io_error (EmpathyFileCopy *copy,
+               GError *error)
+{
+  g_cancellable_cancel (copy->cancellable);
+
+  if (error == NULL)
+    g_warning ("I/O error");
+  else if (error->domain == G_IO_ERROR && error->code == G_IO_ERROR_CANCELLED)
+    ; /* Ignore cancellations */
+  else
+    g_warning ("I/O error: %d: %s", error->code, error->message);
+
+  if (copy->in != NULL)
+    g_input_stream_close (copy->in, NULL, NULL);
+
+  if (copy->out != NULL)
+    g_output_stream_close (copy->out, NULL, NULL);
+
+  copy_finish (copy, error);
+}
+
+/* GIO engine. Each pending async operation holds a reference. */
+
+static void gio_schedule_next (EmpathyFileCopy *copy);
+
+static void
+gio_sample_occupancy (EmpathyFileCopy *copy)
+{
+  copy->occupancy_sum += copy->n_full;
+  copy->occupancy_samples++;
+}
+
+static void
+gio_close_done (GObject *source_object,
+                GAsyncResult *res,
+                gpointer user_data)
+{
+  EmpathyFileCopy *copy = user_data;
+
+  g_object_unref (source_object);
+
+  copy->n_closed++;
+  if (copy->n_closed == 2)
+    copy_finish (copy, NULL);
+
+  empathy_file_copy_unref (copy);
+}
+
+static void
+gio_write_done_cb (GObject *source_object,
+                   GAsyncResult *res,
+                   gpointer user_data)
+{
+  EmpathyFileCopy *copy = user_data;
+  CopyBuffer *buffer;
+  gssize count_write;
+  GError *error = NULL;
+
+  count_write = g_output_stream_write_finish (G_OUTPUT_STREAM (source_object),
+      res, &error);
+
+  if (copy->finished)
+    goto out;
+
+  if (count_write <= 0)
+    {
+      copy_io_error (copy, error);
+      goto out;
+    }
+
+  buffer = &copy->ring[copy->curr_write];
+  copy->copied += count_write;
+  copy->written += count_write;
+  copy->is_writing = FALSE;
+
+  /* The whole buffer may not have been written at once */
+  if (copy->written == buffer->count)
+    {
+      buffer->is_full = FALSE;
+      copy->n_full--;
+      copy->curr_write = (copy->curr_write + 1) % copy->ring_depth;
+      copy->written = 0;
+    }
+
+  gio_sample_occupancy (copy);
+  if (copy_update_progress (copy))
+    copy_notify_progress (copy);
+
+  gio_schedule_next (copy);
+
+out:
+  g_clear_error (&error);
+  empathy_file_copy_unref (copy);
+}
+
+static void
+gio_read_done_cb (GObject *source_object,
+                  GAsyncResult *res,
+                  gpointer user_data)
+{
+  EmpathyFileCopy *copy = user_data;
+  CopyBuffer *buffer;
+  gssize count_read;
+  GError *error = NULL;
+
+  count_read = g_input_stream_read_finish (G_INPUT_STREAM (source_object),
+      res, &error);
+
+  if (copy->finished)
+    goto out;
+
+  if (count_read == 0)
+    {
+      g_input_stream_close_async (copy->in, 0, copy->cancellable,
+          gio_close_done, empathy_file_copy_ref (copy));
+      copy->in = NULL;
+    }
+  else if (count_read < 0)
+    {
+      copy_io_error (copy, error);
+      goto out;
+    }
+
+  copy_return_tokens (copy, copy->requested - count_read);
+
+  buffer = &copy->ring[copy->curr_read];
+  if (copy->checksum != NULL && count_read > 0)
+    g_checksum_update (copy->checksum, (const guchar *) buffer->data,
+        count_read);
+
+  buffer->count = count_read;
+  buffer->is_full = TRUE;
+  copy->n_full++;
+  copy->curr_read = (copy->curr_read + 1) % copy->ring_depth;
+  copy->is_reading = FALSE;
+
+  gio_sample_occupancy (copy);
+  gio_schedule_next (copy);
+
+out:
+  g_clear_error (&error);
+  empathy_file_copy_unref (copy);
+}
+
+static gboolean
+gio_throttle_cb (gpointer user_data)
+{
+  EmpathyFileCopy *copy = user_data;
+
+  copy->throttle_id = 0;
+  if (!copy->finished)
+    gio_schedule_next (copy);
+
+  return FALSE;
+}
+
+static void
+gio_schedule_next (EmpathyFileCopy *copy)
+{
+  CopyBuffer *buffer;
+  guint wait_ms;
+
+  buffer = &copy->ring[copy->curr_read];
+  if (copy->in != NULL &&
+      !copy->is_reading &&
+      buffer->is_full)
+    {
+      /* All the buffers are waiting to be written */
+      if (!copy->read_stalled)
+        copy->stats.stalls++;
+      copy->read_stalled = TRUE;
+    }
+  else if (copy->in != NULL &&
+      !copy->is_reading &&
+      copy->throttle_id == 0)
+    {
+      /* We are not reading and the current buffer is empty, so
+       * start an async read, in a buffer of the current size. */
+      if (buffer->size != copy->stats.buffer_size)
+        {
+          g_free (buffer->data);
+          buffer->size = copy->stats.buffer_size;
+          buffer->data = g_malloc (buffer->size);
+        }
+
+      copy->read_stalled = FALSE;
+      copy->requested = copy_take_tokens (copy, buffer->size, &wait_ms);
+      if (copy->requested == 0)
+        {
+          copy->throttle_id = g_timeout_add_full (G_PRIORITY_DEFAULT,
+              wait_ms, gio_throttle_cb, empathy_file_copy_ref (copy),
+              (GDestroyNotify) empathy_file_copy_unref);
+        }
+      else
+        {
+          copy->is_reading = TRUE;
+          g_input_stream_read_async (copy->in,
+              buffer->data, copy->requested, 0, copy->cancellable,
+              gio_read_done_cb, empathy_file_copy_ref (copy));
+        }
+    }
+
+  buffer = &copy->ring[copy->curr_write];
+  if (!copy->is_writing &&
+      buffer->is_full)
+    {
+      if (buffer->count == 0)
+        {
+          /* The last read on the buffer read 0 bytes, this
+           * means that we got an EOF, so we can close
+           * the output channel. */
+          g_output_stream_close_async (copy->out, 0,
+              copy->cancellable,
+              gio_close_done, empathy_file_copy_ref (copy));
+          copy->out = NULL;
+        }
+      else
+        {
+          /* We are not writing and the current buffer contains
+           * data, so start an async write. */
+          copy->is_writing = TRUE;
+          g_output_stream_write_async (copy->out,
+              buffer->data + copy->written,
+              buffer->count - copy->written,
+              0, copy->cancellable,
+              gio_write_done_cb, empathy_file_copy_ref (copy));
+        }
+    }
+}
+
+static void
+gio_start (EmpathyFileCopy *copy)
+{
+  copy->ring = g_new0 (CopyBuffer, copy->ring_depth);
+
+  gio_schedule_next (copy);
+}
+
+/* Zero-copy engine. The thread holds a reference until its completion has
+ * been handled on the main loop. */
+
+#ifdef HAVE_ZERO_COPY
+
+static void
+zero_copy_set_error (GError **error,
+                     gint errsv)
+{
+  GIOErrorEnum code;
+
+  /* The kernel refuses to splice these fds, the GIO engine can copy them
+   * instead */
+  if (errsv == EINVAL || errsv == ENOSYS)
+    code = G_IO_ERROR_NOT_SUPPORTED;
+  else
+    code = g_io_error_from_errno (errsv);
+
+  g_set_error (error, G_IO_ERROR, code, "%s", g_strerror (errsv));
+}
+
+static gboolean
+zero_copy_progress_cb (gpointer user_data)
+{
+  EmpathyFileCopy *copy = user_data;
+
+  g_mutex_lock (copy->lock);
+  copy->progress_pending = FALSE;
+  g_mutex_unlock (copy->lock);
+
+  if (!copy->finished)
+    copy_notify_progress (copy);
+
+  return FALSE;
+}
+
+/* Makes @fd non-blocking, returns its previous flags or -1 */
+static gint
+zero_copy_set_nonblock (gint fd)
+{
+  gint flags;
+
+  flags = fcntl (fd, F_GETFL);
+  if (flags >= 0)
+    fcntl (fd, F_SETFL, flags | O_NONBLOCK);
+
+  return flags;
+}
+
+/* Waits for @events on @fd, or only for @timeout ms if @fd is -1. Returns
+ * FALSE if the copy has been cancelled meanwhile. */
+static gboolean
+zero_copy_wait (EmpathyFileCopy *copy,
+                gint fd,
+                gshort events,
+                gint timeout,
+                GError **error)
+{
+  struct pollfd fds[2];
+  nfds_t n_fds = 0;
+  gint cancel_fd;
+
+  if (fd >= 0)
+    {
+      fds[n_fds].fd = fd;
+      fds[n_fds].events = events;
+      fds[n_fds].revents = 0;
+      n_fds++;
+    }
+
+  cancel_fd = g_cancellable_get_fd (copy->cancellable);
+  if (cancel_fd >= 0)
+    {
+      fds[n_fds].fd = cancel_fd;
+      fds[n_fds].events = POLLIN;
+      fds[n_fds].revents = 0;
+      n_fds++;
+    }
+  else if (timeout < 0 || timeout > CANCEL_POLL_INTERVAL)
+    {
+      /* No way to be woken up, check for cancellation regularly */
+      timeout = CANCEL_POLL_INTERVAL;
+    }
+
+  if (poll (fds, n_fds, timeout) < 0 && errno != EINTR)
+    {
+      zero_copy_set_error (error, errno);
+      return FALSE;
+    }
+
+  return !g_cancellable_set_error_if_cancelled (copy->cancellable, error);
+}
+
+static void
+zero_copy_add_copied (EmpathyFileCopy *copy,
+                      gsize n)
+{
+  g_mutex_lock (copy->lock);
+  copy->copied += n;
+  if (!copy->progress_pending && copy_update_progress (copy))
+    {
+      copy->progress_pending = TRUE;
+      g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, zero_copy_progress_cb,
+          empathy_file_copy_ref (copy),
+          (GDestroyNotify) empathy_file_copy_unref);
+    }
+  g_mutex_unlock (copy->lock);
+}
+
+/* Moves the @len bytes held by the pipe to the output, @len is updated
+ * with what is left if that fails */
+static gboolean
+zero_copy_splice_all (EmpathyFileCopy *copy,
+                      gint pipe_fd,
+                      gsize *len,
+                      GError **error)
+{
+  while (*len > 0)
+    {
+      gssize n;
+
+      n = splice (pipe_fd, NULL, copy->out_fd, NULL, *len,
+          SPLICE_F_MOVE | SPLICE_F_MORE | SPLICE_F_NONBLOCK);
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n < 0 && errno == EAGAIN)
+        {
+          if (!zero_copy_wait (copy, copy->out_fd, POLLOUT, -1, error))
+            return FALSE;
+          continue;
+        }
+
+      if (n <= 0)
+        {
+          zero_copy_set_error (error, n < 0 ? errno : EPIPE);
+          return FALSE;
+        }
+
+      *len -= n;
+      zero_copy_add_copied (copy, n);
+    }
+
+  return TRUE;
+}
+
+/* Writes the @len bytes left in the pipe to the output through userspace,
+ * when the kernel refuses to splice them */
+static gboolean
+zero_copy_drain_pipe (EmpathyFileCopy *copy,
+                      gint pipe_fd,
+                      gsize len,
+                      GError **error)
+{
+  gchar buffer[MIN_BUFFER_SIZE];
+
+  while (len > 0)
+    {
+      gssize n_read;
+      gsize done = 0;
+
+      n_read = read (pipe_fd, buffer, MIN (len, sizeof (buffer)));
+      if (n_read < 0 && errno == EINTR)
+        continue;
+
+      if (n_read < 0)
+        {
+          gint errsv = errno;
+
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+              "%s", g_strerror (errsv));
+          return FALSE;
+        }
+
+      /* The pipe ran dry before all it was said to hold was read. This is
+       * G_IO_ERROR_BROKEN_PIPE where GLib is recent enough to know it. */
+      if (n_read == 0)
+        {
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (EPIPE),
+              "%s", g_strerror (EPIPE));
+          return FALSE;
+        }
+
+      while (done < (gsize) n_read)
+        {
+          gssize n_written;
+
+          n_written = write (copy->out_fd, buffer + done, n_read - done);
+          if (n_written < 0 && errno == EINTR)
+            continue;
+
+          if (n_written < 0 && errno == EAGAIN)
+            {
+              if (!zero_copy_wait (copy, copy->out_fd, POLLOUT, -1, error))
+                return FALSE;
+              continue;
+            }
+
+          if (n_written < 0)
+            {
+              g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                  "%s", g_strerror (errno));
+              return FALSE;
+            }
+
+          done += n_written;
+          zero_copy_add_copied (copy, n_written);
+        }
+
+      len -= n_read;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+zero_copy_done_cb (gpointer user_data)
+{
+  EmpathyFileCopy *copy = user_data;
+  GError *error;
+
+  g_mutex_lock (copy->lock);
+  error = copy->error;
+  copy->error = NULL;
+  g_mutex_unlock (copy->lock);
+
+  /* The thread only gives up that way once everything it read has been
+   * written, so GIO can go on from the current positions of the fds */
+  if (error != NULL &&
+      g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+    {
+      DEBUG ("Can't splice, falling back to GIO: %s", error->message);
+      copy->zero_copy = FALSE;
+      copy->stats.buffer_size = MIN_BUFFER_SIZE;
+      gio_start (copy);
+    }
+  else if (error != NULL)
+    {
+      copy_io_error (copy, error);
+    }
+  else
+    {
+      g_input_stream_close (copy->in, NULL, NULL);
+      g_output_stream_close (copy->out, NULL, NULL);
+      copy_finish (copy, NULL);
+    }
+
+  g_clear_error (&error);
+
+  return FALSE;
+}
+
+static gpointer
+zero_copy_thread (gpointer user_data)
+{
+  EmpathyFileCopy *copy = user_data;
+  gint pipe_fds[2] = { -1, -1 };
+  gint in_flags, out_flags;
+  gsize in_pipe = 0;
+  gboolean use_sendfile;
+  struct stat st;
+  GError *error = NULL;
+
+  /* sendfile() needs a mmapable source, otherwise data is spliced through
+   * a pipe */
+  use_sendfile = fstat (copy->in_fd, &st) == 0 && S_ISREG (st.st_mode);
+
+  /* Blocking calls couldn't be interrupted when the copy is cancelled, so
+   * the fds are polled along with the cancellable */
+  in_flags = zero_copy_set_nonblock (copy->in_fd);
+  out_flags = zero_copy_set_nonblock (copy->out_fd);
+
+  if (!use_sendfile && pipe (pipe_fds) < 0)
+    {
+      zero_copy_set_error (&error, errno);
+      goto out;
+    }
+
+  while (!g_cancellable_set_error_if_cancelled (copy->cancellable, &error))
+    {
+      gssize n;
+      gsize chunk;
+      guint wait_ms;
+
+      chunk = copy_take_tokens (copy, ZERO_COPY_CHUNK_SIZE, &wait_ms);
+      if (chunk == 0)
+        {
+          zero_copy_wait (copy, -1, 0, wait_ms, NULL);
+          continue;
+        }
+
+      if (use_sendfile)
+        n = sendfile (copy->out_fd, copy->in_fd, NULL, chunk);
+      else
+        n = splice (copy->in_fd, NULL, pipe_fds[1], NULL, chunk,
+            SPLICE_F_MOVE | SPLICE_F_MORE | SPLICE_F_NONBLOCK);
+
+      copy_return_tokens (copy, chunk - MAX (n, 0));
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n < 0 && errno == EAGAIN)
+        {
+          /* sendfile() waits for the output, splice() for the input */
+          if (use_sendfile &&
+              !zero_copy_wait (copy, copy->out_fd, POLLOUT, -1, &error))
+            break;
+          if (!use_sendfile &&
+              !zero_copy_wait (copy, copy->in_fd, POLLIN, -1, &error))
+            break;
+          continue;
+        }
+
+      if (n < 0)
+        {
+          zero_copy_set_error (&error, errno);
+          break;
+        }
+
+      /* EOF */
+      if (n == 0)
+        break;
+
+      if (use_sendfile)
+        {
+          zero_copy_add_copied (copy, n);
+        }
+      else
+        {
+          in_pipe = n;
+          if (!zero_copy_splice_all (copy, pipe_fds[0], &in_pipe, &error))
+            break;
+        }
+    }
+
+  /* Data read from the input but stuck in the pipe would be lost if GIO
+   * took over */
+  if (in_pipe > 0 &&
+      g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+    {
+      GError *drain_error = NULL;
+
+      if (!zero_copy_drain_pipe (copy, pipe_fds[0], in_pipe, &drain_error))
+        {
+          g_error_free (error);
+          error = drain_error;
+        }
+    }
+
+out:
+  if (pipe_fds[0] >= 0)
+    close (pipe_fds[0]);
+  if (pipe_fds[1] >= 0)
+    close (pipe_fds[1]);
+
+  if (in_flags >= 0)
+    fcntl (copy->in_fd, F_SETFL, in_flags);
+  if (out_flags >= 0)
+    fcntl (copy->out_fd, F_SETFL, out_flags);
+
+  g_mutex_lock (copy->lock);
+  copy->error = error;
+  g_mutex_unlock (copy->lock);
+
+  g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, zero_copy_done_cb, copy,
+      (GDestroyNotify) empathy_file_copy_unref);
+
+  return NULL;
+}
+
+static gboolean
+zero_copy_start (EmpathyFileCopy *copy)
+{
+  GError *error = NULL;
+
+  if (!g_thread_supported ())
+    return FALSE;
+
+  copy->lock = g_mutex_new ();
+
+  if (!g_thread_create (zero_copy_thread, empathy_file_copy_ref (copy),
+          FALSE, &error))
+    {
+      DEBUG ("Couldn't create the copy thread: %s", error->message);
+      g_error_free (error);
+      empathy_file_copy_unref (copy);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+#endif /* HAVE_ZERO_COPY */
+
+/**
+ * empathy_file_copy_new:
+ * @in: the stream to read from
+ * @out: the stream to write to
+ * @cancellable: a #GCancellable, or %NULL
+ *
+ * Prepares the copy of @in to @out. Both streams are closed once the copy
+ * is done, or has failed.
+ *
+ * Return value: a new #EmpathyFileCopy
+ */
+EmpathyFileCopy *
+empathy_file_copy_new (GInputStream *in,
+                       GOutputStream *out,
+                       GCancellable *cancellable)
+{
+  EmpathyFileCopy *copy;
+
+  g_return_val_if_fail (G_IS_INPUT_STREAM (in), NULL);
+  g_return_val_if_fail (G_IS_OUTPUT_STREAM (out), NULL);
+
+  copy = g_slice_new0 (EmpathyFileCopy);
+  copy->ref_count = 1;
+  copy->in = g_object_ref (in);
+  copy->out = g_object_ref (out);
+  copy->in_fd = -1;
+  copy->out_fd = -1;
+  copy->ring_depth = DEFAULT_RING_DEPTH;
+  copy->max_buffer_size = DEFAULT_MAX_BUFFER_SIZE;
+  copy->stats.buffer_size = MIN_BUFFER_SIZE;
+
+  if (cancellable != NULL)
+    copy->cancellable = g_object_ref (cancellable);
+  else
+    copy->cancellable = g_cancellable_new ();
+
+  return copy;
+}
+
+EmpathyFileCopy *
+empathy_file_copy_ref (EmpathyFileCopy *copy)
+{
+  g_return_val_if_fail (copy != NULL, NULL);
+
+  g_atomic_int_inc (&copy->ref_count);
+
+  return copy;
+}
+
+void
+empathy_file_copy_unref (EmpathyFileCopy *copy)
+{
+  guint i;
+
+  g_return_if_fail (copy != NULL);
+
+  if (!g_atomic_int_dec_and_test (&copy->ref_count))
+    return;
+
+  if (copy->in != NULL)
+    g_object_unref (copy->in);
+
+  if (copy->out != NULL)
+    g_object_unref (copy->out);
+
+  if (copy->ring != NULL)
+    {
+      for (i = 0; i < copy->ring_depth; i++)
+        g_free (copy->ring[i].data);
+      g_free (copy->ring);
+    }
+
+  if (copy->timer != NULL)
+    g_timer_destroy (copy->timer);
+
+  if (copy->checksum != NULL)
+    g_checksum_free (copy->checksum);
+
+  if (copy->lock != NULL)
+    g_mutex_free (copy->lock);
+
+  if (copy->error != NULL)
+    g_error_free (copy->error);
+
+  g_object_unref (copy->cancellable);
+  g_slice_free (EmpathyFileCopy, copy);
+}
+
+/**
+ * empathy_file_copy_set_fds:
+ * @copy: an #EmpathyFileCopy
+ * @in_fd: the file descriptor behind the input stream
+ * @out_fd: the file descriptor behind the output stream
+ *
+ * Allows @copy to move the data between the file descriptors without
+ * copying it to userspace, where supported. The descriptors still belong
+ * to the streams.
+ */
+void
+empathy_file_copy_set_fds (EmpathyFileCopy *copy,
+                           gint in_fd,
+                           gint out_fd)
+{
+  g_return_if_fail (copy != NULL);
+  g_return_if_fail (!copy->started);
+
+  copy->in_fd = in_fd;
+  copy->out_fd = out_fd;
+}
+
+/**
+ * empathy_file_copy_set_ring:
+ * @copy: an #EmpathyFileCopy
+ * @depth: the number of buffers, at least 2
+ * @max_buffer_size: the size buffers can grow to with the throughput
+ *
+ * Configures the buffers used when the data can't be moved without
+ * copying. Reads go up to @depth buffers ahead of writes.
+ */
+void
+empathy_file_copy_set_ring (EmpathyFileCopy *copy,
+                            guint depth,
+                            gsize max_buffer_size)
+{
+  g_return_if_fail (copy != NULL);
+  g_return_if_fail (!copy->started);
+  g_return_if_fail (depth >= 2);
+  g_return_if_fail (max_buffer_size >= MIN_BUFFER_SIZE);
+
+  copy->ring_depth = depth;
+  copy->max_buffer_size = max_buffer_size;
+}
+
+/**
+ * empathy_file_copy_set_checksum:
+ * @copy: an #EmpathyFileCopy
+ * @checksum_type: the hashing algorithm to use
+ *
+ * Makes @copy compute a checksum of the data while copying it, see
+ * empathy_file_copy_get_checksum(). The data is then always copied through
+ * userspace buffers.
+ */
+void
+empathy_file_copy_set_checksum (EmpathyFileCopy *copy,
+                                GChecksumType checksum_type)
+{
+  g_return_if_fail (copy != NULL);
+  g_return_if_fail (!copy->started);
+
+  if (copy->checksum != NULL)
+    g_checksum_free (copy->checksum);
+
+  copy->checksum = g_checksum_new (checksum_type);
+}
+
+/**
+ * empathy_file_copy_get_checksum:
+ * @copy: an #EmpathyFileCopy
+ *
+ * Gets the checksum of the copied data, as an hexadecimal string. The data
+ * can't be updated anymore once this has been called, so it should only be
+ * called once the copy is done.
+ *
+ * Return value: the checksum of the copied data, or %NULL if
+ * empathy_file_copy_set_checksum() wasn't called
+ */
+const gchar *
+empathy_file_copy_get_checksum (EmpathyFileCopy *copy)
+{
+  g_return_val_if_fail (copy != NULL, NULL);
+
+  if (copy->checksum == NULL)
+    return NULL;
+
+  return g_checksum_get_string (copy->checksum);
+}
+
+/**
+ * empathy_file_copy_set_rate_limit:
+ * @copy: an #EmpathyFileCopy
+ * @rate: the maximum throughput of @copy in bytes per second, or 0
+ *
+ * Limits how fast @copy moves data. This can be changed while the copy is
+ * running.
+ */
+void
+empathy_file_copy_set_rate_limit (EmpathyFileCopy *copy,
+                                  guint64 rate)
+{
+  g_return_if_fail (copy != NULL);
+
+  G_LOCK (rate_limit);
+  copy->bucket.rate = rate;
+  copy->bucket.tokens = MIN (copy->bucket.tokens, rate * RATE_BURST);
+  G_UNLOCK (rate_limit);
+}
+
+/**
+ * empathy_file_copy_set_global_rate_limit:
+ * @rate: the maximum throughput of all copies in bytes per second, or 0
+ *
+ * Limits how fast all the copies together move data.
+ */
+void
+empathy_file_copy_set_global_rate_limit (guint64 rate)
+{
+  G_LOCK (rate_limit);
+  global_bucket.rate = rate;
+  global_bucket.tokens = MIN (global_bucket.tokens, rate * RATE_BURST);
+  G_UNLOCK (rate_limit);
+}
+
+/**
+ * empathy_file_copy_set_callbacks:
+ * @copy: an #EmpathyFileCopy
+ * @progress_func: called from time to time with the number of bytes copied
+ * @done_func: called once the copy is done or has failed
+ * @user_data: data passed to the callbacks
+ *
+ * Sets the functions called on the main loop while @copy runs. Progress is
+ * reported at most a few times per second.
+ */
+void
+empathy_file_copy_set_callbacks (EmpathyFileCopy *copy,
+                                 EmpathyFileCopyProgressFunc progress_func,
+                                 EmpathyFileCopyDoneFunc done_func,
+                                 gpointer user_data)
+{
+  g_return_if_fail (copy != NULL);
+
+  copy->progress_func = progress_func;
+  copy->done_func = done_func;
+  copy->user_data = user_data;
+}
+
+/**
+ * empathy_file_copy_start:
+ * @copy: an #EmpathyFileCopy
+ *
+ * Starts copying. @copy keeps a reference on itself until it is done.
+ */
+void
+empathy_file_copy_start (EmpathyFileCopy *copy)
+{
+  g_return_if_fail (copy != NULL);
+  g_return_if_fail (!copy->started);
+
+  copy->started = TRUE;
+  copy->timer = g_timer_new ();
+
+#ifdef HAVE_ZERO_COPY
+  if (copy->in_fd >= 0 && copy->out_fd >= 0 && copy->checksum == NULL)
+    {
+      copy->zero_copy = TRUE;
+      copy->stats.buffer_size = ZERO_COPY_CHUNK_SIZE;
+
+      if (zero_copy_start (copy))
+        {
+          DEBUG ("Copying from fd %d to fd %d without buffering",
+              copy->in_fd, copy->out_fd);
+          return;
+        }
+
+      copy->zero_copy = FALSE;
+      copy->stats.buffer_size = MIN_BUFFER_SIZE;
+    }
+#endif
+
+  gio_start (copy);
+}
+
+guint64
+empathy_file_copy_get_copied (EmpathyFileCopy *copy)
+{
+  guint64 copied;
+
+  g_return_val_if_fail (copy != NULL, 0);
+
+  if (copy->lock != NULL)
+    g_mutex_lock (copy->lock);
+
+  copied = copy->copied;
+
+  if (copy->lock != NULL)
+    g_mutex_unlock (copy->lock);
+
+  return copied;
+}
+
+/**
+ * empathy_file_copy_get_stats:
+ * @copy: an #EmpathyFileCopy
+ * @stats: return location for the statistics
+ *
+ * Gets the statistics of @copy, as of the last progress notification.
+ */
+void
+empathy_file_copy_get_stats (EmpathyFileCopy *copy,
+                             EmpathyFileCopyStats *stats)
+{
+  g_return_if_fail (copy != NULL);
+  g_return_if_fail (stats != NULL);
+
+  if (copy->lock != NULL)
+    g_mutex_lock (copy->lock);
+
+  *stats = copy->stats;
+
+  if (copy->lock != NULL)
+    g_mutex_unlock (copy->lock);
+}
+
+gboolean
+empathy_file_copy_is_zero_copy (EmpathyFileCopy *copy)
+{
+  g_return_val_if_fail (copy != NULL, FALSE);
+
+  return copy->zero_copy;
+}
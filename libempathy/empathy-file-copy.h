@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __EMPATHY_FILE_COPY_H__
+#define __EMPATHY_FILE_COPY_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EmpathyFileCopy EmpathyFileCopy;
+
+typedef struct {
+  gdouble rate; /* bytes per second */
+  guint stalls; /* times reads waited for writes to free a buffer */
+  guint occupancy; /* percentage of the buffers holding data */
+  gsize buffer_size; /* current size of the buffers */
+} EmpathyFileCopyStats;
+
+typedef void (*EmpathyFileCopyProgressFunc) (EmpathyFileCopy *copy,
+    guint64 copied, gpointer user_data);
+typedef void (*EmpathyFileCopyDoneFunc) (EmpathyFileCopy *copy,
+    const GError *error, gpointer user_data);
+
+EmpathyFileCopy *empathy_file_copy_new (GInputStream *in,
+    GOutputStream *out, GCancellable *cancellable);
+EmpathyFileCopy *empathy_file_copy_ref (EmpathyFileCopy *copy);
+void empathy_file_copy_unref (EmpathyFileCopy *copy);
+void empathy_file_copy_set_fds (EmpathyFileCopy *copy, gint in_fd,
+    gint out_fd);
+void empathy_file_copy_set_ring (EmpathyFileCopy *copy, guint depth,
+    gsize max_buffer_size);
+void empathy_file_copy_set_checksum (EmpathyFileCopy *copy,
+    GChecksumType checksum_type);
+const gchar *empathy_file_copy_get_checksum (EmpathyFileCopy *copy);
+void empathy_file_copy_set_rate_limit (EmpathyFileCopy *copy, guint64 rate);
+void empathy_file_copy_set_global_rate_limit (guint64 rate);
+void empathy_file_copy_set_callbacks (EmpathyFileCopy *copy,
+    EmpathyFileCopyProgressFunc progress_func,
+    EmpathyFileCopyDoneFunc done_func, gpointer user_data);
+void empathy_file_copy_start (EmpathyFileCopy *copy);
+guint64 empathy_file_copy_get_copied (EmpathyFileCopy *copy);
+void empathy_file_copy_get_stats (EmpathyFileCopy *copy,
+    EmpathyFileCopyStats *stats);
+gboolean empathy_file_copy_is_zero_copy (EmpathyFileCopy *copy);
+
+G_END_DECLS
+
+#endif /* __EMPATHY_FILE_COPY_H__ */
@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include <telepathy-glib/util.h>
+
+#include "empathy-file-resume.h"
+#include "empathy-utils.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_FT
+#include "empathy-debug.h"
+
+/**
+ * SECTION:empathy-file-resume
+ * @short_description: Resume state of interrupted incoming transfers
+ * @include: libempathy/empathy-file-resume.h
+ *
+ * When an incoming transfer is interrupted, what was received so far is
+ * described in a hidden file next to the partial file: the size and hash
+ * of the offered file, how many bytes were received, and a hash of the
+ * last bytes received. A new offer of the same file can then be accepted
+ * from that offset, if the partial file still ends with the same data.
+ */
+
+/* Bytes hashed at the end of the received data */
+#define TAIL_WINDOW (64 * 1024)
+#define GROUP "Resume"
+
+static gchar *
+file_resume_get_state_path (GFile *file)
+{
+  gchar *path;
+  gchar *dirname;
+  gchar *basename;
+  gchar *state_basename;
+  gchar *state_path;
+
+  path = g_file_get_path (file);
+  if (path == NULL)
+    return NULL;
+
+  dirname = g_path_get_dirname (path);
+  basename = g_path_get_basename (path);
+  state_basename = g_strdup_printf (".%s.empathy-resume", basename);
+  state_path = g_build_filename (dirname, state_basename, NULL);
+
+  g_free (path);
+  g_free (dirname);
+  g_free (basename);
+  g_free (state_basename);
+
+  return state_path;
+}
+
+/* Hashes the TAIL_WINDOW bytes before @offset in the file at @path */
+static gchar *
+file_resume_hash_tail (const gchar *path,
+                       guint64 offset,
+                       GError **error)
+{
+  GChecksum *checksum;
+  guchar *buffer;
+  guint64 start;
+  gsize len, done = 0;
+  gchar *hash = NULL;
+  gint fd;
+
+  fd = g_open (path, O_RDONLY, 0);
+  if (fd < 0)
+    goto error;
+
+  start = offset > TAIL_WINDOW ? offset - TAIL_WINDOW : 0;
+  len = offset - start;
+  if (lseek (fd, start, SEEK_SET) < 0)
+    goto error;
+
+  buffer = g_malloc (len);
+  while (done < len)
+    {
+      gssize n;
+
+      n = read (fd, buffer + done, len - done);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break;
+      done += n;
+    }
+
+  if (done == len)
+    {
+      checksum = g_checksum_new (G_CHECKSUM_SHA1);
+      g_checksum_update (checksum, buffer, len);
+      hash = g_strdup (g_checksum_get_string (checksum));
+      g_checksum_free (checksum);
+    }
+  else
+    {
+      /* The file is shorter than it should be */
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+          "%s is truncated", path);
+    }
+
+  g_free (buffer);
+  close (fd);
+
+  return hash;
+
+error:
+  {
+    gint errsv = errno;
+
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+        "%s", g_strerror (errsv));
+    if (fd >= 0)
+      close (fd);
+
+    return NULL;
+  }
+}
+
+/**
+ * empathy_file_resume_save:
+ * @file: the partial file of an interrupted incoming transfer
+ * @size: the size of the offered file
+ * @content_hash: the hash of the offered file, or %NULL
+ * @error: a #GError set if the state can't be saved
+ *
+ * Records that @file holds the beginning of a file of @size bytes whose hash
+ * is @content_hash, so that a later offer of the same file can be resumed.
+ * Only local files can be resumed.
+ *
+ * Return value: %TRUE if the state was saved
+ */
+gboolean
+empathy_file_resume_save (GFile *file,
+                          guint64 size,
+                          const gchar *content_hash,
+                          GError **error)
+{
+  gchar *path;
+  gchar *state_path;
+  gchar *tail_hash = NULL;
+  gchar *str;
+  gchar *data;
+  gsize len;
+  GKeyFile *key_file;
+  struct stat st;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+
+  path = g_file_get_path (file);
+  state_path = file_resume_get_state_path (file);
+  if (path == NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+          "Only local files can be resumed");
+      goto out;
+    }
+
+  if (g_stat (path, &st) < 0)
+    {
+      gint errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+          "%s", g_strerror (errsv));
+      goto out;
+    }
+
+  /* Nothing worth resuming */
+  if (st.st_size == 0 || (guint64) st.st_size >= size)
+    {
+      empathy_file_resume_clear (file);
+      ret = TRUE;
+      goto out;
+    }
+
+  tail_hash = file_resume_hash_tail (path, st.st_size, error);
+  if (tail_hash == NULL)
+    goto out;
+
+  key_file = g_key_file_new ();
+  str = g_strdup_printf ("%" G_GUINT64_FORMAT, size);
+  g_key_file_set_string (key_file, GROUP, "Size", str);
+  g_free (str);
+  str = g_strdup_printf ("%" G_GUINT64_FORMAT, (guint64) st.st_size);
+  g_key_file_set_string (key_file, GROUP, "Offset", str);
+  g_free (str);
+  g_key_file_set_string (key_file, GROUP, "TailHash", tail_hash);
+  if (content_hash != NULL)
+    g_key_file_set_string (key_file, GROUP, "ContentHash", content_hash);
+
+  data = g_key_file_to_data (key_file, &len, NULL);
+  ret = g_file_set_contents (state_path, data, len, error);
+  g_free (data);
+  g_key_file_free (key_file);
+
+  DEBUG ("Saved resume state of %s at offset %" G_GUINT64_FORMAT, path,
+      (guint64) st.st_size);
+
+out:
+  g_free (tail_hash);
+  g_free (state_path);
+  g_free (path);
+
+  return ret;
+}
+
+static guint64
+key_file_get_uint64 (GKeyFile *key_file,
+                     const gchar *key)
+{
+  gchar *str;
+  guint64 value;
+
+  str = g_key_file_get_string (key_file, GROUP, key, NULL);
+  if (str == NULL)
+    return 0;
+
+  value = g_ascii_strtoull (str, NULL, 10);
+  g_free (str);
+
+  return value;
+}
+
+/**
+ * empathy_file_resume_get_offset:
+ * @file: the destination of an incoming transfer
+ * @size: the size of the offered file
+ * @content_hash: the hash of the offered file, or %NULL
+ *
+ * Checks whether @file is the partial file of an interrupted transfer of the
+ * same file, and whether the data received then is still there. Data past
+ * the returned offset is not accounted for, and should be discarded.
+ *
+ * Return value: the offset from which the transfer can be resumed, or 0
+ */
+guint64
+empathy_file_resume_get_offset (GFile *file,
+                                guint64 size,
+                                const gchar *content_hash)
+{
+  gchar *path;
+  gchar *state_path;
+  gchar *saved_hash = NULL;
+  gchar *tail_hash = NULL;
+  gchar *saved_tail_hash = NULL;
+  GKeyFile *key_file;
+  guint64 offset = 0;
+  struct stat st;
+
+  g_return_val_if_fail (G_IS_FILE (file), 0);
+
+  path = g_file_get_path (file);
+  state_path = file_resume_get_state_path (file);
+  if (path == NULL)
+    return 0;
+
+  key_file = g_key_file_new ();
+  if (!g_key_file_load_from_file (key_file, state_path, 0, NULL))
+    goto out;
+
+  /* Is this the same file? */
+  saved_hash = g_key_file_get_string (key_file, GROUP, "ContentHash", NULL);
+  if (key_file_get_uint64 (key_file, "Size") != size ||
+      (!EMP_STR_EMPTY (content_hash) && !EMP_STR_EMPTY (saved_hash) &&
+       g_ascii_strcasecmp (content_hash, saved_hash)))
+    {
+      DEBUG ("%s is the partial file of another transfer", path);
+      goto out;
+    }
+
+  /* Is the data still there? */
+  offset = key_file_get_uint64 (key_file, "Offset");
+  saved_tail_hash = g_key_file_get_string (key_file, GROUP, "TailHash",
+      NULL);
+  if (offset == 0 || offset >= size || g_stat (path, &st) < 0 ||
+      (guint64) st.st_size < offset)
+    {
+      offset = 0;
+      goto out;
+    }
+
+  tail_hash = file_resume_hash_tail (path, offset, NULL);
+  if (tp_strdiff (tail_hash, saved_tail_hash))
+    {
+      DEBUG ("%s was modified since the transfer was interrupted", path);
+      offset = 0;
+      goto out;
+    }
+
+  DEBUG ("%s can be resumed at offset %" G_GUINT64_FORMAT, path, offset);
+
+out:
+  g_key_file_free (key_file);
+  g_free (saved_hash);
+  g_free (saved_tail_hash);
+  g_free (tail_hash);
+  g_free (state_path);
+  g_free (path);
+
+  return offset;
+}
+
+/**
+ * empathy_file_resume_clear:
+ * @file: the destination of an incoming transfer
+ *
+ * Forgets the resume state of @file, if any.
+ */
+void
+empathy_file_resume_clear (GFile *file)
+{
+  gchar *state_path;
+
+  g_return_if_fail (G_IS_FILE (file));
+
+  state_path = file_resume_get_state_path (file);
+  if (state_path != NULL)
+    g_unlink (state_path);
+
+  g_free (state_path);
+}
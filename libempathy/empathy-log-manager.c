@@ -33,6 +33,7 @@
 #include "empathy-log-manager.h"
 #include "empathy-log-store-empathy.h"
 #include "empathy-log-store.h"
+#include "empathy-stats.h"
 #include "empathy-tp-chat.h"
 #include "empathy-utils.h"
 
@@ -126,6 +127,7 @@ empathy_log_manager_add_message (EmpathyLogManager *manager,
   GList *l;
   gboolean out = FALSE;
   gboolean found = FALSE;
+  gint64 start;
 
   /* TODO: When multiple log stores appear with add_message implementations
    * make this customisable. */
@@ -136,6 +138,7 @@ empathy_log_manager_add_message (EmpathyLogManager *manager,
   g_return_val_if_fail (EMPATHY_IS_MESSAGE (message), FALSE);
 
   priv = GET_PRIV (manager);
+  start = empathy_stats_get_time ();
 
   for (l = priv->stores; l; l = g_list_next (l))
     {
@@ -152,6 +155,9 @@ empathy_log_manager_add_message (EmpathyLogManager *manager,
   if (!found)
     DEBUG ("Failed to find chosen log store to write to.");
 
+  EMPATHY_STAT_RECORD ("log-manager.add-message-time",
+      empathy_stats_get_time () - start);
+
   return out;
 }
 
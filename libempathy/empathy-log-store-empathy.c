@@ -33,6 +33,8 @@
 #include "empathy-log-store-empathy.h"
 #include "empathy-log-manager.h"
 #include "empathy-contact.h"
+#include "empathy-message-record.h"
+#include "empathy-stats.h"
 #include "empathy-time.h"
 #include "empathy-utils.h"
 
@@ -92,11 +94,17 @@ empathy_log_store_empathy_init (EmpathyLogStoreEmpathy *self)
 {
   EmpathyLogStoreEmpathyPriv *priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
       EMPATHY_TYPE_LOG_STORE_EMPATHY, EmpathyLogStoreEmpathyPriv);
+  const gchar *basedir;
 
   self->priv = priv;
 
-  priv->basedir = g_build_path (G_DIR_SEPARATOR_S, g_get_home_dir (),
-      ".gnome2", PACKAGE_NAME, "logs", NULL);
+  /* Benchmarks and tests point this at logs of their own */
+  basedir = g_getenv ("EMPATHY_LOG_DIR");
+  if (!EMP_STR_EMPTY (basedir))
+    priv->basedir = g_strdup (basedir);
+  else
+    priv->basedir = g_build_path (G_DIR_SEPARATOR_S, g_get_home_dir (),
+        ".gnome2", PACKAGE_NAME, "logs", NULL);
 
   priv->name = g_strdup ("Empathy");
 }
@@ -193,6 +201,7 @@ log_store_empathy_add_message (EmpathyLogStore *self,
   gchar *contact_name;
   gchar *contact_id;
   TpChannelTextMessageType msg_type;
+  gint written;
 
   g_return_val_if_fail (EMPATHY_IS_LOG_STORE (self), FALSE);
   g_return_val_if_fail (chat_id != NULL, FALSE);
@@ -206,6 +215,8 @@ log_store_empathy_add_message (EmpathyLogStore *self,
   if (EMP_STR_EMPTY (body_str))
     return FALSE;
 
+  EMPATHY_TRACE_BEGIN (DEBUG_FLAG, "log-store-add-message", 0);
+
   filename = log_store_empathy_get_filename (self, account, chat_id, chatroom);
   basedir = g_path_get_dirname (filename);
   if (!g_file_test (basedir, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_DIR))
@@ -245,7 +256,7 @@ log_store_empathy_add_message (EmpathyLogStore *self,
   if (avatar != NULL)
     avatar_token = g_markup_escape_text (avatar->token, -1);
 
-  g_fprintf (file,
+  written = g_fprintf (file,
        "<message time='%s' cm_id='%d' id='%s' name='%s' token='%s' isuser='%s' type='%s'>"
        "%s</message>\n" LOG_FOOTER, timestamp,
        empathy_message_get_id (message),
@@ -253,6 +264,9 @@ log_store_empathy_add_message (EmpathyLogStore *self,
        avatar_token ? avatar_token : "",
        empathy_contact_is_user (sender) ? "true" : "false",
        empathy_message_type_to_str (msg_type), body);
+  if (written > 0)
+    EMPATHY_STAT_ADD ("log-manager.bytes-written", EMPATHY_STAT_COUNTER,
+        written);
 
   fclose (file);
   g_free (filename);
@@ -262,6 +276,8 @@ log_store_empathy_add_message (EmpathyLogStore *self,
   g_free (body);
   g_free (avatar_token);
 
+  EMPATHY_TRACE_END (DEBUG_FLAG, "log-store-add-message", 0);
+
   return TRUE;
 }
 
@@ -391,17 +407,20 @@ log_store_empathy_search_hit_new (EmpathyLogStore *self,
   return hit;
 }
 
+/* Parses @filename into a list of EmpathyMessageRecord, oldest first, and
+ * returns its account in @account if not NULL. Records only become
+ * EmpathyMessage once they are known to be returned. */
 static GList *
-log_store_empathy_get_messages_for_file (EmpathyLogStore *self,
-                                         const gchar *filename)
+log_store_empathy_get_records_for_file (EmpathyLogStore *self,
+                                        const gchar *filename,
+                                        McAccount **account)
 {
-  GList *messages = NULL;
+  GList *records = NULL;
   xmlParserCtxtPtr ctxt;
   xmlDocPtr doc;
   xmlNodePtr log_node;
   xmlNodePtr node;
   EmpathyLogSearchHit *hit;
-  McAccount *account;
 
   g_return_val_if_fail (EMPATHY_IS_LOG_STORE (self), NULL);
   g_return_val_if_fail (filename != NULL, NULL);
@@ -414,10 +433,7 @@ log_store_empathy_get_messages_for_file (EmpathyLogStore *self,
       return NULL;
     }
 
-  /* Get the account from the filename */
-  hit = log_store_empathy_search_hit_new (self, filename);
-  account = g_object_ref (hit->account);
-  empathy_log_manager_search_hit_free (hit);
+  EMPATHY_TRACE_BEGIN (DEBUG_FLAG, "log-store-parse-file", 0);
 
   /* Create parser. */
   ctxt = xmlNewParserCtxt ();
@@ -428,6 +444,7 @@ log_store_empathy_get_messages_for_file (EmpathyLogStore *self,
     {
       g_warning ("Failed to parse file:'%s'", filename);
       xmlFreeParserCtxt (ctxt);
+      EMPATHY_TRACE_END (DEBUG_FLAG, "log-store-parse-file", 0);
       return NULL;
     }
 
@@ -437,14 +454,14 @@ log_store_empathy_get_messages_for_file (EmpathyLogStore *self,
     {
       xmlFreeDoc (doc);
       xmlFreeParserCtxt (ctxt);
+      EMPATHY_TRACE_END (DEBUG_FLAG, "log-store-parse-file", 0);
       return NULL;
     }
 
   /* Now get the messages. */
   for (node = log_node->children; node; node = node->next)
     {
-      EmpathyMessage *message;
-      EmpathyContact *sender;
+      EmpathyMessageRecord *record;
       gchar *time;
       time_t t;
       gchar *sender_id;
@@ -452,10 +469,8 @@ log_store_empathy_get_messages_for_file (EmpathyLogStore *self,
       gchar *sender_avatar_token;
       gchar *body;
       gchar *is_user_str;
-      gboolean is_user = FALSE;
       gchar *msg_type_str;
       gchar *cm_id_str;
-      guint cm_id;
       TpChannelTextMessageType msg_type = TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL;
 
       if (strcmp (node->name, "message") != 0)
@@ -470,35 +485,24 @@ log_store_empathy_get_messages_for_file (EmpathyLogStore *self,
       msg_type_str = xmlGetProp (node, "type");
       cm_id_str = xmlGetProp (node, "cm_id");
 
-      if (is_user_str)
-        is_user = strcmp (is_user_str, "true") == 0;
-
       if (msg_type_str)
         msg_type = empathy_message_type_from_str (msg_type_str);
 
-      if (cm_id_str)
-        cm_id = atoi (cm_id_str);
-
       t = empathy_time_parse (time);
 
-      sender = empathy_contact_new_for_log (account, sender_id, sender_name,
-					    is_user);
-
-      if (!EMP_STR_EMPTY (sender_avatar_token))
-        empathy_contact_load_avatar_cache (sender,
-            sender_avatar_token);
+      record = empathy_message_record_new (msg_type, t, body);
+      empathy_message_record_set_sender (record, sender_id, sender_name,
+          EMP_STR_EMPTY (sender_avatar_token) ? NULL : sender_avatar_token);
 
-      message = empathy_message_new (body);
-      empathy_message_set_sender (message, sender);
-      empathy_message_set_timestamp (message, t);
-      empathy_message_set_tptype (message, msg_type);
+      if (is_user_str && strcmp (is_user_str, "true") == 0)
+        empathy_message_record_set_flags (record,
+            EMPATHY_MESSAGE_RECORD_FLAG_FROM_USER);
 
       if (cm_id_str)
-        empathy_message_set_id (message, cm_id);
+        empathy_message_record_set_id (record, atoi (cm_id_str));
 
-      messages = g_list_append (messages, message);
+      records = g_list_prepend (records, record);
 
-      g_object_unref (sender);
       xmlFree (time);
       xmlFree (sender_id);
       xmlFree (sender_name);
@@ -509,12 +513,129 @@ log_store_empathy_get_messages_for_file (EmpathyLogStore *self,
       xmlFree (sender_avatar_token);
     }
 
-  DEBUG ("Parsed %d messages", g_list_length (messages));
+  DEBUG ("Parsed %d messages", g_list_length (records));
 
   xmlFreeDoc (doc);
   xmlFreeParserCtxt (ctxt);
 
-  return messages;
+  EMPATHY_TRACE_END (DEBUG_FLAG, "log-store-parse-file",
+      g_list_length (records));
+
+  /* Get the account from the filename */
+  if (account != NULL)
+    {
+      hit = log_store_empathy_search_hit_new (self, filename);
+      *account = g_object_ref (hit->account);
+      empathy_log_manager_search_hit_free (hit);
+    }
+
+  return g_list_reverse (records);
+}
+
+/* Records of the same sender share their pooled strings, so they can be
+ * compared by address. */
+static guint
+log_store_empathy_sender_hash (gconstpointer key)
+{
+  EmpathyMessageRecord *record = (EmpathyMessageRecord *) key;
+
+  return g_direct_hash (empathy_message_record_get_sender_id (record)) ^
+      g_direct_hash (empathy_message_record_get_sender_name (record)) ^
+      (empathy_message_record_get_flags (record) &
+       EMPATHY_MESSAGE_RECORD_FLAG_FROM_USER);
+}
+
+static gboolean
+log_store_empathy_sender_equal (gconstpointer a,
+                                gconstpointer b)
+{
+  EmpathyMessageRecord *ra = (EmpathyMessageRecord *) a;
+  EmpathyMessageRecord *rb = (EmpathyMessageRecord *) b;
+
+  return empathy_message_record_get_sender_id (ra) ==
+      empathy_message_record_get_sender_id (rb) &&
+    empathy_message_record_get_sender_name (ra) ==
+      empathy_message_record_get_sender_name (rb) &&
+    (empathy_message_record_get_flags (ra) &
+     EMPATHY_MESSAGE_RECORD_FLAG_FROM_USER) ==
+    (empathy_message_record_get_flags (rb) &
+     EMPATHY_MESSAGE_RECORD_FLAG_FROM_USER);
+}
+
+static GHashTable *
+log_store_empathy_senders_new (void)
+{
+  return g_hash_table_new_full (log_store_empathy_sender_hash,
+      log_store_empathy_sender_equal,
+      (GDestroyNotify) empathy_message_record_unref, g_object_unref);
+}
+
+/* Senders are looked up in @senders so that a contact is created once per
+ * sender and not once per message. */
+static EmpathyMessage *
+log_store_empathy_message_from_record (McAccount *account,
+                                       EmpathyMessageRecord *record,
+                                       GHashTable *senders)
+{
+  EmpathyMessage *message;
+  EmpathyContact *sender;
+
+  sender = g_hash_table_lookup (senders, record);
+  if (sender == NULL)
+    {
+      const gchar *avatar_token;
+
+      sender = empathy_contact_new_for_log (account,
+          empathy_message_record_get_sender_id (record),
+          empathy_message_record_get_sender_name (record),
+          empathy_message_record_get_flags (record) &
+          EMPATHY_MESSAGE_RECORD_FLAG_FROM_USER);
+
+      avatar_token = empathy_message_record_get_sender_avatar_token (record);
+      if (avatar_token != NULL)
+        empathy_contact_load_avatar_cache (sender, avatar_token);
+
+      g_hash_table_insert (senders, empathy_message_record_ref (record),
+          sender);
+    }
+
+  message = empathy_message_new_from_record (record);
+  empathy_message_set_sender (message, sender);
+
+  return message;
+}
+
+static GList *
+log_store_empathy_get_messages_for_file (EmpathyLogStore *self,
+                                         const gchar *filename)
+{
+  GList *records, *l;
+  GList *messages = NULL;
+  GHashTable *senders;
+  McAccount *account = NULL;
+
+  records = log_store_empathy_get_records_for_file (self, filename, &account);
+  if (records == NULL)
+    {
+      if (account != NULL)
+        g_object_unref (account);
+      return NULL;
+    }
+
+  senders = log_store_empathy_senders_new ();
+
+  for (l = records; l; l = g_list_next (l))
+    {
+      messages = g_list_prepend (messages,
+          log_store_empathy_message_from_record (account, l->data, senders));
+      empathy_message_record_unref (l->data);
+    }
+
+  g_hash_table_destroy (senders);
+  g_list_free (records);
+  g_object_unref (account);
+
+  return g_list_reverse (messages);
 }
 
 static GList *
@@ -724,37 +845,53 @@ log_store_empathy_get_filtered_messages (EmpathyLogStore *self,
                                          gpointer user_data)
 {
   GList *dates, *l, *messages = NULL;
+  GHashTable *senders;
   guint i = 0;
 
   dates = log_store_empathy_get_dates (self, account, chat_id, chatroom);
+  senders = log_store_empathy_senders_new ();
 
   for (l = g_list_last (dates); l && i < num_messages; l = g_list_previous (l))
     {
-      GList *new_messages, *n, *next;
+      GList *records, *r;
+      GList *new_messages = NULL;
+      gchar *filename;
 
-      /* FIXME: We should really restrict the message parsing to get only
-       * the newest num_messages. */
-      new_messages = log_store_empathy_get_messages_for_date (self, account,
+      filename = log_store_empathy_get_filename_for_date (self, account,
           chat_id, chatroom, l->data);
+      records = log_store_empathy_get_records_for_file (self, filename,
+          NULL);
+      g_free (filename);
 
-      n = new_messages;
-      while (n != NULL)
+      /* Only the newest num_messages become EmpathyMessage, older
+       * records are simply dropped. */
+      for (r = g_list_last (records); r && i < num_messages;
+           r = g_list_previous (r))
         {
-          next = g_list_next (n);
-          if (!filter (n->data, user_data))
+          EmpathyMessage *message;
+
+          message = log_store_empathy_message_from_record (account, r->data,
+              senders);
+
+          if (filter (message, user_data))
             {
-              g_object_unref (n->data);
-              new_messages = g_list_delete_link (new_messages, n);
+              new_messages = g_list_prepend (new_messages, message);
+              i++;
             }
           else
             {
-              i++;
+              g_object_unref (message);
             }
-          n = next;
         }
-      messages = g_list_concat (messages, new_messages);
+
+      g_list_foreach (records, (GFunc) empathy_message_record_unref, NULL);
+      g_list_free (records);
+
+      /* Older dates come first */
+      messages = g_list_concat (new_messages, messages);
     }
 
+  g_hash_table_destroy (senders);
   g_list_foreach (dates, (GFunc) g_free, NULL);
   g_list_free (dates);
 
@@ -0,0 +1,307 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "empathy-message-record.h"
+#include "empathy-time.h"
+
+/* A message as it comes from the connection or the logs, before anything
+ * needs to observe it. The body is stored inline, in the same slice as the
+ * record, and sender strings are shared between records through a
+ * refcounted pool since a chat or a log file only has a handful of
+ * distinct senders. */
+struct _EmpathyMessageRecord {
+	volatile gint ref_count;
+	guint        id;
+	guint32      timestamp;
+	guint        type : 4;
+	guint        flags : 28;
+	guint        sender_handle;
+	guint        body_len;
+	const gchar *sender_id;
+	const gchar *sender_name;
+	const gchar *sender_avatar_token;
+	gchar        body[1];
+};
+
+#define RECORD_SIZE(body_len) \
+	(G_STRUCT_OFFSET (EmpathyMessageRecord, body) + (body_len) + 1)
+
+/* Sender strings in use, mapped to the number of records using them.
+ * Records are boxed values which may be handed to other threads, the
+ * pool is locked like their refcount is atomic. */
+static GHashTable   *string_pool = NULL;
+static GStaticMutex  string_pool_lock = G_STATIC_MUTEX_INIT;
+
+static const gchar *
+string_pool_ref (const gchar *str)
+{
+	gpointer key, count;
+
+	if (str == NULL) {
+		return NULL;
+	}
+
+	g_static_mutex_lock (&string_pool_lock);
+
+	if (string_pool == NULL) {
+		string_pool = g_hash_table_new_full (g_str_hash, g_str_equal,
+						     g_free, NULL);
+	}
+
+	if (g_hash_table_lookup_extended (string_pool, str, &key, &count)) {
+		g_hash_table_insert (string_pool, key,
+				     GUINT_TO_POINTER (GPOINTER_TO_UINT (count) + 1));
+	} else {
+		key = g_strdup (str);
+		g_hash_table_insert (string_pool, key, GUINT_TO_POINTER (1));
+	}
+
+	g_static_mutex_unlock (&string_pool_lock);
+
+	return key;
+}
+
+static void
+string_pool_unref (const gchar *str)
+{
+	guint count;
+
+	if (str == NULL) {
+		return;
+	}
+
+	g_static_mutex_lock (&string_pool_lock);
+
+	count = GPOINTER_TO_UINT (g_hash_table_lookup (string_pool, str));
+	if (count <= 1) {
+		g_hash_table_remove (string_pool, str);
+	} else {
+		g_hash_table_insert (string_pool, (gchar *) str,
+				     GUINT_TO_POINTER (count - 1));
+	}
+
+	g_static_mutex_unlock (&string_pool_lock);
+}
+
+GType
+empathy_message_record_get_type (void)
+{
+	static GType type_id = 0;
+
+	if (!type_id) {
+		type_id = g_boxed_type_register_static ("EmpathyMessageRecord",
+			(GBoxedCopyFunc) empathy_message_record_ref,
+			(GBoxedFreeFunc) empathy_message_record_unref);
+	}
+
+	return type_id;
+}
+
+EmpathyMessageRecord *
+empathy_message_record_new (TpChannelTextMessageType  type,
+			    time_t                    timestamp,
+			    const gchar              *body)
+{
+	EmpathyMessageRecord *record;
+	gsize                 body_len;
+
+	body_len = body ? strlen (body) : 0;
+
+	record = g_slice_alloc (RECORD_SIZE (body_len));
+	record->ref_count = 1;
+	record->id = 0;
+	record->timestamp = timestamp > 0 ? timestamp : empathy_time_get_current ();
+	record->type = type;
+	record->flags = 0;
+	record->sender_handle = 0;
+	record->body_len = body_len;
+	record->sender_id = NULL;
+	record->sender_name = NULL;
+	record->sender_avatar_token = NULL;
+
+	if (body_len > 0) {
+		memcpy (record->body, body, body_len);
+	}
+	record->body[body_len] = '\0';
+
+	return record;
+}
+
+EmpathyMessageRecord *
+empathy_message_record_ref (EmpathyMessageRecord *record)
+{
+	g_return_val_if_fail (record != NULL, NULL);
+
+	g_atomic_int_inc (&record->ref_count);
+
+	return record;
+}
+
+void
+empathy_message_record_unref (EmpathyMessageRecord *record)
+{
+	g_return_if_fail (record != NULL);
+
+	if (g_atomic_int_dec_and_test (&record->ref_count)) {
+		string_pool_unref (record->sender_id);
+		string_pool_unref (record->sender_name);
+		string_pool_unref (record->sender_avatar_token);
+		g_slice_free1 (RECORD_SIZE (record->body_len), record);
+	}
+}
+
+TpChannelTextMessageType
+empathy_message_record_get_tptype (EmpathyMessageRecord *record)
+{
+	g_return_val_if_fail (record != NULL,
+			      TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL);
+
+	return record->type;
+}
+
+time_t
+empathy_message_record_get_timestamp (EmpathyMessageRecord *record)
+{
+	g_return_val_if_fail (record != NULL, -1);
+
+	return record->timestamp;
+}
+
+const gchar *
+empathy_message_record_get_body (EmpathyMessageRecord *record)
+{
+	g_return_val_if_fail (record != NULL, NULL);
+
+	return record->body;
+}
+
+guint
+empathy_message_record_get_flags (EmpathyMessageRecord *record)
+{
+	g_return_val_if_fail (record != NULL, 0);
+
+	return record->flags;
+}
+
+void
+empathy_message_record_set_flags (EmpathyMessageRecord *record,
+				  guint                 flags)
+{
+	g_return_if_fail (record != NULL);
+
+	record->flags = flags;
+}
+
+guint
+empathy_message_record_get_id (EmpathyMessageRecord *record)
+{
+	g_return_val_if_fail (record != NULL, 0);
+
+	return record->id;
+}
+
+void
+empathy_message_record_set_id (EmpathyMessageRecord *record,
+			       guint                 id)
+{
+	g_return_if_fail (record != NULL);
+
+	record->id = id;
+	record->flags |= EMPATHY_MESSAGE_RECORD_FLAG_HAS_ID;
+}
+
+guint
+empathy_message_record_get_sender_handle (EmpathyMessageRecord *record)
+{
+	g_return_val_if_fail (record != NULL, 0);
+
+	return record->sender_handle;
+}
+
+void
+empathy_message_record_set_sender_handle (EmpathyMessageRecord *record,
+					  guint                 handle)
+{
+	g_return_if_fail (record != NULL);
+
+	record->sender_handle = handle;
+}
+
+const gchar *
+empathy_message_record_get_sender_id (EmpathyMessageRecord *record)
+{
+	g_return_val_if_fail (record != NULL, NULL);
+
+	return record->sender_id;
+}
+
+const gchar *
+empathy_message_record_get_sender_name (EmpathyMessageRecord *record)
+{
+	g_return_val_if_fail (record != NULL, NULL);
+
+	return record->sender_name;
+}
+
+const gchar *
+empathy_message_record_get_sender_avatar_token (EmpathyMessageRecord *record)
+{
+	g_return_val_if_fail (record != NULL, NULL);
+
+	return record->sender_avatar_token;
+}
+
+void
+empathy_message_record_set_sender (EmpathyMessageRecord *record,
+				   const gchar          *id,
+				   const gchar          *name,
+				   const gchar          *avatar_token)
+{
+	const gchar *old_id;
+	const gchar *old_name;
+	const gchar *old_avatar_token;
+
+	g_return_if_fail (record != NULL);
+
+	old_id = record->sender_id;
+	old_name = record->sender_name;
+	old_avatar_token = record->sender_avatar_token;
+
+	/* Take the new strings first, they can be the old ones */
+	record->sender_id = string_pool_ref (id);
+	record->sender_name = string_pool_ref (name);
+	record->sender_avatar_token = string_pool_ref (avatar_token);
+
+	string_pool_unref (old_id);
+	string_pool_unref (old_name);
+	string_pool_unref (old_avatar_token);
+}
+
+/* Bytes owned by the record itself, pooled strings are shared. */
+gsize
+empathy_message_record_get_size (EmpathyMessageRecord *record)
+{
+	g_return_val_if_fail (record != NULL, 0);
+
+	return RECORD_SIZE (record->body_len);
+}
@@ -0,0 +1,68 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __EMPATHY_MESSAGE_RECORD_H__
+#define __EMPATHY_MESSAGE_RECORD_H__
+
+#include <time.h>
+
+#include <glib-object.h>
+#include <telepathy-glib/enums.h>
+
+G_BEGIN_DECLS
+
+#define EMPATHY_TYPE_MESSAGE_RECORD (empathy_message_record_get_type ())
+
+typedef struct _EmpathyMessageRecord EmpathyMessageRecord;
+
+typedef enum {
+	EMPATHY_MESSAGE_RECORD_FLAG_FROM_USER = 1 << 0,
+	EMPATHY_MESSAGE_RECORD_FLAG_HAS_ID    = 1 << 1,
+} EmpathyMessageRecordFlags;
+
+GType                     empathy_message_record_get_type         (void) G_GNUC_CONST;
+EmpathyMessageRecord *    empathy_message_record_new              (TpChannelTextMessageType  type,
+								   time_t                    timestamp,
+								   const gchar              *body);
+EmpathyMessageRecord *    empathy_message_record_ref              (EmpathyMessageRecord     *record);
+void                      empathy_message_record_unref            (EmpathyMessageRecord     *record);
+TpChannelTextMessageType  empathy_message_record_get_tptype       (EmpathyMessageRecord     *record);
+time_t                    empathy_message_record_get_timestamp    (EmpathyMessageRecord     *record);
+const gchar *             empathy_message_record_get_body         (EmpathyMessageRecord     *record);
+guint                     empathy_message_record_get_flags        (EmpathyMessageRecord     *record);
+void                      empathy_message_record_set_flags        (EmpathyMessageRecord     *record,
+								   guint                     flags);
+guint                     empathy_message_record_get_id           (EmpathyMessageRecord     *record);
+void                      empathy_message_record_set_id           (EmpathyMessageRecord     *record,
+								   guint                     id);
+guint                     empathy_message_record_get_sender_handle (EmpathyMessageRecord    *record);
+void                      empathy_message_record_set_sender_handle (EmpathyMessageRecord    *record,
+								   guint                     handle);
+const gchar *             empathy_message_record_get_sender_id    (EmpathyMessageRecord     *record);
+const gchar *             empathy_message_record_get_sender_name  (EmpathyMessageRecord     *record);
+const gchar *             empathy_message_record_get_sender_avatar_token (EmpathyMessageRecord *record);
+void                      empathy_message_record_set_sender       (EmpathyMessageRecord     *record,
+								   const gchar              *id,
+								   const gchar              *name,
+								   const gchar              *avatar_token);
+gsize                     empathy_message_record_get_size         (EmpathyMessageRecord     *record);
+
+G_END_DECLS
+
+#endif /* __EMPATHY_MESSAGE_RECORD_H__ */
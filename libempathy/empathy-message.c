@@ -38,6 +38,9 @@ typedef struct {
 	EmpathyContact           *sender;
 	EmpathyContact           *receiver;
 	gchar                    *body;
+	/* Holds the body, unless it was set explicitly */
+	EmpathyMessageRecord     *record;
+	const gchar              *record_body;
 	time_t                    timestamp;
 	guint                     id;
 } EmpathyMessagePriv;
@@ -143,6 +146,9 @@ empathy_message_finalize (GObject *object)
 	}
 
 	g_free (priv->body);
+	if (priv->record) {
+		empathy_message_record_unref (priv->record);
+	}
 
 	G_OBJECT_CLASS (empathy_message_parent_class)->finalize (object);
 }
@@ -168,7 +174,8 @@ message_get_property (GObject    *object,
 		g_value_set_object (value, priv->receiver);
 		break;
 	case PROP_BODY:
-		g_value_set_string (value, priv->body);
+		g_value_set_string (value,
+			empathy_message_get_body (EMPATHY_MESSAGE (object)));
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
@@ -209,6 +216,28 @@ message_set_property (GObject      *object,
 	};
 }
 
+/* Skips the /me and /say commands, returning the type they imply */
+static const gchar *
+message_body_skip_command (const gchar              *body,
+			   TpChannelTextMessageType *type)
+{
+	*type = TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL;
+
+	if (body == NULL) {
+		return NULL;
+	}
+
+	if (g_str_has_prefix (body, "/me")) {
+		*type = TP_CHANNEL_TEXT_MESSAGE_TYPE_ACTION;
+		return body[3] != '\0' ? body + 4 : body + 3;
+	}
+	else if (g_str_has_prefix (body, "/say")) {
+		return body[4] != '\0' ? body + 5 : body + 4;
+	}
+
+	return body;
+}
+
 EmpathyMessage *
 empathy_message_new (const gchar *body)
 {
@@ -217,6 +246,30 @@ empathy_message_new (const gchar *body)
 			     NULL);
 }
 
+/* Wraps @record for the UI. The body is shared with the record instead of
+ * being copied, and no property notification is emitted. */
+EmpathyMessage *
+empathy_message_new_from_record (EmpathyMessageRecord *record)
+{
+	EmpathyMessage           *message;
+	EmpathyMessagePriv       *priv;
+	TpChannelTextMessageType  type;
+
+	g_return_val_if_fail (record != NULL, NULL);
+
+	message = g_object_new (EMPATHY_TYPE_MESSAGE, NULL);
+	priv = GET_PRIV (message);
+
+	priv->record = empathy_message_record_ref (record);
+	priv->record_body = message_body_skip_command (
+		empathy_message_record_get_body (record), &type);
+	priv->type = empathy_message_record_get_tptype (record);
+	priv->timestamp = empathy_message_record_get_timestamp (record);
+	priv->id = empathy_message_record_get_id (record);
+
+	return message;
+}
+
 TpChannelTextMessageType
 empathy_message_get_tptype (EmpathyMessage *message)
 {
@@ -320,6 +373,10 @@ empathy_message_get_body (EmpathyMessage *message)
 
 	priv = GET_PRIV (message);
 
+	if (priv->body == NULL) {
+		return priv->record_body;
+	}
+
 	return priv->body;
 }
 
@@ -334,16 +391,14 @@ empathy_message_set_body (EmpathyMessage *message,
 
 	g_free (priv->body);
 	priv->body = NULL;
-
-	type = TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL;
-	if (g_str_has_prefix (body, "/me")) {
-		type = TP_CHANNEL_TEXT_MESSAGE_TYPE_ACTION;
-		body += 4;
-	}
-	else if (g_str_has_prefix (body, "/say")) {
-		body += 5;
+	if (priv->record) {
+		empathy_message_record_unref (priv->record);
+		priv->record = NULL;
+		priv->record_body = NULL;
 	}
 
+	body = message_body_skip_command (body, &type);
+
 	if (body) {
 		priv->body = g_strdup (body);
 	}
@@ -512,7 +567,9 @@ empathy_message_equal (EmpathyMessage *message1, EmpathyMessage *message2)
 	priv1 = GET_PRIV (message1);
 	priv2 = GET_PRIV (message2);
 
-	if (priv1->id == priv2->id && !tp_strdiff (priv1->body, priv2->body)) {
+	if (priv1->id == priv2->id &&
+	    !tp_strdiff (empathy_message_get_body (message1),
+			 empathy_message_get_body (message2))) {
 		return TRUE;
 	}
 
@@ -28,6 +28,7 @@
 #include <glib-object.h>
 
 #include "empathy-contact.h"
+#include "empathy-message-record.h"
 #include "empathy-time.h"
 
 G_BEGIN_DECLS
@@ -53,6 +54,7 @@ struct _EmpathyMessageClass {
 
 GType                    empathy_message_get_type          (void) G_GNUC_CONST;
 EmpathyMessage *         empathy_message_new               (const gchar              *body);
+EmpathyMessage *         empathy_message_new_from_record   (EmpathyMessageRecord     *record);
 TpChannelTextMessageType empathy_message_get_tptype        (EmpathyMessage           *message);
 void                     empathy_message_set_tptype        (EmpathyMessage           *message,
 							    TpChannelTextMessageType  type);
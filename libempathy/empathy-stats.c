@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <dbus/dbus-glib.h>
+
+#include <telepathy-glib/dbus.h>
+
+#include <extensions/extensions.h>
+
+#include "empathy-stats.h"
+#include "empathy-time.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_OTHER
+#include "empathy-debug.h"
+
+/**
+ * SECTION:empathy-stats
+ * @short_description: Performance counters
+ * @include: libempathy/empathy-stats.h
+ *
+ * Subsystems keep named statistics: counters which only grow, gauges which
+ * go up and down and histograms of durations. Statistics are created the
+ * first time they are looked up and live as long as the process, so their
+ * handle can be kept in a static variable, which the EMPATHY_STAT_ADD() and
+ * EMPATHY_STAT_RECORD() macros do.
+ *
+ * empathy_stats_export() makes them available on the session bus.
+ */
+
+struct _EmpathyStat
+{
+  gchar *name;
+  EmpathyStatType type;
+  gint64 value;
+  guint64 count;
+  guint64 sum;
+  guint64 max;
+  guint buckets[EMPATHY_STAT_N_BUCKETS];
+};
+
+/* Statistics can be updated from the file transfer threads */
+static GStaticMutex stats_lock = G_STATIC_MUTEX_INIT;
+/* name -> EmpathyStat, never freed */
+static GHashTable *stats = NULL;
+
+static void empathy_stats_iface_init (EmpSvcStatsClass *klass);
+
+G_DEFINE_TYPE_WITH_CODE (EmpathyStats, empathy_stats, G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (EMP_TYPE_SVC_STATS, empathy_stats_iface_init))
+
+static EmpathyStats *stats_singleton = NULL;
+
+/**
+ * empathy_stat_get:
+ * @name: the name of the statistic, prefixed by its subsystem
+ * @type: the type of the statistic
+ *
+ * Looks up the statistic @name, creating it if needed.
+ *
+ * Return value: the statistic, valid as long as the process
+ */
+EmpathyStat *
+empathy_stat_get (const gchar *name,
+                  EmpathyStatType type)
+{
+  EmpathyStat *stat;
+
+  g_return_val_if_fail (name != NULL, NULL);
+
+  g_static_mutex_lock (&stats_lock);
+
+  if (stats == NULL)
+    stats = g_hash_table_new (g_str_hash, g_str_equal);
+
+  stat = g_hash_table_lookup (stats, name);
+  if (stat == NULL)
+    {
+      stat = g_slice_new0 (EmpathyStat);
+      stat->name = g_strdup (name);
+      stat->type = type;
+      g_hash_table_insert (stats, stat->name, stat);
+    }
+  else if (stat->type != type)
+    {
+      g_warning ("Statistic %s used with another type", name);
+    }
+
+  g_static_mutex_unlock (&stats_lock);
+
+  return stat;
+}
+
+/**
+ * empathy_stat_add:
+ * @stat: a counter or a gauge
+ * @delta: what to add to its value
+ *
+ * Updates a counter or a gauge.
+ */
+void
+empathy_stat_add (EmpathyStat *stat,
+                  gint64 delta)
+{
+  g_return_if_fail (stat != NULL);
+
+  g_static_mutex_lock (&stats_lock);
+  stat->value += delta;
+  stat->count++;
+  g_static_mutex_unlock (&stats_lock);
+}
+
+static guint
+stat_get_bucket (guint64 usec)
+{
+  guint bucket = 0;
+
+  while (usec != 0 && bucket < EMPATHY_STAT_N_BUCKETS - 1)
+    {
+      usec >>= 1;
+      bucket++;
+    }
+
+  return bucket;
+}
+
+/**
+ * empathy_stat_record:
+ * @stat: a histogram
+ * @usec: a duration in microseconds
+ *
+ * Adds a duration to a histogram.
+ */
+void
+empathy_stat_record (EmpathyStat *stat,
+                     guint64 usec)
+{
+  g_return_if_fail (stat != NULL);
+
+  g_static_mutex_lock (&stats_lock);
+  stat->count++;
+  stat->sum += usec;
+  stat->max = MAX (stat->max, usec);
+  stat->buckets[stat_get_bucket (usec)]++;
+  g_static_mutex_unlock (&stats_lock);
+}
+
+/**
+ * empathy_stat_get_value:
+ * @stat: a statistic
+ * @value: where to copy its current value
+ *
+ * Takes a consistent copy of the current value of @stat.
+ */
+void
+empathy_stat_get_value (EmpathyStat *stat,
+                        EmpathyStatValue *value)
+{
+  g_return_if_fail (stat != NULL);
+  g_return_if_fail (value != NULL);
+
+  g_static_mutex_lock (&stats_lock);
+  value->name = stat->name;
+  value->type = stat->type;
+  value->value = stat->value;
+  value->count = stat->count;
+  value->sum = stat->sum;
+  value->max = stat->max;
+  memcpy (value->buckets, stat->buckets, sizeof (value->buckets));
+  g_static_mutex_unlock (&stats_lock);
+}
+
+static gint
+stat_compare (gconstpointer a,
+              gconstpointer b)
+{
+  return strcmp (((const EmpathyStat *) a)->name,
+      ((const EmpathyStat *) b)->name);
+}
+
+/**
+ * empathy_stats_list:
+ *
+ * Lists the statistics created so far.
+ *
+ * Return value: a #GList of #EmpathyStat sorted by name, to free with
+ * g_list_free()
+ */
+GList *
+empathy_stats_list (void)
+{
+  GList *list = NULL;
+
+  g_static_mutex_lock (&stats_lock);
+  if (stats != NULL)
+    list = g_hash_table_get_values (stats);
+  g_static_mutex_unlock (&stats_lock);
+
+  return g_list_sort (list, stat_compare);
+}
+
+/**
+ * empathy_stats_get_time:
+ *
+ * Return value: a monotonic time in microseconds, to measure durations
+ * recorded with empathy_stat_record()
+ */
+gint64
+empathy_stats_get_time (void)
+{
+  return (gint64) (empathy_time_get_monotonic () * G_USEC_PER_SEC);
+}
+
+static void
+stats_get_stats (EmpSvcStats *iface,
+                 DBusGMethodInvocation *context)
+{
+  GPtrArray *result;
+  GList *list, *l;
+
+  list = empathy_stats_list ();
+  result = g_ptr_array_sized_new (g_list_length (list));
+
+  for (l = list; l != NULL; l = l->next)
+    {
+      EmpathyStatValue value;
+      GValue stat = { 0, };
+      GArray *buckets;
+
+      empathy_stat_get_value (l->data, &value);
+
+      buckets = g_array_sized_new (FALSE, FALSE, sizeof (guint),
+          EMPATHY_STAT_N_BUCKETS);
+      if (value.type == EMPATHY_STAT_HISTOGRAM)
+        g_array_append_vals (buckets, value.buckets, EMPATHY_STAT_N_BUCKETS);
+
+      g_value_init (&stat, EMP_STRUCT_TYPE_STAT);
+      g_value_take_boxed (&stat,
+          dbus_g_type_specialized_construct (EMP_STRUCT_TYPE_STAT));
+      dbus_g_type_struct_set (&stat,
+          0, value.name,
+          1, value.type,
+          2, value.value,
+          3, value.count,
+          4, value.sum,
+          5, value.max,
+          6, buckets,
+          G_MAXUINT);
+      g_ptr_array_add (result, g_value_get_boxed (&stat));
+
+      g_array_free (buckets, TRUE);
+    }
+
+  emp_svc_stats_return_from_get_stats (context, result);
+
+  g_boxed_free (EMP_ARRAY_TYPE_STAT_LIST, result);
+  g_list_free (list);
+}
+
+static void
+empathy_stats_class_init (EmpathyStatsClass *klass)
+{
+}
+
+static void
+empathy_stats_iface_init (EmpSvcStatsClass *klass)
+{
+  emp_svc_stats_implement_get_stats (klass, stats_get_stats);
+}
+
+static void
+empathy_stats_init (EmpathyStats *self)
+{
+}
+
+/**
+ * empathy_stats_export:
+ *
+ * Exports the statistics on the session bus, as the
+ * %EMPATHY_STATS_OBJECT_PATH object of %EMPATHY_STATS_BUS_NAME.
+ *
+ * Return value: a new reference to the exported object, or %NULL if the
+ * bus name couldn't be owned
+ */
+EmpathyStats *
+empathy_stats_export (void)
+{
+  DBusGProxy *proxy;
+  guint result;
+  GError *error = NULL;
+
+  if (stats_singleton != NULL)
+    return g_object_ref (stats_singleton);
+
+  proxy = dbus_g_proxy_new_for_name (tp_get_bus (), DBUS_SERVICE_DBUS,
+      DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS);
+
+  if (!dbus_g_proxy_call (proxy, "RequestName", &error,
+      G_TYPE_STRING, EMPATHY_STATS_BUS_NAME,
+      G_TYPE_UINT, DBUS_NAME_FLAG_DO_NOT_QUEUE,
+      G_TYPE_INVALID, G_TYPE_UINT, &result, G_TYPE_INVALID))
+    {
+      DEBUG ("Failed to request name: %s",
+          error ? error->message : "No error given");
+      g_clear_error (&error);
+      g_object_unref (proxy);
+      return NULL;
+    }
+
+  g_object_unref (proxy);
+
+  if (result != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER)
+    {
+      DEBUG ("%s is owned by another process", EMPATHY_STATS_BUS_NAME);
+      return NULL;
+    }
+
+  stats_singleton = g_object_new (EMPATHY_TYPE_STATS, NULL);
+  g_object_add_weak_pointer (G_OBJECT (stats_singleton),
+      (gpointer) &stats_singleton);
+  dbus_g_connection_register_g_object (tp_get_bus (),
+      EMPATHY_STATS_OBJECT_PATH, G_OBJECT (stats_singleton));
+
+  return stats_singleton;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __EMPATHY_STATS_H__
+#define __EMPATHY_STATS_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define EMPATHY_STATS_BUS_NAME "org.gnome.Empathy.Stats"
+#define EMPATHY_STATS_OBJECT_PATH "/org/gnome/Empathy/Stats"
+
+/* Number of buckets of the histograms, the last one counts everything
+ * longer than 2^(EMPATHY_STAT_N_BUCKETS - 2) microseconds */
+#define EMPATHY_STAT_N_BUCKETS 24
+
+/* Values are those of the Stat_Type D-Bus enum */
+typedef enum
+{
+  EMPATHY_STAT_COUNTER,
+  EMPATHY_STAT_GAUGE,
+  EMPATHY_STAT_HISTOGRAM,
+} EmpathyStatType;
+
+typedef struct _EmpathyStat EmpathyStat;
+
+typedef struct
+{
+  const gchar *name;
+  EmpathyStatType type;
+  gint64 value;
+  guint64 count;
+  guint64 sum;
+  guint64 max;
+  guint buckets[EMPATHY_STAT_N_BUCKETS];
+} EmpathyStatValue;
+
+EmpathyStat *empathy_stat_get (const gchar *name, EmpathyStatType type);
+void empathy_stat_add (EmpathyStat *stat, gint64 delta);
+void empathy_stat_record (EmpathyStat *stat, guint64 usec);
+void empathy_stat_get_value (EmpathyStat *stat, EmpathyStatValue *value);
+GList *empathy_stats_list (void);
+gint64 empathy_stats_get_time (void);
+
+/* Update the statistic @name, which is only looked up the first time.
+ * @name must be a string literal. */
+#define EMPATHY_STAT_ADD(name, type, delta) \
+  G_STMT_START { \
+    static EmpathyStat *_empathy_stat = NULL; \
+    if (G_UNLIKELY (_empathy_stat == NULL)) \
+      _empathy_stat = empathy_stat_get ((name), (type)); \
+    empathy_stat_add (_empathy_stat, (delta)); \
+  } G_STMT_END
+
+#define EMPATHY_STAT_RECORD(name, usec) \
+  G_STMT_START { \
+    static EmpathyStat *_empathy_stat = NULL; \
+    if (G_UNLIKELY (_empathy_stat == NULL)) \
+      _empathy_stat = empathy_stat_get ((name), EMPATHY_STAT_HISTOGRAM); \
+    empathy_stat_record (_empathy_stat, (usec)); \
+  } G_STMT_END
+
+#define EMPATHY_TYPE_STATS (empathy_stats_get_type ())
+#define EMPATHY_STATS(o) (G_TYPE_CHECK_INSTANCE_CAST ((o), \
+    EMPATHY_TYPE_STATS, EmpathyStats))
+#define EMPATHY_STATS_CLASS(k) (G_TYPE_CHECK_CLASS_CAST ((k), \
+    EMPATHY_TYPE_STATS, EmpathyStatsClass))
+#define EMPATHY_IS_STATS(o) (G_TYPE_CHECK_INSTANCE_TYPE ((o), \
+    EMPATHY_TYPE_STATS))
+#define EMPATHY_IS_STATS_CLASS(k) (G_TYPE_CHECK_CLASS_TYPE ((k), \
+    EMPATHY_TYPE_STATS))
+#define EMPATHY_STATS_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), \
+    EMPATHY_TYPE_STATS, EmpathyStatsClass))
+
+typedef struct _EmpathyStats EmpathyStats;
+typedef struct _EmpathyStatsClass EmpathyStatsClass;
+
+struct _EmpathyStats {
+  GObject parent;
+};
+
+struct _EmpathyStatsClass {
+  GObjectClass parent_class;
+};
+
+GType empathy_stats_get_type (void) G_GNUC_CONST;
+EmpathyStats *empathy_stats_export (void);
+
+G_END_DECLS
+
+#endif /* __EMPATHY_STATS_H__ */
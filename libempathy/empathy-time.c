@@ -37,6 +37,27 @@ empathy_time_get_current (void)
 	return time (NULL);
 }
 
+/* Seconds since an arbitrary point in the past. Unlike the wall clock, it
+ * never jumps when the system time is changed, so it is the one to use to
+ * measure durations. */
+gdouble
+empathy_time_get_monotonic (void)
+{
+	GTimeVal tv;
+
+#if defined (HAVE_CLOCK_GETTIME) && defined (CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0) {
+		return ts.tv_sec + ts.tv_nsec / 1e9;
+	}
+#endif
+
+	g_get_current_time (&tv);
+
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
 time_t
 empathy_time_get_local_time (struct tm *tm)
 {
@@ -34,6 +34,7 @@ G_BEGIN_DECLS
 #define EMPATHY_TIME_FORMAT_DISPLAY_LONG  "%a %d %b %Y"
 
 time_t  empathy_time_get_current     (void);
+gdouble empathy_time_get_monotonic   (void);
 time_t  empathy_time_get_local_time  (struct tm   *tm);
 time_t  empathy_time_parse           (const gchar *str);
 gchar  *empathy_time_to_string_utc   (time_t       t,
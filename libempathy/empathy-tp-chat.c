@@ -32,12 +32,17 @@
 #include "empathy-contact-monitor.h"
 #include "empathy-contact-list.h"
 #include "empathy-marshal.h"
+#include "empathy-stats.h"
 #include "empathy-time.h"
 #include "empathy-utils.h"
 
 #define DEBUG_FLAG EMPATHY_DEBUG_TP | EMPATHY_DEBUG_CHAT
 #include "empathy-debug.h"
 
+/* Acknowledgements are sent once per main loop iteration, or as soon as
+ * that many messages are waiting to be acknowledged. */
+#define MAX_PENDING_ACKS 256
+
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyTpChat)
 typedef struct {
 	gboolean               dispose_has_run;
@@ -45,13 +50,25 @@ typedef struct {
 	EmpathyContactMonitor *contact_monitor;
 	EmpathyContact        *user;
 	EmpathyContact        *remote_contact;
-	GList                 *members;
+	/* TpHandle -> link of the contact in members_queue */
+	GHashTable            *members;
+	/* Member contacts, in the order they joined */
+	GQueue                *members_queue;
 	TpChannel             *channel;
 	gboolean               listing_pending_messages;
-	/* Queue of messages not signalled yet */
+	/* Queue of EmpathyMessageRecord not signalled yet */
 	GQueue                *messages_queue;
+	/* TpHandle -> EmpathyContact of the known senders of this chat */
+	GHashTable            *senders;
+	/* Set of the sender handles being requested */
+	GHashTable            *requested_senders;
 	/* Queue of messages signalled but not acked yet */
 	GQueue                *pending_messages_queue;
+	/* EmpathyMessage -> its link in pending_messages_queue */
+	GHashTable            *pending_messages_links;
+	/* Ids of messages to acknowledge on the next flush */
+	GArray                *pending_acks;
+	guint                  flush_acks_id;
 	gboolean               had_properties_list;
 	GPtrArray             *properties;
 	gboolean               ready;
@@ -79,6 +96,8 @@ enum {
 	CHAT_STATE_CHANGED,
 	PROPERTY_CHANGED,
 	DESTROY,
+	MEMBERS_CHANGED_BATCH,
+	MESSAGES_RECEIVED_BATCH,
 	LAST_SIGNAL
 };
 
@@ -89,6 +108,7 @@ G_DEFINE_TYPE_WITH_CODE (EmpathyTpChat, empathy_tp_chat, G_TYPE_OBJECT,
 						tp_chat_iface_init));
 
 static void acknowledge_messages (EmpathyTpChat *chat, GArray *ids);
+static void tp_chat_flush_acks (EmpathyTpChat *chat);
 
 static void
 tp_chat_invalidated_cb (TpProxy       *proxy,
@@ -158,8 +178,8 @@ tp_chat_get_members (EmpathyContactList *list)
 
 	g_return_val_if_fail (EMPATHY_IS_TP_CHAT (list), NULL);
 
-	if (priv->members) {
-		members = g_list_copy (priv->members);
+	if (priv->members_queue->head) {
+		members = g_list_copy (priv->members_queue->head);
 		g_list_foreach (members, (GFunc) g_object_ref, NULL);
 	} else {
 		members = g_list_prepend (members, g_object_ref (priv->user));
@@ -185,45 +205,182 @@ tp_chat_get_monitor (EmpathyContactList *list)
 	return priv->contact_monitor;
 }
 
-static void
-tp_chat_emit_queued_messages (EmpathyTpChat *chat)
+static EmpathyContact *
+tp_chat_lookup_sender (EmpathyTpChat        *chat,
+		       EmpathyMessageRecord *record)
 {
 	EmpathyTpChatPriv *priv = GET_PRIV (chat);
-	EmpathyMessage    *message;
+	TpHandle           handle;
+
+	handle = empathy_message_record_get_sender_handle (record);
+	if (handle == 0) {
+		return priv->user;
+	}
 
-	/* Check if we can now emit some queued messages */
-	while ((message = g_queue_peek_head (priv->messages_queue)) != NULL) {
-		if (empathy_message_get_sender (message) == NULL) {
+	return g_hash_table_lookup (priv->senders, GUINT_TO_POINTER (handle));
+}
+
+static void
+tp_chat_emit_queued_messages (EmpathyTpChat *chat)
+{
+	EmpathyTpChatPriv    *priv = GET_PRIV (chat);
+	EmpathyMessageRecord *record;
+	GPtrArray            *batch = NULL;
+
+	/* Check if we can now emit some queued messages. Records only become
+	 * EmpathyMessage here, once their sender is known. */
+	while ((record = g_queue_peek_head (priv->messages_queue)) != NULL) {
+		EmpathyMessage *message;
+		EmpathyContact *sender;
+
+		sender = tp_chat_lookup_sender (chat, record);
+		if (sender == NULL) {
 			break;
 		}
 
 		DEBUG ("Queued message ready");
 		g_queue_pop_head (priv->messages_queue);
+
+		message = empathy_message_new_from_record (record);
+		empathy_message_set_sender (message, sender);
+		empathy_message_set_receiver (message, priv->user);
+		empathy_message_record_unref (record);
+
 		g_queue_push_tail (priv->pending_messages_queue, message);
+		g_hash_table_insert (priv->pending_messages_links, message,
+				     priv->pending_messages_queue->tail);
+		EMPATHY_STAT_ADD ("tp-chat.pending-messages",
+				  EMPATHY_STAT_GAUGE, 1);
+
+		/* Handlers of message-received may acknowledge it */
+		if (batch == NULL) {
+			batch = g_ptr_array_new ();
+		}
+		g_ptr_array_add (batch, g_object_ref (message));
 		g_signal_emit (chat, signals[MESSAGE_RECEIVED], 0, message);
 	}
+
+	if (batch != NULL) {
+		g_signal_emit (chat, signals[MESSAGES_RECEIVED_BATCH], 0, batch);
+		g_ptr_array_foreach (batch, (GFunc) g_object_unref, NULL);
+		g_ptr_array_free (batch, TRUE);
+	}
+}
+
+/* Drops the queued messages whose sender couldn't be resolved */
+static void
+tp_chat_resolve_senders (EmpathyTpChat *chat)
+{
+	EmpathyTpChatPriv *priv = GET_PRIV (chat);
+	GList             *l, *next;
+
+	for (l = priv->messages_queue->head; l; l = next) {
+		EmpathyMessageRecord *record = l->data;
+		gpointer              handle;
+
+		next = l->next;
+
+		if (tp_chat_lookup_sender (chat, record) != NULL) {
+			continue;
+		}
+
+		handle = GUINT_TO_POINTER (
+			empathy_message_record_get_sender_handle (record));
+		if (g_hash_table_lookup (priv->requested_senders,
+					 handle) == NULL) {
+			/* Do not block the message queue, just drop this
+			 * message */
+			DEBUG ("Dropping message from unknown sender %u",
+				GPOINTER_TO_UINT (handle));
+			g_queue_delete_link (priv->messages_queue, l);
+			empathy_message_record_unref (record);
+		}
+	}
 }
 
 static void
-tp_chat_got_sender_cb (EmpathyTpContactFactory *factory,
-		       EmpathyContact          *contact,
-		       const GError            *error,
-		       gpointer                 message,
-		       GObject                 *chat)
+tp_chat_got_senders_cb (EmpathyTpContactFactory *factory,
+			guint                    n_contacts,
+			EmpathyContact * const * contacts,
+			guint                    n_failed,
+			const TpHandle          *failed,
+			const GError            *error,
+			gpointer                 user_data,
+			GObject                 *chat)
 {
 	EmpathyTpChatPriv *priv = GET_PRIV (chat);
+	GArray            *handles = user_data;
+	guint              i;
 
 	if (error) {
 		DEBUG ("Error: %s", error->message);
-		/* Do not block the message queue, just drop this message */
-		g_queue_remove (priv->messages_queue, message);
-	} else {
-		empathy_message_set_sender (message, contact);
 	}
 
+	for (i = 0; i < n_contacts; i++) {
+		g_hash_table_insert (priv->senders,
+			GUINT_TO_POINTER (empathy_contact_get_handle (contacts[i])),
+			g_object_ref (contacts[i]));
+	}
+
+	for (i = 0; i < handles->len; i++) {
+		g_hash_table_remove (priv->requested_senders,
+			GUINT_TO_POINTER (g_array_index (handles, TpHandle, i)));
+	}
+
+	tp_chat_resolve_senders (EMPATHY_TP_CHAT (chat));
 	tp_chat_emit_queued_messages (EMPATHY_TP_CHAT (chat));
 }
 
+static void
+tp_chat_handles_free (gpointer handles)
+{
+	g_array_free (handles, TRUE);
+}
+
+/* Resolves all the senders of queued messages which are not already
+ * being requested, with a single request. */
+static void
+tp_chat_request_senders (EmpathyTpChat *chat)
+{
+	EmpathyTpChatPriv *priv = GET_PRIV (chat);
+	GList             *l;
+	GArray            *handles;
+
+	handles = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+
+	for (l = priv->messages_queue->head; l; l = l->next) {
+		EmpathyMessageRecord *record = l->data;
+		TpHandle              h;
+		gpointer              handle;
+
+		if (tp_chat_lookup_sender (chat, record) != NULL) {
+			continue;
+		}
+
+		h = empathy_message_record_get_sender_handle (record);
+		handle = GUINT_TO_POINTER (h);
+		if (g_hash_table_lookup (priv->requested_senders, handle)) {
+			continue;
+		}
+
+		g_hash_table_insert (priv->requested_senders, handle,
+				     GUINT_TO_POINTER (TRUE));
+		g_array_append_val (handles, h);
+	}
+
+	if (handles->len == 0) {
+		g_array_free (handles, TRUE);
+		return;
+	}
+
+	DEBUG ("Requesting %u senders", handles->len);
+	empathy_tp_contact_factory_get_from_handles (priv->factory,
+		handles->len, (TpHandle *) handles->data,
+		tp_chat_got_senders_cb,
+		handles, tp_chat_handles_free,
+		G_OBJECT (chat));
+}
+
 static void
 tp_chat_build_message (EmpathyTpChat *chat,
 		       guint          id,
@@ -232,26 +389,29 @@ tp_chat_build_message (EmpathyTpChat *chat,
 		       guint          from_handle,
 		       const gchar   *message_body)
 {
-	EmpathyTpChatPriv *priv;
-	EmpathyMessage    *message;
+	EmpathyTpChatPriv    *priv;
+	EmpathyMessageRecord *record;
+	gboolean              known_sender;
 
 	priv = GET_PRIV (chat);
 
-	message = empathy_message_new (message_body);
-	empathy_message_set_tptype (message, type);
-	empathy_message_set_receiver (message, priv->user);
-	empathy_message_set_timestamp (message, timestamp);
-	empathy_message_set_id (message, id);
-	g_queue_push_tail (priv->messages_queue, message);
+	record = empathy_message_record_new (type, timestamp, message_body);
+	empathy_message_record_set_id (record, id);
+	empathy_message_record_set_sender_handle (record, from_handle);
+	g_queue_push_tail (priv->messages_queue, record);
 
-	if (from_handle == 0) {
-		empathy_message_set_sender (message, priv->user);
-		tp_chat_emit_queued_messages (chat);
+	known_sender = tp_chat_lookup_sender (chat, record) != NULL;
+
+	/* While listing pending messages, senders are requested all at once
+	 * and messages emitted when they are all known. */
+	if (priv->listing_pending_messages) {
+		return;
+	}
+
+	if (!known_sender) {
+		tp_chat_request_senders (chat);
 	} else {
-		empathy_tp_contact_factory_get_from_handle (priv->factory,
-			from_handle,
-			tp_chat_got_sender_cb,
-			message, NULL, G_OBJECT (chat));
+		tp_chat_emit_queued_messages (chat);
 	}
 }
 
@@ -398,6 +558,14 @@ tp_chat_state_changed_cb (TpChannel *channel,
 			  GObject   *chat)
 {
 	EmpathyTpChatPriv *priv = GET_PRIV (chat);
+	EmpathyContact    *contact;
+
+	contact = g_hash_table_lookup (priv->senders, GUINT_TO_POINTER (handle));
+	if (contact != NULL) {
+		tp_chat_state_changed_got_contact_cb (priv->factory, contact,
+			NULL, GUINT_TO_POINTER (state), chat);
+		return;
+	}
 
 	empathy_tp_contact_factory_get_from_handle (priv->factory, handle,
 		tp_chat_state_changed_got_contact_cb, GUINT_TO_POINTER (state),
@@ -416,16 +584,22 @@ tp_chat_list_pending_messages_cb (TpChannel       *channel,
 	guint              i;
 	GArray            *empty_non_text_content_ids = NULL;
 
-	priv->listing_pending_messages = FALSE;
-
-	if (priv->channel == NULL)
+	if (priv->channel == NULL) {
+		priv->listing_pending_messages = FALSE;
 		return;
+	}
 
 	if (error) {
 		DEBUG ("Error listing pending messages: %s", error->message);
+		priv->listing_pending_messages = FALSE;
+		/* Messages sent meanwhile were queued */
+		tp_chat_request_senders (chat);
+		tp_chat_emit_queued_messages (chat);
 		return;
 	}
 
+	/* listing_pending_messages is still set, so the whole backlog is
+	 * queued before resolving its senders in one request */
 	for (i = 0; i < messages_list->len; i++) {
 		GValueArray    *message_struct;
 		const gchar    *message_body;
@@ -466,10 +640,15 @@ tp_chat_list_pending_messages_cb (TpChannel       *channel,
 				       message_body);
 	}
 
+	priv->listing_pending_messages = FALSE;
+
 	if (empty_non_text_content_ids != NULL) {
 		acknowledge_messages (chat, empty_non_text_content_ids);
 		g_array_free (empty_non_text_content_ids, TRUE);
 	}
+
+	tp_chat_request_senders (chat);
+	tp_chat_emit_queued_messages (chat);
 }
 
 static void
@@ -679,6 +858,9 @@ tp_chat_dispose (GObject *object)
 
 	priv->dispose_has_run = TRUE;
 
+	/* Don't lose acknowledgements still waiting for the next flush */
+	tp_chat_flush_acks (self);
+
 	if (priv->channel != NULL) {
 		g_signal_handlers_disconnect_by_func (priv->channel,
 			tp_chat_invalidated_cb, self);
@@ -702,9 +884,20 @@ tp_chat_dispose (GObject *object)
 		g_object_unref (priv->contact_monitor);
 	priv->contact_monitor = NULL;
 
-	g_queue_foreach (priv->messages_queue, (GFunc) g_object_unref, NULL);
+	g_hash_table_remove_all (priv->members);
+	g_queue_foreach (priv->members_queue, (GFunc) g_object_unref, NULL);
+	g_queue_clear (priv->members_queue);
+
+	g_hash_table_remove_all (priv->requested_senders);
+	g_hash_table_remove_all (priv->senders);
+
+	g_queue_foreach (priv->messages_queue,
+		(GFunc) empathy_message_record_unref, NULL);
 	g_queue_clear (priv->messages_queue);
 
+	EMPATHY_STAT_ADD ("tp-chat.pending-messages", EMPATHY_STAT_GAUGE,
+			  - (gint64) g_queue_get_length (priv->pending_messages_queue));
+	g_hash_table_remove_all (priv->pending_messages_links);
 	g_queue_foreach (priv->pending_messages_queue,
 		(GFunc) g_object_unref, NULL);
 	g_queue_clear (priv->pending_messages_queue);
@@ -735,8 +928,14 @@ tp_chat_finalize (GObject *object)
 		g_ptr_array_free (priv->properties, TRUE);
 	}
 
+	g_hash_table_destroy (priv->members);
+	g_queue_free (priv->members_queue);
+	g_hash_table_destroy (priv->senders);
+	g_hash_table_destroy (priv->requested_senders);
 	g_queue_free (priv->messages_queue);
 	g_queue_free (priv->pending_messages_queue);
+	g_hash_table_destroy (priv->pending_messages_links);
+	g_array_free (priv->pending_acks, TRUE);
 
 	G_OBJECT_CLASS (empathy_tp_chat_parent_class)->finalize (object);
 }
@@ -747,7 +946,8 @@ tp_chat_check_if_ready (EmpathyTpChat *chat)
 	EmpathyTpChatPriv *priv = GET_PRIV (chat);
 
 	if (priv->ready || priv->user == NULL ||
-	    (priv->members == NULL && priv->remote_contact == NULL)) {
+	    (g_queue_is_empty (priv->members_queue) &&
+	     priv->remote_contact == NULL)) {
 		return;
 	}
 
@@ -805,7 +1005,7 @@ tp_chat_update_remote_contact (EmpathyTpChat *chat)
 	 * there are more, set the "remote-contact" property to NULL and the
 	 * UI will display a contact list. */
 	self_handle = tp_channel_group_get_self_handle (priv->channel);
-	for (l = priv->members; l; l = l->next) {
+	for (l = priv->members_queue->head; l; l = l->next) {
 		/* Skip self contact if member */
 		if (empathy_contact_get_handle (l->data) == self_handle) {
 			continue;
@@ -836,6 +1036,66 @@ tp_chat_update_remote_contact (EmpathyTpChat *chat)
 	g_object_notify (G_OBJECT (chat), "remote-contact");
 }
 
+static gboolean
+tp_chat_add_member (EmpathyTpChat  *chat,
+		    EmpathyContact *contact)
+{
+	EmpathyTpChatPriv *priv = GET_PRIV (chat);
+	gpointer           handle;
+
+	handle = GUINT_TO_POINTER (empathy_contact_get_handle (contact));
+	if (g_hash_table_lookup (priv->members, handle) != NULL) {
+		return FALSE;
+	}
+
+	g_queue_push_tail (priv->members_queue, g_object_ref (contact));
+	g_hash_table_insert (priv->members, handle, priv->members_queue->tail);
+
+	/* Members are the most likely senders */
+	g_hash_table_insert (priv->senders, handle, g_object_ref (contact));
+
+	return TRUE;
+}
+
+/* Drops a contact who left from the known senders, unless queued messages
+ * are still waiting for it */
+static void
+tp_chat_forget_sender (EmpathyTpChat *chat,
+		       TpHandle       handle)
+{
+	EmpathyTpChatPriv *priv = GET_PRIV (chat);
+	GList             *l;
+
+	for (l = priv->messages_queue->head; l; l = l->next) {
+		if (empathy_message_record_get_sender_handle (l->data) == handle) {
+			return;
+		}
+	}
+
+	g_hash_table_remove (priv->senders, GUINT_TO_POINTER (handle));
+}
+
+/* Returns the removed member, the caller owns the reference */
+static EmpathyContact *
+tp_chat_remove_member (EmpathyTpChat *chat,
+		       TpHandle       handle)
+{
+	EmpathyTpChatPriv *priv = GET_PRIV (chat);
+	EmpathyContact    *contact;
+	GList             *link;
+
+	link = g_hash_table_lookup (priv->members, GUINT_TO_POINTER (handle));
+	if (link == NULL) {
+		return NULL;
+	}
+
+	contact = link->data;
+	g_hash_table_remove (priv->members, GUINT_TO_POINTER (handle));
+	g_queue_delete_link (priv->members_queue, link);
+
+	return contact;
+}
+
 static void
 tp_chat_got_added_contacts_cb (EmpathyTpContactFactory *factory,
 			       guint                    n_contacts,
@@ -851,26 +1111,36 @@ tp_chat_got_added_contacts_cb (EmpathyTpContactFactory *factory,
 	const TpIntSet *members;
 	TpHandle handle;
 	EmpathyContact *contact;
+	GPtrArray *added, *removed;
 
 	if (error) {
 		DEBUG ("Error: %s", error->message);
 		return;
 	}
 
+	added = g_ptr_array_sized_new (n_contacts);
 	members = tp_channel_group_get_members (priv->channel);
 	for (i = 0; i < n_contacts; i++) {
 		contact = contacts[i];
 		handle = empathy_contact_get_handle (contact);
 
 		/* Make sure the contact is still member */
-		if (tp_intset_is_member (members, handle)) {
-			priv->members = g_list_prepend (priv->members,
-				g_object_ref (contact));
+		if (tp_intset_is_member (members, handle) &&
+		    tp_chat_add_member (EMPATHY_TP_CHAT (chat), contact)) {
+			g_ptr_array_add (added, contact);
 			g_signal_emit_by_name (chat, "members-changed",
 					       contact, NULL, 0, NULL, TRUE);
 		}
 	}
 
+	if (added->len > 0) {
+		removed = g_ptr_array_new ();
+		g_signal_emit (chat, signals[MEMBERS_CHANGED_BATCH], 0,
+			       added, removed, 0, NULL);
+		g_ptr_array_free (removed, TRUE);
+	}
+	g_ptr_array_free (added, TRUE);
+
 	tp_chat_update_remote_contact (EMPATHY_TP_CHAT (chat));
 	tp_chat_check_if_ready (EMPATHY_TP_CHAT (chat));
 }
@@ -888,25 +1158,37 @@ tp_chat_group_members_changed_cb (TpChannel     *self,
 {
 	EmpathyTpChatPriv *priv = GET_PRIV (chat);
 	EmpathyContact *contact;
-	TpHandle handle;
+	GPtrArray *removed_contacts;
 	guint i;
-	GList *l;
 
 	/* Remove contacts that are not members anymore */
+	removed_contacts = g_ptr_array_sized_new (removed->len);
 	for (i = 0; i < removed->len; i++) {
-		for (l = priv->members; l; l = l->next) {
-			contact = l->data;
-			handle = empathy_contact_get_handle (contact);
-			if (handle == g_array_index (removed, TpHandle, i)) {
-				priv->members = g_list_delete_link (priv->members, l);
-				g_signal_emit_by_name (chat, "members-changed",
-						       contact, NULL, reason,
-						       message, FALSE);
-				g_object_unref (contact);
-				break;
-			}
+		TpHandle handle = g_array_index (removed, TpHandle, i);
+
+		tp_chat_forget_sender (chat, handle);
+		contact = tp_chat_remove_member (chat, handle);
+		if (contact == NULL) {
+			continue;
 		}
+
+		g_ptr_array_add (removed_contacts, contact);
+		g_signal_emit_by_name (chat, "members-changed",
+				       contact, NULL, reason,
+				       message, FALSE);
+	}
+
+	if (removed_contacts->len > 0) {
+		GPtrArray *added_contacts;
+
+		added_contacts = g_ptr_array_new ();
+		g_signal_emit (chat, signals[MEMBERS_CHANGED_BATCH], 0,
+			       added_contacts, removed_contacts, reason,
+			       message);
+		g_ptr_array_free (added_contacts, TRUE);
 	}
+	g_ptr_array_foreach (removed_contacts, (GFunc) g_object_unref, NULL);
+	g_ptr_array_free (removed_contacts, TRUE);
 
 	/* Request added contacts */
 	if (added->len > 0) {
@@ -1162,6 +1444,35 @@ empathy_tp_chat_class_init (EmpathyTpChatClass *klass)
 			      G_TYPE_NONE,
 			      0);
 
+	/* Emitted once per membership change of the channel, after the
+	 * members-changed signals of each contact. Arguments are a GPtrArray
+	 * of the added EmpathyContact, a GPtrArray of the removed ones (both
+	 * can be empty but are never NULL), the reason and the message. */
+	signals[MEMBERS_CHANGED_BATCH] =
+		g_signal_new ("members-changed-batch",
+			      G_TYPE_FROM_CLASS (klass),
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL,
+			      _empathy_marshal_VOID__POINTER_POINTER_UINT_STRING,
+			      G_TYPE_NONE,
+			      4, G_TYPE_POINTER, G_TYPE_POINTER,
+			      G_TYPE_UINT, G_TYPE_STRING);
+
+	/* Emitted once per batch of messages becoming ready, the backlog of
+	 * pending messages or messages whose senders were resolved together,
+	 * after the message-received signals of each message. The argument
+	 * is a GPtrArray of the EmpathyMessage. */
+	signals[MESSAGES_RECEIVED_BATCH] =
+		g_signal_new ("messages-received-batch",
+			      G_TYPE_FROM_CLASS (klass),
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__POINTER,
+			      G_TYPE_NONE,
+			      1, G_TYPE_POINTER);
+
 	g_type_class_add_private (object_class, sizeof (EmpathyTpChatPriv));
 }
 
@@ -1173,8 +1484,17 @@ empathy_tp_chat_init (EmpathyTpChat *chat)
 
 	chat->priv = priv;
 	priv->contact_monitor = NULL;
+	priv->members = g_hash_table_new (g_direct_hash, g_direct_equal);
+	priv->members_queue = g_queue_new ();
 	priv->messages_queue = g_queue_new ();
+	priv->senders = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					       NULL, g_object_unref);
+	priv->requested_senders = g_hash_table_new (g_direct_hash,
+						    g_direct_equal);
 	priv->pending_messages_queue = g_queue_new ();
+	priv->pending_messages_links = g_hash_table_new (g_direct_hash,
+							 g_direct_equal);
+	priv->pending_acks = g_array_new (FALSE, FALSE, sizeof (guint));
 }
 
 static void
@@ -1311,39 +1631,87 @@ empathy_tp_chat_get_pending_messages (EmpathyTpChat *chat)
 }
 
 static void
-acknowledge_messages (EmpathyTpChat *chat, GArray *ids) {
+tp_chat_flush_acks (EmpathyTpChat *chat)
+{
 	EmpathyTpChatPriv *priv = GET_PRIV (chat);
 
+	if (priv->flush_acks_id != 0) {
+		g_source_remove (priv->flush_acks_id);
+		priv->flush_acks_id = 0;
+	}
+
+	if (priv->pending_acks->len == 0 || priv->channel == NULL) {
+		return;
+	}
+
+	DEBUG ("Acknowledging %u messages", priv->pending_acks->len);
 	tp_cli_channel_type_text_call_acknowledge_pending_messages (
-		priv->channel, -1, ids, tp_chat_async_cb,
+		priv->channel, -1, priv->pending_acks, tp_chat_async_cb,
 		"acknowledging received message", NULL, G_OBJECT (chat));
+	g_array_set_size (priv->pending_acks, 0);
+}
+
+static gboolean
+tp_chat_flush_acks_cb (gpointer chat)
+{
+	EmpathyTpChatPriv *priv = GET_PRIV (chat);
+
+	priv->flush_acks_id = 0;
+	tp_chat_flush_acks (chat);
+
+	return FALSE;
+}
+
+static void
+tp_chat_queue_acks (EmpathyTpChat *chat,
+		    const guint   *ids,
+		    guint          n_ids)
+{
+	EmpathyTpChatPriv *priv = GET_PRIV (chat);
+
+	g_array_append_vals (priv->pending_acks, ids, n_ids);
+
+	if (priv->pending_acks->len >= MAX_PENDING_ACKS) {
+		tp_chat_flush_acks (chat);
+	} else if (priv->flush_acks_id == 0) {
+		priv->flush_acks_id = g_idle_add (tp_chat_flush_acks_cb, chat);
+	}
+}
+
+static void
+acknowledge_messages (EmpathyTpChat *chat, GArray *ids) {
+	tp_chat_queue_acks (chat, (const guint *) ids->data, ids->len);
+}
+
+static void
+tp_chat_remove_pending_message (EmpathyTpChat  *chat,
+				EmpathyMessage *message)
+{
+	EmpathyTpChatPriv *priv = GET_PRIV (chat);
+	GList *m;
+
+	m = g_hash_table_lookup (priv->pending_messages_links, message);
+	g_assert (m != NULL);
+	g_hash_table_remove (priv->pending_messages_links, message);
+	g_queue_delete_link (priv->pending_messages_queue, m);
+	EMPATHY_STAT_ADD ("tp-chat.pending-messages", EMPATHY_STAT_GAUGE, -1);
 }
 
 void
 empathy_tp_chat_acknowledge_message (EmpathyTpChat *chat,
 				     EmpathyMessage *message) {
 	EmpathyTpChatPriv *priv = GET_PRIV (chat);
-	GArray *message_ids;
-	GList *m;
 	guint id;
 
 	g_return_if_fail (EMPATHY_IS_TP_CHAT (chat));
 	g_return_if_fail (priv->ready);
 
-	if (empathy_message_get_sender (message) == priv->user)
-		goto out;
-
-	message_ids = g_array_sized_new (FALSE, FALSE, sizeof (guint), 1);
-
-	id = empathy_message_get_id (message);
-	g_array_append_val (message_ids, id);
-	acknowledge_messages (chat, message_ids);
-	g_array_free (message_ids, TRUE);
+	if (empathy_message_get_sender (message) != priv->user) {
+		id = empathy_message_get_id (message);
+		tp_chat_queue_acks (chat, &id, 1);
+	}
 
-out:
-	m = g_queue_find (priv->pending_messages_queue, message);
-	g_assert (m != NULL);
-	g_queue_delete_link (priv->pending_messages_queue, m);
+	tp_chat_remove_pending_message (chat, message);
 	g_object_unref (message);
 }
 
@@ -1368,13 +1736,9 @@ empathy_tp_chat_acknowledge_messages (EmpathyTpChat *chat,
 	message_ids = g_array_sized_new (FALSE, FALSE, sizeof (guint), length);
 
 	for (l = msgs; l != NULL; l = g_list_next (l)) {
-		GList *m;
-
 		EmpathyMessage *message = EMPATHY_MESSAGE (l->data);
 
-		m = g_queue_find (priv->pending_messages_queue, message);
-		g_assert (m != NULL);
-		g_queue_delete_link (priv->pending_messages_queue, m);
+		tp_chat_remove_pending_message (chat, message);
 
 		if (empathy_message_get_sender (message) != priv->user) {
 			guint id = empathy_message_get_id (message);
@@ -1389,4 +1753,3 @@ empathy_tp_chat_acknowledge_messages (EmpathyTpChat *chat,
 	g_array_free (message_ids, TRUE);
 	g_list_free (msgs);
 }
-
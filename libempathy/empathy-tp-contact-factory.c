@@ -35,6 +35,7 @@
 #include "empathy-tp-contact-factory.h"
 #include "empathy-utils.h"
 #include "empathy-location.h"
+#include "empathy-stats.h"
 
 #define DEBUG_FLAG EMPATHY_DEBUG_TP | EMPATHY_DEBUG_CONTACT
 #include "empathy-debug.h"
@@ -113,6 +114,7 @@ tp_contact_factory_weak_notify (gpointer data,
 	DEBUG ("Remove finalized contact %p", where_the_object_was);
 
 	priv->contacts = g_list_remove (priv->contacts, where_the_object_was);
+	EMPATHY_STAT_ADD ("contact-factory.contacts", EMPATHY_STAT_GAUGE, -1);
 }
 
 static void
@@ -227,10 +229,14 @@ tp_contact_factory_avatar_maybe_update (EmpathyTpContactFactory *tp_factory,
 	/* The avatar changed, search the new one in the cache */
 	if (empathy_contact_load_avatar_cache (contact, token)) {
 		/* Got from cache, use it */
+		EMPATHY_STAT_ADD ("contact-factory.avatar-cache-hits",
+				  EMPATHY_STAT_COUNTER, 1);
 		return TRUE;
 	}
 
 	/* Avatar is not up-to-date, we have to request it. */
+	EMPATHY_STAT_ADD ("contact-factory.avatar-cache-misses",
+			  EMPATHY_STAT_COUNTER, 1);
 	return FALSE;
 }
 
@@ -712,6 +718,7 @@ tp_contact_factory_add_contact (EmpathyTpContactFactory *tp_factory,
 			   tp_contact_factory_weak_notify,
 			   tp_factory);
 	priv->contacts = g_list_prepend (priv->contacts, contact);
+	EMPATHY_STAT_ADD ("contact-factory.contacts", EMPATHY_STAT_GAUGE, 1);
 
 	/* The contact keeps a ref to its factory */
 	g_object_set_data_full (G_OBJECT (contact), "empathy-factory",
@@ -1238,6 +1245,8 @@ tp_contact_factory_finalize (GObject *object)
 				     object);
 	}
 
+	EMPATHY_STAT_ADD ("contact-factory.contacts", EMPATHY_STAT_GAUGE,
+			  - (gint64) g_list_length (priv->contacts));
 	g_list_free (priv->contacts);
 
 	g_object_unref (priv->connection);
@@ -22,13 +22,17 @@
 
 #include <config.h>
 
+#include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/un.h>
 
 #include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
 
 #include <gio/gio.h>
 #include <gio/gunixinputstream.h>
@@ -38,8 +42,11 @@
 #include <telepathy-glib/util.h>
 
 #include "empathy-tp-file.h"
+#include "empathy-file-copy.h"
+#include "empathy-file-resume.h"
 #include "empathy-tp-contact-factory.h"
 #include "empathy-marshal.h"
+#include "empathy-stats.h"
 #include "empathy-time.h"
 #include "empathy-utils.h"
 
@@ -71,215 +78,24 @@
  * the transferred file is unknown.
  */
 
-/* Functions to copy the content of a GInputStream to a GOutputStream */
+/**
+ * EmpathyTpFileStateChangeReason:
+ * @EMPATHY_TP_FILE_STATE_CHANGE_REASON_HASH_MISMATCH: the received data
+ * doesn't match the hash provided by the sender
+ *
+ * Reasons of state changes of an #EmpathyTpFile that come from Empathy
+ * itself rather than from the connection manager. They are given as
+ * #TpFileTransferStateChangeReason by empathy_tp_file_get_state().
+ */
 
-#define N_BUFFERS 2
-#define BUFFER_SIZE 4096
 #define STALLED_TIMEOUT 5
-
-typedef struct {
-  GInputStream *in;
-  GOutputStream *out;
-  GCancellable  *cancellable;
-  char *buff[N_BUFFERS]; /* the temporary buffers */
-  gsize count[N_BUFFERS]; /* how many bytes are used in the buffers */
-  gboolean is_full[N_BUFFERS]; /* whether the buffers contain data */
-  gint curr_read; /* index of the buffer used for reading */
-  gint curr_write; /* index of the buffer used for writing */
-  gboolean is_reading; /* we are reading */
-  gboolean is_writing; /* we are writing */
-  guint n_closed; /* number of streams that have been closed */
-  gint ref_count;
-} CopyData;
-
-static void schedule_next (CopyData *copy);
-
-static void
-copy_data_unref (CopyData *copy)
-{
-  if (--copy->ref_count == 0)
-    {
-      gint i;
-
-      /* Free the data only if both the input and output streams have
-       * been closed. */
-      copy->n_closed++;
-      if (copy->n_closed < 2)
-        return;
-
-      if (copy->in != NULL)
-        g_object_unref (copy->in);
-
-      if (copy->out != NULL)
-        g_object_unref (copy->out);
-
-      for (i = 0; i < N_BUFFERS; i++)
-        g_free (copy->buff[i]);
-
-      g_object_unref (copy->cancellable);
-      g_free (copy);
-    }
-}
-
-static void
-io_error (CopyData *copy,
-          GError *error)
-{
-  g_cancellable_cancel (copy->cancellable);
-
-  if (error == NULL)
-    g_warning ("I/O error");
-  else if (error->domain == G_IO_ERROR && error->code == G_IO_ERROR_CANCELLED)
-    ; /* Ignore cancellations */
-  else
-    g_warning ("I/O error: %d: %s\n", error->code, error->message);
-
-  if (copy->in != NULL)
-    g_input_stream_close (copy->in, NULL, NULL);
-
-  if (copy->out != NULL)
-    g_output_stream_close (copy->out, NULL, NULL);
-
-  copy_data_unref (copy);
-}
-
-static void
-close_done (GObject *source_object,
-            GAsyncResult *res,
-            gpointer user_data)
-{
-  CopyData *copy = user_data;
-
-  g_object_unref (source_object);
-  copy_data_unref (copy);
-}
-
-static void
-write_done_cb (GObject *source_object,
-               GAsyncResult *res,
-               gpointer user_data)
-{
-  CopyData *copy = user_data;
-  gssize count_write;
-  GError *error = NULL;
-
-  count_write = g_output_stream_write_finish (copy->out, res, &error);
-
-  if (count_write <= 0)
-    {
-      io_error (copy, error);
-      g_error_free (error);
-      return;
-    }
-
-  copy->is_full[copy->curr_write] = FALSE;
-  copy->curr_write = (copy->curr_write + 1) % N_BUFFERS;
-  copy->is_writing = FALSE;
-
-  schedule_next (copy);
-}
-
-static void
-read_done_cb (GObject *source_object,
-              GAsyncResult *res,
-              gpointer user_data)
-{
-  CopyData *copy = user_data;
-  gssize count_read;
-  GError *error = NULL;
-
-  count_read = g_input_stream_read_finish (copy->in, res, &error);
-
-  if (count_read == 0)
-    {
-      g_input_stream_close_async (copy->in, 0, copy->cancellable,
-          close_done, copy);
-      copy->in = NULL;
-    }
-  else if (count_read < 0)
-    {
-      io_error (copy, error);
-      g_error_free (error);
-      return;
-    }
-
-  copy->count[copy->curr_read] = count_read;
-  copy->is_full[copy->curr_read] = TRUE;
-  copy->curr_read = (copy->curr_read + 1) % N_BUFFERS;
-  copy->is_reading = FALSE;
-
-  schedule_next (copy);
-}
-
-static void
-schedule_next (CopyData *copy)
-{
-  if (copy->in != NULL &&
-      !copy->is_reading &&
-      !copy->is_full[copy->curr_read])
-    {
-      /* We are not reading and the current buffer is empty, so
-       * start an async read. */
-      copy->is_reading = TRUE;
-      g_input_stream_read_async (copy->in,
-          copy->buff[copy->curr_read],
-          BUFFER_SIZE, 0, copy->cancellable,
-          read_done_cb, copy);
-    }
-
-  if (!copy->is_writing &&
-      copy->is_full[copy->curr_write])
-    {
-      if (copy->count[copy->curr_write] == 0)
-        {
-          /* The last read on the buffer read 0 bytes, this
-           * means that we got an EOF, so we can close
-           * the output channel. */
-          g_output_stream_close_async (copy->out, 0,
-              copy->cancellable,
-              close_done, copy);
-      copy->out = NULL;
-        }
-      else
-        {
-          /* We are not writing and the current buffer contains
-           * data, so start an async write. */
-          copy->is_writing = TRUE;
-          g_output_stream_write_async (copy->out,
-              copy->buff[copy->curr_write],
-              copy->count[copy->curr_write],
-              0, copy->cancellable,
-              write_done_cb, copy);
-        }
-    }
-}
-
-static void
-copy_stream (GInputStream *in,
-             GOutputStream *out,
-             GCancellable *cancellable)
-{
-  CopyData *copy;
-  gint i;
-
-  g_return_if_fail (in != NULL);
-  g_return_if_fail (out != NULL);
-
-  copy = g_new0 (CopyData, 1);
-  copy->in = g_object_ref (in);
-  copy->out = g_object_ref (out);
-  copy->ref_count = 1;
-
-  if (cancellable != NULL)
-    copy->cancellable = g_object_ref (cancellable);
-  else
-    copy->cancellable = g_cancellable_new ();
-
-  for (i = 0; i < N_BUFFERS; i++)
-    copy->buff[i] = g_malloc (BUFFER_SIZE);
-
-  schedule_next (copy);
-}
+/* Time constant of the transfer rate average, in seconds: a rate that lasted
+ * that long weights half of the estimation */
+#define RATE_TIME_CONSTANT 2.0
+#define DEFAULT_REFRESH_RATE 4
+#define DEFAULT_COPY_RING_DEPTH 8
+#define DEFAULT_COPY_BUFFER_SIZE (256 * 1024)
+#define HASH_BUFFER_SIZE (64 * 1024)
 
 /* EmpathyTpFile object */
 
@@ -292,6 +108,27 @@ struct _EmpathyTpFilePriv {
   EmpathyContact *contact;
   GInputStream *in_stream;
   GOutputStream *out_stream;
+  /* fd behind in_stream or out_stream if it is a local file, or -1 */
+  gint file_fd;
+  EmpathyFileCopy *copy;
+  guint copy_ring_depth;
+  guint copy_buffer_size;
+  EmpathyFileCopyStats copy_stats;
+  /* The transfer failed on our side, whatever the CM says */
+  gboolean local_failure;
+  /* Destination of incoming transfers */
+  GFile *gfile;
+  /* Where new incoming files are written until they are complete */
+  gchar *tmp_path;
+  /* gfile is written in place, so an interruption can be resumed */
+  gboolean resumable;
+  /* Where the CM starts the transfer in the file */
+  guint64 initial_offset;
+  gboolean initial_offset_known;
+  /* Data doesn't flow until the transfer is released */
+  gboolean held;
+  gboolean start_pending;
+  guint rate_limit;
 
   /* org.freedesktop.Telepathy.Channel.Type.FileTransfer D-Bus properties */
   TpFileTransferState state;
@@ -305,11 +142,14 @@ struct _EmpathyTpFilePriv {
 
   gboolean incoming;
   TpFileTransferStateChangeReason state_change_reason;
-  time_t last_update_time;
+  gdouble last_update_time;
   guint64 last_update_transferred_bytes;
   gdouble speed;
   gint remaining_time;
   guint stalled_id;
+  guint refresh_rate;
+  gdouble last_refresh_time;
+  guint refresh_id;
   GValue *socket_address;
   GCancellable *cancellable;
 };
@@ -326,11 +166,20 @@ enum {
   PROP_TRANSFERRED_BYTES,
   PROP_CONTENT_HASH_TYPE,
   PROP_CONTENT_HASH,
+  PROP_COPY_RING_DEPTH,
+  PROP_COPY_BUFFER_SIZE,
+  PROP_COPY_RATE,
+  PROP_COPY_STALLS,
+  PROP_COPY_OCCUPANCY,
+  PROP_REFRESH_RATE,
+  PROP_HELD,
+  PROP_RATE_LIMIT,
 };
 
 enum {
-	REFRESH,
-	LAST_SIGNAL
+  REFRESH,
+  CONTENT_HASH_CHECKED,
+  LAST_SIGNAL
 };
 
 static guint signals[LAST_SIGNAL];
@@ -346,6 +195,40 @@ empathy_tp_file_init (EmpathyTpFile *tp_file)
       EMPATHY_TYPE_TP_FILE, EmpathyTpFilePriv);
 
   tp_file->priv = priv;
+  priv->file_fd = -1;
+  priv->cancellable = g_cancellable_new ();
+}
+
+/* Remembers what was received of an interrupted incoming transfer, so that
+ * a new offer of the same file can be resumed */
+static void
+tp_file_update_resume_state (EmpathyTpFile *tp_file)
+{
+  GError *error = NULL;
+
+  if (!tp_file->priv->incoming || tp_file->priv->gfile == NULL)
+    return;
+
+  if (tp_file->priv->state == TP_FILE_TRANSFER_STATE_CANCELLED &&
+      !tp_file->priv->local_failure)
+    {
+      /* What was received of a new file is thrown away with it */
+      if (!tp_file->priv->resumable)
+        return;
+
+
+      if (!empathy_file_resume_save (tp_file->priv->gfile,
+          tp_file->priv->size, tp_file->priv->content_hash, &error))
+        {
+          DEBUG ("Can't save resume state: %s", error->message);
+          g_error_free (error);
+        }
+    }
+  else if (tp_file->priv->state == TP_FILE_TRANSFER_STATE_CANCELLED ||
+      tp_file->priv->state == TP_FILE_TRANSFER_STATE_COMPLETED)
+    {
+      empathy_file_resume_clear (tp_file->priv->gfile);
+    }
 }
 
 static void
@@ -364,6 +247,7 @@ tp_file_invalidated_cb (TpProxy       *proxy,
       tp_file->priv->state = TP_FILE_TRANSFER_STATE_CANCELLED;
       tp_file->priv->state_change_reason =
           TP_FILE_TRANSFER_STATE_CHANGE_REASON_LOCAL_ERROR;
+      tp_file_update_resume_state (tp_file);
       g_object_notify (G_OBJECT (tp_file), "state");
     }
 }
@@ -397,35 +281,524 @@ tp_file_finalize (GObject *object)
   g_free (tp_file->priv->content_hash);
   g_free (tp_file->priv->content_type);
 
-  if (tp_file->priv->in_stream)
-    g_object_unref (tp_file->priv->in_stream);
+  if (tp_file->priv->copy != NULL)
+    {
+      /* Stops the copy thread, which could outlive us otherwise */
+      g_cancellable_cancel (tp_file->priv->cancellable);
+      empathy_file_copy_set_callbacks (tp_file->priv->copy, NULL, NULL, NULL);
+      empathy_file_copy_unref (tp_file->priv->copy);
+    }
+
+  if (tp_file->priv->tmp_path != NULL)
+    {
+      g_unlink (tp_file->priv->tmp_path);
+      g_free (tp_file->priv->tmp_path);
+    }
+
+  if (tp_file->priv->in_stream)
+    g_object_unref (tp_file->priv->in_stream);
+
+  if (tp_file->priv->gfile)
+    g_object_unref (tp_file->priv->gfile);
+
+  if (tp_file->priv->out_stream)
+    g_object_unref (tp_file->priv->out_stream);
+
+  if (tp_file->priv->contact)
+    g_object_unref (tp_file->priv->contact);
+
+  if (tp_file->priv->cancellable)
+    g_object_unref (tp_file->priv->cancellable);
+
+  if (tp_file->priv->stalled_id != 0)
+    g_source_remove (tp_file->priv->stalled_id);
+
+  if (tp_file->priv->refresh_id != 0)
+    g_source_remove (tp_file->priv->refresh_id);
+
+  G_OBJECT_CLASS (empathy_tp_file_parent_class)->finalize (object);
+}
+
+static void
+tp_file_refresh (EmpathyTpFile *tp_file)
+{
+  if (tp_file->priv->refresh_id != 0)
+    {
+      g_source_remove (tp_file->priv->refresh_id);
+      tp_file->priv->refresh_id = 0;
+    }
+
+  tp_file->priv->last_refresh_time = empathy_time_get_monotonic ();
+
+  g_object_notify (G_OBJECT (tp_file), "transferred-bytes");
+  g_signal_emit (tp_file, signals[REFRESH], 0);
+}
+
+static gboolean
+tp_file_refresh_timeout_cb (gpointer user_data)
+{
+  EmpathyTpFile *tp_file = user_data;
+
+  tp_file->priv->refresh_id = 0;
+  tp_file_refresh (tp_file);
+
+  return FALSE;
+}
+
+/* Progress updates can come in much faster than anyone can read them, they
+ * are passed on at most refresh-rate times per second. The last one is
+ * never lost, it's only delayed. */
+static void
+tp_file_queue_refresh (EmpathyTpFile *tp_file)
+{
+  gdouble interval, elapsed;
+
+  if (tp_file->priv->refresh_id != 0)
+    return;
+
+  interval = 1.0 / tp_file->priv->refresh_rate;
+  elapsed = empathy_time_get_monotonic () - tp_file->priv->last_refresh_time;
+  if (elapsed >= interval)
+    {
+      tp_file_refresh (tp_file);
+      return;
+    }
+
+  tp_file->priv->refresh_id = g_timeout_add ((interval - elapsed) * 1000,
+      tp_file_refresh_timeout_cb, tp_file);
+}
+
+/* Pending progress must not be reported after the final state */
+static void
+tp_file_flush_refresh (EmpathyTpFile *tp_file)
+{
+  if (tp_file->priv->refresh_id != 0)
+    tp_file_refresh (tp_file);
+}
+
+static gboolean
+tp_file_stalled_cb (EmpathyTpFile *tp_file)
+{
+  /* We didn't get transferred bytes update for a while, the transfer is
+   * stalled. */
+
+  tp_file->priv->stalled_id = 0;
+  tp_file->priv->speed = 0;
+  tp_file->priv->remaining_time = -1;
+  tp_file_refresh (tp_file);
+
+  return FALSE;
+}
+
+static void
+tp_file_copy_progress_cb (EmpathyFileCopy *copy,
+                          guint64 copied,
+                          gpointer user_data)
+{
+  EmpathyTpFile *tp_file = user_data;
+
+  /* Data is flowing through the socket, the transfer isn't stalled even if
+   * the connection manager didn't report it yet. */
+  if (tp_file->priv->stalled_id != 0)
+    g_source_remove (tp_file->priv->stalled_id);
+  tp_file->priv->stalled_id = g_timeout_add_seconds (STALLED_TIMEOUT,
+    (GSourceFunc) tp_file_stalled_cb, tp_file);
+
+  empathy_file_copy_get_stats (copy, &tp_file->priv->copy_stats);
+
+  g_object_freeze_notify (G_OBJECT (tp_file));
+  g_object_notify (G_OBJECT (tp_file), "copy-rate");
+  g_object_notify (G_OBJECT (tp_file), "copy-stalls");
+  g_object_notify (G_OBJECT (tp_file), "copy-occupancy");
+  g_object_thaw_notify (G_OBJECT (tp_file));
+}
+
+static gboolean
+tp_file_get_checksum_type (TpFileHashType hash_type,
+                           GChecksumType *checksum_type)
+{
+  GChecksumType type;
+
+  switch (hash_type)
+    {
+      case TP_FILE_HASH_TYPE_MD5:
+        type = G_CHECKSUM_MD5;
+        break;
+      case TP_FILE_HASH_TYPE_SHA1:
+        type = G_CHECKSUM_SHA1;
+        break;
+      case TP_FILE_HASH_TYPE_SHA256:
+        type = G_CHECKSUM_SHA256;
+        break;
+      default:
+        return FALSE;
+    }
+
+  if (checksum_type != NULL)
+    *checksum_type = type;
+
+  return TRUE;
+}
+
+/* Puts a new incoming file in place once it was all received, or throws it
+ * away. Returns FALSE if it couldn't be put in place. */
+static gboolean
+tp_file_finish_output (EmpathyTpFile *tp_file,
+                       gboolean keep)
+{
+  gchar *path;
+  gboolean ret = TRUE;
+
+  if (tp_file->priv->tmp_path == NULL)
+    return TRUE;
+
+  if (keep)
+    {
+      path = g_file_get_path (tp_file->priv->gfile);
+      if (g_rename (tp_file->priv->tmp_path, path) < 0)
+        {
+          DEBUG ("Can't rename %s to %s: %s", tp_file->priv->tmp_path, path,
+              g_strerror (errno));
+          ret = FALSE;
+        }
+      g_free (path);
+    }
+
+  if (!keep || !ret)
+    g_unlink (tp_file->priv->tmp_path);
+
+  g_free (tp_file->priv->tmp_path);
+  tp_file->priv->tmp_path = NULL;
+
+  return ret;
+}
+
+static void
+tp_file_fail (EmpathyTpFile *tp_file,
+              TpFileTransferStateChangeReason reason)
+{
+  tp_file->priv->local_failure = TRUE;
+  tp_file->priv->state = TP_FILE_TRANSFER_STATE_CANCELLED;
+  tp_file->priv->state_change_reason = reason;
+  tp_file_update_resume_state (tp_file);
+  g_object_notify (G_OBJECT (tp_file), "state");
+
+  tp_cli_channel_call_close (tp_file->priv->channel, -1, NULL, NULL, NULL,
+      NULL);
+}
+
+static void
+tp_file_check_hash (EmpathyTpFile *tp_file,
+                    const gchar *hash)
+{
+  gboolean valid;
+
+  valid = !g_ascii_strcasecmp (hash, tp_file->priv->content_hash);
+  DEBUG ("Hash of %s is %s, expected %s", tp_file->priv->filename, hash,
+      tp_file->priv->content_hash);
+
+  /* The file is in place when we tell whether it is the right one */
+  if (!tp_file_finish_output (tp_file, valid) && valid)
+    {
+      tp_file_fail (tp_file, TP_FILE_TRANSFER_STATE_CHANGE_REASON_LOCAL_ERROR);
+      return;
+    }
+
+  g_signal_emit (tp_file, signals[CONTENT_HASH_CHECKED], 0, valid);
+
+  /* The CM may still report the transfer as completed, but what we got
+   * isn't what the sender offered. */
+  if (!valid)
+    tp_file_fail (tp_file, (TpFileTransferStateChangeReason)
+        EMPATHY_TP_FILE_STATE_CHANGE_REASON_HASH_MISMATCH);
+}
+
+/* Resumed incoming files are hashed in a thread once the copy is done, as
+ * the copy engine only saw the part of their data received this time. */
+
+typedef struct {
+  GFile *gfile;
+  TpFileHashType hash_type;
+  gchar *hash;
+} HashData;
+
+static void
+hash_data_free (HashData *data)
+{
+  g_object_unref (data->gfile);
+  g_free (data->hash);
+  g_slice_free (HashData, data);
+}
+
+static void
+tp_file_hash_thread (GSimpleAsyncResult *result,
+                     GObject *object,
+                     GCancellable *cancellable)
+{
+  HashData *data;
+  GFileInputStream *stream;
+  GChecksum *checksum;
+  GChecksumType checksum_type;
+  guchar *buffer;
+  gssize n;
+  GError *error = NULL;
+
+  data = g_simple_async_result_get_op_res_gpointer (result);
+
+  stream = g_file_read (data->gfile, cancellable, &error);
+  if (stream == NULL)
+    {
+      g_simple_async_result_set_from_error (result, error);
+      g_error_free (error);
+      return;
+    }
+
+  tp_file_get_checksum_type (data->hash_type, &checksum_type);
+  checksum = g_checksum_new (checksum_type);
+  buffer = g_malloc (HASH_BUFFER_SIZE);
+
+  while ((n = g_input_stream_read (G_INPUT_STREAM (stream), buffer,
+      HASH_BUFFER_SIZE, cancellable, &error)) > 0)
+    g_checksum_update (checksum, buffer, n);
+
+  if (n < 0)
+    {
+      g_simple_async_result_set_from_error (result, error);
+      g_error_free (error);
+    }
+  else
+    {
+      data->hash = g_strdup (g_checksum_get_string (checksum));
+    }
+
+  g_free (buffer);
+  g_checksum_free (checksum);
+  g_input_stream_close (G_INPUT_STREAM (stream), NULL, NULL);
+  g_object_unref (stream);
+}
+
+static gchar *
+tp_file_hash_finish (EmpathyTpFile *tp_file,
+                     GAsyncResult *res)
+{
+  GSimpleAsyncResult *result = G_SIMPLE_ASYNC_RESULT (res);
+  HashData *data;
+  GError *error = NULL;
+
+  if (g_simple_async_result_propagate_error (result, &error))
+    {
+      DEBUG ("Can't hash %s: %s", tp_file->priv->filename, error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  data = g_simple_async_result_get_op_res_gpointer (result);
+  DEBUG ("Hash of %s: %s", tp_file->priv->filename, data->hash);
+
+  return g_strdup (data->hash);
+}
+
+static void
+tp_file_hash_async (EmpathyTpFile *tp_file,
+                    GFile *gfile,
+                    TpFileHashType hash_type,
+                    GAsyncReadyCallback callback)
+{
+  GSimpleAsyncResult *result;
+  HashData *data;
+
+  data = g_slice_new0 (HashData);
+  data->gfile = g_object_ref (gfile);
+  data->hash_type = hash_type;
+
+  result = g_simple_async_result_new (G_OBJECT (tp_file),
+      callback, NULL, tp_file_hash_async);
+  g_simple_async_result_set_op_res_gpointer (result, data,
+      (GDestroyNotify) hash_data_free);
+  g_simple_async_result_run_in_thread (result, tp_file_hash_thread,
+      G_PRIORITY_LOW, tp_file->priv->cancellable);
+  g_object_unref (result);
+}
+
+static void
+tp_file_verify_hash_done_cb (GObject *source_object,
+                             GAsyncResult *res,
+                             gpointer user_data)
+{
+  EmpathyTpFile *tp_file = EMPATHY_TP_FILE (source_object);
+  gchar *hash;
+
+  hash = tp_file_hash_finish (tp_file, res);
+  if (hash != NULL)
+    tp_file_check_hash (tp_file, hash);
+
+  g_free (hash);
+}
+
+static void
+tp_file_copy_done_cb (EmpathyFileCopy *copy,
+                      const GError *error,
+                      gpointer user_data)
+{
+  EmpathyTpFile *tp_file = user_data;
+
+  DEBUG ("Copy of %s done: %s", tp_file->priv->filename,
+      error ? error->message : "no error");
+
+  /* Nothing is flowing anymore */
+  tp_file->priv->copy_stats.rate = 0;
+  tp_file->priv->copy_stats.occupancy = 0;
+  g_object_notify (G_OBJECT (tp_file), "copy-rate");
+
+  EMPATHY_STAT_ADD ("tp-file.bytes-copied", EMPATHY_STAT_COUNTER,
+      empathy_file_copy_get_copied (copy));
+
+  if (error != NULL)
+    {
+      EMPATHY_STAT_ADD ("tp-file.failed-copies", EMPATHY_STAT_COUNTER, 1);
+      tp_file_finish_output (tp_file, FALSE);
+      return;
+    }
+
+  EMPATHY_STAT_ADD ("tp-file.copies", EMPATHY_STAT_COUNTER, 1);
+
+  /* The CM closes the socket when the transfer is cancelled too */
+  if (tp_file->priv->incoming &&
+      tp_file->priv->size != EMPATHY_TP_FILE_UNKNOWN_SIZE &&
+      tp_file->priv->initial_offset + empathy_file_copy_get_copied (copy) <
+          tp_file->priv->size)
+    {
+      DEBUG ("Only got %" G_GUINT64_FORMAT " bytes of %s",
+          empathy_file_copy_get_copied (copy), tp_file->priv->filename);
+      tp_file_finish_output (tp_file, FALSE);
+      return;
+    }
+
+  if (empathy_file_copy_get_checksum (copy) != NULL)
+    {
+      tp_file_check_hash (tp_file, empathy_file_copy_get_checksum (copy));
+      return;
+    }
+
+  if (!tp_file_finish_output (tp_file, TRUE))
+    {
+      tp_file_fail (tp_file, TP_FILE_TRANSFER_STATE_CHANGE_REASON_LOCAL_ERROR);
+      return;
+    }
+
+  if (tp_file->priv->incoming && tp_file->priv->initial_offset > 0 &&
+      !EMP_STR_EMPTY (tp_file->priv->content_hash) &&
+      tp_file_get_checksum_type (tp_file->priv->content_hash_type, NULL))
+    {
+      /* The beginning of the file was received by an earlier transfer */
+      tp_file_hash_async (tp_file, tp_file->priv->gfile,
+          tp_file->priv->content_hash_type, tp_file_verify_hash_done_cb);
+    }
+}
+
+static void
+tp_file_start_copy (EmpathyTpFile *tp_file,
+                    GInputStream *in,
+                    GOutputStream *out,
+                    gint in_fd,
+                    gint out_fd)
+{
+  EmpathyFileCopy *copy;
+  GChecksumType checksum_type;
+
+  copy = empathy_file_copy_new (in, out, tp_file->priv->cancellable);
+
+  /* Received data is hashed on the fly, if the sender told us what to
+   * expect and we receive all of it */
+  if (tp_file->priv->incoming && tp_file->priv->initial_offset == 0 &&
+      !EMP_STR_EMPTY (tp_file->priv->content_hash) &&
+      tp_file_get_checksum_type (tp_file->priv->content_hash_type,
+          &checksum_type))
+    empathy_file_copy_set_checksum (copy, checksum_type);
+
+  if (in_fd >= 0 && out_fd >= 0)
+    empathy_file_copy_set_fds (copy, in_fd, out_fd);
+  empathy_file_copy_set_ring (copy, tp_file->priv->copy_ring_depth,
+      tp_file->priv->copy_buffer_size);
+  empathy_file_copy_set_rate_limit (copy, tp_file->priv->rate_limit);
+  empathy_file_copy_set_callbacks (copy, tp_file_copy_progress_cb,
+      tp_file_copy_done_cb, tp_file);
+  empathy_file_copy_start (copy);
+
+  tp_file->priv->copy = copy;
+}
+
+/* Moves the local file to where the CM starts the transfer: the receiver
+ * may have asked to resume an interrupted transfer, and the CM may not be
+ * able to honour that. */
+static gboolean
+tp_file_seek (EmpathyTpFile *tp_file,
+              guint64 offset,
+              GError **error)
+{
+  gint fd = tp_file->priv->file_fd;
+
+  if (fd >= 0)
+    {
+      /* Drop anything past the offset, it wasn't accounted for */
+      if ((tp_file->priv->incoming && ftruncate (fd, offset) < 0) ||
+          lseek (fd, offset, SEEK_SET) < 0)
+        {
+          gint errsv = errno;
 
-  if (tp_file->priv->out_stream)
-    g_object_unref (tp_file->priv->out_stream);
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+              "%s", g_strerror (errsv));
+          return FALSE;
+        }
 
-  if (tp_file->priv->contact)
-    g_object_unref (tp_file->priv->contact);
+      return TRUE;
+    }
 
-  if (tp_file->priv->cancellable)
-    g_object_unref (tp_file->priv->cancellable);
+  if (offset == 0)
+    return TRUE;
 
-  if (tp_file->priv->stalled_id != 0)
-    g_source_remove (tp_file->priv->stalled_id);
+  if (!tp_file->priv->incoming && G_IS_SEEKABLE (tp_file->priv->in_stream))
+    return g_seekable_seek (G_SEEKABLE (tp_file->priv->in_stream), offset,
+        G_SEEK_SET, NULL, error);
 
-  G_OBJECT_CLASS (empathy_tp_file_parent_class)->finalize (object);
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+      "Can't start the transfer at offset %" G_GUINT64_FORMAT, offset);
+
+  return FALSE;
 }
 
-static gboolean
-tp_file_stalled_cb (EmpathyTpFile *tp_file)
+static void tp_file_start_transfer (EmpathyTpFile *tp_file);
+
+static void
+tp_file_get_initial_offset_cb (TpProxy *proxy,
+                               const GValue *value,
+                               const GError *error,
+                               gpointer user_data,
+                               GObject *weak_object)
 {
-  /* We didn't get transferred bytes update for a while, the transfer is
-   * stalled. */
+  EmpathyTpFile *tp_file = EMPATHY_TP_FILE (weak_object);
+  GError *seek_error = NULL;
 
-  tp_file->priv->speed = 0;
-  tp_file->priv->remaining_time = -1;
-  g_signal_emit (tp_file, signals[REFRESH], 0);
+  /* CMs that don't know about InitialOffset always start at 0 */
+  if (error != NULL)
+    DEBUG ("Can't get InitialOffset: %s", error->message);
+  else if (G_VALUE_HOLDS_UINT64 (value))
+    tp_file->priv->initial_offset = g_value_get_uint64 (value);
 
-  return FALSE;
+  tp_file->priv->initial_offset_known = TRUE;
+
+  DEBUG ("Transfer of %s starts at offset %" G_GUINT64_FORMAT,
+      tp_file->priv->filename, tp_file->priv->initial_offset);
+
+  if (!tp_file_seek (tp_file, tp_file->priv->initial_offset, &seek_error))
+    {
+      DEBUG ("Failed to seek, closing channel: %s", seek_error->message);
+      g_error_free (seek_error);
+      empathy_tp_file_cancel (tp_file);
+      return;
+    }
+
+  tp_file_start_transfer (tp_file);
 }
 
 static void
@@ -435,6 +808,22 @@ tp_file_start_transfer (EmpathyTpFile *tp_file)
   struct sockaddr_un addr;
   GArray *array;
 
+  if (tp_file->priv->held)
+    {
+      DEBUG ("Transfer of %s is held", tp_file->priv->filename);
+      tp_file->priv->start_pending = TRUE;
+      return;
+    }
+  tp_file->priv->start_pending = FALSE;
+
+  if (!tp_file->priv->initial_offset_known)
+    {
+      tp_cli_dbus_properties_call_get (tp_file->priv->channel, -1,
+          TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER, "InitialOffset",
+          tp_file_get_initial_offset_cb, NULL, NULL, G_OBJECT (tp_file));
+      return;
+    }
+
   fd = socket (PF_UNIX, SOCK_STREAM, 0);
   if (fd < 0)
     {
@@ -459,19 +848,18 @@ tp_file_start_transfer (EmpathyTpFile *tp_file)
 
   DEBUG ("Start the transfer");
 
-  tp_file->priv->last_update_time = empathy_time_get_current ();
+  tp_file->priv->last_update_time = empathy_time_get_monotonic ();
   tp_file->priv->last_update_transferred_bytes = tp_file->priv->transferred_bytes;
   tp_file->priv->stalled_id = g_timeout_add_seconds (STALLED_TIMEOUT,
     (GSourceFunc) tp_file_stalled_cb, tp_file);
 
-  tp_file->priv->cancellable = g_cancellable_new ();
   if (tp_file->priv->incoming)
     {
       GInputStream *socket_stream;
 
       socket_stream = g_unix_input_stream_new (fd, TRUE);
-      copy_stream (socket_stream, tp_file->priv->out_stream,
-          tp_file->priv->cancellable);
+      tp_file_start_copy (tp_file, socket_stream, tp_file->priv->out_stream,
+          fd, tp_file->priv->file_fd);
       g_object_unref (socket_stream);
     }
   else
@@ -479,8 +867,8 @@ tp_file_start_transfer (EmpathyTpFile *tp_file)
       GOutputStream *socket_stream;
 
       socket_stream = g_unix_output_stream_new (fd, TRUE);
-      copy_stream (tp_file->priv->in_stream, socket_stream,
-          tp_file->priv->cancellable);
+      tp_file_start_copy (tp_file, tp_file->priv->in_stream, socket_stream,
+          tp_file->priv->file_fd, fd);
       g_object_unref (socket_stream);
     }
 }
@@ -497,6 +885,10 @@ tp_file_state_changed_cb (TpChannel *channel,
   if (state == tp_file->priv->state)
     return;
 
+  /* The transfer already failed on our side */
+  if (tp_file->priv->local_failure)
+    return;
+
   DEBUG ("File transfer state changed:\n"
       "\tfilename = %s, old state = %u, state = %u, reason = %u\n"
       "\tincoming = %s, in_stream = %s, out_stream = %s",
@@ -512,8 +904,15 @@ tp_file_state_changed_cb (TpChannel *channel,
       tp_file->priv->socket_address != NULL)
     tp_file_start_transfer (tp_file);
 
+  tp_file_flush_refresh (tp_file);
+
+  /* Otherwise the copy throws the file away when it stops */
+  if (state == TP_FILE_TRANSFER_STATE_CANCELLED && tp_file->priv->copy == NULL)
+    tp_file_finish_output (tp_file, FALSE);
+
   tp_file->priv->state = state;
   tp_file->priv->state_change_reason = reason;
+  tp_file_update_resume_state (tp_file);
 
   g_object_notify (G_OBJECT (tp_file), "state");
 }
@@ -525,8 +924,7 @@ tp_file_transferred_bytes_changed_cb (TpChannel *channel,
                                       GObject *weak_object)
 {
   EmpathyTpFile *tp_file = EMPATHY_TP_FILE (weak_object);
-  time_t curr_time, elapsed_time;
-  guint64 transferred_bytes;
+  gdouble now, elapsed, rate, weight;
 
   /* If we didn't progress since last update, return */
   if (tp_file->priv->transferred_bytes == count)
@@ -534,7 +932,6 @@ tp_file_transferred_bytes_changed_cb (TpChannel *channel,
 
   /* Update the transferred bytes count */
   tp_file->priv->transferred_bytes = count;
-  g_object_notify (G_OBJECT (tp_file), "transferred-bytes");
 
   /* We got a progress, reset the stalled timeout */
   if (tp_file->priv->stalled_id != 0)
@@ -542,23 +939,34 @@ tp_file_transferred_bytes_changed_cb (TpChannel *channel,
   tp_file->priv->stalled_id = g_timeout_add_seconds (STALLED_TIMEOUT,
     (GSourceFunc) tp_file_stalled_cb, tp_file);
 
-  /* Calculate the transfer speed and remaining time estimation. We recalculate
-   * that each second to get more dynamic values that react faster to network
-   * changes. This is better than calculating the average from the begining of
-   * the transfer, I think. */
-  curr_time = empathy_time_get_current ();
-  elapsed_time = curr_time - tp_file->priv->last_update_time;
-  if (elapsed_time >= 1)
+  /* The speed is an exponentially weighted moving average of the rates
+   * between updates, weighted by how long each rate lasted. It reacts
+   * quickly to network changes without jumping around at every update. */
+  now = empathy_time_get_monotonic ();
+  elapsed = now - tp_file->priv->last_update_time;
+  if (tp_file->priv->last_update_time > 0 && elapsed > 0 &&
+      count > tp_file->priv->last_update_transferred_bytes)
     {
-      transferred_bytes = count - tp_file->priv->last_update_transferred_bytes;
-      tp_file->priv->speed = (gdouble) transferred_bytes / (gdouble) elapsed_time;
-      tp_file->priv->remaining_time = (tp_file->priv->size - count) /
-        tp_file->priv->speed;
-      tp_file->priv->last_update_transferred_bytes = count;
-      tp_file->priv->last_update_time = curr_time;
-
-      g_signal_emit (tp_file, signals[REFRESH], 0);
+      rate = (count - tp_file->priv->last_update_transferred_bytes) / elapsed;
+      weight = elapsed / (elapsed + RATE_TIME_CONSTANT);
+
+      if (tp_file->priv->speed <= 0)
+        tp_file->priv->speed = rate;
+      else
+        tp_file->priv->speed += weight * (rate - tp_file->priv->speed);
+
+      if (tp_file->priv->size != EMPATHY_TP_FILE_UNKNOWN_SIZE &&
+          tp_file->priv->size > count)
+        tp_file->priv->remaining_time = (tp_file->priv->size - count) /
+            tp_file->priv->speed;
+      else
+        tp_file->priv->remaining_time = 0;
     }
+
+  tp_file->priv->last_update_transferred_bytes = count;
+  tp_file->priv->last_update_time = now;
+
+  tp_file_queue_refresh (tp_file);
 }
 
 static void
@@ -755,6 +1163,30 @@ tp_file_get_property (GObject *object,
       case PROP_READY:
         g_value_set_boolean (value, tp_file->priv->ready);
         break;
+      case PROP_COPY_RING_DEPTH:
+        g_value_set_uint (value, tp_file->priv->copy_ring_depth);
+        break;
+      case PROP_COPY_BUFFER_SIZE:
+        g_value_set_uint (value, tp_file->priv->copy_buffer_size);
+        break;
+      case PROP_COPY_RATE:
+        g_value_set_double (value, tp_file->priv->copy_stats.rate);
+        break;
+      case PROP_COPY_STALLS:
+        g_value_set_uint (value, tp_file->priv->copy_stats.stalls);
+        break;
+      case PROP_COPY_OCCUPANCY:
+        g_value_set_uint (value, tp_file->priv->copy_stats.occupancy);
+        break;
+      case PROP_REFRESH_RATE:
+        g_value_set_uint (value, tp_file->priv->refresh_rate);
+        break;
+      case PROP_HELD:
+        g_value_set_boolean (value, tp_file->priv->held);
+        break;
+      case PROP_RATE_LIMIT:
+        g_value_set_uint (value, tp_file->priv->rate_limit);
+        break;
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
         break;
@@ -807,12 +1239,33 @@ tp_file_set_property (GObject *object,
         g_free (tp_file->priv->content_type);
         tp_file->priv->content_type = g_value_dup_string (value);
         break;
+      case PROP_CONTENT_HASH_TYPE:
+        tp_file->priv->content_hash_type = g_value_get_uint (value);
+        break;
       case PROP_CONTENT_HASH:
         tp_file_channel_set_dbus_property (tp_file->priv->channel,
             "ContentHash", value);
         g_free (tp_file->priv->content_hash);
         tp_file->priv->content_hash = g_value_dup_string (value);
         break;
+      case PROP_COPY_RING_DEPTH:
+        tp_file->priv->copy_ring_depth = g_value_get_uint (value);
+        break;
+      case PROP_COPY_BUFFER_SIZE:
+        tp_file->priv->copy_buffer_size = g_value_get_uint (value);
+        break;
+      case PROP_REFRESH_RATE:
+        tp_file->priv->refresh_rate = g_value_get_uint (value);
+        break;
+      case PROP_HELD:
+        empathy_tp_file_set_held (tp_file, g_value_get_boolean (value));
+        break;
+      case PROP_RATE_LIMIT:
+        tp_file->priv->rate_limit = g_value_get_uint (value);
+        if (tp_file->priv->copy != NULL)
+          empathy_file_copy_set_rate_limit (tp_file->priv->copy,
+              tp_file->priv->rate_limit);
+        break;
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
         break;
@@ -933,6 +1386,124 @@ tp_file_method_cb (TpChannel *channel,
     tp_file_start_transfer (tp_file);
 }
 
+/* Creates a temporary file next to @path, to be renamed over it. As with
+ * g_file_replace, an existing file is only replaced once the new one is
+ * complete. */
+static gint
+tp_file_open_tmp (EmpathyTpFile *tp_file,
+                  const gchar *path)
+{
+  gchar *dirname;
+  gchar *basename;
+  gchar *tmp_basename;
+  gchar *tmp_path;
+  struct stat st;
+  mode_t mask;
+  gint fd;
+  gint errsv;
+
+  dirname = g_path_get_dirname (path);
+  basename = g_path_get_basename (path);
+  tmp_basename = g_strdup_printf (".%s.XXXXXX", basename);
+  tmp_path = g_build_filename (dirname, tmp_basename, NULL);
+  g_free (dirname);
+  g_free (basename);
+  g_free (tmp_basename);
+
+  fd = g_mkstemp (tmp_path);
+  if (fd < 0)
+    {
+      errsv = errno;
+      g_free (tmp_path);
+      errno = errsv;
+      return -1;
+    }
+
+  /* g_mkstemp only lets the owner read the file */
+  if (g_stat (path, &st) == 0)
+    {
+      fchmod (fd, st.st_mode & 07777);
+    }
+  else
+    {
+      mask = umask (0);
+      umask (mask);
+      fchmod (fd, 0666 & ~mask);
+    }
+
+  tp_file->priv->tmp_path = tmp_path;
+
+  return fd;
+}
+
+/* Local files are opened directly so that their fd can be given to the
+ * zero-copy engine, which GIO doesn't allow for file streams. */
+static GOutputStream *
+tp_file_open_output (EmpathyTpFile *tp_file,
+                     GFile *gfile,
+                     guint64 offset,
+                     GError **error)
+{
+  gchar *path;
+  gint fd;
+
+  path = g_file_get_path (gfile);
+  if (path == NULL)
+    return G_OUTPUT_STREAM (g_file_replace (gfile, NULL, FALSE, 0, NULL,
+        error));
+
+  /* When resuming, the received data is kept until the CM confirms where
+   * the transfer starts */
+  if (offset > 0)
+    fd = g_open (path, O_WRONLY | O_CREAT, 0666);
+  else
+    fd = tp_file_open_tmp (tp_file, path);
+  g_free (path);
+
+  if (fd < 0)
+    {
+      gint errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+          "%s", g_strerror (errsv));
+      return NULL;
+    }
+
+  tp_file->priv->file_fd = fd;
+  tp_file->priv->resumable = offset > 0;
+
+  return g_unix_output_stream_new (fd, TRUE);
+}
+
+static GInputStream *
+tp_file_open_input (EmpathyTpFile *tp_file,
+                    GFile *gfile,
+                    GError **error)
+{
+  gchar *path;
+  gint fd;
+
+  path = g_file_get_path (gfile);
+  if (path == NULL)
+    return G_INPUT_STREAM (g_file_read (gfile, NULL, error));
+
+  fd = g_open (path, O_RDONLY, 0);
+  g_free (path);
+
+  if (fd < 0)
+    {
+      gint errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+          "%s", g_strerror (errsv));
+      return NULL;
+    }
+
+  tp_file->priv->file_fd = fd;
+
+  return g_unix_input_stream_new (fd, TRUE);
+}
+
 /**
  * empathy_tp_file_accept:
  * @tp_file: an #EmpathyTpFile
@@ -954,16 +1525,23 @@ empathy_tp_file_accept (EmpathyTpFile *tp_file,
   g_return_if_fail (EMPATHY_IS_TP_FILE (tp_file));
   g_return_if_fail (G_IS_FILE (gfile));
 
-  tp_file->priv->out_stream = G_OUTPUT_STREAM (g_file_replace (gfile, NULL,
-  	FALSE, 0, NULL, error));
+  /* Only local files can be resumed */
+  if (offset > 0 && !g_file_is_native (gfile))
+    offset = 0;
+
+  tp_file->priv->out_stream = tp_file_open_output (tp_file, gfile, offset,
+      error);
   if (error && *error)
     return;
 
+  tp_file->priv->gfile = g_object_ref (gfile);
+
   g_free (tp_file->priv->filename);
   tp_file->priv->filename = g_file_get_basename (gfile);
   g_object_notify (G_OBJECT (tp_file), "filename");
 
-  DEBUG ("Accepting file: filename=%s", tp_file->priv->filename);
+  DEBUG ("Accepting file: filename=%s offset=%" G_GUINT64_FORMAT,
+      tp_file->priv->filename, offset);
 
   g_value_init (&nothing, G_TYPE_STRING);
   g_value_set_static_string (&nothing, "");
@@ -973,6 +1551,32 @@ empathy_tp_file_accept (EmpathyTpFile *tp_file,
       &nothing, offset, tp_file_method_cb, NULL, NULL, G_OBJECT (tp_file));
 }
 
+/**
+ * empathy_tp_file_get_resume_offset:
+ * @tp_file: an incoming #EmpathyTpFile
+ * @gfile: the #GFile where the data will be written
+ *
+ * Checks whether @gfile holds the beginning of the file offered by
+ * @tp_file, received by an earlier transfer that was interrupted.
+ * The returned offset can be given to empathy_tp_file_accept() to only
+ * transfer the rest of the file.
+ *
+ * Return value: the offset from which the transfer can be resumed, or 0
+ */
+guint64
+empathy_tp_file_get_resume_offset (EmpathyTpFile *tp_file,
+                                   GFile *gfile)
+{
+  g_return_val_if_fail (EMPATHY_IS_TP_FILE (tp_file), 0);
+  g_return_val_if_fail (G_IS_FILE (gfile), 0);
+
+  if (tp_file->priv->size == EMPATHY_TP_FILE_UNKNOWN_SIZE)
+    return 0;
+
+  return empathy_file_resume_get_offset (gfile, tp_file->priv->size,
+      tp_file->priv->content_hash);
+}
+
 /**
  * empathy_tp_file_offer:
  * @tp_file: an #EmpathyTpFile
@@ -989,7 +1593,7 @@ empathy_tp_file_offer (EmpathyTpFile *tp_file, GFile *gfile, GError **error)
 
   g_return_if_fail (EMPATHY_IS_TP_FILE (tp_file));
 
-  tp_file->priv->in_stream = G_INPUT_STREAM (g_file_read (gfile, NULL, error));
+  tp_file->priv->in_stream = tp_file_open_input (tp_file, gfile, error);
   if (error && *error)
   	return;
 
@@ -1135,6 +1739,59 @@ empathy_tp_file_get_speed (EmpathyTpFile *tp_file)
   return tp_file->priv->speed;
 }
 
+/**
+ * empathy_tp_file_get_copy_rate:
+ * @tp_file: an #EmpathyTpFile
+ *
+ * Gets the rate at which data of @tp_file goes through the socket of the
+ * connection manager, in bytes per second. Unlike
+ * empathy_tp_file_get_speed(), this is measured locally, a few times per
+ * second.
+ *
+ * Return value: the local throughput of @tp_file, in bytes per second
+ */
+gdouble
+empathy_tp_file_get_copy_rate (EmpathyTpFile *tp_file)
+{
+  g_return_val_if_fail (EMPATHY_IS_TP_FILE (tp_file), 0);
+
+  return tp_file->priv->copy_stats.rate;
+}
+
+/**
+ * empathy_tp_file_get_copy_stalls:
+ * @tp_file: an #EmpathyTpFile
+ *
+ * Gets the number of times reading the data of @tp_file had to wait for
+ * writes to catch up.
+ *
+ * Return value: the number of stalls of the copy
+ */
+guint
+empathy_tp_file_get_copy_stalls (EmpathyTpFile *tp_file)
+{
+  g_return_val_if_fail (EMPATHY_IS_TP_FILE (tp_file), 0);
+
+  return tp_file->priv->copy_stats.stalls;
+}
+
+/**
+ * empathy_tp_file_get_copy_occupancy:
+ * @tp_file: an #EmpathyTpFile
+ *
+ * Gets the percentage of the copy buffers of @tp_file holding data waiting
+ * to be written, over the last fraction of second.
+ *
+ * Return value: the buffer occupancy, in percent
+ */
+guint
+empathy_tp_file_get_copy_occupancy (EmpathyTpFile *tp_file)
+{
+  g_return_val_if_fail (EMPATHY_IS_TP_FILE (tp_file), 0);
+
+  return tp_file->priv->copy_stats.occupancy;
+}
+
 const gchar *
 empathy_tp_file_get_content_type (EmpathyTpFile *tp_file)
 {
@@ -1161,6 +1818,47 @@ empathy_tp_file_cancel (EmpathyTpFile *tp_file)
     g_cancellable_cancel (tp_file->priv->cancellable);
 }
 
+/**
+ * empathy_tp_file_set_held:
+ * @tp_file: an #EmpathyTpFile
+ * @held: whether to hold @tp_file
+ *
+ * Sets whether data of @tp_file may start flowing once the transfer is
+ * open. A held transfer is started when it is released. This has no
+ * effect on a transfer that already started.
+ */
+void
+empathy_tp_file_set_held (EmpathyTpFile *tp_file,
+                          gboolean held)
+{
+  g_return_if_fail (EMPATHY_IS_TP_FILE (tp_file));
+
+  if (tp_file->priv->held == held)
+    return;
+
+  tp_file->priv->held = held;
+  g_object_notify (G_OBJECT (tp_file), "held");
+
+  if (!held && tp_file->priv->start_pending)
+    tp_file_start_transfer (tp_file);
+}
+
+/**
+ * empathy_tp_file_is_held:
+ * @tp_file: an #EmpathyTpFile
+ *
+ * Returns whether @tp_file is held, see empathy_tp_file_set_held().
+ *
+ * Return value: %TRUE if @tp_file is held
+ */
+gboolean
+empathy_tp_file_is_held (EmpathyTpFile *tp_file)
+{
+  g_return_val_if_fail (EMPATHY_IS_TP_FILE (tp_file), FALSE);
+
+  return tp_file->priv->held;
+}
+
 /**
  * empathy_tp_file_is_ready:
  * @tp_file: an #EmpathyTpFile
@@ -1336,6 +2034,133 @@ empathy_tp_file_class_init (EmpathyTpFileClass *klass)
           0,
           G_PARAM_READWRITE));
 
+  /**
+   * EmpathyTpFile:copy-ring-depth:
+   *
+   * The number of buffers used to copy the data of the transfer, when it
+   * can't be moved without copying. Must be set before the transfer starts.
+   */
+  g_object_class_install_property (object_class,
+      PROP_COPY_RING_DEPTH,
+      g_param_spec_uint ("copy-ring-depth",
+          "copy ring depth",
+          "The number of buffers used to copy the data",
+          2,
+          G_MAXUINT,
+          DEFAULT_COPY_RING_DEPTH,
+          G_PARAM_READWRITE |
+          G_PARAM_CONSTRUCT));
+
+  /**
+   * EmpathyTpFile:copy-buffer-size:
+   *
+   * The size copy buffers can grow to with the throughput of the transfer.
+   * Must be set before the transfer starts.
+   */
+  g_object_class_install_property (object_class,
+      PROP_COPY_BUFFER_SIZE,
+      g_param_spec_uint ("copy-buffer-size",
+          "copy buffer size",
+          "The maximum size of the buffers used to copy the data",
+          4096,
+          G_MAXUINT,
+          DEFAULT_COPY_BUFFER_SIZE,
+          G_PARAM_READWRITE |
+          G_PARAM_CONSTRUCT));
+
+  /**
+   * EmpathyTpFile:copy-rate:
+   *
+   * The throughput measured locally, in bytes per second. See
+   * empathy_tp_file_get_copy_rate().
+   */
+  g_object_class_install_property (object_class,
+      PROP_COPY_RATE,
+      g_param_spec_double ("copy-rate",
+          "copy rate",
+          "The local throughput of the transfer",
+          0,
+          G_MAXDOUBLE,
+          0,
+          G_PARAM_READABLE));
+
+  /**
+   * EmpathyTpFile:copy-stalls:
+   *
+   * The number of times reads had to wait for writes to catch up.
+   */
+  g_object_class_install_property (object_class,
+      PROP_COPY_STALLS,
+      g_param_spec_uint ("copy-stalls",
+          "copy stalls",
+          "The number of times reads waited for writes",
+          0,
+          G_MAXUINT,
+          0,
+          G_PARAM_READABLE));
+
+  /**
+   * EmpathyTpFile:copy-occupancy:
+   *
+   * The percentage of the copy buffers holding data.
+   */
+  g_object_class_install_property (object_class,
+      PROP_COPY_OCCUPANCY,
+      g_param_spec_uint ("copy-occupancy",
+          "copy buffer occupancy",
+          "The percentage of the copy buffers holding data",
+          0,
+          100,
+          0,
+          G_PARAM_READABLE));
+
+  /**
+   * EmpathyTpFile:refresh-rate:
+   *
+   * How many times per second at most #EmpathyTpFile::refresh is emitted
+   * and #EmpathyTpFile:transferred-bytes is notified.
+   */
+  g_object_class_install_property (object_class,
+      PROP_REFRESH_RATE,
+      g_param_spec_uint ("refresh-rate",
+          "refresh rate",
+          "Maximum number of progress notifications per second",
+          1,
+          100,
+          DEFAULT_REFRESH_RATE,
+          G_PARAM_READWRITE |
+          G_PARAM_CONSTRUCT));
+
+  /**
+   * EmpathyTpFile:held:
+   *
+   * Whether data of the transfer is kept from flowing, see
+   * empathy_tp_file_set_held().
+   */
+  g_object_class_install_property (object_class,
+      PROP_HELD,
+      g_param_spec_boolean ("held",
+          "held",
+          "Whether the transfer is kept from starting",
+          FALSE,
+          G_PARAM_READWRITE));
+
+  /**
+   * EmpathyTpFile:rate-limit:
+   *
+   * The maximum throughput of the transfer, in bytes per second, or 0 if
+   * it isn't limited.
+   */
+  g_object_class_install_property (object_class,
+      PROP_RATE_LIMIT,
+      g_param_spec_uint ("rate-limit",
+          "rate limit",
+          "The maximum throughput of the transfer",
+          0,
+          G_MAXUINT,
+          0,
+          G_PARAM_READWRITE));
+
   /**
    * EmpathyTpFile::refresh:
    * @tp_file: the #EmpathyTpFile
@@ -1346,13 +2171,28 @@ empathy_tp_file_class_init (EmpathyTpFileClass *klass)
    *
    * This signal is designed for clients to provide more user feedback
    * when something to do with @tp_file changes. To avoid emitting this
-   * signal too much, it is guaranteed that it will only ever be fired
-   * at least every two seconds.
+   * signal too much, it is fired at most #EmpathyTpFile:refresh-rate times
+   * per second.
    */
   signals[REFRESH] = g_signal_new ("refresh", G_TYPE_FROM_CLASS (klass),
       G_SIGNAL_RUN_LAST, 0, NULL, NULL,
       g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
 
+  /**
+   * EmpathyTpFile::content-hash-checked:
+   * @tp_file: the #EmpathyTpFile
+   * @valid: whether the received data matches #EmpathyTpFile:content-hash
+   *
+   * Emitted once all the data of an incoming @tp_file has been received,
+   * if the sender provided a hash of it. If @valid is %FALSE, @tp_file
+   * then goes to the %TP_FILE_TRANSFER_STATE_CANCELLED state, with
+   * %EMPATHY_TP_FILE_STATE_CHANGE_REASON_HASH_MISMATCH as reason.
+   */
+  signals[CONTENT_HASH_CHECKED] = g_signal_new ("content-hash-checked",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+      g_cclosure_marshal_VOID__BOOLEAN, G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
+
   g_type_class_add_private (object_class, sizeof (EmpathyTpFilePriv));
 }
 
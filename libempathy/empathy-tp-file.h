@@ -37,6 +37,12 @@ G_BEGIN_DECLS
 
 #define EMPATHY_TP_FILE_UNKNOWN_SIZE G_MAXUINT64
 
+/* State change reasons telepathy doesn't define */
+typedef enum {
+  EMPATHY_TP_FILE_STATE_CHANGE_REASON_HASH_MISMATCH =
+      TP_FILE_TRANSFER_STATE_CHANGE_REASON_REMOTE_ERROR + 1,
+} EmpathyTpFileStateChangeReason;
+
 #define EMPATHY_TYPE_TP_FILE         (empathy_tp_file_get_type ())
 #define EMPATHY_TP_FILE(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), EMPATHY_TYPE_TP_FILE, EmpathyTpFile))
 #define EMPATHY_TP_FILE_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST((k), EMPATHY_TYPE_TP_FILE, EmpathyTpFileClass))
@@ -68,6 +74,8 @@ EmpathyTpFile *empathy_tp_file_new (TpChannel *channel);
 TpChannel *empathy_tp_file_get_channel (EmpathyTpFile *tp_file);
 void empathy_tp_file_accept (EmpathyTpFile *tp_file, guint64 offset,
   GFile *gfile, GError **error);
+guint64 empathy_tp_file_get_resume_offset (EmpathyTpFile *tp_file,
+  GFile *gfile);
 void empathy_tp_file_cancel (EmpathyTpFile *tp_file);
 void empathy_tp_file_offer (EmpathyTpFile *tp_file, GFile *gfile,
   GError **error);
@@ -81,8 +89,13 @@ guint64 empathy_tp_file_get_size (EmpathyTpFile *tp_file);
 guint64 empathy_tp_file_get_transferred_bytes (EmpathyTpFile *tp_file);
 gint empathy_tp_file_get_remaining_time (EmpathyTpFile *tp_file);
 gdouble empathy_tp_file_get_speed (EmpathyTpFile *tp_file);
+gdouble empathy_tp_file_get_copy_rate (EmpathyTpFile *tp_file);
+guint empathy_tp_file_get_copy_stalls (EmpathyTpFile *tp_file);
+guint empathy_tp_file_get_copy_occupancy (EmpathyTpFile *tp_file);
 const gchar *empathy_tp_file_get_content_type (EmpathyTpFile *tp_file);
 gboolean empathy_tp_file_is_ready (EmpathyTpFile *tp_file);
+void empathy_tp_file_set_held (EmpathyTpFile *tp_file, gboolean held);
+gboolean empathy_tp_file_is_held (EmpathyTpFile *tp_file);
 
 G_END_DECLS
 
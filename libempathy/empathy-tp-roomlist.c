@@ -36,6 +36,15 @@
 #define DEBUG_FLAG EMPATHY_DEBUG_TP
 #include "empathy-debug.h"
 
+/* Rooms emitted at once while the CM keeps sending them */
+#define BATCH_SIZE 1000
+
+/* Rooms waiting to be emitted, their strings are kept in one chunk */
+typedef struct {
+	GPtrArray    *rooms;
+	GStringChunk *strings;
+} RoomBatch;
+
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyTpRoomlist)
 typedef struct {
 	TpConnection *connection;
@@ -43,10 +52,13 @@ typedef struct {
 	McAccount    *account;
 	gboolean      is_listing;
 	gboolean      start_requested;
+	RoomBatch    *batch;
+	guint         flush_id;
 } EmpathyTpRoomlistPriv;
 
 enum {
 	NEW_ROOM,
+	NEW_ROOMS,
 	DESTROY,
 	ERROR,
 	LAST_SIGNAL
@@ -62,6 +74,154 @@ static guint signals[LAST_SIGNAL];
 
 G_DEFINE_TYPE (EmpathyTpRoomlist, empathy_tp_roomlist, G_TYPE_OBJECT);
 
+static RoomBatch *
+room_batch_new (void)
+{
+	RoomBatch *batch;
+
+	batch = g_slice_new (RoomBatch);
+	batch->rooms = g_ptr_array_new ();
+	batch->strings = g_string_chunk_new (4096);
+
+	return batch;
+}
+
+static void
+room_batch_clear (RoomBatch *batch)
+{
+	guint i;
+
+	for (i = 0; i < batch->rooms->len; i++) {
+		g_slice_free (EmpathyTpRoomlistRoom,
+			      g_ptr_array_index (batch->rooms, i));
+	}
+	g_ptr_array_set_size (batch->rooms, 0);
+	g_string_chunk_clear (batch->strings);
+}
+
+static void
+room_batch_free (gpointer data)
+{
+	RoomBatch *batch = data;
+
+	room_batch_clear (batch);
+	g_ptr_array_free (batch->rooms, TRUE);
+	g_string_chunk_free (batch->strings);
+	g_slice_free (RoomBatch, batch);
+}
+
+static const gchar *
+room_batch_get_string (RoomBatch    *batch,
+		       const GValue *value)
+{
+	if (value == NULL || !G_VALUE_HOLDS_STRING (value) ||
+	    g_value_get_string (value) == NULL) {
+		return NULL;
+	}
+
+	return g_string_chunk_insert_const (batch->strings,
+					    g_value_get_string (value));
+}
+
+static EmpathyTpRoomlistRoom *
+room_batch_add (RoomBatch  *batch,
+		GHashTable *info)
+{
+	EmpathyTpRoomlistRoom *room;
+	const GValue          *value;
+
+	room = g_slice_new0 (EmpathyTpRoomlistRoom);
+	room->name = room_batch_get_string (batch,
+		g_hash_table_lookup (info, "name"));
+	room->room = room_batch_get_string (batch,
+		g_hash_table_lookup (info, "handle-name"));
+	room->subject = room_batch_get_string (batch,
+		g_hash_table_lookup (info, "subject"));
+
+	value = g_hash_table_lookup (info, "members");
+	if (value != NULL) {
+		room->members_count = g_value_get_uint (value);
+	}
+	value = g_hash_table_lookup (info, "invite-only");
+	if (value != NULL) {
+		room->invite_only = g_value_get_boolean (value);
+	}
+	value = g_hash_table_lookup (info, "password");
+	if (value != NULL) {
+		room->need_password = g_value_get_boolean (value);
+	}
+
+	g_ptr_array_add (batch->rooms, room);
+
+	return room;
+}
+
+static void
+tp_roomlist_emit_rooms (EmpathyTpRoomlist *list,
+			GPtrArray         *rooms)
+{
+	EmpathyTpRoomlistPriv *priv = GET_PRIV (list);
+	guint                  i;
+
+	if (rooms->len == 0) {
+		return;
+	}
+
+	DEBUG ("Emitting %d rooms", rooms->len);
+	g_signal_emit (list, signals[NEW_ROOMS], 0, rooms);
+
+	/* Building a chatroom object per room is expensive on big servers,
+	 * only do it if someone still uses the "new-room" signal. */
+	if (!g_signal_has_handler_pending (list, signals[NEW_ROOM], 0, FALSE)) {
+		return;
+	}
+
+	for (i = 0; i < rooms->len; i++) {
+		EmpathyTpRoomlistRoom *room = g_ptr_array_index (rooms, i);
+		EmpathyChatroom       *chatroom;
+
+		chatroom = empathy_chatroom_new (priv->account);
+		empathy_chatroom_set_room (chatroom, room->room);
+		if (room->name != NULL) {
+			empathy_chatroom_set_name (chatroom, room->name);
+		}
+		if (room->subject != NULL) {
+			empathy_chatroom_set_subject (chatroom, room->subject);
+		}
+		empathy_chatroom_set_members_count (chatroom, room->members_count);
+		empathy_chatroom_set_invite_only (chatroom, room->invite_only);
+		empathy_chatroom_set_need_password (chatroom, room->need_password);
+
+		g_signal_emit (list, signals[NEW_ROOM], 0, chatroom);
+		g_object_unref (chatroom);
+	}
+}
+
+static void
+tp_roomlist_flush (EmpathyTpRoomlist *list)
+{
+	EmpathyTpRoomlistPriv *priv = GET_PRIV (list);
+
+	if (priv->flush_id != 0) {
+		g_source_remove (priv->flush_id);
+		priv->flush_id = 0;
+	}
+
+	tp_roomlist_emit_rooms (list, priv->batch->rooms);
+	room_batch_clear (priv->batch);
+}
+
+static gboolean
+tp_roomlist_flush_cb (gpointer list)
+{
+	EmpathyTpRoomlistPriv *priv = GET_PRIV (list);
+
+	priv->flush_id = 0;
+	tp_roomlist_flush (list);
+
+	return FALSE;
+}
+
 static void
 tp_roomlist_listing_cb (TpChannel *channel,
 			gboolean   listing,
@@ -71,19 +231,14 @@ tp_roomlist_listing_cb (TpChannel *channel,
 	EmpathyTpRoomlistPriv *priv = GET_PRIV (list);
 
 	DEBUG ("Listing: %s", listing ? "Yes" : "No");
+	if (!listing) {
+		tp_roomlist_flush (EMPATHY_TP_ROOMLIST (list));
+	}
+
 	priv->is_listing = listing;
 	g_object_notify (list, "is-listing");
 }
 
-static void
-tp_roomlist_chatrooms_free (gpointer data)
-{
-	GSList *chatrooms = data;
-
-	g_slist_foreach (chatrooms, (GFunc) g_object_unref, NULL);
-	g_slist_free (chatrooms);
-}
-
 static void
 tp_roomlist_inspect_handles_cb (TpConnection *connection,
 				const gchar **names,
@@ -91,22 +246,25 @@ tp_roomlist_inspect_handles_cb (TpConnection *connection,
 				gpointer      user_data,
 				GObject      *list)
 {
-	GSList *chatrooms = user_data;
+	RoomBatch *batch = user_data;
+	guint      i;
 
 	if (error != NULL) {
 		DEBUG ("Error: %s", error->message);
 		return;
 	}
 
-	while (*names != NULL) {
-		EmpathyChatroom *chatroom = chatrooms->data;
+	for (i = 0; names[i] != NULL && i < batch->rooms->len; i++) {
+		EmpathyTpRoomlistRoom *room;
 
-		empathy_chatroom_set_room (chatroom, *names);
-		g_signal_emit (list, signals[NEW_ROOM], 0, chatroom);
-
-		names++;
-		chatrooms = chatrooms->next;
+		room = g_ptr_array_index (batch->rooms, i);
+		room->room = g_string_chunk_insert_const (batch->strings,
+							  names[i]);
 	}
+
+	/* Keep the rooms in the order they were listed */
+	tp_roomlist_flush (EMPATHY_TP_ROOMLIST (list));
+	tp_roomlist_emit_rooms (EMPATHY_TP_ROOMLIST (list), batch->rooms);
 }
 
 static void
@@ -116,18 +274,11 @@ tp_roomlist_got_rooms_cb (TpChannel       *channel,
 			  GObject         *list)
 {
 	EmpathyTpRoomlistPriv *priv = GET_PRIV (list);
-	EmpathyChatroom       *chatroom;
 	guint                  i;
 	GArray                *handles = NULL;
-	GSList                *chatrooms = NULL;
+	RoomBatch             *unnamed = NULL;
 
 	for (i = 0; i < rooms->len; i++) {
-		const GValue *room_name_value;
-		const GValue *handle_name_value;
-		const GValue *room_members_value;
-		const GValue *room_subject_value;
-		const GValue *room_invite_value;
-		const GValue *room_password_value;
 		GValueArray  *room_struct;
 		guint         handle;
 		const gchar  *channel_type;
@@ -138,71 +289,41 @@ tp_roomlist_got_rooms_cb (TpChannel       *channel,
 		handle = g_value_get_uint (g_value_array_get_nth (room_struct, 0));
 		channel_type = g_value_get_string (g_value_array_get_nth (room_struct, 1));
 		info = g_value_get_boxed (g_value_array_get_nth (room_struct, 2));
-		room_name_value = g_hash_table_lookup (info, "name");
-		handle_name_value = g_hash_table_lookup (info, "handle-name");
-		room_subject_value = g_hash_table_lookup (info, "subject");
-		room_members_value = g_hash_table_lookup (info, "members");
-		room_invite_value = g_hash_table_lookup (info, "invite-only");
-		room_password_value = g_hash_table_lookup (info, "password");
 
 		if (tp_strdiff (channel_type, TP_IFACE_CHANNEL_TYPE_TEXT)) {
 			continue;
 		}
 
-		chatroom = empathy_chatroom_new (priv->account);
-
-		if (room_name_value != NULL) {
-			empathy_chatroom_set_name (chatroom,
-						   g_value_get_string (room_name_value));
-		}
-
-		if (room_members_value != NULL) {
-			empathy_chatroom_set_members_count (chatroom,
-						   g_value_get_uint (room_members_value));
-		}
-
-		if (room_subject_value != NULL) {
-			empathy_chatroom_set_subject (chatroom,
-						   g_value_get_string (room_subject_value));
-		}
-
-		if (room_invite_value != NULL) {
-			empathy_chatroom_set_invite_only (chatroom,
-						   g_value_get_boolean (room_invite_value));
-		}
-
-		if (room_password_value != NULL) {
-			empathy_chatroom_set_need_password (chatroom,
-						   g_value_get_boolean (room_password_value));
-		}
-
-		if (handle_name_value != NULL) {
-			empathy_chatroom_set_room (chatroom,
-						   g_value_get_string (handle_name_value));
-
-			/* We have the room ID, we can directly emit it */
-			g_signal_emit (list, signals[NEW_ROOM], 0, chatroom);
-			g_object_unref (chatroom);
+		if (g_hash_table_lookup (info, "handle-name") != NULL) {
+			/* We have the room ID, it can go with the next batch */
+			room_batch_add (priv->batch, info);
 		} else {
 			/* We don't have the room ID, we'll inspect all handles
 			 * at once and then emit rooms */
 			if (handles == NULL) {
 				handles = g_array_new (FALSE, FALSE, sizeof (guint));
+				unnamed = room_batch_new ();
 			}
 
 			g_array_append_val (handles, handle);
-			chatrooms = g_slist_prepend (chatrooms, chatroom);
+			room_batch_add (unnamed, info);
 		}
 	}
 
+	/* CMs often send rooms a few at a time, emit them together */
+	if (priv->batch->rooms->len >= BATCH_SIZE) {
+		tp_roomlist_flush (EMPATHY_TP_ROOMLIST (list));
+	} else if (priv->batch->rooms->len > 0 && priv->flush_id == 0) {
+		priv->flush_id = g_idle_add (tp_roomlist_flush_cb, list);
+	}
+
 	if (handles != NULL) {
-		chatrooms = g_slist_reverse (chatrooms);
 		tp_cli_connection_call_inspect_handles (priv->connection, -1,
 						       TP_HANDLE_TYPE_ROOM,
 						       handles,
 						       tp_roomlist_inspect_handles_cb,
-						       chatrooms,
-						       tp_roomlist_chatrooms_free,
+						       unnamed,
+						       room_batch_free,
 						       list);
 		g_array_free (handles, TRUE);
 	}
@@ -328,6 +449,11 @@ tp_roomlist_finalize (GObject *object)
 {
 	EmpathyTpRoomlistPriv *priv = GET_PRIV (object);
 
+	if (priv->flush_id != 0) {
+		g_source_remove (priv->flush_id);
+	}
+	room_batch_free (priv->batch);
+
 	if (priv->channel) {
 		DEBUG ("Closing channel...");
 		g_signal_handlers_disconnect_by_func (priv->channel,
@@ -445,6 +571,17 @@ empathy_tp_roomlist_class_init (EmpathyTpRoomlistClass *klass)
 			      G_TYPE_NONE,
 			      1, EMPATHY_TYPE_CHATROOM);
 
+	/* Carries a GPtrArray of EmpathyTpRoomlistRoom */
+	signals[NEW_ROOMS] =
+		g_signal_new ("new-rooms",
+			      G_TYPE_FROM_CLASS (klass),
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__POINTER,
+			      G_TYPE_NONE,
+			      1, G_TYPE_POINTER);
+
 	signals[DESTROY] =
 		g_signal_new ("destroy",
 			      G_TYPE_FROM_CLASS (klass),
@@ -477,6 +614,7 @@ empathy_tp_roomlist_init (EmpathyTpRoomlist *list)
 	list->priv = priv;
 	priv->start_requested = FALSE;
 	priv->is_listing = FALSE;
+	priv->batch = room_batch_new ();
 }
 
 EmpathyTpRoomlist *
@@ -48,6 +48,17 @@ struct _EmpathyTpRoomlistClass {
 	GObjectClass parent_class;
 };
 
+/* A listed room, as carried by the "new-rooms" signal. Records are owned by
+ * the roomlist and only valid during the emission. */
+typedef struct {
+	const gchar *name;
+	const gchar *room;
+	const gchar *subject;
+	guint        members_count;
+	gboolean     invite_only;
+	gboolean     need_password;
+} EmpathyTpRoomlistRoom;
+
 GType              empathy_tp_roomlist_get_type   (void) G_GNUC_CONST;
 EmpathyTpRoomlist *empathy_tp_roomlist_new        (McAccount *account);
 gboolean           empathy_tp_roomlist_is_listing (EmpathyTpRoomlist *list);
@@ -68,6 +68,7 @@ empathy_init (void)
 		g_log_set_default_handler (tp_debug_timestamped_log_handler, NULL);
 	}
 	empathy_debug_set_flags (g_getenv ("EMPATHY_DEBUG"));
+	empathy_trace_set_flags (g_getenv ("EMPATHY_TRACE"));
 	tp_debug_divert_messages (g_getenv ("EMPATHY_LOGFILE"));
 
 	emp_cli_init ();
@@ -63,8 +63,9 @@
 typedef struct {
 	EmpathyChat *current_chat;
 	GList       *chats;
-	GList       *chats_new_msg;
-	GList       *chats_composing;
+	/* Sets of the chats with unread messages and of those composing */
+	GHashTable  *chats_new_msg;
+	GHashTable  *chats_composing;
 	gboolean     page_added;
 	gboolean     dnd_same_window;
 	guint        save_geometry_id;
@@ -91,6 +92,9 @@ typedef struct {
 
 static GList *chat_windows = NULL;
 
+/* "account unique name\nid" -> EmpathyChat, for all chats in all windows */
+static GHashTable *chats_by_id = NULL;
+
 static const guint tab_accel_keys[] = {
 	GDK_1, GDK_2, GDK_3, GDK_4, GDK_5,
 	GDK_6, GDK_7, GDK_8, GDK_9, GDK_0
@@ -136,18 +140,55 @@ chat_window_accel_cb (GtkAccelGroup    *accelgroup,
 static EmpathyChatWindow *
 chat_window_find_chat (EmpathyChat *chat)
 {
-	EmpathyChatWindowPriv *priv;
-	GList                 *l, *ll;
+	return g_object_get_data (G_OBJECT (chat), "chat-window");
+}
 
-	for (l = chat_windows; l; l = l->next) {
-		priv = GET_PRIV (l->data);
-		ll = g_list_find (priv->chats, chat);
-		if (ll) {
-			return l->data;
-		}
+static gchar *
+chat_window_get_chat_key (McAccount   *account,
+			  const gchar *id)
+{
+	return g_strdup_printf ("%s\n%s", mc_account_get_unique_name (account), id);
+}
+
+static void
+chat_window_unregister_chat (EmpathyChat *chat)
+{
+	const gchar *key;
+
+	key = g_object_get_data (G_OBJECT (chat), "chat-window-key");
+	if (!key) {
+		return;
 	}
 
-	return NULL;
+	if (g_hash_table_lookup (chats_by_id, key) == chat) {
+		g_hash_table_remove (chats_by_id, key);
+	}
+	g_object_set_data (G_OBJECT (chat), "chat-window-key", NULL);
+}
+
+static void
+chat_window_register_chat (EmpathyChat *chat)
+{
+	McAccount   *account;
+	const gchar *id;
+	gchar       *key;
+
+	chat_window_unregister_chat (chat);
+
+	account = empathy_chat_get_account (chat);
+	id = empathy_chat_get_id (chat);
+	if (!account || EMP_STR_EMPTY (id)) {
+		return;
+	}
+
+	if (!chats_by_id) {
+		chats_by_id = g_hash_table_new_full (g_str_hash, g_str_equal,
+						     g_free, NULL);
+	}
+
+	key = chat_window_get_chat_key (account, id);
+	g_hash_table_insert (chats_by_id, g_strdup (key), chat);
+	g_object_set_data_full (G_OBJECT (chat), "chat-window-key", key, g_free);
 }
 
 static void
@@ -319,7 +360,7 @@ chat_window_update (EmpathyChatWindow *window)
 	}
 
 	/* Update window icon */
-	if (priv->chats_new_msg) {
+	if (g_hash_table_size (priv->chats_new_msg) > 0) {
 		gtk_window_set_icon_name (GTK_WINDOW (priv->dialog),
 					  EMPATHY_IMAGE_MESSAGE);
 	} else {
@@ -385,10 +426,10 @@ chat_window_update_chat_tab (EmpathyChat *chat)
 		name, mc_account_get_unique_name (account), subject, remote_contact);
 
 	/* Update tab image */
-	if (g_list_find (priv->chats_new_msg, chat)) {
+	if (g_hash_table_lookup (priv->chats_new_msg, chat)) {
 		icon_name = EMPATHY_IMAGE_MESSAGE;
 	}
-	else if (g_list_find (priv->chats_composing, chat)) {
+	else if (g_hash_table_lookup (priv->chats_composing, chat)) {
 		icon_name = EMPATHY_IMAGE_TYPING;
 	}
 	else if (remote_contact) {
@@ -422,7 +463,7 @@ chat_window_update_chat_tab (EmpathyChat *chat)
 		g_string_append (tooltip, markup);
 		g_free (markup);
 	}
-	if (g_list_find (priv->chats_composing, chat)) {
+	if (g_hash_table_lookup (priv->chats_composing, chat)) {
 		markup = g_markup_printf_escaped ("\n%s", _("Typing a message."));
 		g_string_append (tooltip, markup);
 		g_free (markup);
@@ -808,10 +849,10 @@ chat_window_composing_cb (EmpathyChat       *chat,
 
 	priv = GET_PRIV (window);
 
-	if (is_composing && !g_list_find (priv->chats_composing, chat)) {
-		priv->chats_composing = g_list_prepend (priv->chats_composing, chat);
+	if (is_composing) {
+		g_hash_table_insert (priv->chats_composing, chat, chat);
 	} else {
-		priv->chats_composing = g_list_remove (priv->chats_composing, chat);
+		g_hash_table_remove (priv->chats_composing, chat);
 	}
 
 	chat_window_update_chat_tab (chat);
@@ -865,16 +906,11 @@ chat_window_show_or_update_notification (EmpathyChatWindow *window,
 	GdkPixbuf *pixbuf;
 	NotificationData *cb_data;
 	EmpathyChatWindowPriv *priv = GET_PRIV (window);
-	gboolean res;
 
 	if (!empathy_notification_is_enabled ()) {
 		return;
-	} else {
-		empathy_conf_get_bool (empathy_conf_get (),
-				       EMPATHY_PREFS_NOTIFICATIONS_FOCUS, &res);
-		if (!res) {
-			return;
-		}
+	} else if (!empathy_conf_get_cache (empathy_conf_get ())->notifications_focus) {
+		return;
 	}
 
 	cb_data = g_slice_new0 (NotificationData);
@@ -962,8 +998,8 @@ chat_window_new_message_cb (EmpathyChat       *chat,
 		chat_window_show_or_update_notification (window, message, chat);
 	}
 
-	if (!g_list_find (priv->chats_new_msg, chat)) {
-		priv->chats_new_msg = g_list_prepend (priv->chats_new_msg, chat);
+	if (!g_hash_table_lookup (priv->chats_new_msg, chat)) {
+		g_hash_table_insert (priv->chats_new_msg, chat, chat);
 		chat_window_update_chat_tab (chat);
 	}
 }
@@ -1021,7 +1057,7 @@ chat_window_page_switched_cb (GtkNotebook      *notebook,
 	}
 
 	priv->current_chat = chat;
-	priv->chats_new_msg = g_list_remove (priv->chats_new_msg, chat);
+	g_hash_table_remove (priv->chats_new_msg, chat);
 
 	chat_window_update_chat_tab (chat);
 }
@@ -1067,6 +1103,7 @@ chat_window_page_added_cb (GtkNotebook      *notebook,
 
 	/* Get list of chats up to date */
 	priv->chats = g_list_append (priv->chats, chat);
+	g_object_set_data (G_OBJECT (chat), "chat-window", window);
 
 	chat_window_update_chat_tab (chat);
 }
@@ -1106,8 +1143,9 @@ chat_window_page_removed_cb (GtkNotebook      *notebook,
 
 	/* Keep list of chats up to date */
 	priv->chats = g_list_remove (priv->chats, chat);
-	priv->chats_new_msg = g_list_remove (priv->chats_new_msg, chat);
-	priv->chats_composing = g_list_remove (priv->chats_composing, chat);
+	g_hash_table_remove (priv->chats_new_msg, chat);
+	g_hash_table_remove (priv->chats_composing, chat);
+	g_object_set_data (G_OBJECT (chat), "chat-window", NULL);
 
 	if (priv->chats == NULL) {
 		g_object_unref (window);
@@ -1127,7 +1165,7 @@ chat_window_focus_in_event_cb (GtkWidget        *widget,
 
 	priv = GET_PRIV (window);
 
-	priv->chats_new_msg = g_list_remove (priv->chats_new_msg, priv->current_chat);
+	g_hash_table_remove (priv->chats_new_msg, priv->current_chat);
 
 	chat_window_set_urgency_hint (window, FALSE);
 	
@@ -1270,6 +1308,8 @@ chat_window_finalize (GObject *object)
 
 	chat_windows = g_list_remove (chat_windows, window);
 	gtk_widget_destroy (priv->dialog);
+	g_hash_table_destroy (priv->chats_new_msg);
+	g_hash_table_destroy (priv->chats_composing);
 
 	G_OBJECT_CLASS (empathy_chat_window_parent_class)->finalize (object);
 }
@@ -1435,8 +1475,8 @@ empathy_chat_window_init (EmpathyChatWindow *window)
 
 	/* Set up private details */
 	priv->chats = NULL;
-	priv->chats_new_msg = NULL;
-	priv->chats_composing = NULL;
+	priv->chats_new_msg = g_hash_table_new (g_direct_hash, g_direct_equal);
+	priv->chats_composing = g_hash_table_new (g_direct_hash, g_direct_equal);
 	priv->current_chat = NULL;
 }
 
@@ -1544,6 +1584,15 @@ empathy_chat_window_add_chat (EmpathyChatWindow *window,
 			  NULL);
 	chat_window_chat_notify_cb (chat);
 
+	/* Keep the chat findable by account and id */
+	g_signal_connect (chat, "notify::account",
+			  G_CALLBACK (chat_window_register_chat),
+			  NULL);
+	g_signal_connect (chat, "notify::id",
+			  G_CALLBACK (chat_window_register_chat),
+			  NULL);
+	chat_window_register_chat (chat);
+
 	gtk_notebook_append_page (GTK_NOTEBOOK (priv->notebook), child, label);
 	gtk_notebook_set_tab_reorderable (GTK_NOTEBOOK (priv->notebook), child, TRUE);
 	gtk_notebook_set_tab_detachable (GTK_NOTEBOOK (priv->notebook), child, TRUE);
@@ -1569,6 +1618,10 @@ empathy_chat_window_remove_chat (EmpathyChatWindow *window,
 	g_signal_handlers_disconnect_by_func (chat,
 					      chat_window_chat_notify_cb,
 					      NULL);
+	g_signal_handlers_disconnect_by_func (chat,
+					      chat_window_register_chat,
+					      NULL);
+	chat_window_unregister_chat (chat);
 	remote_contact = g_object_get_data (G_OBJECT (chat),
 					    "chat-window-remote-contact");
 	if (remote_contact) {
@@ -1652,32 +1705,21 @@ EmpathyChat *
 empathy_chat_window_find_chat (McAccount   *account,
 			       const gchar *id)
 {
-	GList *l;
+	EmpathyChat *chat;
+	gchar       *key;
 
 	g_return_val_if_fail (MC_IS_ACCOUNT (account), NULL);
 	g_return_val_if_fail (!EMP_STR_EMPTY (id), NULL);
 
-	for (l = chat_windows; l; l = l->next) {
-		EmpathyChatWindowPriv *priv;
-		EmpathyChatWindow     *window;
-		GList                *ll;
-
-		window = l->data;
-		priv = GET_PRIV (window);
-
-		for (ll = priv->chats; ll; ll = ll->next) {
-			EmpathyChat *chat;
-
-			chat = ll->data;
-
-			if (empathy_account_equal (account, empathy_chat_get_account (chat)) &&
-			    !tp_strdiff (id, empathy_chat_get_id (chat))) {
-				return chat;
-			}
-		}
+	if (!chats_by_id) {
+		return NULL;
 	}
 
-	return NULL;
+	key = chat_window_get_chat_key (account, id);
+	chat = g_hash_table_lookup (chats_by_id, key);
+	g_free (key);
+
+	return chat;
 }
 
 void
@@ -50,6 +50,9 @@
 
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyEventManager)
 
+/* Number of ms between two blinks of pending events */
+#define BLINK_TIMEOUT 500
+
 typedef struct {
   EmpathyEventManager *manager;
   EmpathyDispatchOperation *operation;
@@ -70,13 +73,23 @@ typedef struct {
 typedef struct {
   EmpathyDispatcher *dispatcher;
   EmpathyContactManager *contact_manager;
-  GSList *events;
+  /* Newest first */
+  GQueue events;
+  /* EventManagerApproval -> EventPriv */
+  GHashTable *events_by_approval;
+  /* EmpathyContact -> GQueue of EventPriv, newest first. The queue keeps
+   * the number of events of the contact. */
+  GHashTable *events_by_contact;
   /* Ongoing approvals */
   GSList *approvals;
 
   /* voip ringing sound */
   guint voip_timeout;
   gint ringing;
+
+  /* Blink clock shared by everything showing pending events */
+  guint blink_timeout;
+  gboolean blink_on;
 } EmpathyEventManagerPriv;
 
 typedef struct _EventPriv EventPriv;
@@ -89,12 +102,17 @@ struct _EventPriv {
   EventFunc func;
   gboolean inhibit;
   gpointer user_data;
+  /* Link of the event in priv->events */
+  GList *link;
+  /* Link of the event in the queue of its contact */
+  GList *contact_link;
 };
 
 enum {
   EVENT_ADDED,
   EVENT_REMOVED,
   EVENT_UPDATED,
+  BLINK,
   LAST_SIGNAL
 };
 
@@ -236,13 +254,109 @@ event_manager_stop_ringing (EmpathyEventManager *manager)
     }
 }
 
+static gboolean
+event_manager_blink_cb (gpointer data)
+{
+  EmpathyEventManager *manager = EMPATHY_EVENT_MANAGER (data);
+  EmpathyEventManagerPriv *priv = GET_PRIV (manager);
+
+  priv->blink_on = !priv->blink_on;
+  g_signal_emit (manager, signals[BLINK], 0, priv->blink_on);
+
+  return TRUE;
+}
+
+static void
+event_manager_start_blinking (EmpathyEventManager *manager)
+{
+  EmpathyEventManagerPriv *priv = GET_PRIV (manager);
+
+  if (priv->blink_timeout != 0)
+    return;
+
+  DEBUG ("Start blinking");
+  priv->blink_on = TRUE;
+  priv->blink_timeout = g_timeout_add (BLINK_TIMEOUT, event_manager_blink_cb,
+    manager);
+}
+
+static void
+event_manager_stop_blinking (EmpathyEventManager *manager)
+{
+  EmpathyEventManagerPriv *priv = GET_PRIV (manager);
+
+  if (priv->blink_timeout == 0)
+    return;
+
+  DEBUG ("Stop blinking");
+  g_source_remove (priv->blink_timeout);
+  priv->blink_timeout = 0;
+  priv->blink_on = FALSE;
+}
+
+static void
+event_manager_index (EmpathyEventManager *manager,
+  EventPriv *event)
+{
+  EmpathyEventManagerPriv *priv = GET_PRIV (manager);
+  EmpathyContact *contact = event->public.contact;
+  GQueue *events;
+
+  g_queue_push_head (&priv->events, event);
+  event->link = priv->events.head;
+
+  if (event->approval != NULL)
+    g_hash_table_insert (priv->events_by_approval, event->approval, event);
+
+  if (contact != NULL)
+    {
+      events = g_hash_table_lookup (priv->events_by_contact, contact);
+      if (events == NULL)
+        {
+          events = g_queue_new ();
+          g_hash_table_insert (priv->events_by_contact, contact, events);
+        }
+
+      g_queue_push_head (events, event);
+      event->contact_link = events->head;
+    }
+}
+
+static void
+event_manager_unindex (EmpathyEventManager *manager,
+  EventPriv *event)
+{
+  EmpathyEventManagerPriv *priv = GET_PRIV (manager);
+  EmpathyContact *contact = event->public.contact;
+  GQueue *events;
+
+  g_queue_delete_link (&priv->events, event->link);
+  event->link = NULL;
+
+  if (event->approval != NULL &&
+      g_hash_table_lookup (priv->events_by_approval, event->approval) == event)
+    g_hash_table_remove (priv->events_by_approval, event->approval);
+
+  if (contact != NULL)
+    {
+      events = g_hash_table_lookup (priv->events_by_contact, contact);
+      g_queue_delete_link (events, event->contact_link);
+      event->contact_link = NULL;
+
+      if (g_queue_is_empty (events))
+        g_hash_table_remove (priv->events_by_contact, contact);
+    }
+}
+
 static void
 event_remove (EventPriv *event)
 {
   EmpathyEventManagerPriv *priv = GET_PRIV (event->manager);
 
   DEBUG ("Removing event %p", event);
-  priv->events = g_slist_remove (priv->events, event);
+  event_manager_unindex (event->manager, event);
+  if (g_queue_is_empty (&priv->events))
+    event_manager_stop_blinking (event->manager);
   g_signal_emit (event->manager, signals[EVENT_REMOVED], 0, event);
   event_free (event);
 }
@@ -252,7 +366,6 @@ event_manager_add (EmpathyEventManager *manager, EmpathyContact *contact,
   const gchar *icon_name, const gchar *header, const gchar *message,
   EventManagerApproval *approval, EventFunc func, gpointer user_data)
 {
-  EmpathyEventManagerPriv *priv = GET_PRIV (manager);
   EventPriv               *event;
 
   event = g_slice_new0 (EventPriv);
@@ -260,6 +373,7 @@ event_manager_add (EmpathyEventManager *manager, EmpathyContact *contact,
   event->public.icon_name = g_strdup (icon_name);
   event->public.header = g_strdup (header);
   event->public.message = g_strdup (message);
+  event->public.count = 1;
   event->inhibit = FALSE;
   event->func = func;
   event->user_data = user_data;
@@ -267,7 +381,8 @@ event_manager_add (EmpathyEventManager *manager, EmpathyContact *contact,
   event->approval = approval;
 
   DEBUG ("Adding event %p", event);
-  priv->events = g_slist_prepend (priv->events, event);
+  event_manager_index (manager, event);
+  event_manager_start_blinking (manager);
   g_signal_emit (event->manager, signals[EVENT_ADDED], 0, event);
 }
 
@@ -299,21 +414,8 @@ event_lookup_by_approval (EmpathyEventManager *manager,
   EventManagerApproval *approval)
 {
   EmpathyEventManagerPriv *priv = GET_PRIV (manager);
-  GSList *l;
-  EventPriv *retval = NULL;
-
-  for (l = priv->events; l; l = l->next)
-    {
-      EventPriv *event = l->data;
-
-      if (event->approval == approval)
-        {
-          retval = event;
-          break;
-        }
-    }
 
-  return retval;
+  return g_hash_table_lookup (priv->events_by_approval, approval);
 }
 
 static void
@@ -426,12 +528,25 @@ event_manager_chat_message_received_cb (EmpathyTpChat *tp_chat,
     }
 
   sender = empathy_message_get_sender (message);
-  header = g_strdup_printf (_("New message from %s"),
-                            empathy_contact_get_name (sender));
   msg = empathy_message_get_body (message);
 
   channel = empathy_tp_chat_get_channel (tp_chat);
 
+  /* Messages of a chat which is already in the queue are counted in its
+   * event rather than each getting their own */
+  if (event != NULL)
+    {
+      event->public.count++;
+      header = g_strdup_printf (ngettext ("%u new message from %s",
+            "%u new messages from %s", event->public.count),
+          event->public.count, empathy_contact_get_name (sender));
+    }
+  else
+    {
+      header = g_strdup_printf (_("New message from %s"),
+          empathy_contact_get_name (sender));
+    }
+
   if (event != NULL)
     event_update (approval->manager, event, EMPATHY_IMAGE_NEW_MESSAGE, header, msg);
   else
@@ -447,7 +562,7 @@ static void
 event_manager_approval_done (EventManagerApproval *approval)
 {
   EmpathyEventManagerPriv *priv = GET_PRIV (approval->manager);
-  GSList                  *l;
+  EventPriv               *event;
 
   if (approval->operation != NULL)
     {
@@ -463,16 +578,9 @@ event_manager_approval_done (EventManagerApproval *approval)
 
   priv->approvals = g_slist_remove (priv->approvals, approval);
 
-  for (l = priv->events; l; l = l->next)
-    {
-      EventPriv *event = l->data;
-
-      if (event->approval == approval)
-        {
-          event_remove (event);
-          break;
-        }
-    }
+  event = event_lookup_by_approval (approval->manager, approval);
+  if (event != NULL)
+    event_remove (event);
 
   event_manager_approval_free (approval);
 }
@@ -903,14 +1011,15 @@ event_manager_pendings_changed_cb (EmpathyContactList  *list,
 
   if (!is_pending)
     {
-      GSList *l;
+      GQueue *events;
+      GList *l;
 
-      for (l = priv->events; l; l = l->next)
+      events = g_hash_table_lookup (priv->events_by_contact, contact);
+      for (l = events ? events->head : NULL; l; l = l->next)
         {
           EventPriv *event = l->data;
 
-          if (event->public.contact == contact &&
-              event->func == event_pending_subscribe_func)
+          if (event->func == event_pending_subscribe_func)
             {
               event_remove (event);
               break;
@@ -960,8 +1069,12 @@ event_manager_finalize (GObject *object)
 {
   EmpathyEventManagerPriv *priv = GET_PRIV (object);
 
-  g_slist_foreach (priv->events, (GFunc) event_free, NULL);
-  g_slist_free (priv->events);
+  if (priv->blink_timeout != 0)
+    g_source_remove (priv->blink_timeout);
+  g_hash_table_destroy (priv->events_by_approval);
+  g_hash_table_destroy (priv->events_by_contact);
+  g_queue_foreach (&priv->events, (GFunc) event_free, NULL);
+  g_queue_clear (&priv->events);
   g_slist_foreach (priv->approvals, (GFunc) event_manager_approval_free, NULL);
   g_slist_free (priv->approvals);
   g_object_unref (priv->contact_manager);
@@ -1004,6 +1117,14 @@ empathy_event_manager_class_init (EmpathyEventManagerClass *klass)
       g_cclosure_marshal_VOID__POINTER,
       G_TYPE_NONE, 1, G_TYPE_POINTER);
 
+  signals[BLINK] =
+  g_signal_new ("blink",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST,
+      0,
+      NULL, NULL,
+      g_cclosure_marshal_VOID__BOOLEAN,
+      G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
 
   g_type_class_add_private (object_class, sizeof (EmpathyEventManagerPriv));
 }
@@ -1016,6 +1137,11 @@ empathy_event_manager_init (EmpathyEventManager *manager)
 
   manager->priv = priv;
 
+  g_queue_init (&priv->events);
+  priv->events_by_approval = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->events_by_contact = g_hash_table_new_full (g_direct_hash,
+    g_direct_equal, NULL, (GDestroyNotify) g_queue_free);
+
   priv->dispatcher = empathy_dispatcher_dup_singleton ();
   priv->contact_manager = empathy_contact_manager_dup_singleton ();
   g_signal_connect (priv->dispatcher, "approve",
@@ -1030,14 +1156,71 @@ empathy_event_manager_dup_singleton (void)
   return g_object_new (EMPATHY_TYPE_EVENT_MANAGER, NULL);
 }
 
-GSList *
+GList *
 empathy_event_manager_get_events (EmpathyEventManager *manager)
 {
   EmpathyEventManagerPriv *priv = GET_PRIV (manager);
 
   g_return_val_if_fail (EMPATHY_IS_EVENT_MANAGER (manager), NULL);
 
-  return priv->events;
+  return priv->events.head;
+}
+
+guint
+empathy_event_manager_get_n_events (EmpathyEventManager *manager)
+{
+  EmpathyEventManagerPriv *priv = GET_PRIV (manager);
+
+  g_return_val_if_fail (EMPATHY_IS_EVENT_MANAGER (manager), 0);
+
+  return g_queue_get_length (&priv->events);
+}
+
+/* Returns the newest event of @contact, or NULL */
+EmpathyEvent *
+empathy_event_manager_get_contact_event (EmpathyEventManager *manager,
+  EmpathyContact *contact)
+{
+  EmpathyEventManagerPriv *priv = GET_PRIV (manager);
+  GQueue *events;
+
+  g_return_val_if_fail (EMPATHY_IS_EVENT_MANAGER (manager), NULL);
+
+  events = g_hash_table_lookup (priv->events_by_contact, contact);
+
+  return events ? g_queue_peek_head (events) : NULL;
+}
+
+guint
+empathy_event_manager_get_n_contact_events (EmpathyEventManager *manager,
+  EmpathyContact *contact)
+{
+  EmpathyEventManagerPriv *priv = GET_PRIV (manager);
+  GQueue *events;
+
+  g_return_val_if_fail (EMPATHY_IS_EVENT_MANAGER (manager), 0);
+
+  events = g_hash_table_lookup (priv->events_by_contact, contact);
+
+  return events ? g_queue_get_length (events) : 0;
+}
+
+/* Calls @func with the newest event of each contact having events */
+void
+empathy_event_manager_foreach_contact_event (EmpathyEventManager *manager,
+  EmpathyEventFunc func,
+  gpointer user_data)
+{
+  EmpathyEventManagerPriv *priv = GET_PRIV (manager);
+  GHashTableIter iter;
+  gpointer value;
+
+  g_return_if_fail (EMPATHY_IS_EVENT_MANAGER (manager));
+  g_return_if_fail (func != NULL);
+
+  g_hash_table_iter_init (&iter, priv->events_by_contact);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    func (g_queue_peek_head (value), user_data);
 }
 
 EmpathyEvent *
@@ -1047,7 +1230,17 @@ empathy_event_manager_get_top_event (EmpathyEventManager *manager)
 
   g_return_val_if_fail (EMPATHY_IS_EVENT_MANAGER (manager), NULL);
 
-  return priv->events ? priv->events->data : NULL;
+  return g_queue_peek_head (&priv->events);
+}
+
+gboolean
+empathy_event_manager_get_blink_on (EmpathyEventManager *manager)
+{
+  EmpathyEventManagerPriv *priv = GET_PRIV (manager);
+
+  g_return_val_if_fail (EMPATHY_IS_EVENT_MANAGER (manager), FALSE);
+
+  return priv->blink_on;
 }
 
 void
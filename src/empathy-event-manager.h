@@ -53,12 +53,26 @@ typedef struct {
 	gchar          *icon_name;
 	gchar          *header;
 	gchar          *message;
+	/* Number of messages the event stands for */
+	guint           count;
 } EmpathyEvent;
 
+typedef void (*EmpathyEventFunc) (EmpathyEvent *event,
+				  gpointer      user_data);
+
 GType                empathy_event_manager_get_type      (void) G_GNUC_CONST;
 EmpathyEventManager *empathy_event_manager_dup_singleton (void);
 EmpathyEvent *       empathy_event_manager_get_top_event (EmpathyEventManager *manager);
-GSList *             empathy_event_manager_get_events    (EmpathyEventManager *manager);
+GList *              empathy_event_manager_get_events    (EmpathyEventManager *manager);
+guint                empathy_event_manager_get_n_events  (EmpathyEventManager *manager);
+EmpathyEvent *       empathy_event_manager_get_contact_event (EmpathyEventManager *manager,
+							      EmpathyContact      *contact);
+guint                empathy_event_manager_get_n_contact_events (EmpathyEventManager *manager,
+								 EmpathyContact      *contact);
+void                 empathy_event_manager_foreach_contact_event (EmpathyEventManager *manager,
+								  EmpathyEventFunc     func,
+								  gpointer             user_data);
+gboolean             empathy_event_manager_get_blink_on  (EmpathyEventManager *manager);
 void                 empathy_event_activate              (EmpathyEvent        *event);
 void                 empathy_event_inhibit_updates       (EmpathyEvent        *event);
 
@@ -36,6 +36,7 @@
 
 #define DEBUG_FLAG EMPATHY_DEBUG_FT
 #include <libempathy/empathy-debug.h>
+#include <libempathy/empathy-file-copy.h>
 #include <libempathy/empathy-tp-file.h>
 #include <libempathy/empathy-utils.h>
 
@@ -57,8 +58,15 @@
  * The #EmpathyFTManager object represents the file transfer dialog,
  * it can show multiple file transfers at the same time (added
  * with empathy_ft_manager_add_tp_file()).
+ *
+ * Only a few transfers run at the same time, the others are held until one
+ * of them finishes. The order of the list is the order in which held
+ * transfers are started.
  */
 
+/* Used when the key isn't in the schemas */
+#define DEFAULT_MAX_CONCURRENT 3
+
 enum
 {
   COL_PERCENT,
@@ -83,15 +91,27 @@ struct _EmpathyFTManagerPriv
   GtkWidget *treeview;
   GtkWidget *open_button;
   GtkWidget *abort_button;
+  GtkWidget *up_button;
+  GtkWidget *down_button;
 
   guint save_geometry_id;
+  guint update_title_id;
+
+  /* Scheduling */
+  gint max_concurrent;
+  guint transfer_rate_limit;
+  guint notify_max_concurrent_id;
+  guint notify_rate_limit_id;
+  guint notify_transfer_rate_limit_id;
 };
 
 enum
 {
   RESPONSE_OPEN  = 1,
   RESPONSE_STOP  = 2,
-  RESPONSE_CLEAR = 3
+  RESPONSE_CLEAR = 3,
+  RESPONSE_UP    = 4,
+  RESPONSE_DOWN  = 5
 };
 
 G_DEFINE_TYPE (EmpathyFTManager, empathy_ft_manager, G_TYPE_OBJECT);
@@ -130,10 +150,13 @@ ft_manager_update_buttons (EmpathyFTManager *ft_manager)
   GtkTreeSelection *selection;
   GtkTreeModel *model;
   GtkTreeIter iter;
+  GtkTreePath *path;
   EmpathyTpFile *tp_file;
   TpFileTransferState state;
   gboolean open_enabled = FALSE;
   gboolean abort_enabled = FALSE;
+  gboolean up_enabled = FALSE;
+  gboolean down_enabled = FALSE;
 
   selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (
       ft_manager->priv->treeview));
@@ -150,16 +173,28 @@ ft_manager_update_buttons (EmpathyFTManager *ft_manager)
       abort_enabled = (state != TP_FILE_TRANSFER_STATE_CANCELLED &&
         state != TP_FILE_TRANSFER_STATE_COMPLETED);
 
+      /* I can move the transfer if it's not the first/last one */
+      path = gtk_tree_model_get_path (model, &iter);
+      up_enabled = gtk_tree_path_prev (path);
+      gtk_tree_path_free (path);
+      down_enabled = gtk_tree_model_iter_next (model, &iter);
+
       g_object_unref (tp_file);
     }
 
   gtk_widget_set_sensitive (ft_manager->priv->open_button, open_enabled);
   gtk_widget_set_sensitive (ft_manager->priv->abort_button, abort_enabled);
+  gtk_widget_set_sensitive (ft_manager->priv->up_button, up_enabled);
+  gtk_widget_set_sensitive (ft_manager->priv->down_button, down_enabled);
 }
 
 static const gchar *
 ft_manager_state_change_reason_to_string (TpFileTransferStateChangeReason reason)
 {
+  if (reason == (TpFileTransferStateChangeReason)
+      EMPATHY_TP_FILE_STATE_CHANGE_REASON_HASH_MISMATCH)
+    return _("The received file is corrupted");
+
   switch (reason)
     {
       case TP_FILE_TRANSFER_STATE_CHANGE_REASON_NONE:
@@ -178,6 +213,89 @@ ft_manager_state_change_reason_to_string (TpFileTransferStateChangeReason reason
   return _("Unknown reason");
 }
 
+static gdouble
+ft_manager_get_speed (EmpathyTpFile *tp_file)
+{
+  gdouble speed;
+
+  /* Prefer the throughput measured on our side of the socket, it's sampled
+   * more often than the one derived from the CM's progress signals. */
+  speed = empathy_tp_file_get_copy_rate (tp_file);
+  if (speed <= 0)
+    speed = empathy_tp_file_get_speed (tp_file);
+
+  return speed;
+}
+
+/* Shows the overall progress of the running transfers in the title, so it
+ * can be seen in the window list */
+static gboolean
+ft_manager_update_title_cb (gpointer user_data)
+{
+  EmpathyFTManager *ft_manager = user_data;
+  GHashTableIter iter;
+  gpointer key;
+  guint64 total_size = 0;
+  guint64 transferred_bytes = 0;
+  gdouble speed = 0;
+  guint n_running = 0;
+  gchar *title;
+
+  ft_manager->priv->update_title_id = 0;
+
+  g_hash_table_iter_init (&iter, ft_manager->priv->tp_file_to_row_ref);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      EmpathyTpFile *tp_file = key;
+      guint64 size;
+
+      if (empathy_tp_file_get_state (tp_file, NULL) !=
+          TP_FILE_TRANSFER_STATE_OPEN)
+        continue;
+
+      size = empathy_tp_file_get_size (tp_file);
+      if (size == EMPATHY_TP_FILE_UNKNOWN_SIZE)
+        continue;
+
+      total_size += size;
+      transferred_bytes += empathy_tp_file_get_transferred_bytes (tp_file);
+      speed += ft_manager_get_speed (tp_file);
+      n_running++;
+    }
+
+  if (n_running > 0 && total_size > 0)
+    {
+      gchar *speed_str;
+
+      speed_str = g_format_size_for_display (speed);
+      /* translators: first %d is the percentage of the data of all running
+       * transfers transferred so far, %s is their total speed */
+      title = g_strdup_printf (_("File transfers (%d%%, %s/s)"),
+          (gint) (transferred_bytes * 100 / total_size), speed_str);
+      g_free (speed_str);
+    }
+  else
+    {
+      title = g_strdup (_("File transfers"));
+    }
+
+  gtk_window_set_title (GTK_WINDOW (ft_manager->priv->window), title);
+  g_free (title);
+
+  return FALSE;
+}
+
+static void
+ft_manager_queue_update_title (EmpathyFTManager *ft_manager)
+{
+  if (ft_manager->priv->update_title_id != 0 ||
+      ft_manager->priv->window == NULL)
+    return;
+
+  ft_manager->priv->update_title_id = g_idle_add (ft_manager_update_title_cb,
+      ft_manager);
+}
+
 static void
 ft_manager_update_ft_row (EmpathyFTManager *ft_manager,
                           EmpathyTpFile *tp_file)
@@ -211,7 +329,7 @@ ft_manager_update_ft_row (EmpathyFTManager *ft_manager,
   total_size = empathy_tp_file_get_size (tp_file);
   state = empathy_tp_file_get_state (tp_file, &reason);
   incoming = empathy_tp_file_is_incoming (tp_file);
-  speed = empathy_tp_file_get_speed (tp_file);
+  speed = ft_manager_get_speed (tp_file);
 
   switch (state)
     {
@@ -232,7 +350,10 @@ ft_manager_update_ft_row (EmpathyFTManager *ft_manager,
 
         first_line = g_strdup_printf (first_line_format, filename, contact_name);
 
-        if (state == TP_FILE_TRANSFER_STATE_OPEN || incoming)
+        if (state != TP_FILE_TRANSFER_STATE_PENDING &&
+            empathy_tp_file_is_held (tp_file))
+          second_line = g_strdup (_("Waiting for other file transfers to complete"));
+        else if (state == TP_FILE_TRANSFER_STATE_OPEN || incoming)
           {
             gchar *total_size_str;
             gchar *transferred_bytes_str;
@@ -338,6 +459,7 @@ ft_manager_update_ft_row (EmpathyFTManager *ft_manager,
   g_free (remaining_str);
 
   ft_manager_update_buttons (ft_manager);
+  ft_manager_queue_update_title (ft_manager);
 }
 
 static void
@@ -347,6 +469,123 @@ ft_manager_refresh_cb (EmpathyTpFile *tp_file,
   ft_manager_update_ft_row (ft_manager, tp_file);
 }
 
+static void
+ft_manager_held_changed_cb (EmpathyTpFile *tp_file,
+                            GParamSpec *pspec,
+                            EmpathyFTManager *ft_manager)
+{
+  ft_manager_update_ft_row (ft_manager, tp_file);
+}
+
+static gboolean
+ft_manager_is_running (EmpathyTpFile *tp_file)
+{
+  TpFileTransferState state;
+
+  state = empathy_tp_file_get_state (tp_file, NULL);
+
+  return (state == TP_FILE_TRANSFER_STATE_ACCEPTED ||
+      state == TP_FILE_TRANSFER_STATE_OPEN);
+}
+
+/* Starts held transfers, in the order of the list, until max_concurrent
+ * transfers are running. Transfers still waiting for the other side to
+ * accept them don't count. */
+static void
+ft_manager_schedule (EmpathyFTManager *ft_manager)
+{
+  GtkTreeModel *model = ft_manager->priv->model;
+  GtkTreeIter iter;
+  gboolean valid;
+  gint max_concurrent = ft_manager->priv->max_concurrent;
+  gint running = 0;
+
+  if (ft_manager->priv->window == NULL)
+    return;
+
+  for (valid = gtk_tree_model_get_iter_first (model, &iter);
+       valid;
+       valid = gtk_tree_model_iter_next (model, &iter))
+    {
+      EmpathyTpFile *tp_file;
+
+      gtk_tree_model_get (model, &iter, COL_FT_OBJECT, &tp_file, -1);
+      if (ft_manager_is_running (tp_file) &&
+          !empathy_tp_file_is_held (tp_file))
+        running++;
+      g_object_unref (tp_file);
+    }
+
+  for (valid = gtk_tree_model_get_iter_first (model, &iter);
+       valid && (max_concurrent <= 0 || running < max_concurrent);
+       valid = gtk_tree_model_iter_next (model, &iter))
+    {
+      EmpathyTpFile *tp_file;
+
+      gtk_tree_model_get (model, &iter, COL_FT_OBJECT, &tp_file, -1);
+      if (empathy_tp_file_is_held (tp_file) &&
+          (max_concurrent <= 0 || ft_manager_is_running (tp_file)))
+        {
+          DEBUG ("Starting file transfer: filename=%s, %d running",
+              empathy_tp_file_get_filename (tp_file), running);
+          empathy_tp_file_set_held (tp_file, FALSE);
+          running++;
+        }
+      g_object_unref (tp_file);
+    }
+}
+
+static void
+ft_manager_release_foreach (gpointer key,
+                            gpointer value,
+                            gpointer user_data)
+{
+  g_signal_handlers_disconnect_by_func (key, ft_manager_held_changed_cb,
+      user_data);
+  empathy_tp_file_set_held (EMPATHY_TP_FILE (key), FALSE);
+}
+
+static void
+ft_manager_set_rate_limit_foreach (gpointer key,
+                                   gpointer value,
+                                   gpointer user_data)
+{
+  EmpathyFTManager *ft_manager = EMPATHY_FT_MANAGER (user_data);
+
+  g_object_set (key, "rate-limit", ft_manager->priv->transfer_rate_limit,
+      NULL);
+}
+
+static void
+ft_manager_conf_notify_cb (EmpathyConf *conf,
+                           const gchar *key,
+                           gpointer user_data)
+{
+  EmpathyFTManager *ft_manager = EMPATHY_FT_MANAGER (user_data);
+  gint value = -1;
+
+  /* An unset key leaves value at -1, which selects the defaults below */
+  empathy_conf_get_int (conf, key, &value);
+
+  if (!strcmp (key, EMPATHY_PREFS_FILE_TRANSFER_MAX_CONCURRENT))
+    {
+      ft_manager->priv->max_concurrent =
+          value >= 0 ? value : DEFAULT_MAX_CONCURRENT;
+      ft_manager_schedule (ft_manager);
+    }
+  else if (!strcmp (key, EMPATHY_PREFS_FILE_TRANSFER_RATE_LIMIT))
+    {
+      /* Limits are in kB/s in the preferences */
+      empathy_file_copy_set_global_rate_limit (MAX (value, 0) * 1024);
+    }
+  else if (!strcmp (key, EMPATHY_PREFS_FILE_TRANSFER_TRANSFER_RATE_LIMIT))
+    {
+      ft_manager->priv->transfer_rate_limit = MAX (value, 0) * 1024;
+      g_hash_table_foreach (ft_manager->priv->tp_file_to_row_ref,
+          ft_manager_set_rate_limit_foreach, ft_manager);
+    }
+}
+
 static void
 ft_manager_selection_changed (GtkTreeSelection *selection,
                               EmpathyFTManager *ft_manager)
@@ -488,6 +727,7 @@ ft_manager_state_changed_cb (EmpathyTpFile *tp_file,
     }
 
     ft_manager_update_ft_row (ft_manager, tp_file);
+    ft_manager_schedule (ft_manager);
 }
 
 static void
@@ -547,6 +787,44 @@ ft_manager_stop (EmpathyFTManager *ft_manager)
   g_object_unref (tp_file);
 }
 
+static void
+ft_manager_move (EmpathyFTManager *ft_manager,
+                 gboolean up)
+{
+  GtkTreeSelection *selection;
+  GtkTreeIter iter;
+  GtkTreeIter other;
+  GtkTreeModel *model;
+  GtkTreePath *path;
+  gboolean valid;
+
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (ft_manager->priv->treeview));
+
+  if (!gtk_tree_selection_get_selected (selection, &model, &iter))
+    return;
+
+  path = gtk_tree_model_get_path (model, &iter);
+  if (up)
+    valid = gtk_tree_path_prev (path);
+  else
+    {
+      gtk_tree_path_next (path);
+      valid = TRUE;
+    }
+
+  if (valid)
+    valid = gtk_tree_model_get_iter (model, &other, path);
+  gtk_tree_path_free (path);
+
+  if (!valid)
+    return;
+
+  /* Row references follow the rows when they are swapped */
+  gtk_list_store_swap (GTK_LIST_STORE (model), &iter, &other);
+  ft_manager_update_buttons (ft_manager);
+  ft_manager_schedule (ft_manager);
+}
+
 static void
 ft_manager_response_cb (GtkWidget *widget,
                         gint response,
@@ -563,6 +841,12 @@ ft_manager_response_cb (GtkWidget *widget,
       case RESPONSE_STOP:
         ft_manager_stop (ft_manager);
         break;
+      case RESPONSE_UP:
+        ft_manager_move (ft_manager, TRUE);
+        break;
+      case RESPONSE_DOWN:
+        ft_manager_move (ft_manager, FALSE);
+        break;
     }
 }
 
@@ -590,6 +874,15 @@ ft_manager_destroy_cb (GtkWidget *widget,
   ft_manager->priv->window = NULL;
   if (ft_manager->priv->save_geometry_id != 0)
     g_source_remove (ft_manager->priv->save_geometry_id);
+  if (ft_manager->priv->update_title_id != 0)
+    {
+      g_source_remove (ft_manager->priv->update_title_id);
+      ft_manager->priv->update_title_id = 0;
+    }
+
+  /* Nothing will start them anymore */
+  g_hash_table_foreach (ft_manager->priv->tp_file_to_row_ref,
+      ft_manager_release_foreach, ft_manager);
   g_hash_table_remove_all (ft_manager->priv->tp_file_to_row_ref);
 }
 
@@ -614,6 +907,8 @@ ft_manager_build_ui (EmpathyFTManager *ft_manager)
       "ft_list", &ft_manager->priv->treeview,
       "open_button", &ft_manager->priv->open_button,
       "abort_button", &ft_manager->priv->abort_button,
+      "up_button", &ft_manager->priv->up_button,
+      "down_button", &ft_manager->priv->down_button,
       NULL);
   g_free (filename);
 
@@ -714,9 +1009,16 @@ static void
 empathy_ft_manager_finalize (GObject *object)
 {
   EmpathyFTManager *ft_manager = (EmpathyFTManager *) object;
+  EmpathyConf *conf;
 
   DEBUG ("%p", object);
 
+  conf = empathy_conf_get ();
+  empathy_conf_notify_remove (conf, ft_manager->priv->notify_max_concurrent_id);
+  empathy_conf_notify_remove (conf, ft_manager->priv->notify_rate_limit_id);
+  empathy_conf_notify_remove (conf,
+      ft_manager->priv->notify_transfer_rate_limit_id);
+
   if (ft_manager->priv->window)
     gtk_widget_destroy (ft_manager->priv->window);
 
@@ -729,6 +1031,7 @@ static void
 empathy_ft_manager_init (EmpathyFTManager *ft_manager)
 {
   EmpathyFTManagerPriv *priv;
+  EmpathyConf *conf;
 
   priv = G_TYPE_INSTANCE_GET_PRIVATE ((ft_manager), EMPATHY_TYPE_FT_MANAGER,
       EmpathyFTManagerPriv);
@@ -738,6 +1041,25 @@ empathy_ft_manager_init (EmpathyFTManager *ft_manager)
   priv->tp_file_to_row_ref = g_hash_table_new_full (g_direct_hash,
       g_direct_equal, (GDestroyNotify) g_object_unref,
       (GDestroyNotify) gtk_tree_row_reference_free);
+
+  /* Scheduling preferences */
+  conf = empathy_conf_get ();
+  priv->notify_max_concurrent_id = empathy_conf_notify_add (conf,
+      EMPATHY_PREFS_FILE_TRANSFER_MAX_CONCURRENT,
+      ft_manager_conf_notify_cb, ft_manager);
+  priv->notify_rate_limit_id = empathy_conf_notify_add (conf,
+      EMPATHY_PREFS_FILE_TRANSFER_RATE_LIMIT,
+      ft_manager_conf_notify_cb, ft_manager);
+  priv->notify_transfer_rate_limit_id = empathy_conf_notify_add (conf,
+      EMPATHY_PREFS_FILE_TRANSFER_TRANSFER_RATE_LIMIT,
+      ft_manager_conf_notify_cb, ft_manager);
+
+  ft_manager_conf_notify_cb (conf,
+      EMPATHY_PREFS_FILE_TRANSFER_MAX_CONCURRENT, ft_manager);
+  ft_manager_conf_notify_cb (conf,
+      EMPATHY_PREFS_FILE_TRANSFER_RATE_LIMIT, ft_manager);
+  ft_manager_conf_notify_cb (conf,
+      EMPATHY_PREFS_FILE_TRANSFER_TRANSFER_RATE_LIMIT, ft_manager);
 }
 
 static GObject *
@@ -837,6 +1159,12 @@ ft_manager_add_tp_file_to_list (EmpathyFTManager *ft_manager,
   g_hash_table_insert (ft_manager->priv->tp_file_to_row_ref,
       g_object_ref (tp_file), row_ref);
 
+  /* Wait for a free slot, unless the data is already flowing */
+  g_object_set (tp_file, "rate-limit", ft_manager->priv->transfer_rate_limit,
+      NULL);
+  if (empathy_tp_file_get_state (tp_file, NULL) != TP_FILE_TRANSFER_STATE_OPEN)
+    empathy_tp_file_set_held (tp_file, TRUE);
+
   /* Select the new row */
   selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (
       ft_manager->priv->treeview));
@@ -848,6 +1176,9 @@ ft_manager_add_tp_file_to_list (EmpathyFTManager *ft_manager,
       G_CALLBACK (ft_manager_state_changed_cb), ft_manager);
   g_signal_connect (tp_file, "refresh",
       G_CALLBACK (ft_manager_refresh_cb), ft_manager);
+  g_signal_connect (tp_file, "notify::held",
+      G_CALLBACK (ft_manager_held_changed_cb), ft_manager);
+  ft_manager_schedule (ft_manager);
 
   gtk_window_present (GTK_WINDOW (ft_manager->priv->window));
 }
@@ -886,7 +1217,9 @@ ft_manager_save_dialog_response_cb (GtkDialog *widget,
           GError *error = NULL;
 
           file = g_file_new_for_uri (uri);
-          empathy_tp_file_accept (response_data->tp_file, 0, file, &error);
+          empathy_tp_file_accept (response_data->tp_file,
+              empathy_tp_file_get_resume_offset (response_data->tp_file, file),
+              file, &error);
 
           if (error)
             {
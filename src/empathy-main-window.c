@@ -64,9 +64,6 @@
 #define DEBUG_FLAG EMPATHY_DEBUG_OTHER
 #include <libempathy/empathy-debug.h>
 
-/* Flashing delay for icons (milliseconds). */
-#define FLASH_TIMEOUT 500
-
 /* Minimum width of roster window if something goes wrong. */
 #define MIN_WIDTH 50
 
@@ -83,8 +80,8 @@ typedef struct {
 	EmpathyAccountManager   *account_manager;
 	EmpathyChatroomManager  *chatroom_manager;
 	EmpathyEventManager     *event_manager;
-	guint                    flash_timeout_id;
-	gboolean                 flash_on;
+	/* Created when the file transfers are first shown */
+	EmpathyFTManager        *ft_manager;
 
 	GtkWidget              *window;
 	GtkWidget              *main_vbox;
@@ -102,6 +99,7 @@ typedef struct {
 	GtkWidget              *edit_context_separator;
 
 	guint                   size_timeout_id;
+	guint                   favorite_chatrooms_id;
 	GHashTable             *errors;
 
 	/* Actions that are enabled when there are connected accounts */
@@ -111,120 +109,73 @@ typedef struct {
 static EmpathyMainWindow *window = NULL;
 
 static void
-main_window_flash_stop (EmpathyMainWindow *window)
+main_window_flash_event (EmpathyMainWindow *window,
+			 EmpathyEvent      *event,
+			 gboolean           on)
 {
-	if (window->flash_timeout_id == 0) {
-		return;
-	}
-
-	DEBUG ("Stop flashing");
-	g_source_remove (window->flash_timeout_id);
-	window->flash_timeout_id = 0;
-	window->flash_on = FALSE;
-}
-
-typedef struct {
-	EmpathyEvent *event;
-	gboolean      on;
-} FlashForeachData;
-
-static gboolean
-main_window_flash_foreach (GtkTreeModel *model,
-			   GtkTreePath  *path,
-			   GtkTreeIter  *iter,
-			   gpointer      user_data)
-{
-	FlashForeachData *data = (FlashForeachData *) user_data;
-	EmpathyContact   *contact;
-	const gchar      *icon_name;
-	GtkTreePath      *parent_path = NULL;
-	GtkTreeIter       parent_iter;
-
-	/* To be used with gtk_tree_model_foreach, update the status icon
-	 * of the contact to show the event icon (on=TRUE) or the presence
-	 * (on=FALSE) */
-	gtk_tree_model_get (model, iter,
-			    EMPATHY_CONTACT_LIST_STORE_COL_CONTACT, &contact,
-			    -1);
-
-	if (contact != data->event->contact) {
-		if (contact) {
-			g_object_unref (contact);
-		}
-		return FALSE;
-	}
+	GtkTreeModel *model;
+	GList        *iters, *l;
+	const gchar  *icon_name;
 
-	if (data->on) {
-		icon_name = data->event->icon_name;
+	/* Update the status icon of the rows of the event's contact to show
+	 * the event icon (on=TRUE) or the presence (on=FALSE) */
+	model = GTK_TREE_MODEL (window->list_store);
+	iters = empathy_contact_list_store_find_contact (window->list_store,
+							 event->contact);
+	if (on) {
+		icon_name = event->icon_name;
 	} else {
-		icon_name = empathy_icon_name_for_contact (contact);
+		icon_name = empathy_icon_name_for_contact (event->contact);
 	}
 
-	gtk_tree_store_set (GTK_TREE_STORE (model), iter,
-			    EMPATHY_CONTACT_LIST_STORE_COL_ICON_STATUS, icon_name,
-			    -1);
+	for (l = iters; l; l = l->next) {
+		GtkTreeIter  parent_iter;
+		GtkTreePath *parent_path;
 
-	/* To make sure the parent is shown correctly, we emit
-	 * the row-changed signal on the parent so it prompts
-	 * it to be refreshed by the filter func.
-	 */
-	if (gtk_tree_model_iter_parent (model, &parent_iter, iter)) {
-		parent_path = gtk_tree_model_get_path (model, &parent_iter);
-	}
-	if (parent_path) {
-		gtk_tree_model_row_changed (model, parent_path, &parent_iter);
-		gtk_tree_path_free (parent_path);
-	}
+		gtk_tree_store_set (GTK_TREE_STORE (model), l->data,
+				    EMPATHY_CONTACT_LIST_STORE_COL_ICON_STATUS, icon_name,
+				    -1);
 
-	g_object_unref (contact);
+		/* To make sure the parent is shown correctly, we emit
+		 * the row-changed signal on the parent so it prompts
+		 * it to be refreshed by the filter func.
+		 */
+		if (gtk_tree_model_iter_parent (model, &parent_iter, l->data)) {
+			parent_path = gtk_tree_model_get_path (model, &parent_iter);
+			gtk_tree_model_row_changed (model, parent_path, &parent_iter);
+			gtk_tree_path_free (parent_path);
+		}
+	}
 
-	return FALSE;
+	g_list_foreach (iters, (GFunc) gtk_tree_iter_free, NULL);
+	g_list_free (iters);
 }
 
-static gboolean
-main_window_flash_cb (EmpathyMainWindow *window)
-{
-	GtkTreeModel     *model;
-	GSList           *events, *l;
-	gboolean          found_event = FALSE;
-	FlashForeachData  data;
-
-	window->flash_on = !window->flash_on;
-	data.on = window->flash_on;
-	model = GTK_TREE_MODEL (window->list_store);
-
-	events = empathy_event_manager_get_events (window->event_manager);
-	for (l = events; l; l = l->next) {
-		data.event = l->data;
-		if (!data.event->contact) {
-			continue;
-		}
-
-		found_event = TRUE;
-		gtk_tree_model_foreach (model,
-					main_window_flash_foreach,
-					&data);
-	}
+typedef struct {
+	EmpathyMainWindow *window;
+	gboolean           on;
+} BlinkData;
 
-	if (!found_event) {
-		main_window_flash_stop (window);
-	}
+static void
+main_window_blink_event (EmpathyEvent *event,
+			 gpointer      user_data)
+{
+	BlinkData *data = user_data;
 
-	return TRUE;
+	main_window_flash_event (data->window, event, data->on);
 }
 
 static void
-main_window_flash_start (EmpathyMainWindow *window)
+main_window_blink_cb (EmpathyEventManager *manager,
+		      gboolean             on,
+		      EmpathyMainWindow   *window)
 {
-	if (window->flash_timeout_id != 0) {
-		return;
-	}
+	BlinkData data = { window, on };
 
-	DEBUG ("Start flashing");
-	window->flash_timeout_id = g_timeout_add (FLASH_TIMEOUT,
-						  (GSourceFunc) main_window_flash_cb,
-						  window);
-	main_window_flash_cb (window);
+	/* Contacts with several events show their newest one */
+	empathy_event_manager_foreach_contact_event (manager,
+						     main_window_blink_event,
+						     &data);
 }
 
 static void
@@ -233,7 +184,8 @@ main_window_event_added_cb (EmpathyEventManager *manager,
 			    EmpathyMainWindow   *window)
 {
 	if (event->contact) {
-		main_window_flash_start (window);
+		main_window_flash_event (window, event,
+					 empathy_event_manager_get_blink_on (manager));
 	}
 }
 
@@ -242,17 +194,19 @@ main_window_event_removed_cb (EmpathyEventManager *manager,
 			      EmpathyEvent        *event,
 			      EmpathyMainWindow   *window)
 {
-	FlashForeachData data;
+	EmpathyEvent *next;
 
 	if (!event->contact) {
 		return;
 	}
 
-	data.on = FALSE;
-	data.event = event;
-	gtk_tree_model_foreach (GTK_TREE_MODEL (window->list_store),
-				main_window_flash_foreach,
-				&data);
+	next = empathy_event_manager_get_contact_event (manager, event->contact);
+	if (next) {
+		main_window_flash_event (window, next,
+					 empathy_event_manager_get_blink_on (manager));
+	} else {
+		main_window_flash_event (window, event, FALSE);
+	}
 }
 
 static void
@@ -264,7 +218,7 @@ main_window_row_activated_cb (EmpathyContactListView *view,
 	EmpathyContact *contact;
 	GtkTreeModel   *model;
 	GtkTreeIter     iter;
-	GSList         *events, *l;
+	EmpathyEvent   *event;
 
 	model = GTK_TREE_MODEL (window->list_store);
 	gtk_tree_model_get_iter (model, &iter, path);
@@ -278,19 +232,15 @@ main_window_row_activated_cb (EmpathyContactListView *view,
 
 	/* If the contact has an event activate it, otherwise the
 	 * default handler of row-activated will be called. */
-	events = empathy_event_manager_get_events (window->event_manager);
-	for (l = events; l; l = l->next) {
-		EmpathyEvent *event = l->data;
-
-		if (event->contact == contact) {
-			DEBUG ("Activate event");
-			empathy_event_activate (event);
-
-			/* We don't want the default handler of this signal
-			 * (e.g. open a chat) */
-			g_signal_stop_emission_by_name (view, "row-activated");
-			break;
-		}
+	event = empathy_event_manager_get_contact_event (window->event_manager,
+							 contact);
+	if (event) {
+		DEBUG ("Activate event");
+		empathy_event_activate (event);
+
+		/* We don't want the default handler of this signal
+		 * (e.g. open a chat) */
+		g_signal_stop_emission_by_name (view, "row-activated");
 	}
 
 	g_object_unref (contact);
@@ -637,6 +587,10 @@ main_window_destroy_cb (GtkWidget         *widget,
 		g_source_remove (window->size_timeout_id);
 	}
 
+	if (window->favorite_chatrooms_id) {
+		g_source_remove (window->favorite_chatrooms_id);
+	}
+
 	g_list_free (window->actions_connected);
 
 	g_object_unref (window->mc);
@@ -650,9 +604,16 @@ main_window_destroy_cb (GtkWidget         *widget,
 	g_signal_handlers_disconnect_by_func (window->event_manager,
 			  		      main_window_event_removed_cb,
 			  		      window);
+	g_signal_handlers_disconnect_by_func (window->event_manager,
+			  		      main_window_blink_cb,
+			  		      window);
 	g_object_unref (window->event_manager);
 	g_object_unref (window->ui_manager);
 
+	if (window->ft_manager) {
+		g_object_unref (window->ft_manager);
+	}
+
 	g_free (window);
 }
 
@@ -688,14 +649,15 @@ static void
 main_window_view_show_ft_manager (GtkAction         *action,
 				  EmpathyMainWindow *window)
 {
-	EmpathyFTManager *manager;
 	GtkWidget *dialog;
 
-	manager = empathy_ft_manager_dup_singleton ();
-	dialog = empathy_ft_manager_get_dialog (manager);
+	/* Keep the manager, its dialog goes away with it */
+	if (!window->ft_manager) {
+		window->ft_manager = empathy_ft_manager_dup_singleton ();
+	}
 
+	dialog = empathy_ft_manager_get_dialog (window->ft_manager);
 	gtk_window_present (GTK_WINDOW (dialog));
-	g_object_unref (manager);
 }
 
 static void
@@ -809,26 +771,22 @@ main_window_favorite_chatroom_menu_removed_cb (EmpathyChatroomManager *manager,
 	g_list_free (chatrooms);
 }
 
-static void
-main_window_favorite_chatroom_menu_setup (EmpathyMainWindow *window)
+/* Fills the menu once the window is shown, so chatrooms.xml is not
+ * parsed before the first frame */
+static gboolean
+main_window_favorite_chatroom_menu_fill_cb (EmpathyMainWindow *window)
 {
 	GList *chatrooms, *l;
-	GtkWidget *room;
 
-	window->chatroom_manager = empathy_chatroom_manager_dup_singleton (NULL);
-	chatrooms = empathy_chatroom_manager_get_chatrooms (window->chatroom_manager, NULL);
-	room = gtk_ui_manager_get_widget (window->ui_manager,
-		"/menubar/room");
-	window->room_menu = gtk_menu_item_get_submenu (GTK_MENU_ITEM (room));
-	window->room_separator = gtk_ui_manager_get_widget (window->ui_manager,
-		"/menubar/room/room_separator");
+	window->favorite_chatrooms_id = 0;
 
+	chatrooms = empathy_chatroom_manager_get_chatrooms (window->chatroom_manager, NULL);
 	for (l = chatrooms; l; l = l->next) {
 		main_window_favorite_chatroom_menu_add (window, l->data);
 	}
 
-	if (!chatrooms) {
-		gtk_widget_hide (window->room_separator);
+	if (chatrooms) {
+		gtk_widget_show (window->room_separator);
 	}
 
 	gtk_action_set_sensitive (window->room_join_favorites, chatrooms != NULL);
@@ -841,6 +799,28 @@ main_window_favorite_chatroom_menu_setup (EmpathyMainWindow *window)
 			  window);
 
 	g_list_free (chatrooms);
+
+	return FALSE;
+}
+
+static void
+main_window_favorite_chatroom_menu_setup (EmpathyMainWindow *window)
+{
+	GtkWidget *room;
+
+	window->chatroom_manager = empathy_chatroom_manager_dup_singleton (NULL);
+	room = gtk_ui_manager_get_widget (window->ui_manager,
+		"/menubar/room");
+	window->room_menu = gtk_menu_item_get_submenu (GTK_MENU_ITEM (room));
+	window->room_separator = gtk_ui_manager_get_widget (window->ui_manager,
+		"/menubar/room/room_separator");
+
+	gtk_widget_hide (window->room_separator);
+	gtk_action_set_sensitive (window->room_join_favorites, FALSE);
+
+	window->favorite_chatrooms_id = g_idle_add_full (G_PRIORITY_LOW,
+		(GSourceFunc) main_window_favorite_chatroom_menu_fill_cb,
+		window, NULL);
 }
 
 static void
@@ -1114,7 +1094,7 @@ empathy_main_window_show (void)
 	gboolean                  compact_contact_list;
 	gint                      x, y, w, h;
 	gchar                    *filename;
-	GSList                   *l;
+	GList                    *l;
 
 	if (window) {
 		empathy_window_present (GTK_WINDOW (window->window), TRUE);
@@ -1272,6 +1252,9 @@ empathy_main_window_show (void)
 	g_signal_connect (window->event_manager, "event-removed",
 			  G_CALLBACK (main_window_event_removed_cb),
 			  window);
+	g_signal_connect (window->event_manager, "blink",
+			  G_CALLBACK (main_window_blink_cb),
+			  window);
 
 	g_signal_connect (window->account_manager, "account-created",
 			  G_CALLBACK (main_window_account_created_or_deleted_cb),
@@ -86,6 +86,8 @@ empathy_map_view_show (void)
       return window->window;
     }
 
+  empathy_gtk_clutter_init ();
+
   window = g_slice_new0 (EmpathyMapView);
 
   /* Set up interface */
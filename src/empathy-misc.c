@@ -51,25 +51,17 @@ empathy_misc_get_pixbuf_for_notification (EmpathyContact *contact,
 gboolean
 empathy_notification_is_enabled (void)
 {
-	EmpathyConf *conf;
-	gboolean res;
+	const EmpathyConfCache *cache;
 
-	conf = empathy_conf_get ();
-	res = FALSE;
+	cache = empathy_conf_get_cache (empathy_conf_get ());
 
-	empathy_conf_get_bool (conf, EMPATHY_PREFS_NOTIFICATIONS_ENABLED, &res);
-
-	if (!res) {
+	if (!cache->notifications_enabled) {
 		return FALSE;
 	}
 
-	if (!empathy_check_available_state ()) {
-		empathy_conf_get_bool (conf,
-				       EMPATHY_PREFS_NOTIFICATIONS_DISABLED_AWAY,
-				       &res);
-		if (res) {
-			return FALSE;
-		}
+	if (!empathy_check_available_state () &&
+	    cache->notifications_disabled_away) {
+		return FALSE;
 	}
 
 	return TRUE;
@@ -50,6 +50,22 @@
 #define DEBUG_FLAG EMPATHY_DEBUG_OTHER
 #include <libempathy/empathy-debug.h>
 
+/* Past this many rows to show or hide, the view is rebuilt instead */
+#define REBUILD_THRESHOLD 1000
+
+/* A listed room, the strings are kept in the dialog's room_strings */
+typedef struct {
+	const gchar *name;
+	const gchar *room;
+	const gchar *collate_key;
+	const gchar *filter_key;
+	guint        members_count;
+	gboolean     invite_only;
+	gboolean     need_password;
+	gboolean     visible;
+	GtkTreeIter  iter;
+} NewChatroomDialogRoom;
+
 typedef struct {
 	EmpathyTpRoomlist *room_list;
 
@@ -66,22 +82,31 @@ typedef struct {
 	GtkWidget         *throbber;
 	GtkWidget         *treeview;
 	GtkTreeModel      *model;
+	GtkWidget         *entry_filter;
 	GtkWidget         *button_join;
 	GtkWidget         *label_error_message;
 	GtkWidget         *viewport_error;
+
+	/* All listed rooms, the model only holds those matching the filter */
+	GPtrArray         *rooms;
+	GStringChunk      *room_strings;
+	gchar             *filter;
 } EmpathyNewChatroomDialog;
 
 enum {
-	COL_NEED_PASSWORD,
-	COL_INVITE_ONLY,
-	COL_NAME,
-	COL_ROOM,
-	COL_MEMBERS,
-	COL_MEMBERS_INT,
-	COL_TOOLTIP,
+	COL_ROOM_DATA,
 	COL_COUNT
 };
 
+/* Columns of the view, each is also the ID of the sort function ordering
+ * rooms by it */
+enum {
+	VIEW_COL_INVITE_ONLY,
+	VIEW_COL_NEED_PASSWORD,
+	VIEW_COL_NAME,
+	VIEW_COL_MEMBERS
+};
+
 static void     new_chatroom_dialog_response_cb                     (GtkWidget               *widget,
 								     gint                     response,
 								     EmpathyNewChatroomDialog *dialog);
@@ -94,8 +119,8 @@ static void     new_chatroom_dialog_account_changed_cb              (GtkComboBox
 								     EmpathyNewChatroomDialog *dialog);
 static void     new_chatroom_dialog_roomlist_destroy_cb             (EmpathyTpRoomlist        *room_list,
 								     EmpathyNewChatroomDialog *dialog);
-static void     new_chatroom_dialog_new_room_cb                     (EmpathyTpRoomlist        *room_list,
-								     EmpathyChatroom          *chatroom,
+static void     new_chatroom_dialog_new_rooms_cb                    (EmpathyTpRoomlist        *room_list,
+								     GPtrArray                *rooms,
 								     EmpathyNewChatroomDialog *dialog);
 static void     new_chatroom_dialog_listing_cb                      (EmpathyTpRoomlist        *room_list,
 								     gpointer                  unused,
@@ -116,6 +141,14 @@ static void     new_chatroom_dialog_model_selection_changed         (GtkTreeSele
 static void     new_chatroom_dialog_join                            (EmpathyNewChatroomDialog *dialog);
 static void     new_chatroom_dialog_entry_changed_cb                (GtkWidget               *entry,
 								     EmpathyNewChatroomDialog *dialog);
+static void     new_chatroom_dialog_entry_filter_changed_cb         (GtkWidget               *entry,
+								     EmpathyNewChatroomDialog *dialog);
+static gboolean new_chatroom_dialog_query_tooltip_cb                (GtkWidget               *widget,
+								     gint                     x,
+								     gint                     y,
+								     gboolean                 keyboard_mode,
+								     GtkTooltip              *tooltip,
+								     EmpathyNewChatroomDialog *dialog);
 static void     new_chatroom_dialog_browse_start                    (EmpathyNewChatroomDialog *dialog);
 static void     new_chatroom_dialog_browse_stop                     (EmpathyNewChatroomDialog *dialog);
 static void     new_chatroom_dialog_entry_server_activate_cb        (GtkWidget               *widget,
@@ -154,6 +187,7 @@ empathy_new_chatroom_dialog_show (GtkWindow *parent)
 				       "label_room", &dialog->label_room,
 				       "entry_server", &dialog->entry_server,
 				       "entry_room", &dialog->entry_room,
+				       "entry_filter", &dialog->entry_filter,
 				       "treeview", &dialog->treeview,
 				       "button_join", &dialog->button_join,
 				       "expander_browse", &dialog->expander_browse,
@@ -169,6 +203,7 @@ empathy_new_chatroom_dialog_show (GtkWindow *parent)
 			      "entry_server", "activate", new_chatroom_dialog_entry_server_activate_cb,
 			      "entry_server", "focus-out-event", new_chatroom_dialog_entry_server_focus_out_cb,
 			      "entry_room", "changed", new_chatroom_dialog_entry_changed_cb,
+			      "entry_filter", "changed", new_chatroom_dialog_entry_filter_changed_cb,
 			      "expander_browse", "activate", new_chatroom_dialog_expander_browse_activate_cb,
 			      "button_close_error", "clicked", new_chatroom_dialog_button_close_error_clicked_cb,
 			      NULL);
@@ -241,17 +276,75 @@ new_chatroom_dialog_destroy_cb (GtkWidget               *widget,
 	if (dialog->room_list) {
 		g_object_unref (dialog->room_list);
 	}
+	new_chatroom_dialog_model_clear (dialog);
   	g_object_unref (dialog->model);
+	g_ptr_array_free (dialog->rooms, TRUE);
+	g_string_chunk_free (dialog->room_strings);
+	g_free (dialog->filter);
 
 	g_free (dialog);
 }
 
+static gint
+new_chatroom_dialog_model_sort_func (GtkTreeModel *model,
+				     GtkTreeIter  *iter_a,
+				     GtkTreeIter  *iter_b,
+				     gpointer      user_data)
+{
+	NewChatroomDialogRoom *a;
+	NewChatroomDialogRoom *b;
+	gint                   ret = 0;
+
+	gtk_tree_model_get (model, iter_a, COL_ROOM_DATA, &a, -1);
+	gtk_tree_model_get (model, iter_b, COL_ROOM_DATA, &b, -1);
+
+	switch (GPOINTER_TO_INT (user_data)) {
+	case VIEW_COL_INVITE_ONLY:
+		ret = a->invite_only - b->invite_only;
+		break;
+	case VIEW_COL_NEED_PASSWORD:
+		ret = a->need_password - b->need_password;
+		break;
+	case VIEW_COL_MEMBERS:
+		ret = (a->members_count > b->members_count) -
+		      (a->members_count < b->members_count);
+		break;
+	}
+
+	if (ret == 0) {
+		ret = strcmp (a->collate_key, b->collate_key);
+	}
+
+	return ret;
+}
+
+static gboolean
+new_chatroom_dialog_model_search_func (GtkTreeModel *model,
+				       gint          column,
+				       const gchar  *key,
+				       GtkTreeIter  *iter,
+				       gpointer      user_data)
+{
+	NewChatroomDialogRoom *room;
+	gchar                 *folded;
+	gboolean               ret;
+
+	gtk_tree_model_get (model, iter, COL_ROOM_DATA, &room, -1);
+	folded = g_utf8_casefold (key, -1);
+	ret = !g_str_has_prefix (room->filter_key, folded);
+	g_free (folded);
+
+	return ret;
+}
+
 static void
 new_chatroom_dialog_model_setup (EmpathyNewChatroomDialog *dialog)
 {
 	GtkTreeView      *view;
 	GtkListStore     *store;
+	GtkTreeSortable  *sortable;
 	GtkTreeSelection *selection;
+	gint              i;
 
 	/* View */
 	view = GTK_TREE_VIEW (dialog->treeview);
@@ -260,25 +353,37 @@ new_chatroom_dialog_model_setup (EmpathyNewChatroomDialog *dialog)
 			  G_CALLBACK (new_chatroom_dialog_model_row_activated_cb),
 			  dialog);
 
-	/* Store/Model */
+	/* Store/Model. Rows only point to the listed rooms, the view reads
+	 * them with cell data functions. */
 	store = gtk_list_store_new (COL_COUNT,
-				    G_TYPE_STRING,       /* Invite */
-				    G_TYPE_STRING,       /* Password */
-				    G_TYPE_STRING,       /* Name */
-				    G_TYPE_STRING,       /* Room */
-				    G_TYPE_STRING,       /* Member count */
-				    G_TYPE_INT,          /* Member count int */
-				    G_TYPE_STRING);      /* Tool tip */
+				    G_TYPE_POINTER);     /* Room */
+
+	sortable = GTK_TREE_SORTABLE (store);
+	for (i = VIEW_COL_INVITE_ONLY; i <= VIEW_COL_MEMBERS; i++) {
+		gtk_tree_sortable_set_sort_func (sortable, i,
+						 new_chatroom_dialog_model_sort_func,
+						 GINT_TO_POINTER (i), NULL);
+	}
+	gtk_tree_sortable_set_sort_column_id (sortable,
+					      VIEW_COL_NAME, GTK_SORT_ASCENDING);
 
 	dialog->model = GTK_TREE_MODEL (store);
 	gtk_tree_view_set_model (view, dialog->model);
-	gtk_tree_view_set_tooltip_column (view, COL_TOOLTIP);
-	gtk_tree_view_set_search_column (view, COL_NAME);
+	gtk_tree_view_set_search_equal_func (view,
+					     new_chatroom_dialog_model_search_func,
+					     NULL, NULL);
+
+	/* Tooltips are only built when shown */
+	g_object_set (view, "has-tooltip", TRUE, NULL);
+	g_signal_connect (view, "query-tooltip",
+			  G_CALLBACK (new_chatroom_dialog_query_tooltip_cb),
+			  dialog);
+
+	dialog->rooms = g_ptr_array_new ();
+	dialog->room_strings = g_string_chunk_new (4096);
 
 	/* Selection */
 	selection = gtk_tree_view_get_selection (view);
-	gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (store),
-					      COL_NAME, GTK_SORT_ASCENDING);
 
 	g_signal_connect (selection, "changed",
 			  G_CALLBACK (new_chatroom_dialog_model_selection_changed),
@@ -288,6 +393,79 @@ new_chatroom_dialog_model_setup (EmpathyNewChatroomDialog *dialog)
 	new_chatroom_dialog_model_add_columns (dialog);
 }
 
+static void
+new_chatroom_dialog_model_cell_data_func (GtkTreeViewColumn *column,
+					  GtkCellRenderer   *cell,
+					  GtkTreeModel      *model,
+					  GtkTreeIter       *iter,
+					  gpointer           user_data)
+{
+	NewChatroomDialogRoom *room;
+	gchar                  members[16];
+
+	gtk_tree_model_get (model, iter, COL_ROOM_DATA, &room, -1);
+
+	switch (GPOINTER_TO_INT (user_data)) {
+	case VIEW_COL_INVITE_ONLY:
+		g_object_set (cell, "stock-id",
+			      room->invite_only ? GTK_STOCK_INDEX : NULL,
+			      NULL);
+		break;
+	case VIEW_COL_NEED_PASSWORD:
+		g_object_set (cell, "stock-id",
+			      room->need_password ? GTK_STOCK_DIALOG_AUTHENTICATION : NULL,
+			      NULL);
+		break;
+	case VIEW_COL_NAME:
+		g_object_set (cell, "text", room->name, NULL);
+		break;
+	case VIEW_COL_MEMBERS:
+		g_snprintf (members, sizeof (members), "%u", room->members_count);
+		g_object_set (cell, "text", members, NULL);
+		break;
+	}
+}
+
+static gint
+new_chatroom_dialog_get_text_width (GtkWidget   *widget,
+				    const gchar *text)
+{
+	PangoLayout *layout;
+	gint         width;
+
+	layout = gtk_widget_create_pango_layout (widget, text);
+	pango_layout_get_pixel_size (layout, &width, NULL);
+	g_object_unref (layout);
+
+	return width;
+}
+
+static GtkTreeViewColumn *
+new_chatroom_dialog_model_add_column (EmpathyNewChatroomDialog *dialog,
+				      const gchar              *title,
+				      GtkCellRenderer          *cell,
+				      gint                      view_col,
+				      gint                      width)
+{
+	GtkTreeViewColumn *column;
+
+	column = gtk_tree_view_column_new ();
+	gtk_tree_view_column_set_title (column, title);
+	gtk_tree_view_column_pack_start (column, cell, TRUE);
+	gtk_tree_view_column_set_cell_data_func (column, cell,
+						 new_chatroom_dialog_model_cell_data_func,
+						 GINT_TO_POINTER (view_col), NULL);
+	gtk_tree_view_column_set_sort_column_id (column, view_col);
+
+	/* Rows are never measured, so huge lists stay cheap to show */
+	gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width (column, width);
+
+	gtk_tree_view_append_column (GTK_TREE_VIEW (dialog->treeview), column);
+
+	return column;
+}
+
 static void
 new_chatroom_dialog_model_add_columns (EmpathyNewChatroomDialog *dialog)
 {
@@ -306,21 +484,13 @@ new_chatroom_dialog_model_add_columns (EmpathyNewChatroomDialog *dialog)
 		      "height", height,
 		      "stock-size", GTK_ICON_SIZE_MENU,
 		      NULL);
-	column = gtk_tree_view_column_new_with_attributes (NULL,
-		                                           cell,
-		                                           "stock-id", COL_INVITE_ONLY,
-		                                           NULL);
-
-	gtk_tree_view_column_set_sort_column_id (column, COL_INVITE_ONLY);
-	gtk_tree_view_append_column (view, column);
+	gtk_cell_renderer_get_size (cell, dialog->treeview, NULL,
+				    NULL, NULL, &width, NULL);
 
-	column = gtk_tree_view_column_new_with_attributes (NULL,
-		                                           cell,
-		                                           "stock-id", COL_NEED_PASSWORD,
-		                                           NULL);
-
-	gtk_tree_view_column_set_sort_column_id (column, COL_NEED_PASSWORD);
-	gtk_tree_view_append_column (view, column);
+	new_chatroom_dialog_model_add_column (dialog, NULL, cell,
+					      VIEW_COL_INVITE_ONLY, width);
+	new_chatroom_dialog_model_add_column (dialog, NULL, cell,
+					      VIEW_COL_NEED_PASSWORD, width);
 
 	cell = gtk_cell_renderer_text_new ();
 	g_object_set (cell,
@@ -329,14 +499,9 @@ new_chatroom_dialog_model_add_columns (EmpathyNewChatroomDialog *dialog)
 		      "ellipsize", PANGO_ELLIPSIZE_END,
 		      NULL);
 
-	column = gtk_tree_view_column_new_with_attributes (_("Chat Room"),
-		                                           cell,
-		                                           "text", COL_NAME,
-		                                           NULL);
-
-	gtk_tree_view_column_set_sort_column_id (column, COL_NAME);
+	column = new_chatroom_dialog_model_add_column (dialog, _("Chat Room"),
+						       cell, VIEW_COL_NAME, 1);
 	gtk_tree_view_column_set_expand (column, TRUE);
-	gtk_tree_view_append_column (view, column);
 
 	cell = gtk_cell_renderer_text_new ();
 	g_object_set (cell,
@@ -345,13 +510,14 @@ new_chatroom_dialog_model_add_columns (EmpathyNewChatroomDialog *dialog)
 		      "ellipsize", PANGO_ELLIPSIZE_END,
 		      "alignment", PANGO_ALIGN_RIGHT,
 		      NULL);
-	column = gtk_tree_view_column_new_with_attributes (_("Members"),
-		                                           cell,
-		                                           "text", COL_MEMBERS,
-		                                           NULL);
 
-	gtk_tree_view_column_set_sort_column_id (column, COL_MEMBERS_INT);
-	gtk_tree_view_append_column (view, column);
+	/* Wide enough for the title and its sort arrow, or big numbers */
+	width = MAX (new_chatroom_dialog_get_text_width (dialog->treeview, _("Members")) + 20,
+		     new_chatroom_dialog_get_text_width (dialog->treeview, "000000")) + 8;
+	new_chatroom_dialog_model_add_column (dialog, _("Members"), cell,
+					      VIEW_COL_MEMBERS, width);
+
+	gtk_tree_view_set_fixed_height_mode (view, TRUE);
 }
 
 static void
@@ -418,8 +584,8 @@ new_chatroom_dialog_account_changed_cb (GtkComboBox             *combobox,
 		g_signal_connect (dialog->room_list, "destroy",
 				  G_CALLBACK (new_chatroom_dialog_roomlist_destroy_cb),
 				  dialog);
-		g_signal_connect (dialog->room_list, "new-room",
-				  G_CALLBACK (new_chatroom_dialog_new_room_cb),
+		g_signal_connect (dialog->room_list, "new-rooms",
+				  G_CALLBACK (new_chatroom_dialog_new_rooms_cb),
 				  dialog);
 		g_signal_connect (dialog->room_list, "notify::is-listing",
 				  G_CALLBACK (new_chatroom_dialog_listing_cb),
@@ -464,54 +630,125 @@ new_chatroom_dialog_roomlist_destroy_cb (EmpathyTpRoomlist        *room_list,
 	dialog->room_list = NULL;
 }
 
-static void
-new_chatroom_dialog_new_room_cb (EmpathyTpRoomlist        *room_list,
-				 EmpathyChatroom          *chatroom,
-				 EmpathyNewChatroomDialog *dialog)
+static gboolean
+new_chatroom_dialog_room_matches (EmpathyNewChatroomDialog *dialog,
+				  NewChatroomDialogRoom    *room)
 {
-	GtkTreeView      *view;
-	GtkTreeSelection *selection;
-	GtkListStore     *store;
-	GtkTreeIter       iter;
-	gchar            *members;
-	gchar            *tooltip;
-	const gchar      *need_password;
-	const gchar      *invite_only;
+	return dialog->filter == NULL ||
+	       strstr (room->filter_key, dialog->filter) != NULL;
+}
 
-	DEBUG ("New chatroom listed: %s (%s)",
-		empathy_chatroom_get_name (chatroom),
-		empathy_chatroom_get_room (chatroom));
+static void
+new_chatroom_dialog_model_show_room (EmpathyNewChatroomDialog *dialog,
+				     NewChatroomDialogRoom    *room,
+				     gboolean                  visible)
+{
+	GtkListStore *store;
 
-	/* Add to model */
-	view = GTK_TREE_VIEW (dialog->treeview);
-	selection = gtk_tree_view_get_selection (view);
 	store = GTK_LIST_STORE (dialog->model);
-	members = g_strdup_printf ("%d", empathy_chatroom_get_members_count (chatroom));
-	tooltip = g_strdup_printf (C_("Room/Join's roomlist tooltip. Parameters"
+	if (visible) {
+		/* The store is sorted, this is a binary insertion */
+		gtk_list_store_insert_with_values (store, &room->iter, -1,
+						   COL_ROOM_DATA, room,
+						   -1);
+	} else {
+		/* List store iters persist, no need to look the row up */
+		gtk_list_store_remove (store, &room->iter);
+	}
+	room->visible = visible;
+}
+
+static void
+new_chatroom_dialog_new_rooms_cb (EmpathyTpRoomlist        *room_list,
+				  GPtrArray                *rooms,
+				  EmpathyNewChatroomDialog *dialog)
+{
+	guint i;
+
+	DEBUG ("%d new chatrooms listed", rooms->len);
+
+	for (i = 0; i < rooms->len; i++) {
+		EmpathyTpRoomlistRoom *listed = g_ptr_array_index (rooms, i);
+		NewChatroomDialogRoom *room;
+		gchar                 *str;
+		gchar                 *folded;
+
+		if (listed->room == NULL) {
+			continue;
+		}
+
+		room = g_slice_new0 (NewChatroomDialogRoom);
+		room->room = g_string_chunk_insert (dialog->room_strings,
+						    listed->room);
+		if (EMP_STR_EMPTY (listed->name)) {
+			room->name = room->room;
+		} else {
+			room->name = g_string_chunk_insert (dialog->room_strings,
+							    listed->name);
+		}
+
+		str = g_utf8_collate_key (room->name, -1);
+		room->collate_key = g_string_chunk_insert (dialog->room_strings, str);
+		g_free (str);
+
+		/* The filter matches the name and the ID */
+		str = g_strconcat (room->name, "\n", room->room, NULL);
+		folded = g_utf8_casefold (str, -1);
+		room->filter_key = g_string_chunk_insert (dialog->room_strings,
+							  folded);
+		g_free (folded);
+		g_free (str);
+
+		room->members_count = listed->members_count;
+		room->invite_only = listed->invite_only;
+		room->need_password = listed->need_password;
+
+		g_ptr_array_add (dialog->rooms, room);
+		if (new_chatroom_dialog_room_matches (dialog, room)) {
+			new_chatroom_dialog_model_show_room (dialog, room, TRUE);
+		}
+	}
+}
+
+static gboolean
+new_chatroom_dialog_query_tooltip_cb (GtkWidget                *widget,
+				      gint                      x,
+				      gint                      y,
+				      gboolean                  keyboard_mode,
+				      GtkTooltip               *tooltip,
+				      EmpathyNewChatroomDialog *dialog)
+{
+	GtkTreeModel          *model;
+	GtkTreePath           *path;
+	GtkTreeIter            iter;
+	NewChatroomDialogRoom *room;
+	gchar                 *members;
+	gchar                 *markup;
+
+	if (!gtk_tree_view_get_tooltip_context (GTK_TREE_VIEW (widget),
+						&x, &y, keyboard_mode,
+						&model, &path, &iter)) {
+		return FALSE;
+	}
+
+	gtk_tree_model_get (model, &iter, COL_ROOM_DATA, &room, -1);
+
+	members = g_strdup_printf ("%d", room->members_count);
+	markup = g_markup_printf_escaped (C_("Room/Join's roomlist tooltip. Parameters"
 		"are a channel name, yes/no, yes/no and a number.",
 		"<b>%s</b>\nInvite required: %s\nPassword required: %s\nMembers: %s"),
-		empathy_chatroom_get_name (chatroom),
-		empathy_chatroom_get_invite_only (chatroom) ? _("Yes") : _("No"),
-		empathy_chatroom_get_need_password (chatroom) ? _("Yes") : _("No"),
+		room->name,
+		room->invite_only ? _("Yes") : _("No"),
+		room->need_password ? _("Yes") : _("No"),
 		members);
-	invite_only = (empathy_chatroom_get_invite_only (chatroom) ?
-		GTK_STOCK_INDEX : NULL);
-	need_password = (empathy_chatroom_get_need_password (chatroom) ?
-		GTK_STOCK_DIALOG_AUTHENTICATION : NULL);
-
-	gtk_list_store_append (store, &iter);
-	gtk_list_store_set (store, &iter,
-			    COL_NEED_PASSWORD, need_password,
-			    COL_INVITE_ONLY, invite_only,
-			    COL_NAME, empathy_chatroom_get_name (chatroom),
-			    COL_ROOM, empathy_chatroom_get_room (chatroom),
-			    COL_MEMBERS, members,
-			    COL_MEMBERS_INT, empathy_chatroom_get_members_count (chatroom),
-			    COL_TOOLTIP, tooltip,
-			    -1);
+	gtk_tooltip_set_markup (tooltip, markup);
+	gtk_tree_view_set_tooltip_row (GTK_TREE_VIEW (widget), tooltip, path);
 
+	gtk_tree_path_free (path);
 	g_free (members);
-	g_free (tooltip);
+	g_free (markup);
+
+	return TRUE;
 }
 
 static void
@@ -555,9 +792,17 @@ static void
 new_chatroom_dialog_model_clear (EmpathyNewChatroomDialog *dialog)
 {
 	GtkListStore *store;
+	guint         i;
 
 	store = GTK_LIST_STORE (dialog->model);
 	gtk_list_store_clear (store);
+
+	for (i = 0; i < dialog->rooms->len; i++) {
+		g_slice_free (NewChatroomDialogRoom,
+			      g_ptr_array_index (dialog->rooms, i));
+	}
+	g_ptr_array_set_size (dialog->rooms, 0);
+	g_string_chunk_clear (dialog->room_strings);
 }
 
 static void
@@ -573,16 +818,18 @@ static void
 new_chatroom_dialog_model_selection_changed (GtkTreeSelection         *selection,
 					     EmpathyNewChatroomDialog *dialog)
 {	
-	GtkTreeModel *model;
-	GtkTreeIter   iter;
-	gchar        *room = NULL;
-	gchar        *server = NULL;
+	GtkTreeModel          *model;
+	GtkTreeIter            iter;
+	NewChatroomDialogRoom *room_data;
+	gchar                 *room = NULL;
+	gchar                 *server = NULL;
 
 	if (!gtk_tree_selection_get_selected (selection, &model, &iter)) {
 		return;
 	}
 
-	gtk_tree_model_get (model, &iter, COL_ROOM, &room, -1);
+	gtk_tree_model_get (model, &iter, COL_ROOM_DATA, &room_data, -1);
+	room = g_strdup (room_data->room);
 	server = strstr (room, "@");
 	if (server) {
 		*server = '\0';
@@ -635,6 +882,67 @@ new_chatroom_dialog_entry_changed_cb (GtkWidget                *entry,
 	}
 }
 
+static void
+new_chatroom_dialog_entry_filter_changed_cb (GtkWidget                *entry,
+					     EmpathyNewChatroomDialog *dialog)
+{
+	const gchar *text;
+	gchar       *filter = NULL;
+	gboolean     narrower;
+	gboolean     wider;
+	GPtrArray   *changed;
+	guint        i;
+
+	text = gtk_entry_get_text (GTK_ENTRY (entry));
+	if (!EMP_STR_EMPTY (text)) {
+		filter = g_utf8_casefold (text, -1);
+	}
+
+	/* Rooms matching a filter also match any part of it. While typing
+	 * only shown rooms can disappear, and while erasing only hidden rooms
+	 * can come back. */
+	narrower = filter != NULL &&
+		   (dialog->filter == NULL || strstr (filter, dialog->filter) != NULL);
+	wider = dialog->filter != NULL &&
+		(filter == NULL || strstr (dialog->filter, filter) != NULL);
+
+	g_free (dialog->filter);
+	dialog->filter = filter;
+
+	changed = g_ptr_array_new ();
+	for (i = 0; i < dialog->rooms->len; i++) {
+		NewChatroomDialogRoom *room = g_ptr_array_index (dialog->rooms, i);
+
+		if (room->visible ? wider : narrower) {
+			continue;
+		}
+		if (new_chatroom_dialog_room_matches (dialog, room) != room->visible) {
+			g_ptr_array_add (changed, room);
+		}
+	}
+
+	DEBUG ("Filter '%s' shows or hides %d rooms", text, changed->len);
+
+	/* Detach the model while making lots of changes, the view is faster
+	 * at building itself than at following them */
+	if (changed->len > REBUILD_THRESHOLD) {
+		gtk_tree_view_set_model (GTK_TREE_VIEW (dialog->treeview), NULL);
+	}
+
+	for (i = 0; i < changed->len; i++) {
+		NewChatroomDialogRoom *room = g_ptr_array_index (changed, i);
+
+		new_chatroom_dialog_model_show_room (dialog, room, !room->visible);
+	}
+
+	if (changed->len > REBUILD_THRESHOLD) {
+		gtk_tree_view_set_model (GTK_TREE_VIEW (dialog->treeview),
+					 dialog->model);
+	}
+
+	g_ptr_array_free (changed, TRUE);
+}
+
 static void
 new_chatroom_dialog_browse_start (EmpathyNewChatroomDialog *dialog)
 {
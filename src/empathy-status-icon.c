@@ -47,16 +47,12 @@
 #define DEBUG_FLAG EMPATHY_DEBUG_DISPATCHER
 #include <libempathy/empathy-debug.h>
 
-/* Number of ms to wait when blinking */
-#define BLINK_TIMEOUT 500
-
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyStatusIcon)
 typedef struct {
 	GtkStatusIcon       *icon;
 	EmpathyIdle         *idle;
 	EmpathyAccountManager *account_manager;
 	gboolean             showing_event_icon;
-	guint                blink_timeout;
 	EmpathyEventManager *event_manager;
 	EmpathyEvent        *event;
 	NotifyNotification  *notification;
@@ -204,16 +200,17 @@ status_icon_update_icon (EmpathyStatusIcon *icon)
 	gtk_status_icon_set_from_icon_name (priv->icon, icon_name);
 }
 
-static gboolean
-status_icon_blink_timeout_cb (EmpathyStatusIcon *icon)
+static void
+status_icon_blink_cb (EmpathyEventManager *manager,
+		      gboolean             on,
+		      EmpathyStatusIcon   *icon)
 {
 	EmpathyStatusIconPriv *priv = GET_PRIV (icon);
 
-	priv->showing_event_icon = !priv->showing_event_icon;
+	priv->showing_event_icon = on;
 	status_icon_update_icon (icon);
-
-	return TRUE;
 }
+
 static void
 status_icon_event_added_cb (EmpathyEventManager *manager,
 			    EmpathyEvent        *event,
@@ -228,17 +225,11 @@ status_icon_event_added_cb (EmpathyEventManager *manager,
 	DEBUG ("New event %p", event);
 
 	priv->event = event;
-	priv->showing_event_icon = TRUE;
+	priv->showing_event_icon = empathy_event_manager_get_blink_on (manager);
 
 	status_icon_update_icon (icon);
 	status_icon_update_tooltip (icon);
 	status_icon_update_notification (icon);
-
-	if (!priv->blink_timeout) {
-		priv->blink_timeout = g_timeout_add (BLINK_TIMEOUT,
-						     (GSourceFunc) status_icon_blink_timeout_cb,
-						     icon);
-	}
 }
 
 static void
@@ -261,11 +252,6 @@ status_icon_event_removed_cb (EmpathyEventManager *manager,
 	 * changed presence in the meanwhile
 	 */	
 	status_icon_update_notification (icon);
-
-	if (!priv->event && priv->blink_timeout) {
-		g_source_remove (priv->blink_timeout);
-		priv->blink_timeout = 0;
-	}
 }
 
 static void
@@ -500,10 +486,9 @@ status_icon_finalize (GObject *object)
 {
 	EmpathyStatusIconPriv *priv = GET_PRIV (object);
 
-	if (priv->blink_timeout) {
-		g_source_remove (priv->blink_timeout);
-	}
-
+	g_signal_handlers_disconnect_by_func (priv->event_manager,
+					      status_icon_blink_cb,
+					      object);
 	g_signal_handlers_disconnect_by_func (priv->account_manager,
 					      status_icon_connection_changed_cb,
 					      object);
@@ -568,6 +553,9 @@ empathy_status_icon_init (EmpathyStatusIcon *icon)
 	g_signal_connect (priv->event_manager, "event-updated",
 			  G_CALLBACK (status_icon_event_updated_cb),
 			  icon);
+	g_signal_connect (priv->event_manager, "blink",
+			  G_CALLBACK (status_icon_blink_cb),
+			  icon);
 	g_signal_connect (priv->icon, "activate",
 			  G_CALLBACK (status_icon_activate_cb),
 			  icon);
@@ -24,17 +24,15 @@
 
 #include <stdlib.h>
 #include <errno.h>
+#include <signal.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
 
-#if HAVE_LIBCHAMPLAIN
-#include <clutter-gtk/gtk-clutter-embed.h>
-#endif
-
 #include <libebook/e-book.h>
 #include <libnotify/notify.h>
 
@@ -50,6 +48,7 @@
 #include <libempathy/empathy-dispatcher.h>
 #include <libempathy/empathy-dispatch-operation.h>
 #include <libempathy/empathy-log-manager.h>
+#include <libempathy/empathy-stats.h>
 #include <libempathy/empathy-tp-chat.h>
 #include <libempathy/empathy-tp-call.h>
 
@@ -73,6 +72,145 @@
 
 static BaconMessageConnection *connection = NULL;
 
+/* Created when the first file transfer is dispatched */
+static EmpathyFTManager *ft_manager = NULL;
+
+/* Startup profiling, enabled with --profile-startup or by setting
+ * EMPATHY_PROFILE_STARTUP in the environment */
+typedef struct {
+	const gchar *name;
+	gdouble      time;
+} StartupMark;
+
+static GTimer *startup_timer = NULL;
+static GArray *startup_marks = NULL;
+
+static void
+startup_mark (const gchar *name)
+{
+	StartupMark mark;
+
+	if (startup_timer == NULL) {
+		return;
+	}
+
+	mark.name = name;
+	mark.time = g_timer_elapsed (startup_timer, NULL);
+	g_array_append_val (startup_marks, mark);
+}
+
+static void
+startup_profile_stop (void)
+{
+	if (startup_timer == NULL) {
+		return;
+	}
+
+	g_timer_destroy (startup_timer);
+	g_array_free (startup_marks, TRUE);
+	startup_timer = NULL;
+	startup_marks = NULL;
+}
+
+/* Runs with a low priority, once the main window was drawn */
+static gboolean
+startup_profile_print_cb (gpointer user_data)
+{
+	gdouble previous = 0;
+	guint   i;
+
+	startup_mark ("first frame");
+
+	g_printerr ("Startup timeline:\n");
+	for (i = 0; i < startup_marks->len; i++) {
+		StartupMark *mark;
+
+		mark = &g_array_index (startup_marks, StartupMark, i);
+		g_printerr ("  %8.1f ms  %+8.1f ms  %s\n",
+			    mark->time * 1000,
+			    (mark->time - previous) * 1000,
+			    mark->name);
+		previous = mark->time;
+	}
+
+	startup_profile_stop ();
+
+	return FALSE;
+}
+
+/* Written to by the SIGUSR2 handler, to dump the trace from the main loop */
+static int trace_dump_pipe[2] = { -1, -1 };
+
+static void
+trace_dump (void)
+{
+	const gchar *filename;
+	gchar       *default_filename = NULL;
+	GError      *error = NULL;
+
+	filename = g_getenv ("EMPATHY_TRACE_FILE");
+	if (filename == NULL) {
+		gchar *basename;
+
+		basename = g_strdup_printf ("empathy-%d.trace", getpid ());
+		default_filename = g_build_filename (g_get_tmp_dir (),
+						     basename, NULL);
+		filename = default_filename;
+		g_free (basename);
+	}
+
+	if (empathy_trace_dump (filename, &error)) {
+		g_message ("Trace written to %s", filename);
+	} else {
+		g_warning ("Couldn't write the trace: %s", error->message);
+		g_clear_error (&error);
+	}
+
+	g_free (default_filename);
+}
+
+static void
+trace_dump_signal_handler (int signum)
+{
+	gchar c = 0;
+
+	/* Nothing else is safe in a signal handler */
+	if (write (trace_dump_pipe[1], &c, 1) < 0) {
+		return;
+	}
+}
+
+static gboolean
+trace_dump_cb (GIOChannel   *source,
+	       GIOCondition  condition,
+	       gpointer      user_data)
+{
+	gchar c;
+
+	if (read (trace_dump_pipe[0], &c, 1) > 0) {
+		trace_dump ();
+	}
+
+	return TRUE;
+}
+
+/* When tracing, "kill -USR2" dumps the trace to EMPATHY_TRACE_FILE */
+static void
+trace_dump_setup (void)
+{
+	GIOChannel *channel;
+
+	if (empathy_trace_flags == 0 || pipe (trace_dump_pipe) < 0) {
+		return;
+	}
+
+	channel = g_io_channel_unix_new (trace_dump_pipe[0]);
+	g_io_add_watch (channel, G_IO_IN, trace_dump_cb, NULL);
+	g_io_channel_unref (channel);
+
+	signal (SIGUSR2, trace_dump_signal_handler);
+}
+
 static void
 dispatch_cb (EmpathyDispatcher *dispatcher,
 	     EmpathyDispatchOperation *operation,
@@ -128,15 +266,16 @@ dispatch_cb (EmpathyDispatcher *dispatcher,
 		factory = empathy_call_factory_get ();
 		empathy_call_factory_claim_channel (factory, operation);
 	} else if (channel_type == TP_IFACE_QUARK_CHANNEL_TYPE_FILE_TRANSFER) {
-		EmpathyFTManager *ft_manager;
-		EmpathyTpFile    *tp_file;
+		EmpathyTpFile *tp_file;
+
+		if (ft_manager == NULL) {
+			ft_manager = empathy_ft_manager_dup_singleton ();
+		}
 
-		ft_manager = empathy_ft_manager_dup_singleton ();
 		tp_file = EMPATHY_TP_FILE (
 			empathy_dispatch_operation_get_channel_wrapper (operation));
 		empathy_ft_manager_add_tp_file (ft_manager, tp_file);
 		empathy_dispatch_operation_claim (operation);
-		g_object_unref (ft_manager);
 	}
 }
 
@@ -413,6 +552,10 @@ new_call_handler_cb (EmpathyCallFactory *factory, EmpathyCallHandler *handler,
 {
 		EmpathyCallWindow *window;
 
+		/* GStreamer is only needed for calls, it is initialised
+		 * with the first one */
+		gst_init (NULL, NULL);
+
 		window = empathy_call_window_new (handler);
 		gtk_widget_show (GTK_WIDGET (window));
 }
@@ -425,8 +568,8 @@ main (int argc, char *argv[])
 	EmpathyDispatcher *dispatcher;
 	EmpathyLogManager *log_manager;
 	EmpathyChatroomManager *chatroom_manager;
-	EmpathyFTManager  *ft_manager;
 	EmpathyCallFactory *call_factory;
+	EmpathyStats      *stats;
 	GtkWidget         *window;
 	MissionControl    *mc;
 	EmpathyIdle       *idle;
@@ -434,6 +577,7 @@ main (int argc, char *argv[])
 	gboolean           no_connect = FALSE;
 	gboolean           hide_contact_list = FALSE;
 	gboolean           accounts_dialog = FALSE;
+	gboolean           profile_startup = FALSE;
 	GError            *error = NULL;
 	GOptionEntry       options[] = {
 		{ "no-connect", 'n',
@@ -448,6 +592,10 @@ main (int argc, char *argv[])
 		  0, G_OPTION_ARG_NONE, &accounts_dialog,
 		  N_("Show the accounts dialog"),
 		  NULL },
+		{ "profile-startup", 0,
+		  0, G_OPTION_ARG_NONE, &profile_startup,
+		  N_("Print how long each step of the startup took"),
+		  NULL },
 		{ "version", 'v',
 		  G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK, show_version_cb, NULL, NULL },
 		{ NULL }
@@ -455,7 +603,14 @@ main (int argc, char *argv[])
 
 	/* Init */
 	g_thread_init (NULL);
+
+	/* Marks are recorded from the start, but only kept if profiling
+	 * was asked for */
+	startup_timer = g_timer_new ();
+	startup_marks = g_array_new (FALSE, FALSE, sizeof (StartupMark));
+
 	empathy_init ();
+	startup_mark ("empathy init");
 
 	if (!gtk_init_with_args (&argc, &argv,
 				 N_("- Empathy Instant Messenger"),
@@ -464,15 +619,17 @@ main (int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	if (!profile_startup && g_getenv ("EMPATHY_PROFILE_STARTUP") == NULL) {
+		startup_profile_stop ();
+	}
+	startup_mark ("gtk init");
+
 	empathy_gtk_init ();
 	g_set_application_name (_(PACKAGE_NAME));
 	g_setenv ("PULSE_PROP_media.role", "phone", TRUE);
 
-	gst_init (&argc, &argv);
-
-#if HAVE_LIBCHAMPLAIN
-	gtk_clutter_init (&argc, &argv);
-#endif
+	/* GStreamer and Clutter are initialised when the first call window
+	 * and the map view are shown */
 
 	gtk_window_set_default_icon_name ("empathy");
 	textdomain (GETTEXT_PACKAGE);
@@ -505,12 +662,14 @@ main (int argc, char *argv[])
 
 			g_free (message);
 			bacon_message_connection_free (connection);
+			startup_profile_stop ();
 
 			return EXIT_SUCCESS;
 		}
 	} else {
 		g_warning ("Cannot create the 'empathy' bacon connection.");
 	}
+	startup_mark ("single instance check");
 
 	/* Setting up MC */
 	mc = empathy_mission_control_dup_singleton ();
@@ -520,10 +679,13 @@ main (int argc, char *argv[])
 	g_signal_connect (mc, "Error",
 			  G_CALLBACK (operation_error_cb),
 			  NULL);
+	startup_mark ("mission control");
 
 	if (accounts_dialog) {
 		GtkWidget *dialog;
 
+		startup_profile_stop ();
+
 		dialog = empathy_accounts_dialog_show (NULL, NULL);
 		g_signal_connect (dialog, "destroy",
 				  G_CALLBACK (gtk_main_quit),
@@ -549,11 +711,16 @@ main (int argc, char *argv[])
 		empathy_idle_set_state (idle, MC_PRESENCE_AVAILABLE);
 	}
 	
+	startup_mark ("idle");
+
 	create_salut_account ();
+	startup_mark ("salut account");
 
 	/* Setting up UI */
 	window = empathy_main_window_show ();
+	startup_mark ("main window");
 	icon = empathy_status_icon_new (GTK_WINDOW (window), hide_contact_list);
+	startup_mark ("status icon");
 
 	if (connection) {
 		/* We se the callback here because we need window */
@@ -565,24 +732,45 @@ main (int argc, char *argv[])
 	/* Handle channels */
 	dispatcher = empathy_dispatcher_dup_singleton ();
 	g_signal_connect (dispatcher, "dispatch", G_CALLBACK (dispatch_cb), NULL);
+	startup_mark ("dispatcher");
 
 	/* Logging */
 	log_manager = empathy_log_manager_dup_singleton ();
 	empathy_log_manager_observe (log_manager, dispatcher);
+	startup_mark ("log manager");
 
+	/* chatrooms.xml is parsed when the favourites are first needed */
 	chatroom_manager = empathy_chatroom_manager_dup_singleton (NULL);
 	empathy_chatroom_manager_observe (chatroom_manager, dispatcher);
-
-	ft_manager = empathy_ft_manager_dup_singleton ();
+	startup_mark ("chatroom manager");
 
 	notify_init (_(PACKAGE_NAME));
-	/* Create the call factory */
+	startup_mark ("libnotify");
+
+	/* Create the call factory, it must be there to handle incoming
+	 * calls but it doesn't load anything until a call is made */
 	call_factory = empathy_call_factory_initialise ();
 	g_signal_connect (G_OBJECT (call_factory), "new-call-handler",
 		G_CALLBACK (new_call_handler_cb), NULL);
+	startup_mark ("call factory");
+
+	/* Performance counters, see tools/empathy-stats.py */
+	stats = empathy_stats_export ();
+	startup_mark ("stats");
+
+	if (startup_timer != NULL) {
+		g_idle_add_full (G_PRIORITY_LOW, startup_profile_print_cb,
+				 NULL, NULL);
+	}
+
+	trace_dump_setup ();
 
 	gtk_main ();
 
+	if (empathy_trace_flags != 0) {
+		trace_dump ();
+	}
+
 	empathy_idle_set_state (idle, MC_PRESENCE_OFFLINE);
 
 	g_object_unref (mc);
@@ -591,7 +779,12 @@ main (int argc, char *argv[])
 	g_object_unref (log_manager);
 	g_object_unref (dispatcher);
 	g_object_unref (chatroom_manager);
-	g_object_unref (ft_manager);
+	if (ft_manager != NULL) {
+		g_object_unref (ft_manager);
+	}
+	if (stats != NULL) {
+		g_object_unref (stats);
+	}
 
 	notify_uninit ();
 
@@ -0,0 +1,580 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <time.h>
+
+#include <dbus/dbus-glib.h>
+
+#include <telepathy-glib/channel-iface.h>
+#include <telepathy-glib/dbus.h>
+#include <telepathy-glib/errors.h>
+#include <telepathy-glib/exportable-channel.h>
+#include <telepathy-glib/gtypes.h>
+#include <telepathy-glib/interfaces.h>
+#include <telepathy-glib/svc-channel.h>
+#include <telepathy-glib/svc-generic.h>
+#include <telepathy-glib/util.h>
+
+#include "bench-channel.h"
+
+static void channel_iface_init (gpointer g_iface, gpointer iface_data);
+static void text_iface_init    (gpointer g_iface, gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (BenchChannel, bench_channel, G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_SVC_CHANNEL,
+						channel_iface_init);
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_SVC_CHANNEL_TYPE_CONTACT_LIST,
+						NULL);
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_SVC_CHANNEL_TYPE_TEXT,
+						text_iface_init);
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_SVC_CHANNEL_INTERFACE_GROUP,
+						tp_group_mixin_iface_init);
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_SVC_DBUS_PROPERTIES,
+						tp_dbus_properties_mixin_iface_init);
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_CHANNEL_IFACE, NULL);
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_EXPORTABLE_CHANNEL, NULL));
+
+enum {
+	PROP_0,
+	PROP_CONNECTION,
+	PROP_OBJECT_PATH,
+	PROP_CHANNEL_TYPE,
+	PROP_HANDLE_TYPE,
+	PROP_HANDLE,
+	PROP_TARGET_ID,
+	PROP_INITIATOR_HANDLE,
+	PROP_INITIATOR_ID,
+	PROP_REQUESTED,
+	PROP_INTERFACES,
+	PROP_CHANNEL_DESTROYED,
+	PROP_CHANNEL_PROPERTIES,
+};
+
+static const gchar *group_interfaces[] = {
+	TP_IFACE_CHANNEL_INTERFACE_GROUP,
+	NULL
+};
+
+static const gchar *no_interfaces[] = {
+	NULL
+};
+
+static gboolean
+bench_channel_is_text (BenchChannel *channel)
+{
+	return !tp_strdiff (channel->channel_type, TP_IFACE_CHANNEL_TYPE_TEXT);
+}
+
+/* 1-1 text channels have no members */
+static const gchar **
+bench_channel_list_interfaces (BenchChannel *channel)
+{
+	if (channel->handle_type == TP_HANDLE_TYPE_CONTACT) {
+		return no_interfaces;
+	}
+
+	return group_interfaces;
+}
+
+static void
+bench_channel_change_member (GObject     *object,
+			     TpHandle     handle,
+			     const gchar *message,
+			     gboolean     is_member)
+{
+	TpIntSet *set;
+
+	set = tp_intset_new ();
+	tp_intset_add (set, handle);
+	tp_group_mixin_change_members (object, message,
+				       is_member ? set : NULL,
+				       is_member ? NULL : set,
+				       NULL, NULL, 0,
+				       TP_CHANNEL_GROUP_CHANGE_REASON_NONE);
+	tp_intset_destroy (set);
+}
+
+/* Requests are granted straight away */
+static gboolean
+bench_channel_add_member (GObject      *object,
+			  TpHandle      handle,
+			  const gchar  *message,
+			  GError      **error)
+{
+	bench_channel_change_member (object, handle, message, TRUE);
+
+	return TRUE;
+}
+
+static gboolean
+bench_channel_remove_member (GObject      *object,
+			     TpHandle      handle,
+			     const gchar  *message,
+			     GError      **error)
+{
+	bench_channel_change_member (object, handle, message, FALSE);
+
+	return TRUE;
+}
+
+static void
+bench_channel_constructed (GObject *object)
+{
+	BenchChannel      *channel = BENCH_CHANNEL (object);
+	TpHandleRepoIface *contact_repo;
+	TpHandleRepoIface *repo;
+
+	contact_repo = tp_base_connection_get_handles (channel->conn,
+						       TP_HANDLE_TYPE_CONTACT);
+	repo = tp_base_connection_get_handles (channel->conn,
+					       channel->handle_type);
+	tp_handle_ref (repo, channel->handle);
+	if (channel->initiator != 0) {
+		tp_handle_ref (contact_repo, channel->initiator);
+	}
+
+	tp_group_mixin_init (object, G_STRUCT_OFFSET (BenchChannel, group),
+			     contact_repo, channel->conn->self_handle);
+
+	if (channel->handle_type == TP_HANDLE_TYPE_LIST) {
+		tp_group_mixin_change_flags (object,
+					     TP_CHANNEL_GROUP_FLAG_CAN_ADD |
+					     TP_CHANNEL_GROUP_FLAG_CAN_REMOVE,
+					     0);
+	}
+	else if (channel->handle_type == TP_HANDLE_TYPE_ROOM) {
+		/* We already joined */
+		bench_channel_change_member (object,
+					     channel->conn->self_handle,
+					     "", TRUE);
+	}
+
+	if (bench_channel_is_text (channel)) {
+		tp_text_mixin_init (object, G_STRUCT_OFFSET (BenchChannel, text),
+				    contact_repo);
+		tp_text_mixin_set_message_types (object,
+						 TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL,
+						 TP_CHANNEL_TEXT_MESSAGE_TYPE_ACTION,
+						 TP_CHANNEL_TEXT_MESSAGE_TYPE_NOTICE,
+						 G_MAXUINT);
+	}
+
+	dbus_g_connection_register_g_object (tp_get_bus (),
+					     channel->object_path,
+					     object);
+}
+
+static void
+bench_channel_get_property (GObject    *object,
+			    guint       param_id,
+			    GValue     *value,
+			    GParamSpec *pspec)
+{
+	BenchChannel      *channel = BENCH_CHANNEL (object);
+	TpHandleRepoIface *repo;
+
+	switch (param_id) {
+	case PROP_CONNECTION:
+		g_value_set_object (value, channel->conn);
+		break;
+	case PROP_OBJECT_PATH:
+		g_value_set_string (value, channel->object_path);
+		break;
+	case PROP_CHANNEL_TYPE:
+		g_value_set_string (value, channel->channel_type);
+		break;
+	case PROP_HANDLE_TYPE:
+		g_value_set_uint (value, channel->handle_type);
+		break;
+	case PROP_HANDLE:
+		g_value_set_uint (value, channel->handle);
+		break;
+	case PROP_TARGET_ID:
+		repo = tp_base_connection_get_handles (channel->conn,
+						       channel->handle_type);
+		g_value_set_string (value, tp_handle_inspect (repo,
+							      channel->handle));
+		break;
+	case PROP_INITIATOR_HANDLE:
+		g_value_set_uint (value, channel->initiator);
+		break;
+	case PROP_INITIATOR_ID:
+		repo = tp_base_connection_get_handles (channel->conn,
+						       TP_HANDLE_TYPE_CONTACT);
+		g_value_set_string (value, channel->initiator == 0 ? "" :
+				    tp_handle_inspect (repo, channel->initiator));
+		break;
+	case PROP_REQUESTED:
+		g_value_set_boolean (value, channel->requested);
+		break;
+	case PROP_INTERFACES:
+		g_value_set_boxed (value, bench_channel_list_interfaces (channel));
+		break;
+	case PROP_CHANNEL_DESTROYED:
+		g_value_set_boolean (value, channel->closed);
+		break;
+	case PROP_CHANNEL_PROPERTIES:
+		g_value_take_boxed (value,
+			tp_dbus_properties_mixin_make_properties_hash (object,
+				TP_IFACE_CHANNEL, "ChannelType",
+				TP_IFACE_CHANNEL, "TargetHandleType",
+				TP_IFACE_CHANNEL, "TargetHandle",
+				TP_IFACE_CHANNEL, "TargetID",
+				TP_IFACE_CHANNEL, "InitiatorHandle",
+				TP_IFACE_CHANNEL, "InitiatorID",
+				TP_IFACE_CHANNEL, "Requested",
+				TP_IFACE_CHANNEL, "Interfaces",
+				NULL));
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
+		break;
+	};
+}
+
+static void
+bench_channel_set_property (GObject      *object,
+			    guint         param_id,
+			    const GValue *value,
+			    GParamSpec   *pspec)
+{
+	BenchChannel *channel = BENCH_CHANNEL (object);
+
+	switch (param_id) {
+	case PROP_CONNECTION:
+		channel->conn = g_value_get_object (value);
+		break;
+	case PROP_OBJECT_PATH:
+		g_free (channel->object_path);
+		channel->object_path = g_value_dup_string (value);
+		break;
+	case PROP_CHANNEL_TYPE:
+		/* Writable in TpChannelIface, but only set at construction */
+		if (channel->channel_type == NULL) {
+			channel->channel_type = g_value_dup_string (value);
+		}
+		break;
+	case PROP_HANDLE_TYPE:
+		channel->handle_type = g_value_get_uint (value);
+		break;
+	case PROP_HANDLE:
+		channel->handle = g_value_get_uint (value);
+		break;
+	case PROP_INITIATOR_HANDLE:
+		channel->initiator = g_value_get_uint (value);
+		break;
+	case PROP_REQUESTED:
+		channel->requested = g_value_get_boolean (value);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
+		break;
+	};
+}
+
+static void
+bench_channel_dispose (GObject *object)
+{
+	BenchChannel *channel = BENCH_CHANNEL (object);
+
+	if (!channel->closed) {
+		channel->closed = TRUE;
+		tp_svc_channel_emit_closed (channel);
+	}
+
+	G_OBJECT_CLASS (bench_channel_parent_class)->dispose (object);
+}
+
+static void
+bench_channel_finalize (GObject *object)
+{
+	BenchChannel      *channel = BENCH_CHANNEL (object);
+	TpHandleRepoIface *contact_repo;
+	TpHandleRepoIface *repo;
+
+	contact_repo = tp_base_connection_get_handles (channel->conn,
+						       TP_HANDLE_TYPE_CONTACT);
+	repo = tp_base_connection_get_handles (channel->conn,
+					       channel->handle_type);
+	tp_handle_unref (repo, channel->handle);
+	if (channel->initiator != 0) {
+		tp_handle_unref (contact_repo, channel->initiator);
+	}
+
+	if (bench_channel_is_text (channel)) {
+		tp_text_mixin_finalize (object);
+	}
+	tp_group_mixin_finalize (object);
+
+	g_free (channel->object_path);
+	g_free (channel->channel_type);
+
+	G_OBJECT_CLASS (bench_channel_parent_class)->finalize (object);
+}
+
+static void
+bench_channel_class_init (BenchChannelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	static TpDBusPropertiesMixinPropImpl channel_props[] = {
+		{ "ChannelType", "channel-type", NULL },
+		{ "TargetHandleType", "handle-type", NULL },
+		{ "TargetHandle", "handle", NULL },
+		{ "TargetID", "target-id", NULL },
+		{ "InitiatorHandle", "initiator-handle", NULL },
+		{ "InitiatorID", "initiator-id", NULL },
+		{ "Requested", "requested", NULL },
+		{ "Interfaces", "interfaces", NULL },
+		{ NULL }
+	};
+	static TpDBusPropertiesMixinIfaceImpl prop_interfaces[] = {
+		{ TP_IFACE_CHANNEL,
+		  tp_dbus_properties_mixin_getter_gobject_properties,
+		  NULL,
+		  channel_props,
+		},
+		{ NULL }
+	};
+
+	object_class->constructed = bench_channel_constructed;
+	object_class->get_property = bench_channel_get_property;
+	object_class->set_property = bench_channel_set_property;
+	object_class->dispose = bench_channel_dispose;
+	object_class->finalize = bench_channel_finalize;
+
+	g_object_class_override_property (object_class, PROP_OBJECT_PATH,
+					  "object-path");
+	g_object_class_override_property (object_class, PROP_CHANNEL_TYPE,
+					  "channel-type");
+	g_object_class_override_property (object_class, PROP_HANDLE_TYPE,
+					  "handle-type");
+	g_object_class_override_property (object_class, PROP_HANDLE,
+					  "handle");
+	g_object_class_override_property (object_class, PROP_CHANNEL_DESTROYED,
+					  "channel-destroyed");
+	g_object_class_override_property (object_class, PROP_CHANNEL_PROPERTIES,
+					  "channel-properties");
+
+	g_object_class_install_property (object_class,
+					 PROP_CONNECTION,
+					 g_param_spec_object ("connection",
+							      "Connection",
+							      "The connection owning the channel",
+							      TP_TYPE_BASE_CONNECTION,
+							      G_PARAM_READWRITE |
+							      G_PARAM_CONSTRUCT_ONLY));
+	g_object_class_install_property (object_class,
+					 PROP_TARGET_ID,
+					 g_param_spec_string ("target-id",
+							      "Target ID",
+							      "The identifier of the target handle",
+							      NULL,
+							      G_PARAM_READABLE));
+	g_object_class_install_property (object_class,
+					 PROP_INITIATOR_HANDLE,
+					 g_param_spec_uint ("initiator-handle",
+							    "Initiator handle",
+							    "The contact who initiated the channel",
+							    0, G_MAXUINT32, 0,
+							    G_PARAM_READWRITE |
+							    G_PARAM_CONSTRUCT_ONLY));
+	g_object_class_install_property (object_class,
+					 PROP_INITIATOR_ID,
+					 g_param_spec_string ("initiator-id",
+							      "Initiator ID",
+							      "The identifier of the initiator",
+							      NULL,
+							      G_PARAM_READABLE));
+	g_object_class_install_property (object_class,
+					 PROP_REQUESTED,
+					 g_param_spec_boolean ("requested",
+							       "Requested",
+							       "Whether we requested the channel",
+							       FALSE,
+							       G_PARAM_READWRITE |
+							       G_PARAM_CONSTRUCT_ONLY));
+	g_object_class_install_property (object_class,
+					 PROP_INTERFACES,
+					 g_param_spec_boxed ("interfaces",
+							     "Interfaces",
+							     "Extra interfaces of the channel",
+							     G_TYPE_STRV,
+							     G_PARAM_READABLE));
+
+	klass->dbus_properties_class.interfaces = prop_interfaces;
+	tp_dbus_properties_mixin_class_init (object_class,
+		G_STRUCT_OFFSET (BenchChannelClass, dbus_properties_class));
+
+	tp_group_mixin_class_init (object_class,
+				   G_STRUCT_OFFSET (BenchChannelClass, group_class),
+				   bench_channel_add_member,
+				   bench_channel_remove_member);
+	tp_group_mixin_init_dbus_properties (object_class);
+
+	tp_text_mixin_class_init (object_class,
+				  G_STRUCT_OFFSET (BenchChannelClass, text_class));
+}
+
+static void
+bench_channel_init (BenchChannel *channel)
+{
+}
+
+static void
+bench_channel_close (TpSvcChannel          *iface,
+		     DBusGMethodInvocation *context)
+{
+	BenchChannel *channel = BENCH_CHANNEL (iface);
+
+	if (channel->handle_type == TP_HANDLE_TYPE_LIST) {
+		GError error = { TP_ERRORS, TP_ERROR_NOT_IMPLEMENTED,
+				 "Contact lists can't be closed" };
+
+		dbus_g_method_return_error (context, &error);
+		return;
+	}
+
+	if (!channel->closed) {
+		channel->closed = TRUE;
+		tp_svc_channel_emit_closed (channel);
+	}
+
+	tp_svc_channel_return_from_close (context);
+}
+
+static void
+bench_channel_get_channel_type (TpSvcChannel          *iface,
+				DBusGMethodInvocation *context)
+{
+	BenchChannel *channel = BENCH_CHANNEL (iface);
+
+	tp_svc_channel_return_from_get_channel_type (context,
+						     channel->channel_type);
+}
+
+static void
+bench_channel_get_handle (TpSvcChannel          *iface,
+			  DBusGMethodInvocation *context)
+{
+	BenchChannel *channel = BENCH_CHANNEL (iface);
+
+	tp_svc_channel_return_from_get_handle (context, channel->handle_type,
+					       channel->handle);
+}
+
+static void
+bench_channel_get_interfaces (TpSvcChannel          *iface,
+			      DBusGMethodInvocation *context)
+{
+	BenchChannel *channel = BENCH_CHANNEL (iface);
+
+	tp_svc_channel_return_from_get_interfaces (context,
+		bench_channel_list_interfaces (channel));
+}
+
+static void
+channel_iface_init (gpointer g_iface,
+		    gpointer iface_data)
+{
+	TpSvcChannelClass *klass = g_iface;
+
+#define IMPLEMENT(x) tp_svc_channel_implement_##x (klass, bench_channel_##x)
+	IMPLEMENT (close);
+	IMPLEMENT (get_channel_type);
+	IMPLEMENT (get_handle);
+	IMPLEMENT (get_interfaces);
+#undef IMPLEMENT
+}
+
+/* Messages we send are delivered right away */
+static void
+bench_channel_send (TpSvcChannelTypeText  *iface,
+		    guint                  type,
+		    const gchar           *text,
+		    DBusGMethodInvocation *context)
+{
+	tp_svc_channel_type_text_emit_sent (iface, time (NULL), type, text);
+	tp_svc_channel_type_text_return_from_send (context);
+}
+
+static void
+text_iface_init (gpointer g_iface,
+		 gpointer iface_data)
+{
+	TpSvcChannelTypeTextClass *klass = g_iface;
+
+	tp_text_mixin_iface_init (g_iface, iface_data);
+	tp_svc_channel_type_text_implement_send (klass, bench_channel_send);
+}
+
+BenchChannel *
+bench_channel_new (TpBaseConnection *conn,
+		   const gchar      *object_path,
+		   const gchar      *channel_type,
+		   TpHandleType      handle_type,
+		   TpHandle          handle,
+		   TpHandle          initiator,
+		   gboolean          requested)
+{
+	return g_object_new (BENCH_TYPE_CHANNEL,
+			     "connection", conn,
+			     "object-path", object_path,
+			     "channel-type", channel_type,
+			     "handle-type", handle_type,
+			     "handle", handle,
+			     "initiator-handle", initiator,
+			     "requested", requested,
+			     NULL);
+}
+
+const gchar *
+bench_channel_get_object_path (BenchChannel *channel)
+{
+	g_return_val_if_fail (BENCH_IS_CHANNEL (channel), NULL);
+
+	return channel->object_path;
+}
+
+/* Adds @members to the channel in a single MembersChanged signal */
+void
+bench_channel_add_members (BenchChannel *channel,
+			   TpIntSet     *members)
+{
+	g_return_if_fail (BENCH_IS_CHANNEL (channel));
+
+	tp_group_mixin_change_members (G_OBJECT (channel), "", members,
+				       NULL, NULL, NULL, 0,
+				       TP_CHANNEL_GROUP_CHANGE_REASON_NONE);
+}
+
+void
+bench_channel_receive (BenchChannel *channel,
+		       TpHandle      sender,
+		       const gchar  *text)
+{
+	g_return_if_fail (BENCH_IS_CHANNEL (channel));
+	g_return_if_fail (bench_channel_is_text (channel));
+
+	tp_text_mixin_receive (G_OBJECT (channel),
+			       TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL,
+			       sender, time (NULL), text);
+}
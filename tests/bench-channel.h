@@ -0,0 +1,87 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef __BENCH_CHANNEL_H__
+#define __BENCH_CHANNEL_H__
+
+#include <glib-object.h>
+
+#include <telepathy-glib/base-connection.h>
+#include <telepathy-glib/dbus-properties-mixin.h>
+#include <telepathy-glib/group-mixin.h>
+#include <telepathy-glib/intset.h>
+#include <telepathy-glib/text-mixin.h>
+
+G_BEGIN_DECLS
+
+#define BENCH_TYPE_CHANNEL         (bench_channel_get_type ())
+#define BENCH_CHANNEL(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), BENCH_TYPE_CHANNEL, BenchChannel))
+#define BENCH_CHANNEL_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST ((k), BENCH_TYPE_CHANNEL, BenchChannelClass))
+#define BENCH_IS_CHANNEL(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), BENCH_TYPE_CHANNEL))
+#define BENCH_IS_CHANNEL_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), BENCH_TYPE_CHANNEL))
+#define BENCH_CHANNEL_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), BENCH_TYPE_CHANNEL, BenchChannelClass))
+
+typedef struct _BenchChannel      BenchChannel;
+typedef struct _BenchChannelClass BenchChannelClass;
+
+/* A contact list or text channel of the bench connection. Every channel
+ * has the group mixin, only contact lists and rooms advertise it. */
+struct _BenchChannel {
+	GObject           parent;
+
+	TpGroupMixin      group;
+	TpTextMixin       text;
+
+	TpBaseConnection *conn;
+	gchar            *object_path;
+	gchar            *channel_type;
+	TpHandleType      handle_type;
+	TpHandle          handle;
+	TpHandle          initiator;
+	gboolean          requested;
+	gboolean          closed;
+};
+
+struct _BenchChannelClass {
+	GObjectClass               parent_class;
+
+	TpGroupMixinClass          group_class;
+	TpTextMixinClass           text_class;
+	TpDBusPropertiesMixinClass dbus_properties_class;
+};
+
+GType         bench_channel_get_type        (void) G_GNUC_CONST;
+BenchChannel *bench_channel_new             (TpBaseConnection *conn,
+					     const gchar      *object_path,
+					     const gchar      *channel_type,
+					     TpHandleType      handle_type,
+					     TpHandle          handle,
+					     TpHandle          initiator,
+					     gboolean          requested);
+const gchar * bench_channel_get_object_path (BenchChannel     *channel);
+void          bench_channel_add_members     (BenchChannel     *channel,
+					     TpIntSet         *members);
+void          bench_channel_receive         (BenchChannel     *channel,
+					     TpHandle          sender,
+					     const gchar      *text);
+
+G_END_DECLS
+
+#endif /* __BENCH_CHANNEL_H__ */
@@ -0,0 +1,813 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <telepathy-glib/channel-manager.h>
+#include <telepathy-glib/dbus.h>
+#include <telepathy-glib/errors.h>
+#include <telepathy-glib/exportable-channel.h>
+#include <telepathy-glib/handle-repo-dynamic.h>
+#include <telepathy-glib/handle-repo-static.h>
+#include <telepathy-glib/interfaces.h>
+#include <telepathy-glib/svc-connection.h>
+#include <telepathy-glib/util.h>
+
+#include "bench-connection.h"
+
+/* Hands out the contact lists, the text channels and the file transfers of
+ * the connection. Only contact lists can be requested, text channels and
+ * file transfers are always incoming. */
+
+#define BENCH_TYPE_CHANNEL_MANAGER (bench_channel_manager_get_type ())
+#define BENCH_CHANNEL_MANAGER(o)   (G_TYPE_CHECK_INSTANCE_CAST ((o), BENCH_TYPE_CHANNEL_MANAGER, BenchChannelManager))
+
+typedef struct {
+	GObject           parent;
+
+	TpBaseConnection *conn;
+	/* Indexed by list handle */
+	BenchChannel     *lists[3];
+	/* object path -> BenchChannel */
+	GHashTable       *text_channels;
+	guint             n_text_channels;
+	/* object path -> BenchFtChannel */
+	GHashTable       *file_channels;
+	guint             n_file_channels;
+} BenchChannelManager;
+
+typedef struct {
+	GObjectClass parent_class;
+} BenchChannelManagerClass;
+
+static GType bench_channel_manager_get_type (void);
+static void  channel_manager_iface_init     (gpointer g_iface,
+					     gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (BenchChannelManager, bench_channel_manager, G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_CHANNEL_MANAGER,
+						channel_manager_iface_init));
+
+static const gchar *list_handle_strings[] = {
+	"publish",
+	"subscribe",
+	NULL
+};
+
+static void
+bench_channel_manager_text_closed_cb (BenchChannel        *channel,
+				      BenchChannelManager *manager)
+{
+	tp_channel_manager_emit_channel_closed_for_object (manager,
+		TP_EXPORTABLE_CHANNEL (channel));
+
+	g_hash_table_remove (manager->text_channels, channel->object_path);
+}
+
+static void
+bench_channel_manager_file_closed_cb (BenchFtChannel      *channel,
+				      BenchChannelManager *manager)
+{
+	tp_channel_manager_emit_channel_closed_for_object (manager,
+		TP_EXPORTABLE_CHANNEL (channel));
+
+	g_hash_table_remove (manager->file_channels, channel->object_path);
+}
+
+static void
+bench_channel_manager_destroy_channels (BenchChannelManager *manager,
+					GHashTable          *channels,
+					gpointer             closed_cb)
+{
+	GHashTableIter iter;
+	gpointer       channel;
+
+	g_hash_table_iter_init (&iter, channels);
+	while (g_hash_table_iter_next (&iter, NULL, &channel)) {
+		g_signal_handlers_disconnect_by_func (channel, closed_cb,
+						      manager);
+	}
+	g_hash_table_destroy (channels);
+}
+
+static void
+bench_channel_manager_dispose (GObject *object)
+{
+	BenchChannelManager *manager = BENCH_CHANNEL_MANAGER (object);
+	guint                i;
+
+	for (i = 0; i < G_N_ELEMENTS (manager->lists); i++) {
+		if (manager->lists[i] != NULL) {
+			g_object_unref (manager->lists[i]);
+			manager->lists[i] = NULL;
+		}
+	}
+
+	if (manager->text_channels != NULL) {
+		bench_channel_manager_destroy_channels (manager,
+			manager->text_channels,
+			bench_channel_manager_text_closed_cb);
+		manager->text_channels = NULL;
+	}
+
+	if (manager->file_channels != NULL) {
+		bench_channel_manager_destroy_channels (manager,
+			manager->file_channels,
+			bench_channel_manager_file_closed_cb);
+		manager->file_channels = NULL;
+	}
+
+	G_OBJECT_CLASS (bench_channel_manager_parent_class)->dispose (object);
+}
+
+static void
+bench_channel_manager_class_init (BenchChannelManagerClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = bench_channel_manager_dispose;
+}
+
+static void
+bench_channel_manager_init (BenchChannelManager *manager)
+{
+	manager->text_channels = g_hash_table_new_full (g_str_hash,
+							g_str_equal,
+							NULL,
+							g_object_unref);
+	manager->file_channels = g_hash_table_new_full (g_str_hash,
+							g_str_equal,
+							NULL,
+							g_object_unref);
+}
+
+static BenchChannel *
+bench_channel_manager_ensure_list (BenchChannelManager *manager,
+				   TpHandle             handle,
+				   gpointer             request_token)
+{
+	BenchChannel *channel;
+	GSList       *tokens = NULL;
+	gchar        *object_path;
+
+	channel = manager->lists[handle];
+	if (channel != NULL) {
+		if (request_token != NULL) {
+			tp_channel_manager_emit_request_already_satisfied (manager,
+				request_token, TP_EXPORTABLE_CHANNEL (channel));
+		}
+		return channel;
+	}
+
+	object_path = g_strdup_printf ("%s/ContactList/%s",
+				       manager->conn->object_path,
+				       list_handle_strings[handle - 1]);
+	channel = bench_channel_new (manager->conn, object_path,
+				     TP_IFACE_CHANNEL_TYPE_CONTACT_LIST,
+				     TP_HANDLE_TYPE_LIST, handle, 0, FALSE);
+	manager->lists[handle] = channel;
+	g_free (object_path);
+
+	if (request_token != NULL) {
+		tokens = g_slist_prepend (NULL, request_token);
+	}
+	tp_channel_manager_emit_new_channel (manager,
+					     TP_EXPORTABLE_CHANNEL (channel),
+					     tokens);
+	g_slist_free (tokens);
+
+	return channel;
+}
+
+static gboolean
+bench_channel_manager_request (TpChannelManager *iface,
+			       gpointer          request_token,
+			       GHashTable       *request_properties,
+			       gboolean          require_new)
+{
+	BenchChannelManager *manager = BENCH_CHANNEL_MANAGER (iface);
+	TpHandle             handle;
+
+	if (tp_strdiff (tp_asv_get_string (request_properties,
+					   TP_IFACE_CHANNEL ".ChannelType"),
+			TP_IFACE_CHANNEL_TYPE_CONTACT_LIST) ||
+	    tp_asv_get_uint32 (request_properties,
+			       TP_IFACE_CHANNEL ".TargetHandleType",
+			       NULL) != TP_HANDLE_TYPE_LIST) {
+		return FALSE;
+	}
+
+	handle = tp_asv_get_uint32 (request_properties,
+				    TP_IFACE_CHANNEL ".TargetHandle", NULL);
+	if (handle == 0 || handle >= G_N_ELEMENTS (manager->lists)) {
+		tp_channel_manager_emit_request_failed (manager, request_token,
+			TP_ERRORS, TP_ERROR_INVALID_HANDLE, "No such list");
+		return TRUE;
+	}
+
+	if (require_new && manager->lists[handle] != NULL) {
+		tp_channel_manager_emit_request_failed (manager, request_token,
+			TP_ERRORS, TP_ERROR_NOT_AVAILABLE,
+			"Contact lists always exist");
+		return TRUE;
+	}
+
+	bench_channel_manager_ensure_list (manager, handle, request_token);
+
+	return TRUE;
+}
+
+static gboolean
+bench_channel_manager_create_channel (TpChannelManager *manager,
+				      gpointer          request_token,
+				      GHashTable       *request_properties)
+{
+	return bench_channel_manager_request (manager, request_token,
+					      request_properties, TRUE);
+}
+
+static gboolean
+bench_channel_manager_ensure_channel (TpChannelManager *manager,
+				      gpointer          request_token,
+				      GHashTable       *request_properties)
+{
+	return bench_channel_manager_request (manager, request_token,
+					      request_properties, FALSE);
+}
+
+static void
+bench_channel_manager_foreach_channel (TpChannelManager        *iface,
+				       TpExportableChannelFunc  func,
+				       gpointer                 user_data)
+{
+	BenchChannelManager *manager = BENCH_CHANNEL_MANAGER (iface);
+	GHashTableIter       iter;
+	gpointer             channel;
+	guint                i;
+
+	for (i = 0; i < G_N_ELEMENTS (manager->lists); i++) {
+		if (manager->lists[i] != NULL) {
+			func (TP_EXPORTABLE_CHANNEL (manager->lists[i]),
+			      user_data);
+		}
+	}
+
+	g_hash_table_iter_init (&iter, manager->text_channels);
+	while (g_hash_table_iter_next (&iter, NULL, &channel)) {
+		func (TP_EXPORTABLE_CHANNEL (channel), user_data);
+	}
+
+	g_hash_table_iter_init (&iter, manager->file_channels);
+	while (g_hash_table_iter_next (&iter, NULL, &channel)) {
+		func (TP_EXPORTABLE_CHANNEL (channel), user_data);
+	}
+}
+
+static void
+bench_channel_manager_foreach_channel_class (TpChannelManager                 *manager,
+					     TpChannelManagerChannelClassFunc  func,
+					     gpointer                          user_data)
+{
+	static const gchar * const allowed[] = {
+		TP_IFACE_CHANNEL ".TargetHandle",
+		TP_IFACE_CHANNEL ".TargetID",
+		NULL
+	};
+	GHashTable *fixed;
+
+	fixed = tp_asv_new (TP_IFACE_CHANNEL ".ChannelType", G_TYPE_STRING,
+			    TP_IFACE_CHANNEL_TYPE_CONTACT_LIST,
+			    TP_IFACE_CHANNEL ".TargetHandleType", G_TYPE_UINT,
+			    TP_HANDLE_TYPE_LIST,
+			    NULL);
+	func (manager, fixed, allowed, user_data);
+	g_hash_table_destroy (fixed);
+}
+
+static void
+channel_manager_iface_init (gpointer g_iface,
+			    gpointer iface_data)
+{
+	TpChannelManagerIface *iface = g_iface;
+
+	iface->foreach_channel = bench_channel_manager_foreach_channel;
+	iface->foreach_channel_class = bench_channel_manager_foreach_channel_class;
+	iface->create_channel = bench_channel_manager_create_channel;
+	iface->ensure_channel = bench_channel_manager_ensure_channel;
+	/* RequestChannel, which EmpathyTpContactList uses, is the same as
+	 * EnsureChannel for lists */
+	iface->request_channel = bench_channel_manager_ensure_channel;
+}
+
+/* The connection itself */
+
+#define GET_PRIV(obj) ((BenchConnectionPriv *) BENCH_CONNECTION (obj)->priv)
+
+typedef struct {
+	BenchPresence  presence;
+	gchar         *message;
+} BenchContactPresence;
+
+typedef struct {
+	BenchChannelManager *manager;
+	/* TpHandle -> BenchContactPresence */
+	GHashTable          *presences;
+} BenchConnectionPriv;
+
+G_DEFINE_TYPE_WITH_CODE (BenchConnection, bench_connection, TP_TYPE_BASE_CONNECTION,
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_SVC_CONNECTION_INTERFACE_CONTACTS,
+						tp_contacts_mixin_iface_init);
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_SVC_CONNECTION_INTERFACE_SIMPLE_PRESENCE,
+						tp_presence_mixin_simple_presence_iface_init));
+
+static const TpPresenceStatusOptionalArgumentSpec status_arguments[] = {
+	{ "message", "s" },
+	{ NULL }
+};
+
+static const TpPresenceStatusSpec statuses[] = {
+	{ "offline", TP_CONNECTION_PRESENCE_TYPE_OFFLINE, FALSE, NULL },
+	{ "available", TP_CONNECTION_PRESENCE_TYPE_AVAILABLE, TRUE, status_arguments },
+	{ "away", TP_CONNECTION_PRESENCE_TYPE_AWAY, TRUE, status_arguments },
+	{ "busy", TP_CONNECTION_PRESENCE_TYPE_BUSY, TRUE, status_arguments },
+	{ NULL }
+};
+
+static const gchar *interfaces_always_present[] = {
+	TP_IFACE_CONNECTION_INTERFACE_CONTACTS,
+	TP_IFACE_CONNECTION_INTERFACE_REQUESTS,
+	TP_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE,
+	NULL
+};
+
+static void
+bench_connection_presence_free (BenchContactPresence *presence)
+{
+	g_free (presence->message);
+	g_slice_free (BenchContactPresence, presence);
+}
+
+static TpPresenceStatus *
+bench_connection_dup_status (BenchConnection *conn,
+			     TpHandle         contact)
+{
+	BenchConnectionPriv  *priv = GET_PRIV (conn);
+	BenchContactPresence *presence;
+	TpPresenceStatus     *status;
+	GHashTable           *arguments;
+
+	presence = g_hash_table_lookup (priv->presences,
+					GUINT_TO_POINTER (contact));
+	if (presence == NULL) {
+		return tp_presence_status_new (BENCH_PRESENCE_OFFLINE, NULL);
+	}
+
+	arguments = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+					   (GDestroyNotify) tp_g_value_slice_free);
+	g_hash_table_insert (arguments, "message",
+			     tp_g_value_slice_new_string (presence->message));
+	status = tp_presence_status_new (presence->presence, arguments);
+	g_hash_table_destroy (arguments);
+
+	return status;
+}
+
+static gboolean
+bench_connection_status_available (GObject *object,
+				   guint    index)
+{
+	return TRUE;
+}
+
+static GHashTable *
+bench_connection_get_contact_statuses (GObject      *object,
+				       const GArray *contacts,
+				       GError      **error)
+{
+	GHashTable *result;
+	guint       i;
+
+	result = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+					(GDestroyNotify) tp_presence_status_free);
+	for (i = 0; i < contacts->len; i++) {
+		TpHandle contact = g_array_index (contacts, TpHandle, i);
+
+		g_hash_table_insert (result, GUINT_TO_POINTER (contact),
+				     bench_connection_dup_status (BENCH_CONNECTION (object),
+								  contact));
+	}
+
+	return result;
+}
+
+static gboolean
+bench_connection_set_own_status (GObject                 *object,
+				 const TpPresenceStatus  *status,
+				 GError                 **error)
+{
+	TpBaseConnection *base = TP_BASE_CONNECTION (object);
+	const gchar      *message = NULL;
+	GArray           *contacts;
+
+	if (status->optional_arguments != NULL) {
+		message = tp_asv_get_string (status->optional_arguments,
+					     "message");
+	}
+
+	bench_connection_set_presence (BENCH_CONNECTION (object),
+				       base->self_handle, status->index,
+				       message);
+
+	contacts = g_array_sized_new (FALSE, FALSE, sizeof (TpHandle), 1);
+	g_array_append_val (contacts, base->self_handle);
+	bench_connection_emit_presences (BENCH_CONNECTION (object), contacts);
+	g_array_free (contacts, TRUE);
+
+	return TRUE;
+}
+
+static void
+bench_connection_create_handle_repos (TpBaseConnection  *base,
+				      TpHandleRepoIface *repos[NUM_TP_HANDLE_TYPES])
+{
+	repos[TP_HANDLE_TYPE_CONTACT] =
+		tp_dynamic_handle_repo_new (TP_HANDLE_TYPE_CONTACT, NULL, NULL);
+	repos[TP_HANDLE_TYPE_ROOM] =
+		tp_dynamic_handle_repo_new (TP_HANDLE_TYPE_ROOM, NULL, NULL);
+	repos[TP_HANDLE_TYPE_LIST] =
+		tp_static_handle_repo_new (TP_HANDLE_TYPE_LIST,
+					   list_handle_strings);
+}
+
+static GPtrArray *
+bench_connection_create_channel_factories (TpBaseConnection *base)
+{
+	return g_ptr_array_sized_new (0);
+}
+
+static GPtrArray *
+bench_connection_create_channel_managers (TpBaseConnection *base)
+{
+	BenchConnectionPriv *priv = GET_PRIV (base);
+	GPtrArray           *managers;
+
+	priv->manager = g_object_new (BENCH_TYPE_CHANNEL_MANAGER, NULL);
+	priv->manager->conn = base;
+
+	/* The base connection owns the manager */
+	managers = g_ptr_array_sized_new (1);
+	g_ptr_array_add (managers, priv->manager);
+
+	return managers;
+}
+
+static gchar *
+bench_connection_get_unique_connection_name (TpBaseConnection *base)
+{
+	return g_strdup_printf ("bench%p", base);
+}
+
+static gboolean
+bench_connection_start_connecting (TpBaseConnection  *base,
+				   GError           **error)
+{
+	TpHandleRepoIface *contact_repo;
+
+	contact_repo = tp_base_connection_get_handles (base,
+						       TP_HANDLE_TYPE_CONTACT);
+	base->self_handle = tp_handle_ensure (contact_repo, "self@bench",
+					      NULL, error);
+	if (base->self_handle == 0) {
+		return FALSE;
+	}
+
+	/* There is no server to wait for */
+	tp_base_connection_change_status (base,
+					  TP_CONNECTION_STATUS_CONNECTING,
+					  TP_CONNECTION_STATUS_REASON_REQUESTED);
+	tp_base_connection_change_status (base,
+					  TP_CONNECTION_STATUS_CONNECTED,
+					  TP_CONNECTION_STATUS_REASON_REQUESTED);
+
+	return TRUE;
+}
+
+static void
+bench_connection_shut_down (TpBaseConnection *base)
+{
+	tp_base_connection_finish_shutdown (base);
+}
+
+static void
+bench_connection_constructed (GObject *object)
+{
+	TpBaseConnection *base = TP_BASE_CONNECTION (object);
+	void (*chain_up) (GObject *) =
+		G_OBJECT_CLASS (bench_connection_parent_class)->constructed;
+
+	if (chain_up != NULL) {
+		chain_up (object);
+	}
+
+	tp_contacts_mixin_init (object,
+				G_STRUCT_OFFSET (BenchConnection, contacts_mixin));
+	tp_base_connection_register_with_contacts_mixin (base);
+
+	tp_presence_mixin_init (object,
+				G_STRUCT_OFFSET (BenchConnection, presence_mixin));
+	tp_presence_mixin_simple_presence_register_with_contacts_mixin (object);
+}
+
+static void
+bench_connection_finalize (GObject *object)
+{
+	BenchConnectionPriv *priv = GET_PRIV (object);
+
+	tp_contacts_mixin_finalize (object);
+	tp_presence_mixin_finalize (object);
+	g_hash_table_destroy (priv->presences);
+
+	G_OBJECT_CLASS (bench_connection_parent_class)->finalize (object);
+}
+
+static void
+bench_connection_class_init (BenchConnectionClass *klass)
+{
+	GObjectClass          *object_class = G_OBJECT_CLASS (klass);
+	TpBaseConnectionClass *base_class = TP_BASE_CONNECTION_CLASS (klass);
+
+	object_class->constructed = bench_connection_constructed;
+	object_class->finalize = bench_connection_finalize;
+
+	base_class->create_handle_repos = bench_connection_create_handle_repos;
+	base_class->create_channel_factories = bench_connection_create_channel_factories;
+	base_class->create_channel_managers = bench_connection_create_channel_managers;
+	base_class->get_unique_connection_name = bench_connection_get_unique_connection_name;
+	base_class->start_connecting = bench_connection_start_connecting;
+	base_class->shut_down = bench_connection_shut_down;
+	base_class->interfaces_always_present = interfaces_always_present;
+
+	tp_contacts_mixin_class_init (object_class,
+				      G_STRUCT_OFFSET (BenchConnectionClass, contacts_class));
+
+	tp_presence_mixin_class_init (object_class,
+				      G_STRUCT_OFFSET (BenchConnectionClass, presence_class),
+				      bench_connection_status_available,
+				      bench_connection_get_contact_statuses,
+				      bench_connection_set_own_status,
+				      statuses);
+	tp_presence_mixin_simple_presence_init_dbus_properties (object_class);
+
+	g_type_class_add_private (object_class, sizeof (BenchConnectionPriv));
+}
+
+static void
+bench_connection_init (BenchConnection *conn)
+{
+	BenchConnectionPriv *priv = G_TYPE_INSTANCE_GET_PRIVATE (conn,
+		BENCH_TYPE_CONNECTION, BenchConnectionPriv);
+
+	conn->priv = priv;
+	priv->presences = g_hash_table_new_full (g_direct_hash,
+						 g_direct_equal,
+						 NULL,
+						 (GDestroyNotify) bench_connection_presence_free);
+}
+
+/**
+ * bench_connection_new:
+ * @error: a #GError set if the connection can't be put on the bus
+ *
+ * Creates a connection and registers it on the session bus. It gets
+ * connected when a client calls Connect().
+ *
+ * Return value: a new #BenchConnection, or %NULL
+ */
+BenchConnection *
+bench_connection_new (GError **error)
+{
+	BenchConnection *conn;
+	gchar           *bus_name;
+	gchar           *object_path;
+
+	conn = g_object_new (BENCH_TYPE_CONNECTION,
+			     "protocol", "bench",
+			     NULL);
+
+	if (!tp_base_connection_register (TP_BASE_CONNECTION (conn), "bench",
+					  &bus_name, &object_path, error)) {
+		g_object_unref (conn);
+		return NULL;
+	}
+
+	g_free (bus_name);
+	g_free (object_path);
+
+	return conn;
+}
+
+const gchar *
+bench_connection_get_bus_name (BenchConnection *conn)
+{
+	g_return_val_if_fail (BENCH_IS_CONNECTION (conn), NULL);
+
+	return TP_BASE_CONNECTION (conn)->bus_name;
+}
+
+const gchar *
+bench_connection_get_object_path (BenchConnection *conn)
+{
+	g_return_val_if_fail (BENCH_IS_CONNECTION (conn), NULL);
+
+	return TP_BASE_CONNECTION (conn)->object_path;
+}
+
+/* The caller owns a reference to the returned handle */
+TpHandle
+bench_connection_ensure_handle (BenchConnection *conn,
+				TpHandleType     handle_type,
+				const gchar     *id)
+{
+	TpHandleRepoIface *repo;
+
+	g_return_val_if_fail (BENCH_IS_CONNECTION (conn), 0);
+
+	repo = tp_base_connection_get_handles (TP_BASE_CONNECTION (conn),
+					       handle_type);
+
+	return tp_handle_ensure (repo, id, NULL, NULL);
+}
+
+/**
+ * bench_connection_add_to_roster:
+ * @conn: a #BenchConnection
+ * @contacts: the contact handles to add
+ *
+ * Adds @contacts to the subscribe and publish lists at once, as a server
+ * sending its roster would.
+ */
+void
+bench_connection_add_to_roster (BenchConnection *conn,
+				TpIntSet        *contacts)
+{
+	BenchConnectionPriv *priv = GET_PRIV (conn);
+	BenchChannel        *channel;
+	TpHandle             handle;
+
+	g_return_if_fail (BENCH_IS_CONNECTION (conn));
+
+	for (handle = 1; list_handle_strings[handle - 1] != NULL; handle++) {
+		channel = bench_channel_manager_ensure_list (priv->manager,
+							     handle, NULL);
+		bench_channel_add_members (channel, contacts);
+	}
+}
+
+/* Only changes the stored presence, see bench_connection_emit_presences() */
+void
+bench_connection_set_presence (BenchConnection *conn,
+			       TpHandle         contact,
+			       BenchPresence    presence,
+			       const gchar     *message)
+{
+	BenchConnectionPriv  *priv = GET_PRIV (conn);
+	BenchContactPresence *contact_presence;
+
+	g_return_if_fail (BENCH_IS_CONNECTION (conn));
+	g_return_if_fail (presence < BENCH_PRESENCE_COUNT);
+
+	contact_presence = g_slice_new (BenchContactPresence);
+	contact_presence->presence = presence;
+	contact_presence->message = g_strdup (message ? message : "");
+	g_hash_table_replace (priv->presences, GUINT_TO_POINTER (contact),
+			      contact_presence);
+}
+
+/* Signals the presences of @contacts in a single PresencesChanged */
+void
+bench_connection_emit_presences (BenchConnection *conn,
+				 const GArray    *contacts)
+{
+	GHashTable *presences;
+
+	g_return_if_fail (BENCH_IS_CONNECTION (conn));
+
+	presences = bench_connection_get_contact_statuses (G_OBJECT (conn),
+							   contacts, NULL);
+	tp_presence_mixin_emit_presence_update (G_OBJECT (conn), presences);
+	g_hash_table_destroy (presences);
+}
+
+/**
+ * bench_connection_new_text_channel:
+ * @conn: a #BenchConnection
+ * @handle_type: %TP_HANDLE_TYPE_CONTACT or %TP_HANDLE_TYPE_ROOM
+ * @handle: the contact or room talking to us
+ *
+ * Announces an incoming text channel. Rooms are already joined.
+ *
+ * Return value: the new channel, owned by the connection
+ */
+BenchChannel *
+bench_connection_new_text_channel (BenchConnection *conn,
+				   TpHandleType     handle_type,
+				   TpHandle         handle)
+{
+	BenchConnectionPriv *priv = GET_PRIV (conn);
+	BenchChannelManager *manager = priv->manager;
+	TpBaseConnection    *base = TP_BASE_CONNECTION (conn);
+	BenchChannel        *channel;
+	gchar               *object_path;
+
+	g_return_val_if_fail (BENCH_IS_CONNECTION (conn), NULL);
+
+	object_path = g_strdup_printf ("%s/Text%u", base->object_path,
+				       manager->n_text_channels++);
+	channel = bench_channel_new (base, object_path,
+				     TP_IFACE_CHANNEL_TYPE_TEXT,
+				     handle_type, handle,
+				     handle_type == TP_HANDLE_TYPE_CONTACT ?
+				     handle : base->self_handle,
+				     FALSE);
+	g_free (object_path);
+
+	g_hash_table_insert (manager->text_channels, channel->object_path,
+			     channel);
+	g_signal_connect (channel, "closed",
+			  G_CALLBACK (bench_channel_manager_text_closed_cb),
+			  manager);
+
+	tp_channel_manager_emit_new_channel (manager,
+					     TP_EXPORTABLE_CHANNEL (channel),
+					     NULL);
+
+	return channel;
+}
+
+/**
+ * bench_connection_new_file_channel:
+ * @conn: a #BenchConnection
+ * @sender: the contact offering the file
+ * @filename: the name of the file
+ * @data: the content of the file
+ * @size: the length of @data
+ * @content_hash_type: the #TpFileHashType of @content_hash
+ * @content_hash: the hash of @data, or %NULL
+ *
+ * Announces an incoming file transfer.
+ *
+ * Return value: the new channel, owned by the connection
+ */
+BenchFtChannel *
+bench_connection_new_file_channel (BenchConnection *conn,
+				   TpHandle         sender,
+				   const gchar     *filename,
+				   const gchar     *data,
+				   gsize            size,
+				   TpFileHashType   content_hash_type,
+				   const gchar     *content_hash)
+{
+	BenchConnectionPriv *priv = GET_PRIV (conn);
+	BenchChannelManager *manager = priv->manager;
+	TpBaseConnection    *base = TP_BASE_CONNECTION (conn);
+	BenchFtChannel      *channel;
+	gchar               *object_path;
+
+	g_return_val_if_fail (BENCH_IS_CONNECTION (conn), NULL);
+
+	object_path = g_strdup_printf ("%s/FileTransfer%u", base->object_path,
+				       manager->n_file_channels++);
+	channel = bench_ft_channel_new (base, object_path, sender, filename,
+					data, size, content_hash_type,
+					content_hash);
+	g_free (object_path);
+
+	g_hash_table_insert (manager->file_channels, channel->object_path,
+			     channel);
+	g_signal_connect (channel, "closed",
+			  G_CALLBACK (bench_channel_manager_file_closed_cb),
+			  manager);
+
+	tp_channel_manager_emit_new_channel (manager,
+					     TP_EXPORTABLE_CHANNEL (channel),
+					     NULL);
+
+	return channel;
+}
@@ -0,0 +1,102 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef __BENCH_CONNECTION_H__
+#define __BENCH_CONNECTION_H__
+
+#include <glib-object.h>
+
+#include <telepathy-glib/base-connection.h>
+#include <telepathy-glib/contacts-mixin.h>
+#include <telepathy-glib/presence-mixin.h>
+
+#include "bench-channel.h"
+#include "bench-ft-channel.h"
+
+G_BEGIN_DECLS
+
+#define BENCH_TYPE_CONNECTION         (bench_connection_get_type ())
+#define BENCH_CONNECTION(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), BENCH_TYPE_CONNECTION, BenchConnection))
+#define BENCH_CONNECTION_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST ((k), BENCH_TYPE_CONNECTION, BenchConnectionClass))
+#define BENCH_IS_CONNECTION(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), BENCH_TYPE_CONNECTION))
+#define BENCH_IS_CONNECTION_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), BENCH_TYPE_CONNECTION))
+#define BENCH_CONNECTION_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), BENCH_TYPE_CONNECTION, BenchConnectionClass))
+
+typedef struct _BenchConnection      BenchConnection;
+typedef struct _BenchConnectionClass BenchConnectionClass;
+
+/* Statuses of the bench protocol */
+typedef enum {
+	BENCH_PRESENCE_OFFLINE,
+	BENCH_PRESENCE_AVAILABLE,
+	BENCH_PRESENCE_AWAY,
+	BENCH_PRESENCE_BUSY,
+	BENCH_PRESENCE_COUNT
+} BenchPresence;
+
+/* An in-process connection manager standing in for a real one: contacts
+ * are whatever identifiers are asked for, and the roster, presences,
+ * incoming messages and file transfers are driven by the benchmark
+ * itself. */
+struct _BenchConnection {
+	TpBaseConnection  parent;
+
+	TpPresenceMixin   presence_mixin;
+	TpContactsMixin   contacts_mixin;
+
+	gpointer          priv;
+};
+
+struct _BenchConnectionClass {
+	TpBaseConnectionClass parent_class;
+
+	TpPresenceMixinClass  presence_class;
+	TpContactsMixinClass  contacts_class;
+};
+
+GType            bench_connection_get_type         (void) G_GNUC_CONST;
+BenchConnection *bench_connection_new              (GError          **error);
+const gchar *    bench_connection_get_bus_name     (BenchConnection  *conn);
+const gchar *    bench_connection_get_object_path  (BenchConnection  *conn);
+TpHandle         bench_connection_ensure_handle    (BenchConnection  *conn,
+						    TpHandleType      handle_type,
+						    const gchar      *id);
+void             bench_connection_add_to_roster    (BenchConnection  *conn,
+						    TpIntSet         *contacts);
+void             bench_connection_set_presence     (BenchConnection  *conn,
+						    TpHandle          contact,
+						    BenchPresence     presence,
+						    const gchar      *message);
+void             bench_connection_emit_presences   (BenchConnection  *conn,
+						    const GArray     *contacts);
+BenchChannel *   bench_connection_new_text_channel (BenchConnection  *conn,
+						    TpHandleType      handle_type,
+						    TpHandle          handle);
+BenchFtChannel * bench_connection_new_file_channel (BenchConnection  *conn,
+						    TpHandle          sender,
+						    const gchar      *filename,
+						    const gchar      *data,
+						    gsize             size,
+						    TpFileHashType    content_hash_type,
+						    const gchar      *content_hash);
+
+G_END_DECLS
+
+#endif /* __BENCH_CONNECTION_H__ */
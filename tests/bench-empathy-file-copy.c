@@ -0,0 +1,215 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Throughput of the file transfer copy engine between a local file and a
+ * Unix socket, like the one a connection manager gives us. A thread plays
+ * the connection manager on the other end of the socket.
+ * Usage: bench-empathy-file-copy [size_in_MB] [ring_depth] */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+
+#include <libempathy/empathy-file-copy.h>
+
+#define DEFAULT_SIZE_MB 256
+#define PEER_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+	gint    fd;
+	guint64 size;
+} Peer;
+
+static GMainLoop *loop;
+static guint      ring_depth = 8;
+
+/* The connection manager receiving a file we send */
+static gpointer
+peer_read_thread (gpointer user_data)
+{
+	Peer  *peer = user_data;
+	gchar *buffer;
+
+	buffer = g_malloc (PEER_BUFFER_SIZE);
+	while (read (peer->fd, buffer, PEER_BUFFER_SIZE) > 0)
+		;
+	close (peer->fd);
+	g_free (buffer);
+
+	return NULL;
+}
+
+/* The connection manager sending us a file */
+static gpointer
+peer_write_thread (gpointer user_data)
+{
+	Peer    *peer = user_data;
+	gchar   *buffer;
+	guint64  left = peer->size;
+
+	buffer = g_malloc (PEER_BUFFER_SIZE);
+	memset (buffer, 'x', PEER_BUFFER_SIZE);
+	while (left > 0) {
+		gssize n;
+
+		n = write (peer->fd, buffer, MIN (left, PEER_BUFFER_SIZE));
+		if (n <= 0) {
+			break;
+		}
+		left -= n;
+	}
+	close (peer->fd);
+	g_free (buffer);
+
+	return NULL;
+}
+
+static void
+copy_done_cb (EmpathyFileCopy *copy,
+	      const GError    *error,
+	      gpointer         user_data)
+{
+	if (error != NULL) {
+		g_printerr ("Copy failed: %s\n", error->message);
+	}
+	g_main_loop_quit (loop);
+}
+
+static void
+run (const gchar *filename,
+     guint64      size,
+     gboolean     incoming,
+     gboolean     zero_copy)
+{
+	EmpathyFileCopy *copy;
+	GInputStream    *in;
+	GOutputStream   *out;
+	GThread         *thread;
+	GTimer          *timer;
+	Peer             peer;
+	gint             fds[2];
+	gint             file_fd;
+	gdouble          elapsed;
+	EmpathyFileCopyStats stats;
+
+	if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+		g_error ("socketpair failed");
+	}
+
+	peer.fd = fds[1];
+	peer.size = size;
+
+	if (incoming) {
+		file_fd = g_open (filename, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		in = g_unix_input_stream_new (fds[0], TRUE);
+		out = g_unix_output_stream_new (file_fd, TRUE);
+		copy = empathy_file_copy_new (in, out, NULL);
+		if (zero_copy) {
+			empathy_file_copy_set_fds (copy, fds[0], file_fd);
+		}
+		thread = g_thread_create (peer_write_thread, &peer, TRUE, NULL);
+	} else {
+		file_fd = g_open (filename, O_RDONLY, 0);
+		in = g_unix_input_stream_new (file_fd, TRUE);
+		out = g_unix_output_stream_new (fds[0], TRUE);
+		copy = empathy_file_copy_new (in, out, NULL);
+		if (zero_copy) {
+			empathy_file_copy_set_fds (copy, file_fd, fds[0]);
+		}
+		thread = g_thread_create (peer_read_thread, &peer, TRUE, NULL);
+	}
+
+	empathy_file_copy_set_ring (copy, ring_depth, 256 * 1024);
+	empathy_file_copy_set_callbacks (copy, NULL, copy_done_cb, NULL);
+
+	timer = g_timer_new ();
+	empathy_file_copy_start (copy);
+	g_main_loop_run (loop);
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	g_thread_join (thread);
+
+	empathy_file_copy_get_stats (copy, &stats);
+	/* The engine is the one that did the copy, zero-copy can fall back
+	 * to GIO */
+	g_print ("scenario=%s-%s engine=%s bytes=%" G_GUINT64_FORMAT
+		 " seconds=%.3f mb_per_second=%.1f stalls=%u buffer_kb=%lu\n",
+		 incoming ? "receive" : "send",
+		 zero_copy ? "zero-copy" : "gio",
+		 empathy_file_copy_is_zero_copy (copy) ? "zero-copy" : "gio",
+		 empathy_file_copy_get_copied (copy),
+		 elapsed, elapsed > 0 ? size / elapsed / (1024 * 1024) : 0,
+		 stats.stalls, (gulong) (stats.buffer_size / 1024));
+
+	g_timer_destroy (timer);
+	empathy_file_copy_unref (copy);
+	g_object_unref (in);
+	g_object_unref (out);
+}
+
+int
+main (int argc, char **argv)
+{
+	gchar   *filename;
+	guint64  size = (guint64) DEFAULT_SIZE_MB * 1024 * 1024;
+	gint     fd;
+
+	g_thread_init (NULL);
+	g_type_init ();
+
+	if (argc > 1) {
+		size = (guint64) atoi (argv[1]) * 1024 * 1024;
+	}
+	if (argc > 2) {
+		ring_depth = MAX (atoi (argv[2]), 2);
+	}
+
+	fd = g_file_open_tmp ("bench-empathy-file-copy-XXXXXX", &filename,
+			      NULL);
+	if (fd < 0) {
+		g_error ("Can't create a temporary file");
+	}
+	close (fd);
+
+	loop = g_main_loop_new (NULL, FALSE);
+
+	/* Receiving also creates the file to send afterwards */
+	run (filename, size, TRUE, FALSE);
+	run (filename, size, TRUE, TRUE);
+	run (filename, size, FALSE, FALSE);
+	run (filename, size, FALSE, TRUE);
+
+	g_unlink (filename);
+	g_free (filename);
+	g_main_loop_unref (loop);
+
+	return EXIT_SUCCESS;
+}
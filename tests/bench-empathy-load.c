@@ -0,0 +1,683 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Load put on libempathy by a busy connection. A stand-in connection
+ * manager (bench-connection.c) runs in this process and libempathy talks
+ * to it over the session bus, as it would to a real one:
+ *  - roster: EmpathyTpContactList getting a large roster;
+ *  - presence-storm: the whole roster changing presence, in batches;
+ *  - muc-flood: messages from many senders in a room, through EmpathyTpChat;
+ *  - pending-backlog: EmpathyTpChat fetching a long queue of messages
+ *    received before the chat was opened;
+ *  - file-transfer: EmpathyTpFile receiving a file, whose hash is checked
+ *    as it is copied to the disk.
+ * Each scenario prints one line of key=value pairs. Latencies are from the
+ * connection sending an event to libempathy signalling it, or from the
+ * start of the scenario when all events are there from the start.
+ * Usage: bench-empathy-load [n_contacts] [n_events]
+ * It needs a session bus of its own, "make bench" runs it in one. */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <telepathy-glib/channel.h>
+#include <telepathy-glib/connection.h>
+#include <telepathy-glib/dbus.h>
+#include <telepathy-glib/interfaces.h>
+
+#include <libempathy/empathy-contact-list.h>
+#include <libempathy/empathy-message.h>
+#include <libempathy/empathy-tp-chat.h>
+#include <libempathy/empathy-tp-contact-list.h>
+#include <libempathy/empathy-tp-file.h>
+
+#include "bench-connection.h"
+
+#define DEFAULT_N_CONTACTS 5000
+#define DEFAULT_N_EVENTS 20000
+#define PRESENCE_BATCH 100
+#define N_ROOM_SENDERS 50
+#define FILE_TRANSFER_SIZE (32 * 1024 * 1024)
+/* Seconds before a scenario is given up */
+#define TIMEOUT 300
+
+typedef struct {
+	const gchar *name;
+	guint        n_events;
+	guint        received;
+	gdouble      start;
+	gdouble      end;
+	gdouble     *sent;
+	GArray      *latencies;
+} Bench;
+
+static GMainLoop       *loop;
+static GTimer          *timer;
+static BenchConnection *conn;
+/* Whether a scenario was given up, the run then fails */
+static gboolean         timed_out = FALSE;
+static TpConnection    *connection;
+static GArray          *roster;
+
+static Bench *
+bench_new (const gchar *name,
+	   guint        n_events)
+{
+	Bench *bench;
+	guint  i;
+
+	bench = g_slice_new0 (Bench);
+	bench->name = name;
+	bench->n_events = n_events;
+	bench->start = g_timer_elapsed (timer, NULL);
+	bench->end = bench->start;
+	bench->latencies = g_array_sized_new (FALSE, FALSE, sizeof (gdouble),
+					      n_events);
+
+	/* Until sent, events count as sent at the start */
+	bench->sent = g_new (gdouble, n_events);
+	for (i = 0; i < n_events; i++) {
+		bench->sent[i] = bench->start;
+	}
+
+	return bench;
+}
+
+static void
+bench_free (Bench *bench)
+{
+	g_array_free (bench->latencies, TRUE);
+	g_free (bench->sent);
+	g_slice_free (Bench, bench);
+}
+
+static void
+bench_sent (Bench *bench,
+	    guint  seq)
+{
+	bench->sent[seq] = g_timer_elapsed (timer, NULL);
+}
+
+static void
+bench_received (Bench *bench,
+		guint  seq)
+{
+	gdouble now;
+	gdouble latency;
+
+	if (seq >= bench->n_events) {
+		return;
+	}
+
+	now = g_timer_elapsed (timer, NULL);
+	latency = now - bench->sent[seq];
+	g_array_append_val (bench->latencies, latency);
+	bench->end = now;
+
+	if (++bench->received == bench->n_events) {
+		g_main_loop_quit (loop);
+	}
+}
+
+static gboolean
+timeout_cb (gpointer user_data)
+{
+	g_printerr ("Timed out\n");
+	timed_out = TRUE;
+	g_main_loop_quit (loop);
+
+	return FALSE;
+}
+
+/* Runs the main loop until something quits it, or TIMEOUT */
+static void
+run_loop (void)
+{
+	guint id;
+
+	id = g_timeout_add_seconds (TIMEOUT, timeout_cb, NULL);
+	g_main_loop_run (loop);
+	g_source_remove (id);
+}
+
+static void
+bench_run (Bench *bench)
+{
+	if (bench->received < bench->n_events) {
+		run_loop ();
+	}
+}
+
+static gint
+compare_doubles (gconstpointer a,
+		 gconstpointer b)
+{
+	gdouble x = *(const gdouble *) a;
+	gdouble y = *(const gdouble *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static gdouble
+percentile (GArray *sorted,
+	    guint   p)
+{
+	if (sorted->len == 0) {
+		return 0;
+	}
+
+	return g_array_index (sorted, gdouble, (sorted->len - 1) * p / 100);
+}
+
+static void
+bench_report (Bench *bench)
+{
+	gdouble elapsed;
+
+	g_array_sort (bench->latencies, compare_doubles);
+	elapsed = bench->end - bench->start;
+
+	g_print ("scenario=%s events=%u received=%u seconds=%.3f"
+		 " per_second=%.1f latency_ms_p50=%.3f latency_ms_p95=%.3f"
+		 " latency_ms_max=%.3f\n",
+		 bench->name, bench->n_events, bench->received, elapsed,
+		 elapsed > 0 ? bench->received / elapsed : 0,
+		 percentile (bench->latencies, 50) * 1000,
+		 percentile (bench->latencies, 95) * 1000,
+		 percentile (bench->latencies, 100) * 1000);
+}
+
+static guint
+parse_seq (const gchar *text,
+	   const gchar *prefix)
+{
+	if (text == NULL || !g_str_has_prefix (text, prefix)) {
+		return G_MAXUINT;
+	}
+
+	return atoi (text + strlen (prefix));
+}
+
+static void
+connection_ready_cb (TpConnection *proxy,
+		     const GError *error,
+		     gpointer      user_data)
+{
+	if (error) {
+		g_error ("Connection failed: %s", error->message);
+	}
+
+	g_main_loop_quit (loop);
+}
+
+static void
+channel_ready_cb (TpChannel    *channel,
+		  const GError *error,
+		  gpointer      user_data)
+{
+	if (error) {
+		g_error ("Channel failed: %s", error->message);
+	}
+
+	g_main_loop_quit (loop);
+}
+
+static void
+chat_ready_cb (EmpathyTpChat *chat,
+	       GParamSpec    *pspec,
+	       gpointer       user_data)
+{
+	g_main_loop_quit (loop);
+}
+
+static void
+chat_message_received_cb (EmpathyTpChat  *chat,
+			  EmpathyMessage *message,
+			  Bench          *bench)
+{
+	/* Like the chat window showing it */
+	bench_received (bench, parse_seq (empathy_message_get_body (message),
+					  "message "));
+	empathy_tp_chat_acknowledge_message (chat, message);
+}
+
+/* Opens @channel the way the dispatcher does */
+static EmpathyTpChat *
+chat_new (BenchChannel *channel,
+	  Bench        *bench)
+{
+	TpChannel     *tp_channel;
+	EmpathyTpChat *chat;
+	GError        *error = NULL;
+	gulong         id;
+
+	tp_channel = tp_channel_new (connection,
+				     bench_channel_get_object_path (channel),
+				     TP_IFACE_CHANNEL_TYPE_TEXT,
+				     channel->handle_type, channel->handle,
+				     &error);
+	if (tp_channel == NULL) {
+		g_error ("Can't open the channel: %s", error->message);
+	}
+
+	tp_channel_call_when_ready (tp_channel, channel_ready_cb, NULL);
+	run_loop ();
+
+	chat = empathy_tp_chat_new (tp_channel);
+	g_object_unref (tp_channel);
+	g_signal_connect (chat, "message-received",
+			  G_CALLBACK (chat_message_received_cb),
+			  bench);
+
+	id = g_signal_connect (chat, "notify::ready",
+			       G_CALLBACK (chat_ready_cb), NULL);
+	if (!empathy_tp_chat_is_ready (chat)) {
+		run_loop ();
+	}
+	g_signal_handler_disconnect (chat, id);
+
+	return chat;
+}
+
+static void
+tp_file_ready_cb (EmpathyTpFile *tp_file,
+		  GParamSpec    *pspec,
+		  gpointer       user_data)
+{
+	g_main_loop_quit (loop);
+}
+
+static void
+tp_file_content_hash_checked_cb (EmpathyTpFile *tp_file,
+				 gboolean       valid,
+				 Bench         *bench)
+{
+	if (!valid) {
+		g_error ("The received file doesn't match the sent one");
+	}
+
+	bench_received (bench, 0);
+}
+
+/* Opens @channel the way the dispatcher does */
+static EmpathyTpFile *
+tp_file_new (BenchFtChannel *channel,
+	     TpHandle        sender)
+{
+	TpChannel     *tp_channel;
+	EmpathyTpFile *tp_file;
+	GError        *error = NULL;
+	gulong         id;
+
+	tp_channel = tp_channel_new (connection,
+				     bench_ft_channel_get_object_path (channel),
+				     TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER,
+				     TP_HANDLE_TYPE_CONTACT, sender, &error);
+	if (tp_channel == NULL) {
+		g_error ("Can't open the channel: %s", error->message);
+	}
+
+	tp_channel_call_when_ready (tp_channel, channel_ready_cb, NULL);
+	run_loop ();
+
+	tp_file = empathy_tp_file_new (tp_channel);
+	g_object_unref (tp_channel);
+
+	id = g_signal_connect (tp_file, "notify::ready",
+			       G_CALLBACK (tp_file_ready_cb), NULL);
+	if (!empathy_tp_file_is_ready (tp_file)) {
+		run_loop ();
+	}
+	g_signal_handler_disconnect (tp_file, id);
+
+	return tp_file;
+}
+
+static void
+roster_members_changed_cb (EmpathyContactList *list,
+			   EmpathyContact     *contact,
+			   EmpathyContact     *actor,
+			   guint               reason,
+			   gchar              *message,
+			   gboolean            is_member,
+			   Bench              *bench)
+{
+	if (is_member) {
+		bench_received (bench, bench->received);
+	}
+}
+
+static EmpathyTpContactList *
+run_roster (guint n_contacts)
+{
+	EmpathyTpContactList *list;
+	TpIntSet             *contacts;
+	Bench                *bench;
+	guint                 i;
+
+	contacts = tp_intset_new ();
+	for (i = 0; i < n_contacts; i++) {
+		TpHandle  handle;
+		gchar    *id;
+
+		id = g_strdup_printf ("contact%u@bench", i);
+		handle = bench_connection_ensure_handle (conn,
+							 TP_HANDLE_TYPE_CONTACT,
+							 id);
+		g_array_append_val (roster, handle);
+		tp_intset_add (contacts, handle);
+		bench_connection_set_presence (conn, handle,
+					       BENCH_PRESENCE_AVAILABLE, "");
+		g_free (id);
+	}
+	bench_connection_add_to_roster (conn, contacts);
+	tp_intset_destroy (contacts);
+
+	bench = bench_new ("roster", n_contacts);
+	list = empathy_tp_contact_list_new (connection);
+	g_signal_connect (list, "members-changed",
+			  G_CALLBACK (roster_members_changed_cb),
+			  bench);
+	bench_run (bench);
+	g_signal_handlers_disconnect_by_func (list,
+					      roster_members_changed_cb,
+					      bench);
+
+	bench_report (bench);
+	bench_free (bench);
+
+	return list;
+}
+
+static void
+contact_presence_message_cb (EmpathyContact *contact,
+			     GParamSpec     *pspec,
+			     Bench          *bench)
+{
+	bench_received (bench, parse_seq (
+		empathy_contact_get_presence_message (contact), "storm "));
+}
+
+static void
+run_presence_storm (EmpathyTpContactList *list,
+		    guint                 n_events)
+{
+	GList  *members, *l;
+	GArray *batch;
+	Bench  *bench;
+	guint   batch_size;
+	guint   seq;
+
+	/* Contacts are in a single batch at most once */
+	batch_size = MIN (PRESENCE_BATCH, roster->len);
+	batch = g_array_sized_new (FALSE, FALSE, sizeof (TpHandle),
+				   batch_size);
+
+	bench = bench_new ("presence-storm", n_events);
+	members = empathy_contact_list_get_members (EMPATHY_CONTACT_LIST (list));
+	for (l = members; l; l = l->next) {
+		g_signal_connect (l->data, "notify::presence-message",
+				  G_CALLBACK (contact_presence_message_cb),
+				  bench);
+	}
+
+	for (seq = 0; seq < n_events; seq++) {
+		TpHandle  handle;
+		gchar    *message;
+
+		handle = g_array_index (roster, TpHandle, seq % roster->len);
+		message = g_strdup_printf ("storm %u", seq);
+		bench_connection_set_presence (conn, handle,
+					       seq % 2 ? BENCH_PRESENCE_AWAY :
+					       BENCH_PRESENCE_BUSY,
+					       message);
+		g_array_append_val (batch, handle);
+		bench_sent (bench, seq);
+		g_free (message);
+
+		if (batch->len == batch_size || seq == n_events - 1) {
+			bench_connection_emit_presences (conn, batch);
+			g_array_set_size (batch, 0);
+		}
+	}
+	bench_run (bench);
+
+	for (l = members; l; l = l->next) {
+		g_signal_handlers_disconnect_by_func (l->data,
+						      contact_presence_message_cb,
+						      bench);
+		g_object_unref (l->data);
+	}
+	g_list_free (members);
+
+	bench_report (bench);
+	bench_free (bench);
+	g_array_free (batch, TRUE);
+}
+
+static void
+run_muc_flood (guint n_events)
+{
+	BenchChannel  *channel;
+	EmpathyTpChat *chat;
+	TpIntSet      *senders;
+	TpHandle       room;
+	Bench         *bench;
+	guint          n_senders;
+	guint          i;
+
+	room = bench_connection_ensure_handle (conn, TP_HANDLE_TYPE_ROOM,
+					       "flood@conference.bench");
+	channel = bench_connection_new_text_channel (conn, TP_HANDLE_TYPE_ROOM,
+						     room);
+
+	n_senders = MIN (N_ROOM_SENDERS, roster->len);
+	senders = tp_intset_new ();
+	for (i = 0; i < n_senders; i++) {
+		tp_intset_add (senders, g_array_index (roster, TpHandle, i));
+	}
+	bench_channel_add_members (channel, senders);
+	tp_intset_destroy (senders);
+
+	bench = bench_new ("muc-flood", n_events);
+	chat = chat_new (channel, bench);
+
+	/* Only the flood itself is timed */
+	bench->start = g_timer_elapsed (timer, NULL);
+	for (i = 0; i < n_events; i++) {
+		gchar *text;
+
+		text = g_strdup_printf ("message %u", i);
+		bench_sent (bench, i);
+		bench_channel_receive (channel,
+				       g_array_index (roster, TpHandle,
+						      i % n_senders),
+				       text);
+		g_free (text);
+	}
+	bench_run (bench);
+
+	bench_report (bench);
+	bench_free (bench);
+	g_object_unref (chat);
+}
+
+static void
+run_pending_backlog (guint n_events)
+{
+	BenchChannel  *channel;
+	EmpathyTpChat *chat;
+	TpHandle       contact;
+	Bench         *bench;
+	guint          i;
+
+	contact = g_array_index (roster, TpHandle, 0);
+	channel = bench_connection_new_text_channel (conn,
+						     TP_HANDLE_TYPE_CONTACT,
+						     contact);
+	for (i = 0; i < n_events; i++) {
+		gchar *text;
+
+		text = g_strdup_printf ("message %u", i);
+		bench_channel_receive (channel, contact, text);
+		g_free (text);
+	}
+
+	/* From opening the channel to the last message shown */
+	bench = bench_new ("pending-backlog", n_events);
+	chat = chat_new (channel, bench);
+	bench_run (bench);
+
+	bench_report (bench);
+	bench_free (bench);
+	g_object_unref (chat);
+}
+
+static void
+run_file_transfer (void)
+{
+	BenchFtChannel *channel;
+	EmpathyTpFile  *tp_file;
+	TpHandle        sender;
+	GFile          *gfile;
+	GError         *error = NULL;
+	Bench          *bench;
+	gchar          *data;
+	gchar          *hash;
+	gchar          *path;
+	gdouble         elapsed;
+	gint            fd;
+	guint           i;
+
+	data = g_malloc (FILE_TRANSFER_SIZE);
+	for (i = 0; i < FILE_TRANSFER_SIZE; i++) {
+		data[i] = (i * 7 + i / 251) & 0xff;
+	}
+	hash = g_compute_checksum_for_data (G_CHECKSUM_MD5,
+					    (const guchar *) data,
+					    FILE_TRANSFER_SIZE);
+
+	sender = g_array_index (roster, TpHandle, 0);
+	channel = bench_connection_new_file_channel (conn, sender,
+						     "bench.dat", data,
+						     FILE_TRANSFER_SIZE,
+						     TP_FILE_HASH_TYPE_MD5,
+						     hash);
+	tp_file = tp_file_new (channel, sender);
+
+	fd = g_file_open_tmp ("bench-empathy-load-XXXXXX", &path, &error);
+	if (fd < 0) {
+		g_error ("Can't create the file: %s", error->message);
+	}
+	close (fd);
+	gfile = g_file_new_for_path (path);
+
+	/* From accepting the transfer to the data being on the disk */
+	bench = bench_new ("file-transfer", 1);
+	g_signal_connect (tp_file, "content-hash-checked",
+			  G_CALLBACK (tp_file_content_hash_checked_cb),
+			  bench);
+	empathy_tp_file_accept (tp_file, 0, gfile, &error);
+	if (error != NULL) {
+		g_error ("Can't accept the transfer: %s", error->message);
+	}
+	bench_run (bench);
+
+	elapsed = bench->end - bench->start;
+	g_print ("scenario=%s bytes=%u received=%u seconds=%.3f"
+		 " mb_per_second=%.1f\n",
+		 bench->name, FILE_TRANSFER_SIZE,
+		 bench->received ? FILE_TRANSFER_SIZE : 0, elapsed,
+		 elapsed > 0 && bench->received ?
+		 FILE_TRANSFER_SIZE / elapsed / (1024 * 1024) : 0);
+
+	bench_free (bench);
+	g_object_unref (tp_file);
+	g_object_unref (gfile);
+	g_unlink (path);
+	g_free (path);
+	g_free (hash);
+	g_free (data);
+}
+
+int
+main (int argc, char **argv)
+{
+	EmpathyTpContactList *list;
+	TpDBusDaemon         *daemon;
+	GError               *error = NULL;
+	guint                 n_contacts = DEFAULT_N_CONTACTS;
+	guint                 n_events = DEFAULT_N_EVENTS;
+
+	g_thread_init (NULL);
+	g_type_init ();
+
+	if (argc > 1) {
+		n_contacts = MAX (atoi (argv[1]), 1);
+	}
+	if (argc > 2) {
+		n_events = MAX (atoi (argv[2]), 1);
+	}
+
+	loop = g_main_loop_new (NULL, FALSE);
+	timer = g_timer_new ();
+	roster = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+
+	conn = bench_connection_new (&error);
+	if (conn == NULL) {
+		g_error ("Can't register the connection: %s", error->message);
+	}
+
+	daemon = tp_dbus_daemon_new (tp_get_bus ());
+	connection = tp_connection_new (daemon,
+					bench_connection_get_bus_name (conn),
+					bench_connection_get_object_path (conn),
+					&error);
+	if (connection == NULL) {
+		g_error ("Can't open the connection: %s", error->message);
+	}
+
+	tp_cli_connection_call_connect (connection, -1, NULL, NULL, NULL, NULL);
+	tp_connection_call_when_ready (connection, connection_ready_cb, NULL);
+	run_loop ();
+
+	list = run_roster (n_contacts);
+	run_presence_storm (list, n_events);
+	run_muc_flood (n_events);
+	run_pending_backlog (n_events);
+	run_file_transfer ();
+
+	g_object_unref (list);
+	g_object_unref (connection);
+	g_object_unref (daemon);
+	g_object_unref (conn);
+	g_array_free (roster, TRUE);
+	g_timer_destroy (timer);
+	g_main_loop_unref (loop);
+
+	return timed_out ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,324 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Times the log manager on a generated history of two years: logging new
+ * messages, listing dates, opening a day in the log viewer, the backlog
+ * shown when a chat opens, and searches. The logs live in a temporary
+ * EMPATHY_LOG_DIR, but they belong to accounts of the "test" profile,
+ * so MC_PROFILE_DIR and MC_MANAGER_DIR must point at this directory.
+ * Usage: bench-empathy-log [n_days] */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libmissioncontrol/mc-account.h>
+#include <libmissioncontrol/mc-profile.h>
+
+#include <libempathy/empathy-contact.h>
+#include <libempathy/empathy-log-manager.h>
+#include <libempathy/empathy-message.h>
+
+#include "bench-log-fixture.h"
+
+#define N_ACCOUNTS 2
+#define N_ADD 10000
+#define N_SENDERS 20
+#define N_DAYS_OPENED 200
+
+/* One line per scenario, in the format of bench-empathy-load */
+static void
+report (const gchar *name,
+	guint        ops,
+	guint        results,
+	gdouble      elapsed)
+{
+	g_print ("scenario=%s ops=%u results=%u seconds=%.3f per_second=%.1f"
+		 " ms_per_op=%.3f\n",
+		 name, ops, results, elapsed,
+		 elapsed > 0 ? ops / elapsed : 0,
+		 ops > 0 ? elapsed * 1000 / ops : 0);
+}
+
+/* Log reading looks accounts up by name, so the logs have to belong to
+ * real ones. Like check-empathy-helpers.c, reuse accounts left over by
+ * previous runs as they can't be removed from GConf. */
+static GList *
+get_accounts (guint n)
+{
+	McProfile *profile;
+	GList     *accounts;
+
+	profile = mc_profile_lookup ("test");
+	if (profile == NULL) {
+		g_error ("No \"test\" profile, set MC_PROFILE_DIR and "
+			 "MC_MANAGER_DIR to the tests directory");
+	}
+
+	accounts = mc_accounts_list_by_profile (profile);
+	while (g_list_length (accounts) < n) {
+		accounts = g_list_append (accounts,
+					  mc_account_create (profile));
+	}
+	g_object_unref (profile);
+
+	return accounts;
+}
+
+static void
+remove_dir (const gchar *path)
+{
+	GDir        *dir;
+	const gchar *name;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir != NULL) {
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			gchar *child;
+
+			child = g_build_filename (path, name, NULL);
+			if (g_file_test (child, G_FILE_TEST_IS_DIR)) {
+				remove_dir (child);
+			} else {
+				g_unlink (child);
+			}
+			g_free (child);
+		}
+		g_dir_close (dir);
+	}
+	g_rmdir (path);
+}
+
+static gboolean
+accept_all (EmpathyMessage *message,
+	    gpointer        user_data)
+{
+	return TRUE;
+}
+
+static void
+free_messages (GList *messages)
+{
+	g_list_foreach (messages, (GFunc) g_object_unref, NULL);
+	g_list_free (messages);
+}
+
+static void
+free_dates (GList *dates)
+{
+	g_list_foreach (dates, (GFunc) g_free, NULL);
+	g_list_free (dates);
+}
+
+static void
+bench_search (EmpathyLogManager *manager,
+	      const gchar       *name,
+	      const gchar       *text)
+{
+	GTimer *timer;
+	GList  *hits;
+	gdouble elapsed;
+	gchar  *scenario;
+
+	timer = g_timer_new ();
+	hits = empathy_log_manager_search_new (manager, text);
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	scenario = g_strconcat ("search-", name, NULL);
+	report (scenario, 1, g_list_length (hits), elapsed);
+
+	g_free (scenario);
+	empathy_log_manager_search_free (hits);
+	g_timer_destroy (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+	BenchLogFixture       fixture;
+	BenchLogFixtureStats  stats;
+	EmpathyLogManager    *manager;
+	McAccount            *account;
+	EmpathyContact       *senders[N_SENDERS];
+	GList                *accounts, *l;
+	const gchar          *names[N_ACCOUNTS + 1];
+	GTimer               *timer;
+	GRand                *rand;
+	GError               *error = NULL;
+	gchar                 basedir[] = "/tmp/empathy-bench-log-XXXXXX";
+	gchar                *chat_id;
+	guint                 n_chats;
+	guint                 n_dates = 0;
+	guint                 n_messages = 0;
+	guint                 i;
+
+	g_thread_init (NULL);
+	g_type_init ();
+
+	bench_log_fixture_init (&fixture);
+	if (argc > 1) {
+		gint n_days = atoi (argv[1]);
+
+		if (n_days < 1) {
+			g_printerr ("Usage: %s [n_days]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+		fixture.n_days = n_days;
+	}
+
+	accounts = get_accounts (N_ACCOUNTS);
+	for (l = accounts, i = 0; i < N_ACCOUNTS; l = l->next, i++) {
+		names[i] = mc_account_get_unique_name (l->data);
+	}
+	names[N_ACCOUNTS] = NULL;
+	account = accounts->data;
+
+	if (mkdtemp (basedir) == NULL) {
+		g_error ("Can't create a temporary directory");
+	}
+	g_setenv ("EMPATHY_LOG_DIR", basedir, TRUE);
+
+	timer = g_timer_new ();
+	if (!bench_log_fixture_generate (&fixture, basedir, names, &stats,
+					 &error)) {
+		g_error ("%s", error->message);
+	}
+	g_print ("scenario=fixture accounts=%u days=%u files=%u messages=%u"
+		 " bytes=%" G_GUINT64_FORMAT "\n", N_ACCOUNTS, fixture.n_days,
+		 stats.n_files, stats.n_messages, stats.n_bytes);
+	report ("generate", stats.n_files, stats.n_messages,
+		g_timer_elapsed (timer, NULL));
+
+	manager = empathy_log_manager_dup_singleton ();
+	rand = g_rand_new_with_seed (fixture.seed);
+	n_chats = fixture.n_contacts + fixture.n_rooms;
+
+	/* Incoming messages of a busy room, each one appended to the log */
+	for (i = 0; i < N_SENDERS; i++) {
+		gchar *id;
+		gchar *name;
+
+		id = g_strdup_printf ("bench-room@example.com/member%u", i);
+		name = g_strdup_printf ("Membre n°%u", i);
+		senders[i] = empathy_contact_new_for_log (account, id, name,
+							  i == 0);
+		g_free (id);
+		g_free (name);
+	}
+
+	g_timer_start (timer);
+	for (i = 0; i < N_ADD; i++) {
+		EmpathyMessage *message;
+
+		message = empathy_message_new ("Ça va? Как дела? 你好 <3 R&D");
+		empathy_message_set_sender (message, senders[i % N_SENDERS]);
+		if (!empathy_log_manager_add_message (manager,
+						      "bench-room@example.com",
+						      TRUE, message, &error)) {
+			g_error ("%s", error->message);
+		}
+		g_object_unref (message);
+	}
+	report ("add-message", N_ADD, N_ADD, g_timer_elapsed (timer, NULL));
+
+	/* What the log viewer does when a chat is selected */
+	g_timer_start (timer);
+	for (i = 0; i < n_chats; i++) {
+		GList *dates;
+
+		chat_id = bench_log_fixture_chat_id (
+			i < fixture.n_contacts ? i : i - fixture.n_contacts,
+			i >= fixture.n_contacts);
+		dates = empathy_log_manager_get_dates (manager, account,
+			chat_id, i >= fixture.n_contacts);
+		n_dates += g_list_length (dates);
+		free_dates (dates);
+		g_free (chat_id);
+	}
+	report ("get-dates", n_chats, n_dates, g_timer_elapsed (timer, NULL));
+
+	/* ... and then a day */
+	chat_id = bench_log_fixture_chat_id (0, FALSE);
+	{
+		GList  *dates;
+		GList  *messages;
+		gdouble elapsed = 0;
+		guint   n_dates_chat;
+		guint   n_read = 0;
+
+		dates = empathy_log_manager_get_dates (manager, account,
+						       chat_id, FALSE);
+		n_dates_chat = g_list_length (dates);
+		for (i = 0; n_dates_chat > 0 && i < N_DAYS_OPENED; i++) {
+			const gchar *date;
+
+			date = g_list_nth_data (dates,
+				g_rand_int_range (rand, 0, n_dates_chat));
+			g_timer_start (timer);
+			messages = empathy_log_manager_get_messages_for_date (
+				manager, account, chat_id, FALSE, date);
+			elapsed += g_timer_elapsed (timer, NULL);
+			n_read += g_list_length (messages);
+			free_messages (messages);
+		}
+		report ("get-messages-for-date", i, n_read, elapsed);
+		free_dates (dates);
+	}
+
+	/* The backlog EmpathyChat shows when a conversation starts */
+	g_timer_start (timer);
+	for (i = 0; i < n_chats; i++) {
+		GList *messages;
+		gchar *id;
+
+		id = bench_log_fixture_chat_id (
+			i < fixture.n_contacts ? i : i - fixture.n_contacts,
+			i >= fixture.n_contacts);
+		messages = empathy_log_manager_get_filtered_messages (manager,
+			account, id, i >= fixture.n_contacts, 5,
+			accept_all, NULL);
+		n_messages += g_list_length (messages);
+		free_messages (messages);
+		g_free (id);
+	}
+	report ("get-filtered-messages", n_chats, n_messages,
+		g_timer_elapsed (timer, NULL));
+	g_free (chat_id);
+
+	bench_search (manager, "common", "meeting");
+	bench_search (manager, "rare", BENCH_LOG_FIXTURE_RARE_WORD);
+	bench_search (manager, "non-ascii", "привет");
+
+	for (i = 0; i < N_SENDERS; i++) {
+		g_object_unref (senders[i]);
+	}
+	g_rand_free (rand);
+	g_timer_destroy (timer);
+	g_object_unref (manager);
+	g_list_foreach (accounts, (GFunc) g_object_unref, NULL);
+	g_list_free (accounts);
+	remove_dir (basedir);
+
+	return EXIT_SUCCESS;
+}
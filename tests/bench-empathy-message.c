@@ -0,0 +1,244 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Memory and time needed to hold a log replay worth of messages:
+ *  - gobject: an EmpathyMessage and an EmpathyContact per message, which is
+ *    what the log store used to create;
+ *  - record: an EmpathyMessageRecord per message;
+ *  - wrap: records wrapped in EmpathyMessage sharing one contact per
+ *    sender, which is what the log store now returns.
+ * Each mode runs in its own process so resident sizes don't mix.
+ * Usage: bench-empathy-message [gobject|record|wrap] [n_messages] */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include <libempathy/empathy-contact.h>
+#include <libempathy/empathy-message.h>
+#include <libempathy/empathy-message-record.h>
+
+#define N_MESSAGES 100000
+#define N_SENDERS 50
+
+static const gchar *words[] = {
+	"hello", "the", "build", "is", "broken", "again", "lol", "ok",
+	"patch", "review", "\xc3\xa9t\xc3\xa9", "yes", "no", "maybe", "ping"
+};
+
+/* Resident set size in kB, Linux only */
+static glong
+get_rss (void)
+{
+	FILE  *f;
+	glong  size, resident = 0;
+
+	f = fopen ("/proc/self/statm", "r");
+	if (f == NULL) {
+		return 0;
+	}
+
+	if (fscanf (f, "%ld %ld", &size, &resident) != 2) {
+		resident = 0;
+	}
+	fclose (f);
+
+	return resident * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+static gchar *
+make_body (GRand *rand)
+{
+	GString *body;
+	gint     i, len;
+
+	body = g_string_new (NULL);
+	len = g_rand_int_range (rand, 1, 15);
+	for (i = 0; i < len; i++) {
+		if (i > 0) {
+			g_string_append_c (body, ' ');
+		}
+		g_string_append (body, words[g_rand_int_range (rand, 0,
+			G_N_ELEMENTS (words))]);
+	}
+
+	return g_string_free (body, FALSE);
+}
+
+static void
+run_mode (const gchar *mode,
+	  guint        n_messages)
+{
+	GPtrArray      *items;
+	GRand          *rand;
+	GTimer         *timer;
+	EmpathyContact *senders[N_SENDERS];
+	gchar          *sender_ids[N_SENDERS];
+	glong           rss_before;
+	gsize           record_bytes = 0;
+	guint           i;
+
+	rand = g_rand_new_with_seed (42);
+	items = g_ptr_array_sized_new (n_messages);
+
+	for (i = 0; i < N_SENDERS; i++) {
+		sender_ids[i] = g_strdup_printf ("user%u@example.com", i);
+		senders[i] = NULL;
+	}
+
+	/* Make sure types are registered before measuring anything */
+	g_type_class_unref (g_type_class_ref (EMPATHY_TYPE_MESSAGE));
+	g_type_class_unref (g_type_class_ref (EMPATHY_TYPE_CONTACT));
+
+	rss_before = get_rss ();
+	timer = g_timer_new ();
+
+	for (i = 0; i < n_messages; i++) {
+		const gchar *sender_id;
+		gchar       *body;
+		time_t       timestamp = 1230768000 + i;
+		guint        s;
+
+		s = g_rand_int_range (rand, 0, N_SENDERS);
+		sender_id = sender_ids[s];
+		body = make_body (rand);
+
+		if (!strcmp (mode, "gobject")) {
+			EmpathyMessage *message;
+			EmpathyContact *contact;
+
+			contact = g_object_new (EMPATHY_TYPE_CONTACT,
+						"id", sender_id,
+						"name", sender_id,
+						NULL);
+			message = empathy_message_new (body);
+			empathy_message_set_sender (message, contact);
+			empathy_message_set_timestamp (message, timestamp);
+			empathy_message_set_tptype (message,
+				TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL);
+			g_object_unref (contact);
+			g_ptr_array_add (items, message);
+		} else {
+			EmpathyMessageRecord *record;
+
+			record = empathy_message_record_new (
+				TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL,
+				timestamp, body);
+			empathy_message_record_set_sender (record, sender_id,
+							   sender_id, NULL);
+			record_bytes += empathy_message_record_get_size (record);
+
+			if (!strcmp (mode, "wrap")) {
+				EmpathyMessage *message;
+
+				if (senders[s] == NULL) {
+					senders[s] = g_object_new (EMPATHY_TYPE_CONTACT,
+						"id", sender_id,
+						"name", sender_id,
+						NULL);
+				}
+				message = empathy_message_new_from_record (record);
+				empathy_message_set_sender (message, senders[s]);
+				empathy_message_record_unref (record);
+				g_ptr_array_add (items, message);
+			} else {
+				g_ptr_array_add (items, record);
+			}
+		}
+
+		g_free (body);
+	}
+
+	g_print ("scenario=%s-create messages=%u seconds=%.3f rss_kb=%ld"
+		 " record_kb=%lu\n",
+		 mode, n_messages, g_timer_elapsed (timer, NULL),
+		 get_rss () - rss_before, (gulong) (record_bytes / 1024));
+
+	g_timer_start (timer);
+	if (!strcmp (mode, "record")) {
+		g_ptr_array_foreach (items,
+			(GFunc) empathy_message_record_unref, NULL);
+	} else {
+		g_ptr_array_foreach (items, (GFunc) g_object_unref, NULL);
+	}
+	g_print ("scenario=%s-free messages=%u seconds=%.3f\n",
+		 mode, n_messages, g_timer_elapsed (timer, NULL));
+
+	for (i = 0; i < N_SENDERS; i++) {
+		if (senders[i] != NULL) {
+			g_object_unref (senders[i]);
+		}
+		g_free (sender_ids[i]);
+	}
+	g_timer_destroy (timer);
+	g_ptr_array_free (items, TRUE);
+	g_rand_free (rand);
+}
+
+int
+main (int argc, char **argv)
+{
+	static const gchar *modes[] = { "gobject", "record", "wrap" };
+	guint               n_messages = N_MESSAGES;
+	guint               i;
+
+	g_type_init ();
+
+	if (argc > 2) {
+		n_messages = atoi (argv[2]);
+	}
+
+	if (argc > 1) {
+		run_mode (argv[1], n_messages);
+		return EXIT_SUCCESS;
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (modes); i++) {
+		gchar   *child_argv[4];
+		gchar   *n_str;
+		gchar   *output = NULL;
+		GError  *error = NULL;
+
+		n_str = g_strdup_printf ("%u", n_messages);
+		child_argv[0] = argv[0];
+		child_argv[1] = (gchar *) modes[i];
+		child_argv[2] = n_str;
+		child_argv[3] = NULL;
+
+		if (g_spawn_sync (NULL, child_argv, NULL, 0, NULL, NULL,
+				  &output, NULL, NULL, &error)) {
+			g_print ("%s", output);
+		} else {
+			g_printerr ("Failed to run %s: %s\n", modes[i],
+				    error->message);
+			g_clear_error (&error);
+		}
+
+		g_free (output);
+		g_free (n_str);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,209 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Compares nick completion in a room of synthetic members using the
+ * EmpathyNickIndex against the GCompletion EmpathyChat used to build on
+ * every Tab press. Usage: bench-empathy-nick-index [n_members] */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include <libempathy/empathy-contact.h>
+#include <libempathy-gtk/empathy-nick-index.h>
+
+#define N_MEMBERS 10000
+#define N_LOOKUPS 1000
+#define N_CHURN 1000
+
+static const gchar *syllables[] = {
+	"ka", "lo", "mi", "Ze", "ra", "ti", "Nu", "so", "be", "\xc3\xa9l", "gr", "x"
+};
+
+static gint
+completion_compare (const gchar *s1,
+		    const gchar *s2,
+		    gsize        n)
+{
+	gchar *tmp, *nick1, *nick2;
+	gint   ret;
+
+	tmp = g_utf8_normalize (s1, -1, G_NORMALIZE_DEFAULT);
+	nick1 = g_utf8_casefold (tmp, -1);
+	g_free (tmp);
+
+	tmp = g_utf8_normalize (s2, -1, G_NORMALIZE_DEFAULT);
+	nick2 = g_utf8_casefold (tmp, -1);
+	g_free (tmp);
+
+	ret = strncmp (nick1, nick2, n);
+
+	g_free (nick1);
+	g_free (nick2);
+
+	return ret;
+}
+
+static gchar *
+make_nick (GRand *rand)
+{
+	GString *nick;
+	gint     i, len;
+
+	nick = g_string_new (NULL);
+	len = g_rand_int_range (rand, 2, 6);
+	for (i = 0; i < len; i++) {
+		g_string_append (nick, syllables[g_rand_int_range (rand, 0,
+			G_N_ELEMENTS (syllables))]);
+	}
+	g_string_append_printf (nick, "%d", g_rand_int_range (rand, 0, 100));
+
+	return g_string_free (nick, FALSE);
+}
+
+/* One line per scenario, in the format of bench-empathy-load */
+static void
+report (const gchar *name,
+	guint        n_members,
+	guint        ops,
+	guint        results,
+	gdouble      elapsed)
+{
+	g_print ("scenario=%s members=%u ops=%u results=%u seconds=%.3f"
+		 " us_per_op=%.2f\n",
+		 name, n_members, ops, results, elapsed,
+		 ops > 0 ? elapsed * 1e6 / ops : 0);
+}
+
+int
+main (int argc, char **argv)
+{
+	GPtrArray        *members;
+	GList            *list = NULL;
+	EmpathyNickIndex *nick_index;
+	GCompletion      *completion;
+	GRand            *rand;
+	GTimer           *timer;
+	gchar           **prefixes;
+	guint             n_members = N_MEMBERS;
+	guint             i, matches;
+
+	g_type_init ();
+
+	if (argc > 1) {
+		n_members = atoi (argv[1]);
+	}
+
+	rand = g_rand_new_with_seed (42);
+	members = g_ptr_array_new ();
+	for (i = 0; i < n_members; i++) {
+		EmpathyContact *contact;
+		gchar          *nick;
+
+		nick = make_nick (rand);
+		contact = g_object_new (EMPATHY_TYPE_CONTACT,
+					"id", nick,
+					"name", nick,
+					NULL);
+		g_ptr_array_add (members, contact);
+		list = g_list_prepend (list, contact);
+		g_free (nick);
+	}
+
+	/* Typical Tab presses: the first one or two characters of a nick */
+	prefixes = g_new0 (gchar *, N_LOOKUPS + 1);
+	for (i = 0; i < N_LOOKUPS; i++) {
+		EmpathyContact *contact;
+		const gchar    *name;
+
+		contact = g_ptr_array_index (members,
+			g_rand_int_range (rand, 0, n_members));
+		name = empathy_contact_get_name (contact);
+		prefixes[i] = g_strndup (name, g_utf8_offset_to_pointer (name,
+			g_rand_int_range (rand, 1, 4)) - name);
+	}
+
+	/* What EmpathyChat did: fill a GCompletion on each Tab press */
+	completion = g_completion_new ((GCompletionFunc) empathy_contact_get_name);
+	g_completion_set_compare (completion, completion_compare);
+	timer = g_timer_new ();
+	matches = 0;
+	for (i = 0; i < N_LOOKUPS / 10; i++) {
+		gchar *completed = NULL;
+
+		g_completion_add_items (completion, list);
+		matches += g_list_length (g_completion_complete (completion,
+			prefixes[i], &completed));
+		g_completion_clear_items (completion);
+		g_free (completed);
+	}
+	report ("gcompletion-tab", n_members, N_LOOKUPS / 10, matches,
+		g_timer_elapsed (timer, NULL));
+	g_completion_free (completion);
+
+	nick_index = empathy_nick_index_new ();
+	g_timer_start (timer);
+	for (i = 0; i < n_members; i++) {
+		empathy_nick_index_add (nick_index,
+					g_ptr_array_index (members, i));
+	}
+	report ("index-join", n_members, n_members, 0,
+		g_timer_elapsed (timer, NULL));
+
+	g_timer_start (timer);
+	matches = 0;
+	for (i = 0; i < N_LOOKUPS; i++) {
+		GList *completed_list;
+		gchar *completed = NULL;
+
+		completed_list = empathy_nick_index_complete (nick_index,
+			prefixes[i], &completed);
+		matches += g_list_length (completed_list);
+		g_list_free (completed_list);
+		g_free (completed);
+	}
+	report ("index-tab", n_members, N_LOOKUPS, matches,
+		g_timer_elapsed (timer, NULL));
+
+	/* Members leaving and coming back, like during a netsplit */
+	g_timer_start (timer);
+	for (i = 0; i < N_CHURN; i++) {
+		EmpathyContact *contact;
+
+		contact = g_ptr_array_index (members, i % n_members);
+		empathy_nick_index_remove (nick_index, contact);
+		empathy_nick_index_add (nick_index, contact);
+	}
+	report ("index-part-join", n_members, N_CHURN, 0,
+		g_timer_elapsed (timer, NULL));
+
+	g_timer_destroy (timer);
+	empathy_nick_index_free (nick_index);
+	g_strfreev (prefixes);
+	g_list_free (list);
+	g_ptr_array_foreach (members, (GFunc) g_object_unref, NULL);
+	g_ptr_array_free (members, TRUE);
+	g_rand_free (rand);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,153 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Simulates somebody typing a few messages in a chat input: after every
+ * keystroke all the words of the buffer are checked again, like
+ * EmpathyChat does. Usage: bench-empathy-spell [languages], where
+ * languages is a comma separated list like "en,fr,de". */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include <libempathy-gtk/empathy-conf.h>
+#include <libempathy-gtk/empathy-spell.h>
+
+static const gchar *sentences[] = {
+	"the quick brown fox jumps over the lazy dog",
+	"are you coming to the meeting tomorrow at ten",
+	"I think tthe build is brokn again on my machine",
+	"Empathy is an instant messaging client for GNOME",
+	"let me know when you have pushed the branch",
+	NULL
+};
+
+static guint
+type_sentence (const gchar *sentence,
+	       gboolean     batched)
+{
+	guint len, i, checks = 0;
+
+	len = strlen (sentence);
+
+	/* One check pass per keystroke, over the whole typed text. Runs of
+	 * spaces give empty tokens which are no words, both modes skip them
+	 * so they check the same words. */
+	for (i = 1; i <= len; i++) {
+		gchar     *typed;
+		gchar    **tokens;
+		GPtrArray *words;
+		guint      j;
+
+		typed = g_strndup (sentence, i);
+		tokens = g_strsplit (typed, " ", -1);
+		words = g_ptr_array_new ();
+		for (j = 0; tokens[j] != NULL; j++) {
+			if (tokens[j][0] != '\0') {
+				g_ptr_array_add (words, tokens[j]);
+			}
+		}
+		g_ptr_array_add (words, NULL);
+
+		if (batched) {
+			gboolean *correct;
+
+			correct = g_new (gboolean, words->len);
+			empathy_spell_check_words ((const gchar * const *) words->pdata,
+						   correct);
+			g_free (correct);
+		} else {
+			for (j = 0; j < words->len - 1; j++) {
+				empathy_spell_check (g_ptr_array_index (words, j));
+			}
+		}
+
+		checks += words->len - 1;
+		g_ptr_array_free (words, TRUE);
+		g_strfreev (tokens);
+		g_free (typed);
+	}
+
+	return checks;
+}
+
+static void
+run (const gchar *name,
+     gboolean     batched)
+{
+	GTimer  *timer;
+	gdouble  elapsed;
+	guint    checks = 0;
+	guint    i;
+
+	timer = g_timer_new ();
+	for (i = 0; sentences[i] != NULL; i++) {
+		checks += type_sentence (sentences[i], batched);
+	}
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	g_print ("%-20s %8u words %10.3f ms %12.0f words/s\n",
+		 name, checks, elapsed * 1000, checks / elapsed);
+}
+
+int
+main (int argc, char **argv)
+{
+	EmpathyConf *conf;
+	gchar       *old_languages = NULL;
+
+	g_type_init ();
+
+	if (!empathy_spell_supported ()) {
+		g_printerr ("Spell checking is not supported\n");
+		return EXIT_FAILURE;
+	}
+
+	conf = empathy_conf_get ();
+	if (argc > 1) {
+		empathy_conf_get_string (conf,
+					 EMPATHY_PREFS_CHAT_SPELL_CHECKER_LANGUAGES,
+					 &old_languages);
+		empathy_conf_set_string (conf,
+					 EMPATHY_PREFS_CHAT_SPELL_CHECKER_LANGUAGES,
+					 argv[1]);
+	}
+
+	/* The first pass fills the cache, the next ones show the
+	 * steady state while typing. */
+	run ("cold", FALSE);
+	run ("warm", FALSE);
+	run ("warm-batched", TRUE);
+
+	if (argc > 1) {
+		empathy_conf_set_string (conf,
+					 EMPATHY_PREFS_CHAT_SPELL_CHECKER_LANGUAGES,
+					 old_languages ? old_languages : "");
+		g_free (old_languages);
+	}
+
+	empathy_conf_shutdown ();
+
+	return EXIT_SUCCESS;
+}
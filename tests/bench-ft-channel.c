@@ -0,0 +1,824 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <glib/gstdio.h>
+#include <dbus/dbus-glib.h>
+
+#include <telepathy-glib/channel-iface.h>
+#include <telepathy-glib/dbus.h>
+#include <telepathy-glib/errors.h>
+#include <telepathy-glib/exportable-channel.h>
+#include <telepathy-glib/gtypes.h>
+#include <telepathy-glib/interfaces.h>
+#include <telepathy-glib/svc-channel.h>
+#include <telepathy-glib/svc-generic.h>
+#include <telepathy-glib/util.h>
+
+#include "bench-ft-channel.h"
+
+/* Bytes written to the socket each time it can take more */
+#define SEND_CHUNK (64 * 1024)
+
+#define GET_PRIV(obj) ((BenchFtChannelPriv *) BENCH_FT_CHANNEL (obj)->priv)
+
+typedef struct {
+	gchar *socket_dir;
+	gchar *socket_path;
+	gint   listen_fd;
+	gint   client_fd;
+	guint  listen_id;
+	guint  send_id;
+} BenchFtChannelPriv;
+
+static void channel_iface_init       (gpointer g_iface, gpointer iface_data);
+static void file_transfer_iface_init (gpointer g_iface, gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (BenchFtChannel, bench_ft_channel, G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_SVC_CHANNEL,
+						channel_iface_init);
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_SVC_CHANNEL_TYPE_FILE_TRANSFER,
+						file_transfer_iface_init);
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_SVC_DBUS_PROPERTIES,
+						tp_dbus_properties_mixin_iface_init);
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_CHANNEL_IFACE, NULL);
+			 G_IMPLEMENT_INTERFACE (TP_TYPE_EXPORTABLE_CHANNEL, NULL));
+
+enum {
+	PROP_0,
+	PROP_CONNECTION,
+	PROP_OBJECT_PATH,
+	PROP_CHANNEL_TYPE,
+	PROP_HANDLE_TYPE,
+	PROP_HANDLE,
+	PROP_TARGET_ID,
+	PROP_INITIATOR_HANDLE,
+	PROP_INITIATOR_ID,
+	PROP_REQUESTED,
+	PROP_INTERFACES,
+	PROP_CHANNEL_DESTROYED,
+	PROP_CHANNEL_PROPERTIES,
+	PROP_STATE,
+	PROP_CONTENT_TYPE,
+	PROP_FILENAME,
+	PROP_SIZE,
+	PROP_CONTENT_HASH_TYPE,
+	PROP_CONTENT_HASH,
+	PROP_DESCRIPTION,
+	PROP_DATE,
+	PROP_TRANSFERRED_BYTES,
+	PROP_INITIAL_OFFSET,
+};
+
+static const gchar *no_interfaces[] = {
+	NULL
+};
+
+static void
+bench_ft_channel_set_state (BenchFtChannel                  *channel,
+			    TpFileTransferState              state,
+			    TpFileTransferStateChangeReason  reason)
+{
+	channel->state = state;
+	tp_svc_channel_type_file_transfer_emit_file_transfer_state_changed (
+		channel, state, reason);
+}
+
+static void
+bench_ft_channel_stop_sending (BenchFtChannel *channel)
+{
+	BenchFtChannelPriv *priv = GET_PRIV (channel);
+
+	if (priv->listen_id != 0) {
+		g_source_remove (priv->listen_id);
+		priv->listen_id = 0;
+	}
+	if (priv->send_id != 0) {
+		g_source_remove (priv->send_id);
+		priv->send_id = 0;
+	}
+	if (priv->listen_fd >= 0) {
+		close (priv->listen_fd);
+		priv->listen_fd = -1;
+	}
+	if (priv->client_fd >= 0) {
+		close (priv->client_fd);
+		priv->client_fd = -1;
+	}
+}
+
+static gboolean
+bench_ft_channel_send_cb (GIOChannel   *source,
+			  GIOCondition  condition,
+			  gpointer      user_data)
+{
+	BenchFtChannel     *channel = user_data;
+	BenchFtChannelPriv *priv = GET_PRIV (channel);
+	gssize              n;
+
+	if (condition & (G_IO_ERR | G_IO_HUP)) {
+		priv->send_id = 0;
+		bench_ft_channel_stop_sending (channel);
+		bench_ft_channel_set_state (channel,
+			TP_FILE_TRANSFER_STATE_CANCELLED,
+			TP_FILE_TRANSFER_STATE_CHANGE_REASON_LOCAL_ERROR);
+		return FALSE;
+	}
+
+	n = send (priv->client_fd, channel->data + channel->transferred,
+		  MIN (SEND_CHUNK, channel->size - channel->transferred),
+		  MSG_NOSIGNAL);
+	if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+		return TRUE;
+	}
+	if (n < 0) {
+		priv->send_id = 0;
+		bench_ft_channel_stop_sending (channel);
+		bench_ft_channel_set_state (channel,
+			TP_FILE_TRANSFER_STATE_CANCELLED,
+			TP_FILE_TRANSFER_STATE_CHANGE_REASON_LOCAL_ERROR);
+		return FALSE;
+	}
+
+	channel->transferred += n;
+	if (channel->transferred < channel->size) {
+		return TRUE;
+	}
+
+	/* Closing the socket tells the client it has all the data */
+	priv->send_id = 0;
+	bench_ft_channel_stop_sending (channel);
+	tp_svc_channel_type_file_transfer_emit_transferred_bytes_changed (
+		channel, channel->transferred);
+	bench_ft_channel_set_state (channel,
+				    TP_FILE_TRANSFER_STATE_COMPLETED,
+				    TP_FILE_TRANSFER_STATE_CHANGE_REASON_NONE);
+
+	return FALSE;
+}
+
+/* Only the first client gets the data */
+static gboolean
+bench_ft_channel_accept_cb (GIOChannel   *source,
+			    GIOCondition  condition,
+			    gpointer      user_data)
+{
+	BenchFtChannel     *channel = user_data;
+	BenchFtChannelPriv *priv = GET_PRIV (channel);
+	GIOChannel         *io;
+	gint                fd;
+
+	fd = accept (priv->listen_fd, NULL, NULL);
+	if (fd < 0) {
+		return TRUE;
+	}
+
+	priv->listen_id = 0;
+	close (priv->listen_fd);
+	priv->listen_fd = -1;
+
+	fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+	priv->client_fd = fd;
+
+	io = g_io_channel_unix_new (fd);
+	priv->send_id = g_io_add_watch (io, G_IO_OUT | G_IO_ERR | G_IO_HUP,
+					bench_ft_channel_send_cb, channel);
+	g_io_channel_unref (io);
+
+	return FALSE;
+}
+
+static gboolean
+bench_ft_channel_listen (BenchFtChannel  *channel,
+			 GError         **error)
+{
+	BenchFtChannelPriv *priv = GET_PRIV (channel);
+	struct sockaddr_un  addr;
+	GIOChannel         *io;
+	gint                fd;
+
+	priv->socket_dir = g_build_filename (g_get_tmp_dir (),
+					     "bench-ft-XXXXXX", NULL);
+	if (mkdtemp (priv->socket_dir) == NULL) {
+		g_set_error (error, TP_ERRORS, TP_ERROR_NOT_AVAILABLE,
+			     "Can't create the socket directory: %s",
+			     g_strerror (errno));
+		g_free (priv->socket_dir);
+		priv->socket_dir = NULL;
+		return FALSE;
+	}
+	priv->socket_path = g_build_filename (priv->socket_dir, "socket",
+					      NULL);
+
+	fd = socket (PF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		g_set_error (error, TP_ERRORS, TP_ERROR_NOT_AVAILABLE,
+			     "Can't create the socket: %s", g_strerror (errno));
+		return FALSE;
+	}
+
+	memset (&addr, 0, sizeof (addr));
+	addr.sun_family = AF_UNIX;
+	strncpy (addr.sun_path, priv->socket_path, sizeof (addr.sun_path) - 1);
+
+	if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0 ||
+	    listen (fd, 1) < 0) {
+		g_set_error (error, TP_ERRORS, TP_ERROR_NOT_AVAILABLE,
+			     "Can't listen on %s: %s", priv->socket_path,
+			     g_strerror (errno));
+		close (fd);
+		return FALSE;
+	}
+
+	priv->listen_fd = fd;
+	io = g_io_channel_unix_new (fd);
+	priv->listen_id = g_io_add_watch (io, G_IO_IN,
+					  bench_ft_channel_accept_cb, channel);
+	g_io_channel_unref (io);
+
+	return TRUE;
+}
+
+static void
+bench_ft_channel_constructed (GObject *object)
+{
+	BenchFtChannel    *channel = BENCH_FT_CHANNEL (object);
+	TpHandleRepoIface *contact_repo;
+
+	contact_repo = tp_base_connection_get_handles (channel->conn,
+						       TP_HANDLE_TYPE_CONTACT);
+	tp_handle_ref (contact_repo, channel->handle);
+
+	dbus_g_connection_register_g_object (tp_get_bus (),
+					     channel->object_path,
+					     object);
+}
+
+static void
+bench_ft_channel_get_property (GObject    *object,
+			       guint       param_id,
+			       GValue     *value,
+			       GParamSpec *pspec)
+{
+	BenchFtChannel    *channel = BENCH_FT_CHANNEL (object);
+	TpHandleRepoIface *contact_repo;
+
+	switch (param_id) {
+	case PROP_CONNECTION:
+		g_value_set_object (value, channel->conn);
+		break;
+	case PROP_OBJECT_PATH:
+		g_value_set_string (value, channel->object_path);
+		break;
+	case PROP_CHANNEL_TYPE:
+		g_value_set_static_string (value,
+					   TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER);
+		break;
+	case PROP_HANDLE_TYPE:
+		g_value_set_uint (value, TP_HANDLE_TYPE_CONTACT);
+		break;
+	case PROP_HANDLE:
+	case PROP_INITIATOR_HANDLE:
+		g_value_set_uint (value, channel->handle);
+		break;
+	case PROP_TARGET_ID:
+	case PROP_INITIATOR_ID:
+		contact_repo = tp_base_connection_get_handles (channel->conn,
+			TP_HANDLE_TYPE_CONTACT);
+		g_value_set_string (value, tp_handle_inspect (contact_repo,
+							      channel->handle));
+		break;
+	case PROP_REQUESTED:
+		g_value_set_boolean (value, FALSE);
+		break;
+	case PROP_INTERFACES:
+		g_value_set_boxed (value, no_interfaces);
+		break;
+	case PROP_CHANNEL_DESTROYED:
+		g_value_set_boolean (value, channel->closed);
+		break;
+	case PROP_CHANNEL_PROPERTIES:
+		g_value_take_boxed (value,
+			tp_dbus_properties_mixin_make_properties_hash (object,
+				TP_IFACE_CHANNEL, "ChannelType",
+				TP_IFACE_CHANNEL, "TargetHandleType",
+				TP_IFACE_CHANNEL, "TargetHandle",
+				TP_IFACE_CHANNEL, "TargetID",
+				TP_IFACE_CHANNEL, "InitiatorHandle",
+				TP_IFACE_CHANNEL, "InitiatorID",
+				TP_IFACE_CHANNEL, "Requested",
+				TP_IFACE_CHANNEL, "Interfaces",
+				TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER, "ContentType",
+				TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER, "Filename",
+				TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER, "Size",
+				TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER, "ContentHashType",
+				TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER, "ContentHash",
+				TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER, "Description",
+				TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER, "Date",
+				NULL));
+		break;
+	case PROP_STATE:
+		g_value_set_uint (value, channel->state);
+		break;
+	case PROP_CONTENT_TYPE:
+		g_value_set_static_string (value, "application/octet-stream");
+		break;
+	case PROP_FILENAME:
+		g_value_set_string (value, channel->filename);
+		break;
+	case PROP_SIZE:
+		g_value_set_uint64 (value, channel->size);
+		break;
+	case PROP_CONTENT_HASH_TYPE:
+		g_value_set_uint (value, channel->content_hash_type);
+		break;
+	case PROP_CONTENT_HASH:
+		g_value_set_string (value, channel->content_hash);
+		break;
+	case PROP_DESCRIPTION:
+		g_value_set_static_string (value, "");
+		break;
+	case PROP_DATE:
+		g_value_set_uint64 (value, 0);
+		break;
+	case PROP_TRANSFERRED_BYTES:
+		g_value_set_uint64 (value, channel->transferred);
+		break;
+	case PROP_INITIAL_OFFSET:
+		g_value_set_uint64 (value, channel->initial_offset);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
+		break;
+	};
+}
+
+static void
+bench_ft_channel_set_property (GObject      *object,
+			       guint         param_id,
+			       const GValue *value,
+			       GParamSpec   *pspec)
+{
+	BenchFtChannel *channel = BENCH_FT_CHANNEL (object);
+
+	switch (param_id) {
+	case PROP_CONNECTION:
+		channel->conn = g_value_get_object (value);
+		break;
+	case PROP_OBJECT_PATH:
+		g_free (channel->object_path);
+		channel->object_path = g_value_dup_string (value);
+		break;
+	case PROP_HANDLE:
+		channel->handle = g_value_get_uint (value);
+		break;
+	case PROP_CHANNEL_TYPE:
+	case PROP_HANDLE_TYPE:
+		/* Writable in TpChannelIface, but always the same here */
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
+		break;
+	};
+}
+
+static void
+bench_ft_channel_dispose (GObject *object)
+{
+	BenchFtChannel *channel = BENCH_FT_CHANNEL (object);
+
+	bench_ft_channel_stop_sending (channel);
+
+	if (!channel->closed) {
+		channel->closed = TRUE;
+		tp_svc_channel_emit_closed (channel);
+	}
+
+	G_OBJECT_CLASS (bench_ft_channel_parent_class)->dispose (object);
+}
+
+static void
+bench_ft_channel_finalize (GObject *object)
+{
+	BenchFtChannel     *channel = BENCH_FT_CHANNEL (object);
+	BenchFtChannelPriv *priv = GET_PRIV (object);
+	TpHandleRepoIface  *contact_repo;
+
+	contact_repo = tp_base_connection_get_handles (channel->conn,
+						       TP_HANDLE_TYPE_CONTACT);
+	tp_handle_unref (contact_repo, channel->handle);
+
+	if (priv->socket_path != NULL) {
+		g_unlink (priv->socket_path);
+	}
+	if (priv->socket_dir != NULL) {
+		g_rmdir (priv->socket_dir);
+	}
+	g_free (priv->socket_path);
+	g_free (priv->socket_dir);
+
+	g_free (channel->object_path);
+	g_free (channel->filename);
+	g_free (channel->data);
+	g_free (channel->content_hash);
+
+	G_OBJECT_CLASS (bench_ft_channel_parent_class)->finalize (object);
+}
+
+static void
+bench_ft_channel_install_uint64 (GObjectClass *object_class,
+				 guint         param_id,
+				 const gchar  *name,
+				 const gchar  *blurb)
+{
+	g_object_class_install_property (object_class,
+					 param_id,
+					 g_param_spec_uint64 (name, name, blurb,
+							      0, G_MAXUINT64, 0,
+							      G_PARAM_READABLE));
+}
+
+static void
+bench_ft_channel_class_init (BenchFtChannelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	static TpDBusPropertiesMixinPropImpl channel_props[] = {
+		{ "ChannelType", "channel-type", NULL },
+		{ "TargetHandleType", "handle-type", NULL },
+		{ "TargetHandle", "handle", NULL },
+		{ "TargetID", "target-id", NULL },
+		{ "InitiatorHandle", "initiator-handle", NULL },
+		{ "InitiatorID", "initiator-id", NULL },
+		{ "Requested", "requested", NULL },
+		{ "Interfaces", "interfaces", NULL },
+		{ NULL }
+	};
+	/* No AvailableSocketTypes, libempathy always asks for unix sockets */
+	static TpDBusPropertiesMixinPropImpl file_transfer_props[] = {
+		{ "State", "state", NULL },
+		{ "ContentType", "content-type", NULL },
+		{ "Filename", "filename", NULL },
+		{ "Size", "size", NULL },
+		{ "ContentHashType", "content-hash-type", NULL },
+		{ "ContentHash", "content-hash", NULL },
+		{ "Description", "description", NULL },
+		{ "Date", "date", NULL },
+		{ "TransferredBytes", "transferred-bytes", NULL },
+		{ "InitialOffset", "initial-offset", NULL },
+		{ NULL }
+	};
+	static TpDBusPropertiesMixinIfaceImpl prop_interfaces[] = {
+		{ TP_IFACE_CHANNEL,
+		  tp_dbus_properties_mixin_getter_gobject_properties,
+		  NULL,
+		  channel_props,
+		},
+		{ TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER,
+		  tp_dbus_properties_mixin_getter_gobject_properties,
+		  NULL,
+		  file_transfer_props,
+		},
+		{ NULL }
+	};
+
+	object_class->constructed = bench_ft_channel_constructed;
+	object_class->get_property = bench_ft_channel_get_property;
+	object_class->set_property = bench_ft_channel_set_property;
+	object_class->dispose = bench_ft_channel_dispose;
+	object_class->finalize = bench_ft_channel_finalize;
+
+	g_object_class_override_property (object_class, PROP_OBJECT_PATH,
+					  "object-path");
+	g_object_class_override_property (object_class, PROP_CHANNEL_TYPE,
+					  "channel-type");
+	g_object_class_override_property (object_class, PROP_HANDLE_TYPE,
+					  "handle-type");
+	g_object_class_override_property (object_class, PROP_HANDLE,
+					  "handle");
+	g_object_class_override_property (object_class, PROP_CHANNEL_DESTROYED,
+					  "channel-destroyed");
+	g_object_class_override_property (object_class, PROP_CHANNEL_PROPERTIES,
+					  "channel-properties");
+
+	g_object_class_install_property (object_class,
+					 PROP_CONNECTION,
+					 g_param_spec_object ("connection",
+							      "Connection",
+							      "The connection owning the channel",
+							      TP_TYPE_BASE_CONNECTION,
+							      G_PARAM_READWRITE |
+							      G_PARAM_CONSTRUCT_ONLY));
+	g_object_class_install_property (object_class,
+					 PROP_TARGET_ID,
+					 g_param_spec_string ("target-id",
+							      "Target ID",
+							      "The identifier of the sender",
+							      NULL,
+							      G_PARAM_READABLE));
+	g_object_class_install_property (object_class,
+					 PROP_INITIATOR_HANDLE,
+					 g_param_spec_uint ("initiator-handle",
+							    "Initiator handle",
+							    "The sender, who initiated the channel",
+							    0, G_MAXUINT32, 0,
+							    G_PARAM_READABLE));
+	g_object_class_install_property (object_class,
+					 PROP_INITIATOR_ID,
+					 g_param_spec_string ("initiator-id",
+							      "Initiator ID",
+							      "The identifier of the sender",
+							      NULL,
+							      G_PARAM_READABLE));
+	g_object_class_install_property (object_class,
+					 PROP_REQUESTED,
+					 g_param_spec_boolean ("requested",
+							       "Requested",
+							       "Always FALSE, transfers are incoming",
+							       FALSE,
+							       G_PARAM_READABLE));
+	g_object_class_install_property (object_class,
+					 PROP_INTERFACES,
+					 g_param_spec_boxed ("interfaces",
+							     "Interfaces",
+							     "Extra interfaces of the channel",
+							     G_TYPE_STRV,
+							     G_PARAM_READABLE));
+	g_object_class_install_property (object_class,
+					 PROP_STATE,
+					 g_param_spec_uint ("state",
+							    "State",
+							    "The TpFileTransferState",
+							    0, G_MAXUINT, 0,
+							    G_PARAM_READABLE));
+	g_object_class_install_property (object_class,
+					 PROP_CONTENT_TYPE,
+					 g_param_spec_string ("content-type",
+							      "Content type",
+							      "The MIME type of the file",
+							      NULL,
+							      G_PARAM_READABLE));
+	g_object_class_install_property (object_class,
+					 PROP_FILENAME,
+					 g_param_spec_string ("filename",
+							      "Filename",
+							      "The name of the file",
+							      NULL,
+							      G_PARAM_READABLE));
+	g_object_class_install_property (object_class,
+					 PROP_CONTENT_HASH_TYPE,
+					 g_param_spec_uint ("content-hash-type",
+							    "Content hash type",
+							    "The TpFileHashType of content-hash",
+							    0, G_MAXUINT, 0,
+							    G_PARAM_READABLE));
+	g_object_class_install_property (object_class,
+					 PROP_CONTENT_HASH,
+					 g_param_spec_string ("content-hash",
+							      "Content hash",
+							      "The hash of the file",
+							      NULL,
+							      G_PARAM_READABLE));
+	g_object_class_install_property (object_class,
+					 PROP_DESCRIPTION,
+					 g_param_spec_string ("description",
+							      "Description",
+							      "The description of the file",
+							      NULL,
+							      G_PARAM_READABLE));
+	bench_ft_channel_install_uint64 (object_class, PROP_SIZE, "size",
+					 "The size of the file");
+	bench_ft_channel_install_uint64 (object_class, PROP_DATE, "date",
+					 "The modification time of the file");
+	bench_ft_channel_install_uint64 (object_class, PROP_TRANSFERRED_BYTES,
+					 "transferred-bytes",
+					 "The bytes sent, with the initial offset");
+	bench_ft_channel_install_uint64 (object_class, PROP_INITIAL_OFFSET,
+					 "initial-offset",
+					 "The offset given to AcceptFile");
+
+	klass->dbus_properties_class.interfaces = prop_interfaces;
+	tp_dbus_properties_mixin_class_init (object_class,
+		G_STRUCT_OFFSET (BenchFtChannelClass, dbus_properties_class));
+
+	g_type_class_add_private (object_class, sizeof (BenchFtChannelPriv));
+}
+
+static void
+bench_ft_channel_init (BenchFtChannel *channel)
+{
+	BenchFtChannelPriv *priv = G_TYPE_INSTANCE_GET_PRIVATE (channel,
+		BENCH_TYPE_FT_CHANNEL, BenchFtChannelPriv);
+
+	channel->priv = priv;
+	channel->state = TP_FILE_TRANSFER_STATE_PENDING;
+	priv->listen_fd = -1;
+	priv->client_fd = -1;
+}
+
+static void
+bench_ft_channel_close (TpSvcChannel          *iface,
+			DBusGMethodInvocation *context)
+{
+	BenchFtChannel *channel = BENCH_FT_CHANNEL (iface);
+
+	bench_ft_channel_stop_sending (channel);
+
+	if (channel->state != TP_FILE_TRANSFER_STATE_COMPLETED &&
+	    channel->state != TP_FILE_TRANSFER_STATE_CANCELLED) {
+		bench_ft_channel_set_state (channel,
+			TP_FILE_TRANSFER_STATE_CANCELLED,
+			TP_FILE_TRANSFER_STATE_CHANGE_REASON_LOCAL_STOPPED);
+	}
+
+	if (!channel->closed) {
+		channel->closed = TRUE;
+		tp_svc_channel_emit_closed (channel);
+	}
+
+	tp_svc_channel_return_from_close (context);
+}
+
+static void
+bench_ft_channel_get_channel_type (TpSvcChannel          *iface,
+				   DBusGMethodInvocation *context)
+{
+	tp_svc_channel_return_from_get_channel_type (context,
+		TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER);
+}
+
+static void
+bench_ft_channel_get_handle (TpSvcChannel          *iface,
+			     DBusGMethodInvocation *context)
+{
+	BenchFtChannel *channel = BENCH_FT_CHANNEL (iface);
+
+	tp_svc_channel_return_from_get_handle (context, TP_HANDLE_TYPE_CONTACT,
+					       channel->handle);
+}
+
+static void
+bench_ft_channel_get_interfaces (TpSvcChannel          *iface,
+				 DBusGMethodInvocation *context)
+{
+	tp_svc_channel_return_from_get_interfaces (context, no_interfaces);
+}
+
+static void
+channel_iface_init (gpointer g_iface,
+		    gpointer iface_data)
+{
+	TpSvcChannelClass *klass = g_iface;
+
+#define IMPLEMENT(x) tp_svc_channel_implement_##x (klass, bench_ft_channel_##x)
+	IMPLEMENT (close);
+	IMPLEMENT (get_channel_type);
+	IMPLEMENT (get_handle);
+	IMPLEMENT (get_interfaces);
+#undef IMPLEMENT
+}
+
+/* The CM of a protocol that can start anywhere in the file: @offset is
+ * always honoured, and the data is there as soon as the socket is */
+static void
+bench_ft_channel_accept_file (TpSvcChannelTypeFileTransfer *iface,
+			      guint                         address_type,
+			      guint                         access_control,
+			      const GValue                 *access_control_param,
+			      guint64                       offset,
+			      DBusGMethodInvocation        *context)
+{
+	BenchFtChannel     *channel = BENCH_FT_CHANNEL (iface);
+	BenchFtChannelPriv *priv = GET_PRIV (channel);
+	GError             *error = NULL;
+	GArray             *array;
+	GValue             *address;
+
+	if (channel->state != TP_FILE_TRANSFER_STATE_PENDING) {
+		GError e = { TP_ERRORS, TP_ERROR_NOT_AVAILABLE,
+			     "The transfer was already accepted" };
+
+		dbus_g_method_return_error (context, &e);
+		return;
+	}
+
+	if (address_type != TP_SOCKET_ADDRESS_TYPE_UNIX ||
+	    access_control != TP_SOCKET_ACCESS_CONTROL_LOCALHOST) {
+		GError e = { TP_ERRORS, TP_ERROR_NOT_IMPLEMENTED,
+			     "Only unix sockets with localhost access control "
+			     "are supported" };
+
+		dbus_g_method_return_error (context, &e);
+		return;
+	}
+
+	if (!bench_ft_channel_listen (channel, &error)) {
+		dbus_g_method_return_error (context, error);
+		g_error_free (error);
+		return;
+	}
+
+	channel->initial_offset = MIN (offset, channel->size);
+	channel->transferred = channel->initial_offset;
+
+	array = g_array_sized_new (FALSE, FALSE, sizeof (gchar),
+				   strlen (priv->socket_path));
+	g_array_append_vals (array, priv->socket_path,
+			     strlen (priv->socket_path));
+	address = tp_g_value_slice_new (DBUS_TYPE_G_UCHAR_ARRAY);
+	g_value_take_boxed (address, array);
+
+	tp_svc_channel_type_file_transfer_return_from_accept_file (context,
+								   address);
+	tp_g_value_slice_free (address);
+
+	bench_ft_channel_set_state (channel, TP_FILE_TRANSFER_STATE_ACCEPTED,
+		TP_FILE_TRANSFER_STATE_CHANGE_REASON_REQUESTED);
+	/* There is no remote side to wait for */
+	bench_ft_channel_set_state (channel, TP_FILE_TRANSFER_STATE_OPEN,
+		TP_FILE_TRANSFER_STATE_CHANGE_REASON_NONE);
+}
+
+static void
+file_transfer_iface_init (gpointer g_iface,
+			  gpointer iface_data)
+{
+	TpSvcChannelTypeFileTransferClass *klass = g_iface;
+
+	tp_svc_channel_type_file_transfer_implement_accept_file (klass,
+		bench_ft_channel_accept_file);
+}
+
+/**
+ * bench_ft_channel_new:
+ * @conn: the connection owning the channel
+ * @object_path: where to export the channel
+ * @sender: the contact offering the file
+ * @filename: the name of the file
+ * @data: the content of the file, copied
+ * @size: the length of @data
+ * @content_hash_type: the #TpFileHashType of @content_hash
+ * @content_hash: the hash of @data, or %NULL
+ *
+ * Return value: a new #BenchFtChannel, waiting to be accepted
+ */
+BenchFtChannel *
+bench_ft_channel_new (TpBaseConnection *conn,
+		      const gchar      *object_path,
+		      TpHandle          sender,
+		      const gchar      *filename,
+		      const gchar      *data,
+		      gsize             size,
+		      TpFileHashType    content_hash_type,
+		      const gchar      *content_hash)
+{
+	BenchFtChannel *channel;
+
+	channel = g_object_new (BENCH_TYPE_FT_CHANNEL,
+				"connection", conn,
+				"object-path", object_path,
+				"handle", sender,
+				NULL);
+
+	/* Clients can't see the channel before it is announced */
+	channel->filename = g_strdup (filename);
+	channel->data = g_memdup (data, size);
+	channel->size = size;
+	channel->content_hash_type = content_hash_type;
+	channel->content_hash = g_strdup (content_hash ? content_hash : "");
+
+	return channel;
+}
+
+const gchar *
+bench_ft_channel_get_object_path (BenchFtChannel *channel)
+{
+	g_return_val_if_fail (BENCH_IS_FT_CHANNEL (channel), NULL);
+
+	return channel->object_path;
+}
@@ -0,0 +1,84 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef __BENCH_FT_CHANNEL_H__
+#define __BENCH_FT_CHANNEL_H__
+
+#include <glib-object.h>
+
+#include <telepathy-glib/base-connection.h>
+#include <telepathy-glib/dbus-properties-mixin.h>
+#include <telepathy-glib/enums.h>
+
+G_BEGIN_DECLS
+
+#define BENCH_TYPE_FT_CHANNEL         (bench_ft_channel_get_type ())
+#define BENCH_FT_CHANNEL(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), BENCH_TYPE_FT_CHANNEL, BenchFtChannel))
+#define BENCH_FT_CHANNEL_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST ((k), BENCH_TYPE_FT_CHANNEL, BenchFtChannelClass))
+#define BENCH_IS_FT_CHANNEL(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), BENCH_TYPE_FT_CHANNEL))
+#define BENCH_IS_FT_CHANNEL_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), BENCH_TYPE_FT_CHANNEL))
+#define BENCH_FT_CHANNEL_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), BENCH_TYPE_FT_CHANNEL, BenchFtChannelClass))
+
+typedef struct _BenchFtChannel      BenchFtChannel;
+typedef struct _BenchFtChannelClass BenchFtChannelClass;
+
+/* An incoming file transfer of the bench connection. The file is held in
+ * memory and sent, from the offset given to AcceptFile, to whoever
+ * connects to the unix socket it returns. */
+struct _BenchFtChannel {
+	GObject              parent;
+
+	TpBaseConnection    *conn;
+	gchar               *object_path;
+	TpHandle             handle;
+	gboolean             closed;
+
+	gchar               *filename;
+	gchar               *data;
+	guint64              size;
+	TpFileHashType       content_hash_type;
+	gchar               *content_hash;
+	TpFileTransferState  state;
+	guint64              initial_offset;
+	guint64              transferred;
+
+	gpointer             priv;
+};
+
+struct _BenchFtChannelClass {
+	GObjectClass               parent_class;
+
+	TpDBusPropertiesMixinClass dbus_properties_class;
+};
+
+GType            bench_ft_channel_get_type        (void) G_GNUC_CONST;
+BenchFtChannel * bench_ft_channel_new             (TpBaseConnection *conn,
+						   const gchar      *object_path,
+						   TpHandle          sender,
+						   const gchar      *filename,
+						   const gchar      *data,
+						   gsize             size,
+						   TpFileHashType    content_hash_type,
+						   const gchar      *content_hash);
+const gchar *    bench_ft_channel_get_object_path (BenchFtChannel   *channel);
+
+G_END_DECLS
+
+#endif /* __BENCH_FT_CHANNEL_H__ */
@@ -0,0 +1,409 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Writes log trees in the format of empathy-log-store-empathy.c:
+ * <basedir>/<account>/<contact>/<YYYYMMDD>.log for 1-1 chats and
+ * <basedir>/<account>/chatrooms/<room>/<YYYYMMDD>.log for chatrooms, one
+ * XML file per chat and day. Bodies mix several scripts, emoticons and
+ * characters that need escaping, like real conversations do. */
+
+#include <config.h>
+
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include <libempathy/empathy-message.h>
+#include <libempathy/empathy-time.h>
+
+#include "bench-log-fixture.h"
+
+/* Same as empathy-log-store-empathy.c */
+#define LOG_HEADER \
+	"<?xml version='1.0' encoding='utf-8'?>\n" \
+	"<?xml-stylesheet type=\"text/xsl\" href=\"empathy-log.xsl\"?>\n" \
+	"<log>\n"
+#define LOG_FOOTER "</log>\n"
+#define LOG_DIR_CHATROOMS "chatrooms"
+#define LOG_TIME_FORMAT_FULL "%Y%m%dT%H:%M:%S"
+#define LOG_TIME_FORMAT "%Y%m%d"
+#define LOG_DIR_CREATE_MODE (S_IRUSR | S_IWUSR | S_IXUSR)
+
+#define N_ROOM_MEMBERS 20
+
+typedef enum {
+	SCRIPT_LATIN,
+	SCRIPT_CYRILLIC,
+	SCRIPT_GREEK,
+	SCRIPT_CJK,
+	SCRIPT_RTL,
+	N_SCRIPTS
+} Script;
+
+static const gchar *latin_words[] = {
+	"hello", "the", "meeting", "is", "tomorrow", "ok", "lol", "thanks",
+	"see", "you", "later", "did", "it", "work", "café", "naïve", "über",
+	"façade", "crème", "brûlée", "señor", "jalapeño", "smörgåsbord",
+	"Straße", "Ærøskøbing", "Łódź", "déjà", "vu", "coöperate", NULL
+};
+
+static const gchar *cyrillic_words[] = {
+	"привет", "как", "дела", "завтра", "встреча", "спасибо", "хорошо",
+	"да", "нет", "пока", "Ёлка", "щука", NULL
+};
+
+static const gchar *greek_words[] = {
+	"καλημέρα", "ευχαριστώ", "αύριο", "ναι", "όχι", "γεια", "σου",
+	"συνάντηση", NULL
+};
+
+static const gchar *cjk_words[] = {
+	"你好", "明天", "会议", "谢谢", "没问题", "こんにちは", "ありがとう",
+	"大丈夫", "안녕하세요", "감사합니다", NULL
+};
+
+static const gchar *rtl_words[] = {
+	"مرحبا", "شكرا", "غدا", "اجتماع", "שלום", "תודה", "מחר", NULL
+};
+
+static const gchar **words[N_SCRIPTS] = {
+	latin_words,
+	cyrillic_words,
+	greek_words,
+	cjk_words,
+	rtl_words,
+};
+
+/* Emoticons, and characters that need escaping */
+static const gchar *extras[] = {
+	"😀", "👍", "🎉", "☕", "♥", ":-)", ";-)", "<3", "a<b", "R&D",
+	"it's", "\"quoted\"", "http://example.com/?a=1&b=2", NULL
+};
+
+static const gchar *first_names[] = {
+	"Zoë", "José", "Björn", "Анна", "Μαρία", "李雷", "さくら", "Ahmed",
+	"Łukasz", "François", "Siobhán", "Nguyễn", "דני", "Chloé", NULL
+};
+
+static const gchar *
+pick (GRand        *rand,
+      const gchar **list)
+{
+	return list[g_rand_int_range (rand, 0, g_strv_length ((gchar **) list))];
+}
+
+void
+bench_log_fixture_init (BenchLogFixture *fixture)
+{
+	fixture->n_contacts = 30;
+	fixture->n_rooms = 3;
+	fixture->n_days = 730;
+	fixture->activity = 15;
+	fixture->n_messages = 15;
+	fixture->seed = 42;
+}
+
+gchar *
+bench_log_fixture_chat_id (guint    i,
+			   gboolean chatroom)
+{
+	if (chatroom) {
+		return g_strdup_printf ("room%u@conference.example.com", i);
+	}
+
+	return g_strdup_printf ("contact%u@example.com", i);
+}
+
+static gchar *
+make_name (GRand *rand,
+	   guint  i)
+{
+	return g_strdup_printf ("%s %u", pick (rand, first_names), i);
+}
+
+static gchar *
+make_body (GRand  *rand,
+	   Script  script)
+{
+	GString *body;
+	guint    n_words;
+	guint    i;
+
+	body = g_string_new (NULL);
+
+	/* Mostly short lines, sometimes a paste */
+	if (g_rand_int_range (rand, 0, 100) == 0) {
+		n_words = g_rand_int_range (rand, 100, 400);
+	} else {
+		n_words = g_rand_int_range (rand, 1, 20);
+	}
+
+	for (i = 0; i < n_words; i++) {
+		guint r = g_rand_int_range (rand, 0, 100);
+
+		if (i > 0) {
+			g_string_append_c (body, ' ');
+		}
+
+		if (r < 70) {
+			g_string_append (body, pick (rand, words[script]));
+		} else if (r < 90) {
+			g_string_append (body, pick (rand, latin_words));
+		} else {
+			g_string_append (body, pick (rand, extras));
+		}
+	}
+
+	if (g_rand_int_range (rand, 0, 1000) == 0) {
+		g_string_append (body, " " BENCH_LOG_FIXTURE_RARE_WORD);
+	}
+
+	return g_string_free (body, FALSE);
+}
+
+static void
+append_message (GString     *contents,
+		GRand       *rand,
+		time_t       t,
+		guint        cm_id,
+		const gchar *id,
+		const gchar *name,
+		gboolean     is_user,
+		Script       script)
+{
+	TpChannelTextMessageType  type = TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL;
+	gchar                    *time_str;
+	gchar                    *escaped_id;
+	gchar                    *escaped_name;
+	gchar                    *body;
+	gchar                    *escaped_body;
+	guint                     r;
+
+	r = g_rand_int_range (rand, 0, 100);
+	if (r < 3) {
+		type = TP_CHANNEL_TEXT_MESSAGE_TYPE_ACTION;
+	} else if (r < 4 && !is_user) {
+		type = TP_CHANNEL_TEXT_MESSAGE_TYPE_AUTO_REPLY;
+	}
+
+	time_str = empathy_time_to_string_utc (t, LOG_TIME_FORMAT_FULL);
+	escaped_id = g_markup_escape_text (id, -1);
+	escaped_name = g_markup_escape_text (name, -1);
+	body = make_body (rand, script);
+	escaped_body = g_markup_escape_text (body, -1);
+
+	g_string_append_printf (contents,
+		"<message time='%s' cm_id='%u' id='%s' name='%s' token=''"
+		" isuser='%s' type='%s'>%s</message>\n",
+		time_str, cm_id, escaped_id, escaped_name,
+		is_user ? "true" : "false",
+		empathy_message_type_to_str (type), escaped_body);
+
+	g_free (time_str);
+	g_free (escaped_id);
+	g_free (escaped_name);
+	g_free (body);
+	g_free (escaped_body);
+}
+
+/* Writes the day files of one chat */
+static gboolean
+generate_chat (const BenchLogFixture *fixture,
+	       GRand                 *rand,
+	       const gchar           *dir,
+	       const gchar           *self_id,
+	       const gchar           *chat_id,
+	       gboolean               chatroom,
+	       BenchLogFixtureStats  *stats,
+	       GError               **error)
+{
+	GString   *contents;
+	GPtrArray *names;
+	Script     script;
+	gboolean   ret = TRUE;
+	struct tm  today;
+	time_t     now;
+	guint      day;
+	guint      i;
+
+	if (g_mkdir_with_parents (dir, LOG_DIR_CREATE_MODE) < 0) {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+			     "Can't create %s", dir);
+		return FALSE;
+	}
+
+	/* Each chat mostly talks one language */
+	script = g_rand_int_range (rand, 0, N_SCRIPTS);
+
+	/* The other side: one contact, or the members of the room */
+	names = g_ptr_array_new ();
+	for (i = 0; i < (chatroom ? N_ROOM_MEMBERS : 1); i++) {
+		g_ptr_array_add (names, make_name (rand, i));
+	}
+
+	now = empathy_time_get_current ();
+	today = *localtime (&now);
+	contents = g_string_sized_new (64 * 1024);
+
+	for (day = 0; day < fixture->n_days; day++) {
+		struct tm  tm = today;
+		time_t     t;
+		time_t     end;
+		gchar     *date;
+		gchar     *filename;
+		gchar     *path;
+		guint      n_messages;
+
+		if ((guint) g_rand_int_range (rand, 0, 100) >= fixture->activity) {
+			continue;
+		}
+
+		tm.tm_mday -= day;
+		tm.tm_hour = 0;
+		tm.tm_min = 0;
+		tm.tm_sec = 0;
+		tm.tm_isdst = -1;
+		t = mktime (&tm);
+		end = t + 24 * 60 * 60 - 1;
+		t += g_rand_int_range (rand, 7 * 60 * 60, 22 * 60 * 60);
+
+		date = empathy_time_to_string_local (t, LOG_TIME_FORMAT);
+		filename = g_strconcat (date, ".log", NULL);
+		path = g_build_filename (dir, filename, NULL);
+
+		g_string_assign (contents, LOG_HEADER);
+		n_messages = g_rand_int_range (rand, 1,
+					       2 * fixture->n_messages + 1);
+		for (i = 0; i < n_messages; i++) {
+			gboolean  is_user;
+			guint     member;
+			gchar    *id;
+
+			is_user = g_rand_int_range (rand, 0, 100) <
+				(chatroom ? 10 : 50);
+			member = g_rand_int_range (rand, 0, names->len);
+			if (is_user) {
+				id = g_strdup (self_id);
+			} else if (chatroom) {
+				id = g_strdup_printf ("%s/%s", chat_id,
+						      (gchar *) g_ptr_array_index (names, member));
+			} else {
+				id = g_strdup (chat_id);
+			}
+
+			append_message (contents, rand, t, i, id,
+					is_user ? "Me" : g_ptr_array_index (names, member),
+					is_user, script);
+			g_free (id);
+
+			t = MIN (t + g_rand_int_range (rand, 2, 600), end);
+		}
+		g_string_append (contents, LOG_FOOTER);
+
+		if (!g_file_set_contents (path, contents->str, contents->len,
+					  error)) {
+			ret = FALSE;
+			g_free (date);
+			g_free (filename);
+			g_free (path);
+			break;
+		}
+
+		stats->n_files++;
+		stats->n_messages += n_messages;
+		stats->n_bytes += contents->len;
+
+		g_free (date);
+		g_free (filename);
+		g_free (path);
+	}
+
+	g_string_free (contents, TRUE);
+	g_ptr_array_foreach (names, (GFunc) g_free, NULL);
+	g_ptr_array_free (names, TRUE);
+
+	return ret;
+}
+
+/**
+ * bench_log_fixture_generate:
+ * @fixture: the shape of the logs
+ * @basedir: where the logs go, in place of ~/.gnome2/Empathy/logs
+ * @accounts: %NULL terminated unique names of the accounts
+ * @stats: filled with what was written
+ * @error: a #GError set if a file can't be written
+ *
+ * The same @fixture always gives the same logs, apart from their dates
+ * which end today.
+ *
+ * Return value: %TRUE if all the logs were written
+ */
+gboolean
+bench_log_fixture_generate (const BenchLogFixture *fixture,
+			    const gchar           *basedir,
+			    const gchar * const   *accounts,
+			    BenchLogFixtureStats  *stats,
+			    GError               **error)
+{
+	GRand    *rand;
+	gboolean  ret = TRUE;
+	guint     a, i;
+
+	memset (stats, 0, sizeof (BenchLogFixtureStats));
+	rand = g_rand_new_with_seed (fixture->seed);
+
+	for (a = 0; ret && accounts[a] != NULL; a++) {
+		gchar *self_id;
+
+		self_id = g_strdup_printf ("me%u@example.com", a);
+
+		for (i = 0; ret && i < fixture->n_contacts + fixture->n_rooms; i++) {
+			gboolean  chatroom = i >= fixture->n_contacts;
+			gchar    *chat_id;
+			gchar    *dir;
+
+			chat_id = bench_log_fixture_chat_id (
+				chatroom ? i - fixture->n_contacts : i,
+				chatroom);
+			if (chatroom) {
+				dir = g_build_filename (basedir, accounts[a],
+							LOG_DIR_CHATROOMS,
+							chat_id, NULL);
+			} else {
+				dir = g_build_filename (basedir, accounts[a],
+							chat_id, NULL);
+			}
+
+			ret = generate_chat (fixture, rand, dir, self_id,
+					     chat_id, chatroom, stats, error);
+
+			g_free (chat_id);
+			g_free (dir);
+		}
+
+		g_free (self_id);
+	}
+
+	g_rand_free (rand);
+
+	return ret;
+}
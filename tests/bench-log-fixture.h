@@ -0,0 +1,57 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BENCH_LOG_FIXTURE_H__
+#define __BENCH_LOG_FIXTURE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Appears in about one message in a thousand */
+#define BENCH_LOG_FIXTURE_RARE_WORD "xylophone"
+
+typedef struct {
+	guint   n_contacts; /* 1-1 chats per account */
+	guint   n_rooms;    /* chatrooms per account */
+	guint   n_days;     /* days of history, up to today */
+	guint   activity;   /* percentage of days each chat was used */
+	guint   n_messages; /* average messages per chat and day */
+	guint32 seed;
+} BenchLogFixture;
+
+typedef struct {
+	guint   n_files;
+	guint   n_messages;
+	guint64 n_bytes;
+} BenchLogFixtureStats;
+
+void     bench_log_fixture_init     (BenchLogFixture       *fixture);
+gchar *  bench_log_fixture_chat_id  (guint                  i,
+				     gboolean               chatroom);
+gboolean bench_log_fixture_generate (const BenchLogFixture *fixture,
+				     const gchar           *basedir,
+				     const gchar * const   *accounts,
+				     BenchLogFixtureStats  *stats,
+				     GError               **error);
+
+G_END_DECLS
+
+#endif /* __BENCH_LOG_FIXTURE_H__ */
@@ -0,0 +1,284 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <telepathy-glib/connection.h>
+#include <telepathy-glib/dbus.h>
+#include <telepathy-glib/enums.h>
+#include <telepathy-glib/gtypes.h>
+#include <telepathy-glib/interfaces.h>
+#include <telepathy-glib/util.h>
+
+#include <check.h>
+#include "check-helpers.h"
+#include "check-libempathy.h"
+
+#include <libempathy/empathy-account-manager.h>
+#include <libempathy/empathy-channel-classes.h>
+#include <libempathy/empathy-dispatcher.h>
+
+#include "bench-connection.h"
+
+/* Seconds before waiting for the stand-in connection is given up */
+#define TIMEOUT 10
+
+static void
+add_class (GPtrArray *classes,
+           const gchar *channel_type,
+           guint handle_type,
+           const gchar * const *allowed)
+{
+  GHashTable *fixed;
+  GValueArray *class;
+  GValue value = { 0, };
+
+  fixed = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) tp_g_value_slice_free);
+  if (channel_type != NULL)
+    g_hash_table_insert (fixed, TP_IFACE_CHANNEL ".ChannelType",
+        tp_g_value_slice_new_string (channel_type));
+  if (handle_type != 0)
+    g_hash_table_insert (fixed, TP_IFACE_CHANNEL ".TargetHandleType",
+        tp_g_value_slice_new_uint (handle_type));
+
+  class = g_value_array_new (2);
+
+  g_value_init (&value, TP_HASH_TYPE_STRING_VARIANT_MAP);
+  g_value_take_boxed (&value, fixed);
+  g_value_array_append (class, &value);
+  g_value_unset (&value);
+
+  g_value_init (&value, G_TYPE_STRV);
+  g_value_set_boxed (&value, allowed);
+  g_value_array_append (class, &value);
+  g_value_unset (&value);
+
+  g_ptr_array_add (classes, class);
+}
+
+/* The RequestableChannelClasses of a stand-in jabber connection */
+static GPtrArray *
+make_requestable_channels (void)
+{
+  GPtrArray *classes;
+  const gchar * const text_allowed[] = {
+    TP_IFACE_CHANNEL ".TargetHandle",
+    TP_IFACE_CHANNEL ".TargetID",
+    NULL };
+  const gchar * const media_allowed[] = {
+    TP_IFACE_CHANNEL ".TargetHandle",
+    NULL };
+  const gchar * const other_media_allowed[] = {
+    TP_IFACE_CHANNEL ".TargetID",
+    NULL };
+  const gchar * const none[] = { NULL };
+
+  classes = g_ptr_array_new ();
+  add_class (classes, TP_IFACE_CHANNEL_TYPE_TEXT, TP_HANDLE_TYPE_CONTACT,
+      text_allowed);
+  add_class (classes, TP_IFACE_CHANNEL_TYPE_TEXT, TP_HANDLE_TYPE_ROOM,
+      text_allowed);
+  add_class (classes, TP_IFACE_CHANNEL_TYPE_STREAMED_MEDIA,
+      TP_HANDLE_TYPE_CONTACT, media_allowed);
+  /* Shadowed by the previous one */
+  add_class (classes, TP_IFACE_CHANNEL_TYPE_STREAMED_MEDIA,
+      TP_HANDLE_TYPE_CONTACT, other_media_allowed);
+  /* No fixed handle type, can't be looked up */
+  add_class (classes, TP_IFACE_CHANNEL_TYPE_ROOM_LIST, 0, none);
+  add_class (classes, TP_IFACE_CHANNEL_TYPE_CONTACT_LIST,
+      TP_HANDLE_TYPE_GROUP, none);
+
+  return classes;
+}
+
+static void
+free_requestable_channels (GPtrArray *classes)
+{
+  g_ptr_array_foreach (classes, (GFunc) g_value_array_free, NULL);
+  g_ptr_array_free (classes, TRUE);
+}
+
+START_TEST (test_empathy_channel_classes_lookup)
+{
+  EmpathyChannelClasses *classes;
+  GPtrArray *requestable_channels;
+  GStrv allowed;
+
+  requestable_channels = make_requestable_channels ();
+  classes = empathy_channel_classes_new (requestable_channels);
+  /* The table doesn't depend on the property value once built */
+  free_requestable_channels (requestable_channels);
+
+  allowed = empathy_channel_classes_lookup (classes,
+      TP_IFACE_CHANNEL_TYPE_TEXT, TP_HANDLE_TYPE_CONTACT);
+  fail_if (allowed == NULL);
+  fail_unless (tp_strv_contains ((const gchar * const *) allowed,
+        TP_IFACE_CHANNEL ".TargetID"));
+
+  allowed = empathy_channel_classes_lookup (classes,
+      TP_IFACE_CHANNEL_TYPE_TEXT, TP_HANDLE_TYPE_ROOM);
+  fail_if (allowed == NULL);
+
+  /* The first matching class wins */
+  allowed = empathy_channel_classes_lookup (classes,
+      TP_IFACE_CHANNEL_TYPE_STREAMED_MEDIA, TP_HANDLE_TYPE_CONTACT);
+  fail_if (allowed == NULL);
+  fail_unless (tp_strv_contains ((const gchar * const *) allowed,
+        TP_IFACE_CHANNEL ".TargetHandle"));
+  fail_if (tp_strv_contains ((const gchar * const *) allowed,
+        TP_IFACE_CHANNEL ".TargetID"));
+
+  /* Classes without allowed properties can be found */
+  allowed = empathy_channel_classes_lookup (classes,
+      TP_IFACE_CHANNEL_TYPE_CONTACT_LIST, TP_HANDLE_TYPE_GROUP);
+  fail_if (allowed == NULL);
+  fail_if (allowed[0] != NULL);
+
+  /* Not requestable */
+  fail_if (empathy_channel_classes_lookup (classes,
+        TP_IFACE_CHANNEL_TYPE_STREAMED_MEDIA, TP_HANDLE_TYPE_ROOM) != NULL);
+  fail_if (empathy_channel_classes_lookup (classes,
+        TP_IFACE_CHANNEL_TYPE_ROOM_LIST, TP_HANDLE_TYPE_NONE) != NULL);
+  fail_if (empathy_channel_classes_lookup (classes,
+        TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER, TP_HANDLE_TYPE_CONTACT) != NULL);
+  fail_if (empathy_channel_classes_lookup (classes,
+        "org.example.Channel.Type.NeverSeenBefore",
+        TP_HANDLE_TYPE_CONTACT) != NULL);
+  fail_if (empathy_channel_classes_lookup (classes,
+        TP_IFACE_CHANNEL_TYPE_TEXT, NUM_TP_HANDLE_TYPES + 3) != NULL);
+
+  empathy_channel_classes_free (classes);
+}
+END_TEST
+
+START_TEST (test_empathy_channel_classes_empty)
+{
+  EmpathyChannelClasses *classes;
+  GPtrArray *requestable_channels;
+
+  requestable_channels = g_ptr_array_new ();
+  classes = empathy_channel_classes_new (requestable_channels);
+
+  fail_if (empathy_channel_classes_lookup (classes,
+        TP_IFACE_CHANNEL_TYPE_TEXT, TP_HANDLE_TYPE_CONTACT) != NULL);
+
+  empathy_channel_classes_free (classes);
+  g_ptr_array_free (requestable_channels, TRUE);
+}
+END_TEST
+
+static void
+connection_ready_cb (TpConnection *connection,
+                     const GError *error,
+                     gpointer user_data)
+{
+  fail_if (error != NULL);
+  g_main_loop_quit (user_data);
+}
+
+static gboolean
+timeout_cb (gpointer user_data)
+{
+  fail ("Timed out");
+
+  return FALSE;
+}
+
+static void
+request_cb (EmpathyDispatchOperation *operation,
+            const GError *error,
+            gpointer user_data)
+{
+  fail_if (error != NULL);
+  fail_if (operation == NULL);
+  fail_if (tp_strdiff (empathy_dispatch_operation_get_channel_type (operation),
+        TP_IFACE_CHANNEL_TYPE_CONTACT_LIST));
+
+  empathy_dispatch_operation_claim (operation);
+  g_main_loop_quit (user_data);
+}
+
+/* The dispatcher builds the table from the RequestableChannelClasses of the
+ * stand-in connection of the load benchmark, and a channel is requested
+ * after checking it like EmpathyCallHandler does. */
+START_TEST (test_empathy_channel_classes_dispatcher)
+{
+  BenchConnection *conn;
+  TpDBusDaemon *daemon;
+  TpConnection *connection;
+  EmpathyAccountManager *account_manager;
+  EmpathyDispatcher *dispatcher;
+  GMainLoop *loop;
+  GHashTable *request;
+  GError *error = NULL;
+  GStrv allowed;
+  TpHandle handle;
+  guint timeout_id;
+
+  loop = g_main_loop_new (NULL, FALSE);
+  timeout_id = g_timeout_add_seconds (TIMEOUT, timeout_cb, NULL);
+
+  conn = bench_connection_new (&error);
+  fail_if (conn == NULL);
+  daemon = tp_dbus_daemon_new (tp_get_bus ());
+  connection = tp_connection_new (daemon,
+      bench_connection_get_bus_name (conn),
+      bench_connection_get_object_path (conn), &error);
+  fail_if (connection == NULL);
+  tp_cli_connection_call_connect (connection, -1, NULL, NULL, NULL, NULL);
+  tp_connection_call_when_ready (connection, connection_ready_cb, loop);
+  g_main_loop_run (loop);
+
+  /* Hand the connection to the dispatcher the way Mission Control's does */
+  dispatcher = empathy_dispatcher_dup_singleton ();
+  account_manager = empathy_account_manager_dup_singleton ();
+  g_signal_emit_by_name (account_manager, "new-connection", connection);
+
+  while (empathy_dispatcher_find_channel_class (dispatcher, connection,
+        TP_IFACE_CHANNEL_TYPE_CONTACT_LIST, TP_HANDLE_TYPE_LIST) == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  allowed = empathy_dispatcher_find_channel_class (dispatcher, connection,
+      TP_IFACE_CHANNEL_TYPE_CONTACT_LIST, TP_HANDLE_TYPE_LIST);
+  fail_unless (tp_strv_contains ((const gchar * const *) allowed,
+        TP_IFACE_CHANNEL ".TargetHandle"));
+  fail_unless (tp_strv_contains ((const gchar * const *) allowed,
+        TP_IFACE_CHANNEL ".TargetID"));
+
+  /* The stand-in connection can't create anything else */
+  fail_if (empathy_dispatcher_find_channel_class (dispatcher, connection,
+        TP_IFACE_CHANNEL_TYPE_TEXT, TP_HANDLE_TYPE_CONTACT) != NULL);
+  fail_if (empathy_dispatcher_find_channel_class (dispatcher, connection,
+        TP_IFACE_CHANNEL_TYPE_STREAMED_MEDIA, TP_HANDLE_TYPE_CONTACT) != NULL);
+
+  handle = bench_connection_ensure_handle (conn, TP_HANDLE_TYPE_LIST,
+      "subscribe");
+  request = tp_asv_new (
+      TP_IFACE_CHANNEL ".ChannelType", G_TYPE_STRING,
+        TP_IFACE_CHANNEL_TYPE_CONTACT_LIST,
+      TP_IFACE_CHANNEL ".TargetHandleType", G_TYPE_UINT, TP_HANDLE_TYPE_LIST,
+      TP_IFACE_CHANNEL ".TargetHandle", G_TYPE_UINT, handle,
+      NULL);
+  empathy_dispatcher_create_channel (dispatcher, connection, request,
+      request_cb, loop);
+  g_main_loop_run (loop);
+
+  g_source_remove (timeout_id);
+  g_object_unref (account_manager);
+  g_object_unref (dispatcher);
+  g_object_unref (connection);
+  g_object_unref (daemon);
+  g_object_unref (conn);
+  g_main_loop_unref (loop);
+}
+END_TEST
+
+TCase *
+make_empathy_channel_classes_tcase (void)
+{
+    TCase *tc = tcase_create ("empathy-channel-classes");
+    tcase_add_test (tc, test_empathy_channel_classes_lookup);
+    tcase_add_test (tc, test_empathy_channel_classes_empty);
+    tcase_add_test (tc, test_empathy_channel_classes_dispatcher);
+    return tc;
+}
@@ -359,6 +359,11 @@ START_TEST (test_empathy_chatroom_manager_change_chatroom)
   fail_if (chatroom == NULL);
   empathy_chatroom_set_room (chatroom, "new_room");
 
+  /* the chatroom is found under its new room */
+  fail_if (empathy_chatroom_manager_find (mgr, account, "new_room") !=
+      chatroom);
+  fail_if (empathy_chatroom_manager_find (mgr, account, "room2") != NULL);
+
   /* reload chatrooms file */
   g_object_unref (mgr);
   mgr = empathy_chatroom_manager_dup_singleton (file);
@@ -372,6 +377,45 @@ START_TEST (test_empathy_chatroom_manager_change_chatroom)
 }
 END_TEST
 
+START_TEST (test_empathy_chatroom_manager_duplicate_room)
+{
+  EmpathyChatroomManager *mgr;
+  gchar *file;
+  McAccount *account;
+  EmpathyChatroom *room1, *room2;
+
+  account = get_test_account ();
+
+  copy_xml_file (CHATROOM_SAMPLE, "dup.xml");
+
+  file = get_user_xml_file ("dup.xml");
+
+  /* change the chatrooms XML file to use the account we just created */
+  if (!change_account_name_in_file (account, file))
+    return;
+
+  mgr = empathy_chatroom_manager_dup_singleton (file);
+
+  room1 = empathy_chatroom_manager_find (mgr, account, "room1");
+  fail_if (room1 == NULL);
+  room2 = empathy_chatroom_manager_find (mgr, account, "room2");
+  fail_if (room2 == NULL);
+
+  /* after a rename two chatrooms have the same room, the newest is found */
+  empathy_chatroom_set_room (room2, "room1");
+  fail_if (empathy_chatroom_manager_find (mgr, account, "room1") != room2);
+  fail_if (empathy_chatroom_manager_find (mgr, account, "room2") != NULL);
+
+  /* the other one is found once it is removed */
+  empathy_chatroom_manager_remove (mgr, room2);
+  fail_if (empathy_chatroom_manager_find (mgr, account, "room1") != room1);
+
+  g_object_unref (mgr);
+  g_free (file);
+  g_object_unref (account);
+}
+END_TEST
+
 TCase *
 make_empathy_chatroom_manager_tcase (void)
 {
@@ -381,5 +425,6 @@ make_empathy_chatroom_manager_tcase (void)
     tcase_add_test (tc, test_empathy_chatroom_manager_remove);
     tcase_add_test (tc, test_empathy_chatroom_manager_change_favorite);
     tcase_add_test (tc, test_empathy_chatroom_manager_change_chatroom);
+    tcase_add_test (tc, test_empathy_chatroom_manager_duplicate_room);
     return tc;
 }
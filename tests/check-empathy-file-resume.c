@@ -0,0 +1,275 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <telepathy-glib/channel.h>
+#include <telepathy-glib/connection.h>
+#include <telepathy-glib/dbus.h>
+#include <telepathy-glib/interfaces.h>
+
+#include <check.h>
+#include "check-helpers.h"
+#include "check-libempathy.h"
+
+#include <libempathy/empathy-file-resume.h>
+#include <libempathy/empathy-tp-file.h>
+
+#include "bench-connection.h"
+
+#define FILE_SIZE (1024 * 1024)
+#define RECEIVED (300 * 1024 + 17)
+
+static gchar *
+make_content (void)
+{
+  gchar *content;
+  guint i;
+
+  content = g_malloc (FILE_SIZE);
+  for (i = 0; i < FILE_SIZE; i++)
+    content[i] = (i * 7 + i / 251) & 0xff;
+
+  return content;
+}
+
+/* Writes what an interrupted transfer received of @content */
+static GFile *
+make_partial_file (const gchar *content,
+                   gsize received)
+{
+  GFile *file;
+  gchar *path;
+  gint fd;
+
+  fd = g_file_open_tmp ("check-empathy-file-resume-XXXXXX", &path, NULL);
+  fail_if (fd < 0);
+  fail_unless (write (fd, content, received) == (gssize) received);
+  close (fd);
+
+  file = g_file_new_for_path (path);
+  g_free (path);
+
+  return file;
+}
+
+static void
+destroy_partial_file (GFile *file)
+{
+  empathy_file_resume_clear (file);
+  g_file_delete (file, NULL, NULL);
+  g_object_unref (file);
+}
+
+START_TEST (test_empathy_file_resume_offset)
+{
+  GFile *file;
+  gchar *content;
+
+  content = make_content ();
+  file = make_partial_file (content, RECEIVED);
+
+  /* Nothing saved yet */
+  fail_if (empathy_file_resume_get_offset (file, FILE_SIZE, "abc") != 0);
+
+  fail_unless (empathy_file_resume_save (file, FILE_SIZE, "abc", NULL));
+  fail_if (empathy_file_resume_get_offset (file, FILE_SIZE, "abc") !=
+      RECEIVED);
+  fail_if (empathy_file_resume_get_offset (file, FILE_SIZE, "ABC") !=
+      RECEIVED);
+  fail_if (empathy_file_resume_get_offset (file, FILE_SIZE, NULL) !=
+      RECEIVED);
+
+  /* Another file */
+  fail_if (empathy_file_resume_get_offset (file, FILE_SIZE + 1, "abc") != 0);
+  fail_if (empathy_file_resume_get_offset (file, FILE_SIZE, "def") != 0);
+
+  /* Forgotten */
+  empathy_file_resume_clear (file);
+  fail_if (empathy_file_resume_get_offset (file, FILE_SIZE, "abc") != 0);
+
+  destroy_partial_file (file);
+  g_free (content);
+}
+END_TEST
+
+START_TEST (test_empathy_file_resume_modified)
+{
+  GFile *file;
+  gchar *content;
+  gchar *path;
+  gint fd;
+
+  content = make_content ();
+  file = make_partial_file (content, RECEIVED);
+  fail_unless (empathy_file_resume_save (file, FILE_SIZE, NULL, NULL));
+
+  /* Data written past the offset doesn't matter */
+  path = g_file_get_path (file);
+  fd = g_open (path, O_WRONLY | O_APPEND, 0);
+  fail_unless (write (fd, "garbage", 7) == 7);
+  close (fd);
+  fail_if (empathy_file_resume_get_offset (file, FILE_SIZE, NULL) !=
+      RECEIVED);
+
+  /* Data before it does */
+  fd = g_open (path, O_WRONLY, 0);
+  fail_unless (lseek (fd, RECEIVED - 10, SEEK_SET) == RECEIVED - 10);
+  fail_unless (write (fd, "X", 1) == 1);
+  close (fd);
+  fail_if (empathy_file_resume_get_offset (file, FILE_SIZE, NULL) != 0);
+
+  g_free (path);
+  destroy_partial_file (file);
+  g_free (content);
+}
+END_TEST
+
+static void
+connection_ready_cb (TpConnection *connection,
+                     const GError *error,
+                     gpointer user_data)
+{
+  fail_if (error != NULL);
+  g_main_loop_quit (user_data);
+}
+
+static void
+channel_ready_cb (TpChannel *channel,
+                  const GError *error,
+                  gpointer user_data)
+{
+  fail_if (error != NULL);
+  g_main_loop_quit (user_data);
+}
+
+static void
+tp_file_ready_cb (EmpathyTpFile *tp_file,
+                  GParamSpec *pspec,
+                  gpointer user_data)
+{
+  g_main_loop_quit (user_data);
+}
+
+static void
+tp_file_content_hash_checked_cb (EmpathyTpFile *tp_file,
+                                 gboolean valid,
+                                 gpointer user_data)
+{
+  fail_unless (valid);
+  g_main_loop_quit (user_data);
+}
+
+/* Resumes a transfer through EmpathyTpFile. The stand-in CM of the load
+ * benchmark offers the file and sends it from the offset given to
+ * AcceptFile. */
+START_TEST (test_empathy_file_resume_transfer)
+{
+  BenchConnection *conn;
+  BenchFtChannel *channel;
+  TpDBusDaemon *daemon;
+  TpConnection *connection;
+  TpChannel *tp_channel;
+  EmpathyTpFile *tp_file;
+  TpHandle sender;
+  GFile *file;
+  GMainLoop *loop;
+  GError *error = NULL;
+  gchar *content;
+  gchar *hash;
+  gchar *path;
+  gchar *result;
+  gsize len;
+  guint64 offset;
+  gint fd;
+
+  loop = g_main_loop_new (NULL, FALSE);
+
+  conn = bench_connection_new (&error);
+  fail_if (conn == NULL);
+  daemon = tp_dbus_daemon_new (tp_get_bus ());
+  connection = tp_connection_new (daemon,
+      bench_connection_get_bus_name (conn),
+      bench_connection_get_object_path (conn), &error);
+  fail_if (connection == NULL);
+  tp_cli_connection_call_connect (connection, -1, NULL, NULL, NULL, NULL);
+  tp_connection_call_when_ready (connection, connection_ready_cb, loop);
+  g_main_loop_run (loop);
+
+  content = make_content ();
+  hash = g_compute_checksum_for_data (G_CHECKSUM_MD5,
+      (const guchar *) content, FILE_SIZE);
+  file = make_partial_file (content, RECEIVED);
+  fail_unless (empathy_file_resume_save (file, FILE_SIZE, hash, NULL));
+
+  /* Some data made it to the disk after the state was saved */
+  path = g_file_get_path (file);
+  fd = g_open (path, O_WRONLY | O_APPEND, 0);
+  fail_unless (write (fd, content + RECEIVED, 1000) == 1000);
+  close (fd);
+
+  sender = bench_connection_ensure_handle (conn, TP_HANDLE_TYPE_CONTACT,
+      "sender@bench");
+  channel = bench_connection_new_file_channel (conn, sender, "resumed",
+      content, FILE_SIZE, TP_FILE_HASH_TYPE_MD5, hash);
+
+  /* Opened the way the transfer manager gets it from the dispatcher */
+  tp_channel = tp_channel_new (connection,
+      bench_ft_channel_get_object_path (channel),
+      TP_IFACE_CHANNEL_TYPE_FILE_TRANSFER, TP_HANDLE_TYPE_CONTACT, sender,
+      &error);
+  fail_if (tp_channel == NULL);
+  tp_channel_call_when_ready (tp_channel, channel_ready_cb, loop);
+  g_main_loop_run (loop);
+
+  tp_file = empathy_tp_file_new (tp_channel);
+  g_signal_connect (tp_file, "notify::ready",
+      G_CALLBACK (tp_file_ready_cb), loop);
+  if (!empathy_tp_file_is_ready (tp_file))
+    g_main_loop_run (loop);
+  g_signal_handlers_disconnect_by_func (tp_file, tp_file_ready_cb, loop);
+
+  offset = empathy_tp_file_get_resume_offset (tp_file, file);
+  fail_if (offset != RECEIVED);
+
+  /* The resumed file is hashed as a whole once the copy is done */
+  g_signal_connect (tp_file, "content-hash-checked",
+      G_CALLBACK (tp_file_content_hash_checked_cb), loop);
+  empathy_tp_file_accept (tp_file, offset, file, &error);
+  fail_if (error != NULL);
+  g_main_loop_run (loop);
+
+  fail_if (channel->initial_offset != RECEIVED);
+  fail_if (channel->transferred != FILE_SIZE);
+
+  fail_unless (g_file_get_contents (path, &result, &len, NULL));
+  fail_if (len != FILE_SIZE);
+  fail_if (memcmp (result, content, FILE_SIZE) != 0);
+
+  g_object_unref (tp_file);
+  g_object_unref (tp_channel);
+  g_object_unref (connection);
+  g_object_unref (daemon);
+  g_object_unref (conn);
+  g_main_loop_unref (loop);
+  g_free (result);
+  g_free (path);
+  g_free (hash);
+  destroy_partial_file (file);
+  g_free (content);
+}
+END_TEST
+
+TCase *
+make_empathy_file_resume_tcase (void)
+{
+    TCase *tc = tcase_create ("empathy-file-resume");
+    tcase_add_test (tc, test_empathy_file_resume_offset);
+    tcase_add_test (tc, test_empathy_file_resume_modified);
+    tcase_add_test (tc, test_empathy_file_resume_transfer);
+    return tc;
+}
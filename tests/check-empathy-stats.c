@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <check.h>
+#include "check-helpers.h"
+#include "check-libempathy.h"
+
+#include <libempathy/empathy-stats.h>
+
+START_TEST (test_empathy_stats_counter)
+{
+  EmpathyStat *stat;
+  EmpathyStatValue value;
+  guint i;
+
+  stat = empathy_stat_get ("check.counter", EMPATHY_STAT_COUNTER);
+  fail_if (stat == NULL);
+  fail_unless (empathy_stat_get ("check.counter", EMPATHY_STAT_COUNTER) ==
+      stat);
+
+  for (i = 0; i < 3; i++)
+    EMPATHY_STAT_ADD ("check.counter", EMPATHY_STAT_COUNTER, 10);
+
+  empathy_stat_get_value (stat, &value);
+  fail_unless (!strcmp (value.name, "check.counter"));
+  fail_unless (value.type == EMPATHY_STAT_COUNTER);
+  fail_unless (value.value == 30);
+  fail_unless (value.count == 3);
+}
+END_TEST
+
+START_TEST (test_empathy_stats_gauge)
+{
+  EmpathyStat *stat;
+  EmpathyStatValue value;
+
+  stat = empathy_stat_get ("check.gauge", EMPATHY_STAT_GAUGE);
+  empathy_stat_add (stat, 5);
+  empathy_stat_add (stat, -3);
+  empathy_stat_add (stat, -4);
+
+  empathy_stat_get_value (stat, &value);
+  fail_unless (value.value == -2);
+}
+END_TEST
+
+START_TEST (test_empathy_stats_histogram)
+{
+  EmpathyStat *stat;
+  EmpathyStatValue value;
+
+  stat = empathy_stat_get ("check.histogram", EMPATHY_STAT_HISTOGRAM);
+  empathy_stat_record (stat, 0);
+  empathy_stat_record (stat, 1);
+  empathy_stat_record (stat, 2);
+  empathy_stat_record (stat, 3);
+  empathy_stat_record (stat, 1000);
+  empathy_stat_record (stat, G_MAXUINT64);
+
+  empathy_stat_get_value (stat, &value);
+  fail_unless (value.count == 6);
+  fail_unless (value.max == G_MAXUINT64);
+  fail_unless (value.buckets[0] == 1);
+  fail_unless (value.buckets[1] == 1);
+  fail_unless (value.buckets[2] == 2);
+  /* 512 <= 1000 < 1024 */
+  fail_unless (value.buckets[10] == 1);
+  fail_unless (value.buckets[EMPATHY_STAT_N_BUCKETS - 1] == 1);
+}
+END_TEST
+
+START_TEST (test_empathy_stats_list)
+{
+  GList *list, *l;
+  const gchar *previous = NULL;
+  gboolean found = FALSE;
+
+  empathy_stat_get ("check.list-b", EMPATHY_STAT_COUNTER);
+  empathy_stat_get ("check.list-a", EMPATHY_STAT_COUNTER);
+
+  list = empathy_stats_list ();
+  for (l = list; l != NULL; l = l->next)
+    {
+      EmpathyStatValue value;
+
+      empathy_stat_get_value (l->data, &value);
+      if (previous != NULL)
+        fail_unless (strcmp (previous, value.name) < 0);
+      previous = value.name;
+
+      if (!strcmp (value.name, "check.list-a"))
+        found = TRUE;
+    }
+  g_list_free (list);
+
+  fail_unless (found);
+}
+END_TEST
+
+TCase *
+make_empathy_stats_tcase (void)
+{
+    TCase *tc = tcase_create ("empathy-stats");
+    tcase_add_test (tc, test_empathy_stats_counter);
+    tcase_add_test (tc, test_empathy_stats_gauge);
+    tcase_add_test (tc, test_empathy_stats_histogram);
+    tcase_add_test (tc, test_empathy_stats_list);
+    return tc;
+}
@@ -0,0 +1,133 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include <check.h>
+#include "check-helpers.h"
+#include "check-libempathy.h"
+
+#include <libempathy/empathy-debug.h>
+
+/* Counts the lines of the dumped trace that contain all the words */
+static guint
+count_lines (const gchar *contents,
+             const gchar *first_word,
+             ...)
+{
+  gchar **lines;
+  guint i, n = 0;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      const gchar *word;
+      gboolean match = TRUE;
+      va_list args;
+
+      va_start (args, first_word);
+      for (word = first_word; word != NULL; word = va_arg (args, const gchar *))
+        {
+          if (strstr (lines[i], word) == NULL)
+            match = FALSE;
+        }
+      va_end (args);
+
+      if (match)
+        n++;
+    }
+  g_strfreev (lines);
+
+  return n;
+}
+
+static gchar *
+dump_trace (void)
+{
+  gchar *path;
+  gchar *contents;
+  gint fd;
+
+  fd = g_file_open_tmp ("check-empathy-trace-XXXXXX", &path, NULL);
+  fail_if (fd < 0);
+  close (fd);
+
+  fail_unless (empathy_trace_dump (path, NULL));
+  fail_unless (g_file_get_contents (path, &contents, NULL, NULL));
+
+  g_unlink (path);
+  g_free (path);
+
+  return contents;
+}
+
+static guint64
+count_evaluations (guint64 *n)
+{
+  return ++*n;
+}
+
+START_TEST (test_empathy_trace_record)
+{
+  gchar *contents;
+  guint64 evaluated = 0;
+
+  empathy_trace_set_flags ("Chat");
+
+  EMPATHY_TRACE_BEGIN (EMPATHY_DEBUG_CHAT, "check-span", 42);
+  EMPATHY_TRACE_MARK (EMPATHY_DEBUG_CHAT, "check-mark",
+      count_evaluations (&evaluated));
+  EMPATHY_TRACE_END (EMPATHY_DEBUG_CHAT, "check-span", 42);
+
+  /* Not traced, its value isn't evaluated */
+  EMPATHY_TRACE_MARK (EMPATHY_DEBUG_FT, "check-disabled",
+      count_evaluations (&evaluated));
+  fail_unless (evaluated == 1);
+
+  contents = dump_trace ();
+  fail_unless (count_lines (contents, " Chat begin check-span 42", NULL) == 1);
+  fail_unless (count_lines (contents, " Chat end check-span 42", NULL) == 1);
+  fail_unless (count_lines (contents, " Chat mark check-mark 1", NULL) == 1);
+  fail_unless (count_lines (contents, "check-disabled", NULL) == 0);
+
+  /* Begin comes before end */
+  fail_unless (strstr (contents, "begin check-span") <
+      strstr (contents, "end check-span"));
+
+  g_free (contents);
+}
+END_TEST
+
+START_TEST (test_empathy_trace_wrap)
+{
+  gchar *contents;
+  guint i;
+
+  empathy_trace_set_flags ("Chat");
+
+  /* Fill the ring more than once, only the newest events are kept */
+  EMPATHY_TRACE_MARK (EMPATHY_DEBUG_CHAT, "check-old", 0);
+  for (i = 0; i < 20000; i++)
+    EMPATHY_TRACE_MARK (EMPATHY_DEBUG_CHAT, "check-wrap", i);
+
+  contents = dump_trace ();
+  fail_unless (count_lines (contents, "check-old", NULL) == 0);
+  fail_unless (count_lines (contents, "check-wrap 19999", NULL) == 1);
+  fail_unless (count_lines (contents, "check-wrap", NULL) > 0);
+  fail_unless (count_lines (contents, "check-wrap", NULL) < 20000);
+
+  g_free (contents);
+}
+END_TEST
+
+TCase *
+make_empathy_trace_tcase (void)
+{
+    TCase *tc = tcase_create ("empathy-trace");
+    tcase_add_test (tc, test_empathy_trace_record);
+    tcase_add_test (tc, test_empathy_trace_wrap);
+    return tc;
+}
@@ -7,5 +7,9 @@ TCase * make_empathy_irc_network_tcase (void);
 TCase * make_empathy_irc_network_manager_tcase (void);
 TCase * make_empathy_chatroom_tcase (void);
 TCase * make_empathy_chatroom_manager_tcase (void);
+TCase * make_empathy_file_resume_tcase (void);
+TCase * make_empathy_channel_classes_tcase (void);
+TCase * make_empathy_trace_tcase (void);
+TCase * make_empathy_stats_tcase (void);
 
 #endif /* #ifndef __CHECK_LIBEMPATHY__ */
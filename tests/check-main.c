@@ -22,6 +22,10 @@ make_libempathy_suite (void)
     suite_add_tcase (s, make_empathy_irc_network_manager_tcase ());
     suite_add_tcase (s, make_empathy_chatroom_tcase ());
     suite_add_tcase (s, make_empathy_chatroom_manager_tcase ());
+    suite_add_tcase (s, make_empathy_file_resume_tcase ());
+    suite_add_tcase (s, make_empathy_channel_classes_tcase ());
+    suite_add_tcase (s, make_empathy_trace_tcase ());
+    suite_add_tcase (s, make_empathy_stats_tcase ());
 
     return s;
 }
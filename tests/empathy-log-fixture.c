@@ -0,0 +1,111 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2009 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Fills a directory with years of synthetic conversations, to try the log
+ * viewer and the chat backlog on a realistic history:
+ *
+ *   empathy-log-fixture DIRECTORY ACCOUNT...
+ *   EMPATHY_LOG_DIR=DIRECTORY empathy
+ *
+ * ACCOUNTs are the unique names of existing accounts, as found in
+ * ~/.gnome2/Empathy/logs; logs of unknown accounts are ignored. */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "bench-log-fixture.h"
+
+int
+main (int argc, char **argv)
+{
+	BenchLogFixture       fixture;
+	BenchLogFixtureStats  stats;
+	GOptionContext       *context;
+	GError               *error = NULL;
+	gint                  n_contacts, n_rooms, n_days;
+	gint                  activity, n_messages;
+	gint                  seed;
+	GOptionEntry          options[] = {
+		{ "contacts", 0, 0, G_OPTION_ARG_INT, &n_contacts,
+		  "1-1 chats per account", "N" },
+		{ "rooms", 0, 0, G_OPTION_ARG_INT, &n_rooms,
+		  "Chatrooms per account", "N" },
+		{ "days", 0, 0, G_OPTION_ARG_INT, &n_days,
+		  "Days of history", "N" },
+		{ "activity", 0, 0, G_OPTION_ARG_INT, &activity,
+		  "Percentage of days each chat was used", "PERCENT" },
+		{ "messages", 0, 0, G_OPTION_ARG_INT, &n_messages,
+		  "Average messages per chat and day", "N" },
+		{ "seed", 0, 0, G_OPTION_ARG_INT, &seed,
+		  "Seed of the generator", "N" },
+		{ NULL }
+	};
+
+	bench_log_fixture_init (&fixture);
+	n_contacts = fixture.n_contacts;
+	n_rooms = fixture.n_rooms;
+	n_days = fixture.n_days;
+	activity = fixture.activity;
+	n_messages = fixture.n_messages;
+	seed = fixture.seed;
+
+	context = g_option_context_new ("DIRECTORY ACCOUNT...");
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	if (argc < 3) {
+		g_printerr ("Usage: %s [OPTION...] DIRECTORY ACCOUNT...\n",
+			    g_get_prgname ());
+		return EXIT_FAILURE;
+	}
+
+	if (n_contacts < 0 || n_rooms < 0 || n_days < 0 || n_messages < 0 ||
+	    activity < 0 || activity > 100) {
+		g_printerr ("Counts can't be negative, and activity is a "
+			    "percentage\n");
+		return EXIT_FAILURE;
+	}
+
+	fixture.n_contacts = n_contacts;
+	fixture.n_rooms = n_rooms;
+	fixture.n_days = n_days;
+	fixture.activity = activity;
+	fixture.n_messages = n_messages;
+	fixture.seed = seed;
+	if (!bench_log_fixture_generate (&fixture, argv[1],
+					 (const gchar * const *) argv + 2,
+					 &stats, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		return EXIT_FAILURE;
+	}
+
+	g_print ("%u files, %u messages, %" G_GUINT64_FORMAT " bytes\n",
+		 stats.n_files, stats.n_messages, stats.n_bytes);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+#!/usr/bin/python
+
+# Prints the performance counters of a running Empathy.
+#
+# Usage: empathy-stats.py [PREFIX]
+#
+# Only the statistics whose name starts with PREFIX are printed, e.g.
+# "tp-chat." or "log-manager.".
+
+from sys import argv, exit, stderr
+
+import dbus
+
+BUS_NAME = 'org.gnome.Empathy.Stats'
+OBJECT_PATH = '/org/gnome/Empathy/Stats'
+INTERFACE = 'org.gnome.Empathy.Stats'
+
+COUNTER, GAUGE, HISTOGRAM = range(3)
+
+def bucket_label(i, n_buckets):
+    if i == 0:
+        return '<1us'
+    if i == n_buckets - 1:
+        return '>=%dus' % (1 << (i - 1))
+    return '%d-%dus' % (1 << (i - 1), (1 << i) - 1)
+
+def print_stat(name, type, value, count, sum, max, buckets):
+    if type == COUNTER:
+        print '%-45s counter   %d' % (name, value)
+    elif type == GAUGE:
+        print '%-45s gauge     %d' % (name, value)
+    elif type == HISTOGRAM:
+        if count > 0:
+            mean = float(sum) / count
+        else:
+            mean = 0
+        print '%-45s histogram %d samples, mean %.1fus, max %dus' % \
+            (name, count, mean, max)
+        for i, n in enumerate(buckets):
+            if n > 0:
+                print '%47s %-16s %d' % ('', bucket_label(i, len(buckets)), n)
+
+def main():
+    prefix = ''
+    if len(argv) > 1:
+        prefix = argv[1]
+
+    try:
+        stats = dbus.Interface(
+            dbus.SessionBus().get_object(BUS_NAME, OBJECT_PATH), INTERFACE)
+        values = stats.GetStats()
+    except dbus.DBusException, e:
+        print >> stderr, 'Could not get the statistics of Empathy: %s' % e
+        exit(1)
+
+    for stat in values:
+        if stat[0].startswith(prefix):
+            print_stat(*stat)
+
+if __name__ == '__main__':
+    main()